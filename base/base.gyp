@@ -130,6 +130,7 @@
         'time_win_unittest.cc',
         'timer_unittest.cc',
         'tools_sanity_unittest.cc',
+        'trace_event_unittest.cc',
         'tracked_objects_unittest.cc',
         'tuple_unittest.cc',
         'utf_offset_string_conversions_unittest.cc',
@@ -255,6 +256,42 @@
         }],
       ],
     },
+    {
+      'target_name': 'base_perftests',
+      'type': 'executable',
+      'msvs_guid': 'CFFD1A97-D9BA-4FD3-B647-02CE87D80FC9',
+      'dependencies': [
+        'base',
+        'base_i18n',
+        'test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'histogram_perftest.cc',
+        'message_loop_perftest.cc',
+        'timer_perftest.cc',
+        'trace_event_perftest.cc',
+        'worker_pool_linux_perftest.cc',
+      ],
+      'conditions': [
+        ['OS == "linux" or OS == "freebsd"', {
+          'dependencies': [
+            '../build/linux/system.gyp:gtk',
+            '../build/linux/system.gyp:nss',
+          ],
+        }, {  # OS != "linux" and OS != "freebsd"
+          'sources!': [
+            'worker_pool_linux_perftest.cc',
+          ],
+        }],
+        # This is needed to trigger the dll copy step on windows.
+        ['OS == "win"', {
+          'dependencies': [
+            '../third_party/icu/icu.gyp:icudata',
+          ],
+        }],
+      ],
+    },
   ],
   'conditions': [
     [ 'OS == "win"', {
@@ -12,14 +12,85 @@
 #include <math.h>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/logging.h"
 #include "base/pickle.h"
 #include "base/string_util.h"
+#include "base/thread_local_storage.h"
 
 using base::TimeDelta;
 
 typedef Histogram::Count Count;
 
+namespace {
+
+// The next index in the per-thread tables of samples.
+base::subtle::Atomic32 g_next_thread_samples_index = 0;
+
+size_t NextThreadSamplesIndex() {
+  return base::subtle::NoBarrier_AtomicIncrement(
+      &g_next_thread_samples_index, 1) - 1;
+}
+
+}  // namespace
+
+// The samples added by one thread to one histogram.  Only that thread adds to
+// them, so it does not lock.  SnapshotSample() reads them from other threads:
+// the counts are read whole, but a snapshot may see sum() and square_sum() in
+// the middle of an update on 32 bit platforms, which the next snapshot fixes.
+class Histogram::ThreadSamples
+    : public Histogram::SampleSet,
+      public base::RefCountedThreadSafe<Histogram::ThreadSamples> {
+ public:
+  explicit ThreadSamples(size_t bucket_count) : retired_(0) {
+    counts_.resize(bucket_count, 0);
+  }
+
+  // True once the thread exited, after which the samples do not change.
+  bool retired() const { return base::subtle::Acquire_Load(&retired_) != 0; }
+  void Retire() { base::subtle::Release_Store(&retired_, 1); }
+
+ private:
+  friend class base::RefCountedThreadSafe<Histogram::ThreadSamples>;
+
+  ~ThreadSamples() {}
+
+  base::subtle::Atomic32 retired_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadSamples);
+};
+
+// The TLS slot which holds the ThreadSamplesList of each thread.  The list is
+// deleted when the thread exits.
+class Histogram::ThreadSamplesSlot {
+ public:
+  ThreadSamplesSlot() : slot_(&DeleteThreadSamplesList) {}
+
+  ThreadSamplesList* Get() const {
+    return static_cast<ThreadSamplesList*>(slot_.Get());
+  }
+  void Set(ThreadSamplesList* list) { slot_.Set(list); }
+
+ private:
+  static void DeleteThreadSamplesList(void* value) {
+    ThreadSamplesList* list = static_cast<ThreadSamplesList*>(value);
+    for (ThreadSamplesList::iterator it = list->begin(); it != list->end();
+         ++it) {
+      if (it->get())
+        (*it)->Retire();
+    }
+    delete list;
+  }
+
+  ThreadLocalStorage::Slot slot_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadSamplesSlot);
+};
+
+// static
+base::LazyInstance<Histogram::ThreadSamplesSlot>
+    Histogram::thread_samples_slot_(base::LINKER_INITIALIZED);
+
 scoped_refptr<Histogram> Histogram::FactoryGet(const std::string& name,
     Sample minimum, Sample maximum, size_t bucket_count, Flags flags) {
   scoped_refptr<Histogram> histogram(NULL);
@@ -63,6 +134,7 @@ Histogram::Histogram(const std::string& name, Sample minimum,
     bucket_count_(bucket_count),
     flags_(kNoFlags),
     ranges_(bucket_count + 1, 0),
+    thread_samples_index_(NextThreadSamplesIndex()),
     sample_() {
   Initialize();
 }
@@ -75,6 +147,7 @@ Histogram::Histogram(const std::string& name, TimeDelta minimum,
     bucket_count_(bucket_count),
     flags_(kNoFlags),
     ranges_(bucket_count + 1, 0),
+    thread_samples_index_(NextThreadSamplesIndex()),
     sample_() {
   Initialize();
 }
@@ -102,6 +175,7 @@ void Histogram::Add(int value) {
 }
 
 void Histogram::AddSampleSet(const SampleSet& sample) {
+  AutoLock locked(lock_);
   sample_.Add(sample);
 }
 
@@ -277,23 +351,58 @@ double Histogram::GetBucketSize(Count current, size_t i) const {
 }
 
 //------------------------------------------------------------------------------
-// The following two methods can be overridden to provide a thread safe
-// version of this class.  The cost of locking is low... but an error in each
-// of these methods has minimal impact.  For now, I'll leave this unlocked,
-// and I don't believe I can loose more than a count or two.
+// The following two methods can be overridden to store the samples
+// differently.  Each thread has its own samples, so that adding a sample does
+// not lock, nor contend with other threads adding to the same buckets.
 // The vectors are NOT reallocated, so there is no risk of them moving around.
 
 // Update histogram data with new sample.
 void Histogram::Accumulate(Sample value, Count count, size_t index) {
-  // Note locking not done in this version!!!
-  sample_.Accumulate(value, count, index);
+  GetThreadSamples()->Accumulate(value, count, index);
 }
 
-// Do a safe atomic snapshot of sample data.
-// This implementation assumes we are on a safe single thread.
+// Add up the samples of all the threads.
 void Histogram::SnapshotSample(SampleSet* sample) const {
-  // Note locking not done in this version!!!
+  AutoLock locked(lock_);
+  // The samples of the threads which exited do not change anymore, so they
+  // are folded into |sample_|.
+  ThreadSamplesList::iterator it = thread_samples_.begin();
+  while (it != thread_samples_.end()) {
+    if ((*it)->retired()) {
+      sample_.Add(**it);
+      it = thread_samples_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
   *sample = sample_;
+  for (it = thread_samples_.begin(); it != thread_samples_.end(); ++it)
+    sample->Add(**it);
+}
+
+Histogram::ThreadSamples* Histogram::GetThreadSamples() {
+  ThreadSamplesSlot* slot = thread_samples_slot_.Pointer();
+  ThreadSamplesList* list = slot->Get();
+  if (list && thread_samples_index_ < list->size()) {
+    ThreadSamples* samples = (*list)[thread_samples_index_].get();
+    if (samples)
+      return samples;
+  }
+
+  // This is the first sample of this thread.
+  if (!list) {
+    list = new ThreadSamplesList;
+    slot->Set(list);
+  }
+  if (list->size() <= thread_samples_index_)
+    list->resize(thread_samples_index_ + 1);
+  ThreadSamples* samples = new ThreadSamples(bucket_count_);
+  (*list)[thread_samples_index_] = samples;
+
+  AutoLock locked(lock_);
+  thread_samples_.push_back(samples);
+  return samples;
 }
 
 //------------------------------------------------------------------------------
@@ -536,7 +645,19 @@ bool Histogram::SampleSet::Serialize(Pickle* pickle) const {
   pickle->WriteInt64(square_sum_);
   pickle->WriteSize(counts_.size());
 
+  // Only the buckets which have samples are written, as (index, count) pairs.
+  // The renderers send deltas to the browser, where most buckets are empty.
+  size_t non_empty_buckets = 0;
+  for (size_t index = 0; index < counts_.size(); ++index) {
+    if (counts_[index])
+      ++non_empty_buckets;
+  }
+  pickle->WriteSize(non_empty_buckets);
+
   for (size_t index = 0; index < counts_.size(); ++index) {
+    if (!counts_[index])
+      continue;
+    pickle->WriteSize(index);
     pickle->WriteInt(counts_[index]);
   }
 
@@ -549,21 +670,28 @@ bool Histogram::SampleSet::Deserialize(void** iter, const Pickle& pickle) {
   DCHECK_EQ(square_sum_, 0);
 
   size_t counts_size;
+  size_t non_empty_buckets;
 
   if (!pickle.ReadInt64(iter, &sum_) ||
       !pickle.ReadInt64(iter, &square_sum_) ||
-      !pickle.ReadSize(iter, &counts_size)) {
+      !pickle.ReadSize(iter, &counts_size) ||
+      !pickle.ReadSize(iter, &non_empty_buckets)) {
     return false;
   }
 
-  if (counts_size == 0)
+  if (counts_size == 0 || INT_MAX / sizeof(Count) <= counts_size ||
+      non_empty_buckets > counts_size)
     return false;
 
-  for (size_t index = 0; index < counts_size; ++index) {
-    int i;
-    if (!pickle.ReadInt(iter, &i))
+  counts_.resize(counts_size, 0);
+  for (size_t i = 0; i < non_empty_buckets; ++i) {
+    size_t index;
+    int count;
+    if (!pickle.ReadSize(iter, &index) || !pickle.ReadInt(iter, &count))
+      return false;
+    if (index >= counts_size)
       return false;
-    counts_.push_back(i);
+    counts_[index] = count;
   }
 
   return true;
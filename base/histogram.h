@@ -28,6 +28,10 @@
 // at the low end of the histogram scale, but allows the histogram to cover a
 // gigantic range with the addition of very few buckets.
 
+// Each thread adds its samples to its own copy of the buckets, so adding a
+// sample takes no lock, and threads do not contend on the same counters.  The
+// copies of all the threads are added up when the histogram is snapshotted.
+
 #ifndef BASE_HISTOGRAM_H_
 #define BASE_HISTOGRAM_H_
 
@@ -35,6 +39,7 @@
 #include <string>
 #include <vector>
 
+#include "base/lazy_instance.h"
 #include "base/lock.h"
 #include "base/ref_counted.h"
 #include "base/logging.h"
@@ -338,8 +343,7 @@ class Histogram : public base::RefCountedThreadSafe<Histogram> {
   Sample declared_max() const { return declared_max_; }
   virtual Sample ranges(size_t i) const { return ranges_[i];}
   virtual size_t bucket_count() const { return bucket_count_; }
-  // Snapshot the current complete set of sample data.
-  // Override with atomic/locked snapshot if needed.
+  // Snapshot the current complete set of sample data, from all the threads.
   virtual void SnapshotSample(SampleSet* sample) const;
 
   virtual bool HasConstructorArguments(Sample minimum, Sample maximum,
@@ -383,9 +387,10 @@ class Histogram : public base::RefCountedThreadSafe<Histogram> {
   virtual const std::string GetAsciiBucketRange(size_t it) const;
 
   //----------------------------------------------------------------------------
-  // Methods to override to create thread safe histogram.
+  // Methods to override to store samples differently.
   //----------------------------------------------------------------------------
-  // Update all our internal data, including histogram
+  // Update all our internal data, including histogram.  Adds to the calling
+  // thread's samples, without locking.
   virtual void Accumulate(Sample value, Count count, size_t index);
 
   //----------------------------------------------------------------------------
@@ -398,9 +403,17 @@ class Histogram : public base::RefCountedThreadSafe<Histogram> {
   bool ValidateBucketRanges() const;
 
  private:
+  class ThreadSamples;
+  class ThreadSamplesSlot;
+
+  typedef std::vector<scoped_refptr<ThreadSamples> > ThreadSamplesList;
+
   // Post constructor initialization.
   void Initialize();
 
+  // Returns the calling thread's samples, creating them on its first sample.
+  ThreadSamples* GetThreadSamples();
+
   //----------------------------------------------------------------------------
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
 
@@ -448,9 +461,22 @@ class Histogram : public base::RefCountedThreadSafe<Histogram> {
   // The dimension of ranges_ is bucket_count + 1.
   Ranges ranges_;
 
+  // The index of this histogram in the per-thread tables of samples.
+  const size_t thread_samples_index_;
+
   // Finally, provide the state that changes with the addition of each new
-  // sample.
-  SampleSet sample_;
+  // sample.  SnapshotSample() adds up |sample_| and the samples of each
+  // thread.
+  mutable Lock lock_;  // Protects the two variables below.
+  // The samples passed to AddSampleSet(), and those of the threads which
+  // exited.
+  mutable SampleSet sample_;
+  // The samples of each thread which added samples, and did not exit yet.
+  mutable ThreadSamplesList thread_samples_;
+
+  // Holds the calling thread's samples of all the histograms, in a
+  // ThreadSamplesList indexed by |thread_samples_index_|.
+  static base::LazyInstance<ThreadSamplesSlot> thread_samples_slot_;
 
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
@@ -0,0 +1,57 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/histogram.h"
+#include "base/perftimer.h"
+#include "base/platform_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Adds |num_samples| samples, from 0 to 99, to |histogram|.
+class AddSamplesThread : public PlatformThread::Delegate {
+ public:
+  AddSamplesThread(Histogram* histogram, int num_samples)
+      : histogram_(histogram), num_samples_(num_samples) {}
+
+  virtual void ThreadMain() {
+    for (int i = 0; i < num_samples_; ++i)
+      histogram_->Add(i % 100);
+  }
+
+ private:
+  Histogram* histogram_;
+  const int num_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddSamplesThread);
+};
+
+}  // namespace
+
+// Measures how long it takes to add samples from several threads at once.
+TEST(HistogramPerfTest, AddSamplesFromThreads) {
+  const int kNumThreads = 4;
+  const int kNumSamples = 1000000;
+  scoped_refptr<Histogram> histogram = Histogram::FactoryGet(
+      "ThreadSamplesPerformance", 1, 100, 50, Histogram::kNoFlags);
+
+  std::vector<AddSamplesThread*> delegates;
+  std::vector<PlatformThreadHandle> threads(kNumThreads);
+  PerfTimeLogger timer("Histogram_add_samples_from_threads");
+  for (int i = 0; i < kNumThreads; ++i) {
+    delegates.push_back(new AddSamplesThread(histogram, kNumSamples));
+    ASSERT_TRUE(PlatformThread::Create(0, delegates[i], &threads[i]));
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    PlatformThread::Join(threads[i]);
+    delete delegates[i];
+  }
+  timer.Done();
+
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  EXPECT_EQ(kNumThreads * kNumSamples, sample.TotalCount());
+}
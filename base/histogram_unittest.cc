@@ -5,6 +5,8 @@
 // Test of Histogram class
 
 #include "base/histogram.h"
+#include "base/pickle.h"
+#include "base/platform_thread.h"
 #include "base/string_util.h"
 #include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -225,4 +227,108 @@ TEST(HistogramTest, BucketPlacementTest) {
 }
 
 
+// Adds |num_samples| samples, from 0 to 99, to |histogram|.
+class AddSamplesThread : public PlatformThread::Delegate {
+ public:
+  AddSamplesThread(Histogram* histogram, int num_samples)
+      : histogram_(histogram), num_samples_(num_samples) {}
+
+  virtual void ThreadMain() {
+    for (int i = 0; i < num_samples_; ++i)
+      histogram_->Add(i % 100);
+  }
+
+ private:
+  Histogram* histogram_;
+  const int num_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddSamplesThread);
+};
+
+// Runs |num_threads| AddSamplesThreads on |histogram|, and returns once they
+// exited.
+void AddSamplesFromThreads(Histogram* histogram, int num_threads,
+                           int num_samples) {
+  std::vector<AddSamplesThread*> delegates;
+  std::vector<PlatformThreadHandle> threads(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    delegates.push_back(new AddSamplesThread(histogram, num_samples));
+    ASSERT_TRUE(PlatformThread::Create(0, delegates[i], &threads[i]));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    PlatformThread::Join(threads[i]);
+    delete delegates[i];
+  }
+}
+
+// The samples of all the threads are added up, including those of the threads
+// which exited.
+TEST(HistogramTest, ThreadSamplesTest) {
+  const int kNumThreads = 4;
+  const int kNumSamples = 10000;
+  scoped_refptr<Histogram> histogram = LinearHistogram::FactoryGet(
+      "ThreadSamples", 1, 100, 101, Histogram::kNoFlags);
+
+  histogram->Add(50);
+  AddSamplesFromThreads(histogram, kNumThreads, kNumSamples);
+
+  // Each thread added (0 + 1 + ... + 99) * kNumSamples / 100.
+  const int64 kThreadSum = 4950 * kNumSamples / 100;
+  for (int snapshots = 0; snapshots < 2; ++snapshots) {
+    Histogram::SampleSet sample;
+    histogram->SnapshotSample(&sample);
+    EXPECT_EQ(kNumThreads * kNumSamples + 1, sample.TotalCount());
+    EXPECT_EQ(kNumThreads * kThreadSum + 50, sample.sum());
+    EXPECT_EQ(kNumThreads * kNumSamples / 100, sample.counts(1));
+    EXPECT_EQ(kNumThreads * kNumSamples / 100 + 1, sample.counts(50));
+  }
+
+  // Samples added after the threads exited are counted too.
+  histogram->Add(50);
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  EXPECT_EQ(kNumThreads * kNumSamples + 2, sample.TotalCount());
+}
+
+// Only the buckets which have samples are serialized.
+TEST(HistogramTest, SerializeNonEmptyBucketsTest) {
+  const size_t kBucketCount = 50;
+  scoped_refptr<Histogram> histogram = Histogram::FactoryGet(
+      "Serialized", 1, 1000, kBucketCount, Histogram::kNoFlags);
+  histogram->Add(1);
+  histogram->Add(500);
+  histogram->Add(500);
+
+  Histogram::SampleSet sample;
+  histogram->SnapshotSample(&sample);
+  Pickle pickle;
+  EXPECT_TRUE(sample.Serialize(&pickle));
+  EXPECT_GT(static_cast<int>(kBucketCount * sizeof(Histogram::Count)),
+            pickle.size());
+
+  Histogram::SampleSet deserialized;
+  void* iter = NULL;
+  ASSERT_TRUE(deserialized.Deserialize(&iter, pickle));
+  deserialized.CheckSize(*histogram);
+  EXPECT_EQ(3, deserialized.TotalCount());
+  EXPECT_EQ(1001, deserialized.sum());
+  EXPECT_EQ(sample.square_sum(), deserialized.square_sum());
+  for (size_t i = 0; i < kBucketCount; ++i)
+    EXPECT_EQ(sample.counts(i), deserialized.counts(i));
+}
+
+TEST(HistogramTest, DeserializeBadBucketIndexTest) {
+  Pickle pickle;
+  pickle.WriteInt64(10);
+  pickle.WriteInt64(100);
+  pickle.WriteSize(8);  // Bucket count.
+  pickle.WriteSize(1);  // Non empty buckets.
+  pickle.WriteSize(8);  // Out of range.
+  pickle.WriteInt(1);
+
+  Histogram::SampleSet sample;
+  void* iter = NULL;
+  EXPECT_FALSE(sample.Deserialize(&iter, pickle));
+}
+
 }  // namespace
@@ -66,6 +66,127 @@ static LPTOP_LEVEL_EXCEPTION_FILTER GetTopSEHFilter() {
 
 #endif  // defined(OS_WIN)
 
+//------------------------------------------------------------------------------
+// MessageLoop::IncomingTaskQueue
+
+// An intrusive, lock-free, multiple producer, single consumer queue of tasks.
+// Any thread may push, and only the thread of the MessageLoop pops.  The tasks
+// are linked through Task::next_incoming_task_, and the queue always holds at
+// least one node (|stub_| when it is otherwise empty), so that producers never
+// have to touch the consumer's end.
+//
+// The queue also batches the wake-ups of the message pump: only the first
+// task pushed after the MessageLoop started draining the queue schedules work.
+class MessageLoop::IncomingTaskQueue
+    : public base::RefCountedThreadSafe<MessageLoop::IncomingTaskQueue> {
+ public:
+  explicit IncomingTaskQueue(base::MessagePump* pump)
+      : pump_(pump),
+        head_(reinterpret_cast<base::subtle::AtomicWord>(&stub_)),
+        tail_(&stub_),
+        wakeup_pending_(0) {
+  }
+
+  // Appends |task|, and schedules work on the pump unless a wake-up is
+  // already pending.  Possibly called on a background thread!
+  void Push(Task* task) {
+    Link(task);
+
+    // This barrier pairs with the one in ClearWakeUp: either the loop sees
+    // |task| while it drains the queue, or we see that the wake-up it was
+    // draining for is gone.
+    base::subtle::MemoryBarrier();
+    if (base::subtle::NoBarrier_Load(&wakeup_pending_))
+      return;  // Someone else has started the sub-pump.
+    if (base::subtle::NoBarrier_CompareAndSwap(&wakeup_pending_, 0, 1) == 0)
+      pump_->ScheduleWork();
+  }
+
+  // Called by the loop before it drains the queue, so that the next push
+  // schedules work again.
+  void ClearWakeUp() {
+    base::subtle::NoBarrier_Store(&wakeup_pending_, 0);
+    base::subtle::MemoryBarrier();
+  }
+
+  // Removes and returns the oldest task, or returns NULL if the queue is
+  // empty.  It also returns NULL when the next task is still being pushed; the
+  // thread pushing it will then schedule work.
+  Task* Pop() {
+    Task* tail = tail_;
+    Task* next = Next(tail);
+    if (tail == &stub_) {
+      if (!next)
+        return NULL;
+      tail_ = next;
+      tail = next;
+      next = Next(next);
+    }
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != reinterpret_cast<Task*>(base::subtle::Acquire_Load(&head_)))
+      return NULL;  // A push is in progress.
+
+    // |tail| is the last task: put the stub back behind it, so that popping
+    // |tail| does not leave the queue without a node.
+    Link(&stub_);
+    next = Next(tail);
+    if (!next)
+      return NULL;
+    tail_ = next;
+    return tail;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<IncomingTaskQueue>;
+
+  class StubTask : public Task {
+   public:
+    virtual void Run() {
+      NOTREACHED();
+    }
+  };
+
+  ~IncomingTaskQueue() {}
+
+  static Task* Next(Task* task) {
+    return reinterpret_cast<Task*>(
+        base::subtle::Acquire_Load(&task->next_incoming_task_));
+  }
+
+  // Makes |task| the new head of the queue.  Wait-free.
+  void Link(Task* task) {
+    base::subtle::NoBarrier_Store(&task->next_incoming_task_, 0);
+    // The exchange is a full barrier on all the platforms we build for, so it
+    // also publishes the store above.
+    Task* previous = reinterpret_cast<Task*>(
+        base::subtle::NoBarrier_AtomicExchange(
+            &head_, reinterpret_cast<base::subtle::AtomicWord>(task)));
+    // Until this store, the consumer sees the queue end at |previous|.
+    base::subtle::Release_Store(
+        &previous->next_incoming_task_,
+        reinterpret_cast<base::subtle::AtomicWord>(task));
+  }
+
+  scoped_refptr<base::MessagePump> pump_;
+
+  // The last task pushed.  Shared by all the producers.
+  base::subtle::AtomicWord head_;
+
+  // The next task to pop.  Only used by the consumer.
+  Task* tail_;
+
+  StubTask stub_;
+
+  // Non-zero while the pump has work scheduled that has not drained the
+  // queue yet.
+  base::subtle::Atomic32 wakeup_pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
+};
+
 //------------------------------------------------------------------------------
 
 // static
@@ -108,6 +229,8 @@ MessageLoop::MessageLoop(Type type)
     pump_ = new base::MessagePumpDefault();
   }
 #endif  // OS_POSIX
+
+  incoming_queue_ = new IncomingTaskQueue(pump_);
 }
 
 MessageLoop::~MessageLoop() {
@@ -259,10 +382,9 @@ void MessageLoop::PostTask_Helper(
     bool nestable) {
   task->SetBirthPlace(from_here);
 
-  PendingTask pending_task(task, nestable);
-
+  task->nestable_ = nestable;
   if (delay_ms > 0) {
-    pending_task.delayed_run_time =
+    task->delayed_run_time_ =
         Time::Now() + TimeDelta::FromMilliseconds(delay_ms);
   } else {
     DCHECK_EQ(delay_ms, 0) << "delay should not be negative";
@@ -272,23 +394,24 @@ void MessageLoop::PostTask_Helper(
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  scoped_refptr<base::MessagePump> pump;
-  {
-    AutoLock locked(incoming_queue_lock_);
+  // Since the incoming_queue_ may contain a task that destroys this message
+  // loop, we cannot use |this| once |task| is pushed.  We use a stack-based
+  // reference to the queue, which keeps the message pump alive, so that Push
+  // can wake up the pump after that.
+  scoped_refptr<IncomingTaskQueue> queue(incoming_queue_);
+  queue->Push(task);
+}
 
-    bool was_empty = incoming_queue_.empty();
-    incoming_queue_.push(pending_task);
-    if (!was_empty)
-      return;  // Someone else should have started the sub-pump.
+void MessageLoop::CancelDelayedTask(Task* task) {
+  DCHECK(this == current());
 
-    pump = pump_;
+  if (task->delayed_task_index_ < 0) {
+    // The task is still in the incoming_queue_ or the work_queue_.
+    task->cancelled_ = true;
+    return;
   }
-  // Since the incoming_queue_ may contain a task that destroys this message
-  // loop, we cannot exit incoming_queue_lock_ until we are done with |this|.
-  // We use a stack-based reference to the message pump so that we can call
-  // ScheduleWork outside of incoming_queue_lock_.
-
-  pump->ScheduleWork();
+  delayed_work_queue_.Remove(task);
+  delete task;
 }
 
 void MessageLoop::SetNestableTasksAllowed(bool allowed) {
@@ -313,6 +436,11 @@ bool MessageLoop::IsNested() {
 
 void MessageLoop::RunTask(Task* task) {
   DCHECK(nestable_tasks_allowed_);
+  if (task->cancelled_) {
+    delete task;
+    return;
+  }
+
   // Execute the task and assume the worst: It is probably not reentrant.
   nestable_tasks_allowed_ = false;
 
@@ -350,18 +478,18 @@ void MessageLoop::AddToDelayedWorkQueue(const PendingTask& pending_task) {
 void MessageLoop::ReloadWorkQueue() {
   // We can improve performance of our loading tasks from incoming_queue_ to
   // work_queue_ by waiting until the last minute (work_queue_ is empty) to
-  // load.  That reduces the number of locks-per-task significantly when our
-  // queues get large.
+  // load.  Until then, posting threads see that a wake-up is pending, and
+  // don't schedule work on the pump.
   if (!work_queue_.empty())
-    return;  // Wait till we *really* need to lock and load.
-
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  {
-    AutoLock lock(incoming_queue_lock_);
-    if (incoming_queue_.empty())
-      return;
-    incoming_queue_.Swap(&work_queue_);  // Constant time
-    DCHECK(incoming_queue_.empty());
+    return;  // Wait till we *really* need to load.
+
+  // Acquire all we can from the inter-thread queue.  Tasks pushed from now on
+  // wake up the pump again, unless we get to them first.
+  incoming_queue_->ClearWakeUp();
+  while (Task* task = incoming_queue_->Pop()) {
+    PendingTask pending_task(task, task->nestable_);
+    pending_task.delayed_run_time = task->delayed_run_time_;
+    work_queue_.push(pending_task);
   }
 }
 
@@ -426,7 +554,9 @@ bool MessageLoop::DoWork() {
     do {
       PendingTask pending_task = work_queue_.front();
       work_queue_.pop();
-      if (!pending_task.delayed_run_time.is_null()) {
+      if (pending_task.task->cancelled_) {
+        delete pending_task.task;
+      } else if (!pending_task.delayed_run_time.is_null()) {
         AddToDelayedWorkQueue(pending_task);
         // If we changed the topmost task, then it is time to re-schedule.
         if (delayed_work_queue_.top().task == pending_task.task)
@@ -515,6 +645,73 @@ bool MessageLoop::PendingTask::operator<(const PendingTask& other) const {
   return (sequence_num - other.sequence_num) > 0;
 }
 
+//------------------------------------------------------------------------------
+// MessageLoop::DelayedTaskQueue
+
+void MessageLoop::DelayedTaskQueue::push(const PendingTask& pending_task) {
+  heap_.push_back(pending_task);
+  SiftUp(heap_.size() - 1, pending_task);
+}
+
+void MessageLoop::DelayedTaskQueue::pop() {
+  RemoveAt(0);
+}
+
+void MessageLoop::DelayedTaskQueue::Remove(Task* task) {
+  size_t index = static_cast<size_t>(task->delayed_task_index_);
+  DCHECK(index < heap_.size() && heap_[index].task == task);
+  RemoveAt(index);
+}
+
+void MessageLoop::DelayedTaskQueue::SiftUp(size_t index,
+                                           const PendingTask& pending_task) {
+  // The top of the heap is the "greatest" element, see PendingTask::operator<.
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (!(heap_[parent] < pending_task))
+      break;
+    Place(index, heap_[parent]);
+    index = parent;
+  }
+  Place(index, pending_task);
+}
+
+void MessageLoop::DelayedTaskQueue::SiftDown(size_t index,
+                                             const PendingTask& pending_task) {
+  for (;;) {
+    size_t child = 2 * index + 1;
+    if (child >= heap_.size())
+      break;
+    if (child + 1 < heap_.size() && heap_[child] < heap_[child + 1])
+      ++child;
+    if (!(pending_task < heap_[child]))
+      break;
+    Place(index, heap_[child]);
+    index = child;
+  }
+  Place(index, pending_task);
+}
+
+void MessageLoop::DelayedTaskQueue::Place(size_t index,
+                                          const PendingTask& pending_task) {
+  heap_[index] = pending_task;
+  pending_task.task->delayed_task_index_ = static_cast<int>(index);
+}
+
+void MessageLoop::DelayedTaskQueue::RemoveAt(size_t index) {
+  heap_[index].task->delayed_task_index_ = -1;
+  PendingTask last = heap_.back();
+  heap_.pop_back();
+  if (index == heap_.size())
+    return;
+
+  // Put the last task in the hole, and move it up or down from there.
+  if (index > 0 && heap_[(index - 1) / 2] < last)
+    SiftUp(index, last);
+  else
+    SiftDown(index, last);
+}
+
 //------------------------------------------------------------------------------
 // Method and data for histogramming events and actions taken by each instance
 // on each thread.
@@ -7,6 +7,7 @@
 
 #include <queue>
 #include <string>
+#include <vector>
 
 #include "base/histogram.h"
 #include "base/message_pump.h"
@@ -111,6 +112,13 @@ class MessageLoop : public base::MessagePump::Delegate {
   void PostNonNestableDelayedTask(
       const tracked_objects::Location& from_here, Task* task, int64 delay_ms);
 
+  // Removes |task|, which was posted to this loop with PostDelayedTask or
+  // PostNonNestableDelayedTask and has not run yet, and deletes it without
+  // running it.  A task which is still on its way to the queue of delayed
+  // tasks is deleted when it gets there.  This method may only be called on
+  // the thread that executes MessageLoop::Run().
+  void CancelDelayedTask(Task* task);
+
   // A variant on PostTask that deletes the given object.  This is useful
   // if the object needs to live until the next run of the MessageLoop (for
   // example, deleting a RenderProcessHost from within an IPC callback is not
@@ -305,7 +313,38 @@ class MessageLoop : public base::MessagePump::Delegate {
     }
   };
 
-  typedef std::priority_queue<PendingTask> DelayedTaskQueue;
+  // A heap of delayed tasks, like std::priority_queue<PendingTask>, which can
+  // also remove any task.  Each task keeps its position in the heap, so that
+  // Remove does not have to search for it.
+  class DelayedTaskQueue {
+   public:
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+    const PendingTask& top() const { return heap_.front(); }
+    void push(const PendingTask& pending_task);
+    void pop();
+
+    // Removes |task|, which must be in the heap.
+    void Remove(Task* task);
+
+   private:
+    // Moves |pending_task| up from |index| (resp. down), to restore the heap
+    // property, and stores it there.
+    void SiftUp(size_t index, const PendingTask& pending_task);
+    void SiftDown(size_t index, const PendingTask& pending_task);
+
+    // Stores |pending_task| at |index|, and records the position in the task.
+    void Place(size_t index, const PendingTask& pending_task);
+
+    // Removes the task at |index|.
+    void RemoveAt(size_t index);
+
+    std::vector<PendingTask> heap_;
+  };
+
+  // The lock-free queue that other threads post tasks to.  Defined in
+  // message_loop.cc.
+  class IncomingTaskQueue;
 
 #if defined(OS_WIN)
   base::MessagePumpWin* pump_win() {
@@ -358,8 +397,8 @@ class MessageLoop : public base::MessagePump::Delegate {
   void AddToDelayedWorkQueue(const PendingTask& pending_task);
 
   // Load tasks from the incoming_queue_ into work_queue_ if the latter is
-  // empty.  The former requires a lock to access, while the latter is directly
-  // accessible on this thread.
+  // empty.  The former is shared with the posting threads, while the latter is
+  // directly accessible on this thread.
   void ReloadWorkQueue();
 
   // Delete tasks that haven't run yet without running them.  Used in the
@@ -416,13 +455,11 @@ class MessageLoop : public base::MessagePump::Delegate {
   // A profiling histogram showing the counts of various messages and events.
   scoped_refptr<Histogram> message_histogram_;
 
-  // A null terminated list which creates an incoming_queue of tasks that are
-  // aquired under a mutex for processing on this instance's thread. These tasks
-  // have not yet been sorted out into items for our work_queue_ vs items that
-  // will be handled by the TimerManager.
-  TaskQueue incoming_queue_;
-  // Protect access to incoming_queue_.
-  Lock incoming_queue_lock_;
+  // The tasks posted to this instance, which have not yet been sorted out into
+  // items for our work_queue_ vs items that will be handled by the
+  // TimerManager.  It is reference counted so that a posting thread can still
+  // use it after the task it pushed has run, and possibly destroyed |this|.
+  scoped_refptr<IncomingTaskQueue> incoming_queue_;
 
   RunState* state_;
 
@@ -0,0 +1,116 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "base/thread.h"
+#include "base/task.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::Thread;
+
+namespace {
+
+const int kNumProducers = 4;
+const int kTasksPerProducer = 25000;
+
+// Quits the loop once the tasks of all the producers have run.
+class CountdownTask : public Task {
+ public:
+  explicit CountdownTask(int* tasks_left) : tasks_left_(tasks_left) {}
+  virtual void Run() {
+    if (--(*tasks_left_) == 0)
+      MessageLoop::current()->Quit();
+  }
+ private:
+  int* tasks_left_;
+};
+
+// A connection timeout, which never fires.
+class TimeoutTask : public Task {
+ public:
+  virtual void Run() {}
+};
+
+// Runs on a producer thread.
+void PostCountdownTasks(MessageLoop* target, int num_tasks, int* tasks_left) {
+  for (int i = 0; i < num_tasks; ++i)
+    target->PostTask(FROM_HERE, new CountdownTask(tasks_left));
+}
+
+// Measures how fast several threads can post to one loop at once, while it
+// runs their tasks.
+void RunTest_PostTaskFromManyThreads(MessageLoop::Type message_loop_type,
+                                     const char* test_name) {
+  MessageLoop loop(message_loop_type);
+
+  int tasks_left = kNumProducers * kTasksPerProducer;
+  scoped_ptr<Thread> producers[kNumProducers];
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i].reset(new Thread(StringPrintf("Producer%d", i).c_str()));
+    ASSERT_TRUE(producers[i]->Start());
+  }
+
+  PerfTimeLogger timer(test_name);
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i]->message_loop()->PostTask(FROM_HERE, NewRunnableFunction(
+        &PostCountdownTasks, &loop, kTasksPerProducer, &tasks_left));
+  }
+  loop.Run();
+  timer.Done();
+  EXPECT_EQ(0, tasks_left);
+
+  for (int i = 0; i < kNumProducers; ++i)
+    producers[i]->Stop();
+}
+
+// Simulates connection timeouts which get restarted as data arrives, and
+// measures the cost of cancelling and posting them again.
+void RunTest_CancelDelayedTask_ManyTimeouts(
+    MessageLoop::Type message_loop_type, const char* test_name) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumTimeouts = 10000;
+  const int kNumRestarts = 10;
+  std::vector<Task*> timeouts(kNumTimeouts);
+
+  PerfTimeLogger timer(test_name);
+  for (int restart = 0; restart < kNumRestarts; ++restart) {
+    for (int i = 0; i < kNumTimeouts; ++i) {
+      if (timeouts[i])
+        loop.CancelDelayedTask(timeouts[i]);
+      timeouts[i] = new TimeoutTask();
+      loop.PostDelayedTask(FROM_HERE, timeouts[i], 60000 + i);
+    }
+    loop.RunAllPending();
+  }
+  timer.Done();
+
+  for (int i = 0; i < kNumTimeouts; ++i)
+    loop.CancelDelayedTask(timeouts[i]);
+}
+
+}  // namespace
+
+TEST(MessageLoopPerfTest, PostTaskFromManyThreads) {
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_DEFAULT,
+                                  "Message_loop_post_task_many_threads");
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_UI,
+                                  "Message_loop_ui_post_task_many_threads");
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_IO,
+                                  "Message_loop_io_post_task_many_threads");
+}
+
+TEST(MessageLoopPerfTest, CancelDelayedTask_ManyTimeouts) {
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_DEFAULT,
+                                         "Message_loop_restart_timeouts");
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_UI,
+                                         "Message_loop_ui_restart_timeouts");
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_IO,
+                                         "Message_loop_io_restart_timeouts");
+}
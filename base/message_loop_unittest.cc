@@ -2,10 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
 #include "base/thread.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -151,6 +155,68 @@ void RunTest_PostTask_SEH(MessageLoop::Type message_loop_type) {
   EXPECT_EQ(foo->result(), "abacad");
 }
 
+// Checks that the tasks of one producer thread run in the order they were
+// posted, and quits the loop once the tasks of all the producers have run.
+class OrderedProducerTask : public Task {
+ public:
+  OrderedProducerTask(int sequence, int* next_sequence, int* tasks_left)
+      : sequence_(sequence),
+        next_sequence_(next_sequence),
+        tasks_left_(tasks_left) {
+  }
+  virtual void Run() {
+    EXPECT_EQ(*next_sequence_, sequence_);
+    *next_sequence_ = sequence_ + 1;
+    if (--(*tasks_left_) == 0)
+      MessageLoop::current()->Quit();
+  }
+ private:
+  int sequence_;
+  int* next_sequence_;
+  int* tasks_left_;
+};
+
+// Runs on a producer thread.
+void PostOrderedProducerTasks(MessageLoop* target, int num_tasks,
+                              int* next_sequence, int* tasks_left) {
+  for (int i = 0; i < num_tasks; ++i) {
+    target->PostTask(FROM_HERE,
+                     new OrderedProducerTask(i, next_sequence, tasks_left));
+  }
+}
+
+// Several threads post to one loop at once, while it runs their tasks.  The
+// posting throughput is measured by message_loop_perftest.cc.
+void RunTest_PostTaskFromManyThreads(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumProducers = 4;
+  const int kTasksPerProducer = 1000;
+
+  int next_sequence[kNumProducers] = { 0 };
+  int tasks_left = kNumProducers * kTasksPerProducer;
+
+  scoped_ptr<Thread> producers[kNumProducers];
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i].reset(new Thread(StringPrintf("Producer%d", i).c_str()));
+    ASSERT_TRUE(producers[i]->Start());
+  }
+
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers[i]->message_loop()->PostTask(FROM_HERE, NewRunnableFunction(
+        &PostOrderedProducerTasks, &loop, kTasksPerProducer,
+        &next_sequence[i], &tasks_left));
+  }
+  loop.Run();
+
+  EXPECT_EQ(0, tasks_left);
+  for (int i = 0; i < kNumProducers; ++i)
+    EXPECT_EQ(kTasksPerProducer, next_sequence[i]);
+
+  for (int i = 0; i < kNumProducers; ++i)
+    producers[i]->Stop();
+}
+
 // This class runs slowly to simulate a large amount of work being done.
 class SlowTask : public Task {
  public:
@@ -452,6 +518,127 @@ void RunTest_EnsureTaskDeletion_Chain(MessageLoop::Type message_loop_type) {
   EXPECT_TRUE(c_was_deleted);
 }
 
+void RunTest_CancelDelayedTask(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  bool a_was_deleted = false;
+  bool b_was_deleted = false;
+  bool c_was_deleted = false;
+  RecordDeletionTask* a = new RecordDeletionTask(NULL, &a_was_deleted);
+  RecordDeletionTask* b = new RecordDeletionTask(NULL, &b_was_deleted);
+  RecordDeletionTask* c = new RecordDeletionTask(NULL, &c_was_deleted);
+  loop.PostDelayedTask(FROM_HERE, a, 100000);
+  loop.PostDelayedTask(FROM_HERE, b, 200000);
+  loop.PostDelayedTask(FROM_HERE, c, 300000);
+  loop.RunAllPending();
+
+  // The tasks are in the delayed work queue: they are deleted right away.
+  loop.CancelDelayedTask(b);
+  EXPECT_TRUE(b_was_deleted);
+  loop.CancelDelayedTask(a);
+  EXPECT_TRUE(a_was_deleted);
+  EXPECT_FALSE(c_was_deleted);
+
+  // This task has not been moved to the delayed work queue yet: it is deleted
+  // when it gets there.
+  bool d_was_deleted = false;
+  RecordDeletionTask* d = new RecordDeletionTask(NULL, &d_was_deleted);
+  loop.PostDelayedTask(FROM_HERE, d, 100000);
+  loop.CancelDelayedTask(d);
+  EXPECT_FALSE(d_was_deleted);
+  loop.RunAllPending();
+  EXPECT_TRUE(d_was_deleted);
+  EXPECT_FALSE(c_was_deleted);
+}
+
+// Appends its id to a list when it runs, and quits the loop when it is the
+// last one.
+class DelayedOrderTask : public Task {
+ public:
+  DelayedOrderTask(std::vector<int>* order, int id, bool quit)
+      : order_(order), id_(id), quit_(quit) {
+  }
+  virtual void Run() {
+    order_->push_back(id_);
+    if (quit_)
+      MessageLoop::current()->Quit();
+  }
+ private:
+  std::vector<int>* order_;
+  int id_;
+  bool quit_;
+};
+
+void RunTest_CancelDelayedTask_Order(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  // Post tasks in a scrambled order, cancel every third one, and check that
+  // the others still run by delay.
+  const int kNumTasks = 30;
+  std::vector<int> order;
+  std::vector<Task*> tasks(kNumTasks);
+  for (int i = 0; i < kNumTasks; ++i) {
+    int id = (i * 7) % kNumTasks;
+    tasks[id] = new DelayedOrderTask(&order, id, id == kNumTasks - 1);
+    loop.PostDelayedTask(FROM_HERE, tasks[id], 10 + id);
+  }
+  loop.RunAllPending();
+  for (int id = 0; id < kNumTasks; id += 3)
+    loop.CancelDelayedTask(tasks[id]);
+  loop.Run();
+
+  std::vector<int> expected;
+  for (int id = 0; id < kNumTasks; ++id) {
+    if (id % 3)
+      expected.push_back(id);
+  }
+  EXPECT_TRUE(order == expected);
+}
+
+// Counts the live instances, as a measure of the memory held by the delayed
+// work queue.
+class TimeoutTask : public Task {
+ public:
+  TimeoutTask() { ++num_live_; }
+  virtual ~TimeoutTask() { --num_live_; }
+  virtual void Run() {}
+
+  static int num_live() { return num_live_; }
+
+ private:
+  static int num_live_;
+};
+
+int TimeoutTask::num_live_ = 0;
+
+// Simulates connection timeouts which get restarted as data arrives.  The cost
+// of the restarts is measured by message_loop_perftest.cc.
+void RunTest_CancelDelayedTask_ManyTimeouts(
+    MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumTimeouts = 100;
+  const int kNumRestarts = 10;
+  std::vector<Task*> timeouts(kNumTimeouts);
+
+  for (int restart = 0; restart < kNumRestarts; ++restart) {
+    for (int i = 0; i < kNumTimeouts; ++i) {
+      if (timeouts[i])
+        loop.CancelDelayedTask(timeouts[i]);
+      timeouts[i] = new TimeoutTask();
+      loop.PostDelayedTask(FROM_HERE, timeouts[i], 60000 + i);
+    }
+    loop.RunAllPending();
+  }
+
+  // Only the last timeout of each connection is left.
+  EXPECT_EQ(kNumTimeouts, TimeoutTask::num_live());
+
+  for (int i = 0; i < kNumTimeouts; ++i)
+    loop.CancelDelayedTask(timeouts[i]);
+  EXPECT_EQ(0, TimeoutTask::num_live());
+}
+
 class NestingTest : public Task {
  public:
   explicit NestingTest(int* depth) : depth_(depth) {
@@ -1297,6 +1484,12 @@ TEST(MessageLoopTest, PostTask_SEH) {
   RunTest_PostTask_SEH(MessageLoop::TYPE_IO);
 }
 
+TEST(MessageLoopTest, PostTaskFromManyThreads) {
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_DEFAULT);
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_UI);
+  RunTest_PostTaskFromManyThreads(MessageLoop::TYPE_IO);
+}
+
 TEST(MessageLoopTest, PostDelayedTask_Basic) {
   RunTest_PostDelayedTask_Basic(MessageLoop::TYPE_DEFAULT);
   RunTest_PostDelayedTask_Basic(MessageLoop::TYPE_UI);
@@ -1354,6 +1547,24 @@ TEST(MessageLoopTest, EnsureTaskDeletion_Chain) {
 }
 #endif
 
+TEST(MessageLoopTest, CancelDelayedTask) {
+  RunTest_CancelDelayedTask(MessageLoop::TYPE_DEFAULT);
+  RunTest_CancelDelayedTask(MessageLoop::TYPE_UI);
+  RunTest_CancelDelayedTask(MessageLoop::TYPE_IO);
+}
+
+TEST(MessageLoopTest, CancelDelayedTask_Order) {
+  RunTest_CancelDelayedTask_Order(MessageLoop::TYPE_DEFAULT);
+  RunTest_CancelDelayedTask_Order(MessageLoop::TYPE_UI);
+  RunTest_CancelDelayedTask_Order(MessageLoop::TYPE_IO);
+}
+
+TEST(MessageLoopTest, CancelDelayedTask_ManyTimeouts) {
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_DEFAULT);
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_UI);
+  RunTest_CancelDelayedTask_ManyTimeouts(MessageLoop::TYPE_IO);
+}
+
 #if defined(OS_WIN)
 TEST(MessageLoopTest, Crasher) {
   RunTest_Crasher(MessageLoop::TYPE_DEFAULT);
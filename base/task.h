@@ -5,8 +5,10 @@
 #ifndef BASE_TASK_H_
 #define BASE_TASK_H_
 
+#include "base/atomicops.h"
 #include "base/non_thread_safe.h"
 #include "base/raw_scoped_refptr_mismatch_checker.h"
+#include "base/time.h"
 #include "base/tracked.h"
 #include "base/tuple.h"
 #include "base/weak_ptr.h"
@@ -18,11 +20,29 @@
 
 class Task : public tracked_objects::Tracked {
  public:
-  Task() {}
+  Task()
+      : next_incoming_task_(0),
+        nestable_(true),
+        delayed_task_index_(-1),
+        cancelled_(false) {}
   virtual ~Task() {}
 
   // Tasks are automatically deleted after Run is called.
   virtual void Run() = 0;
+
+ private:
+  friend class MessageLoop;
+
+  // Used by MessageLoop while the task sits in its incoming queue, so that
+  // posting a task does not allocate.
+  base::subtle::AtomicWord next_incoming_task_;  // Really a Task*.
+  base::Time delayed_run_time_;
+  bool nestable_;
+
+  // The position of the task in MessageLoop's heap of delayed tasks, or -1.
+  int delayed_task_index_;
+  // Set by MessageLoop::CancelDelayedTask before the task reached the heap.
+  bool cancelled_;
 };
 
 class CancelableTask : public Task {
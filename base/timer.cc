@@ -10,8 +10,13 @@ namespace base {
 
 void BaseTimer_Helper::OrphanDelayedTask() {
   if (delayed_task_) {
+    TimerTask* timer_task = delayed_task_;
     delayed_task_->timer_ = NULL;
     delayed_task_ = NULL;
+    // Rather than leaving the orphan in the loop until its delay expires,
+    // delete it now.  The loop may be gone if the timer outlived it.
+    if (timer_task->message_loop_ == MessageLoop::current())
+      timer_task->message_loop_->CancelDelayedTask(timer_task);
   }
 }
 
@@ -20,6 +25,7 @@ void BaseTimer_Helper::InitiateDelayedTask(TimerTask* timer_task) {
 
   delayed_task_ = timer_task;
   delayed_task_->timer_ = this;
+  delayed_task_->message_loop_ = MessageLoop::current();
   MessageLoop::current()->PostDelayedTask(
       FROM_HERE, timer_task,
       static_cast<int>(timer_task->delay_.InMillisecondsRoundedUp()));
@@ -85,14 +85,18 @@ class BaseTimer_Helper {
   // We have access to the timer_ member so we can orphan this task.
   class TimerTask : public Task {
    public:
-    TimerTask(TimeDelta delay) : timer_(NULL), delay_(delay) {
+    TimerTask(TimeDelta delay)
+        : timer_(NULL), delay_(delay), message_loop_(NULL) {
     }
     virtual ~TimerTask() {}
     BaseTimer_Helper* timer_;
     TimeDelta delay_;
+    // The loop the task was posted to.
+    MessageLoop* message_loop_;
   };
 
-  // Used to orphan delayed_task_ so that when it runs it does nothing.
+  // Used to orphan delayed_task_, and take it out of the message loop.  If the
+  // task cannot be taken out, it does nothing when it runs.
   void OrphanDelayedTask();
 
   // Used to initiated a new delayed task.  This has the side-effect of
@@ -0,0 +1,55 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/scoped_ptr.h"
+#include "base/timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using base::TimeDelta;
+
+namespace {
+
+// A timer which never fires, like the timeout of a healthy connection.
+class ConnectionTimeout {
+ public:
+  ConnectionTimeout() {}
+  void Restart() {
+    timer_.Stop();
+    timer_.Start(TimeDelta::FromSeconds(60), this, &ConnectionTimeout::Run);
+  }
+ private:
+  void Run() {}
+  base::OneShotTimer<ConnectionTimeout> timer_;
+};
+
+// Measures the cost of restarting many timers many times.
+void RunTest_OneShotTimer_ManyRestarts(MessageLoop::Type message_loop_type,
+                                       const char* test_name) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumTimers = 5000;
+  const int kNumRestarts = 20;
+  scoped_array<ConnectionTimeout> timeouts(new ConnectionTimeout[kNumTimers]);
+
+  PerfTimeLogger timer(test_name);
+  for (int restart = 0; restart < kNumRestarts; ++restart) {
+    for (int i = 0; i < kNumTimers; ++i)
+      timeouts[i].Restart();
+    MessageLoop::current()->RunAllPending();
+  }
+  timer.Done();
+}
+
+}  // namespace
+
+TEST(TimerPerfTest, OneShotTimer_ManyRestarts) {
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_DEFAULT,
+                                    "Timer_one_shot_restarts");
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_UI,
+                                    "Timer_ui_one_shot_restarts");
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_IO,
+                                    "Timer_io_one_shot_restarts");
+}
@@ -106,6 +106,46 @@ void RunTest_OneShotTimer_Cancel(MessageLoop::Type message_loop_type) {
   EXPECT_TRUE(did_run_b);
 }
 
+// A timer which should never fire, like the timeout of a healthy connection.
+class ConnectionTimeoutTester {
+ public:
+  ConnectionTimeoutTester() {}
+  void Restart() {
+    timer_.Stop();
+    timer_.Start(TimeDelta::FromSeconds(60), this,
+                 &ConnectionTimeoutTester::Run);
+  }
+ private:
+  void Run() {
+    ADD_FAILURE() << "The connection should not have timed out";
+  }
+  base::OneShotTimer<ConnectionTimeoutTester> timer_;
+};
+
+// Restarts many timers many times.  None of them fires.  The cost of the
+// restarts is measured by timer_perftest.cc.
+void RunTest_OneShotTimer_ManyRestarts(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  const int kNumTimers = 100;
+  const int kNumRestarts = 10;
+  scoped_array<ConnectionTimeoutTester> timeouts(
+      new ConnectionTimeoutTester[kNumTimers]);
+
+  for (int restart = 0; restart < kNumRestarts; ++restart) {
+    for (int i = 0; i < kNumTimers; ++i)
+      timeouts[i].Restart();
+    MessageLoop::current()->RunAllPending();
+  }
+
+  bool did_run = false;
+  OneShotTimerTester f(&did_run);
+  f.Start();
+  MessageLoop::current()->Run();
+
+  EXPECT_TRUE(did_run);
+}
+
 void RunTest_OneShotSelfDeletingTimer(MessageLoop::Type message_loop_type) {
   MessageLoop loop(message_loop_type);
 
@@ -286,6 +326,12 @@ TEST(TimerTest, OneShotTimer_Cancel) {
   RunTest_OneShotTimer_Cancel(MessageLoop::TYPE_IO);
 }
 
+TEST(TimerTest, OneShotTimer_ManyRestarts) {
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_DEFAULT);
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_UI);
+  RunTest_OneShotTimer_ManyRestarts(MessageLoop::TYPE_IO);
+}
+
 // If underline timer does not handle properly, we will crash or fail
 // in full page heap or purify environment.
 TEST(TimerTest, OneShotSelfDeletingTimer) {
@@ -4,30 +4,155 @@
 
 #include "base/trace_event.h"
 
-#include "base/format_macros.h"
-#include "base/file_path.h"
+#include <algorithm>
+#include <map>
+
 #include "base/file_util.h"
+#include "base/format_macros.h"
+#include "base/json/string_escape.h"
+#include "base/message_loop.h"
 #include "base/path_service.h"
-#include "base/platform_thread.h"
+#include "base/pickle.h"
 #include "base/process_util.h"
 #include "base/string_util.h"
-#include "base/utf_string_conversions.h"
-#include "base/time.h"
 
 #define USE_UNRELIABLE_NOW
 
 namespace base {
 
-static const char* kEventTypeNames[] = {
-  "BEGIN",
-  "END",
-  "INSTANT"
+namespace {
+
+// The phases of the trace event format, by EventType.
+const char* kEventPhases[] = {
+  "B",
+  "E",
+  "i"
+};
+
+const FilePath::CharType* kJSONFileName = FILE_PATH_LITERAL("trace_%d.json");
+const FilePath::CharType* kBinaryFileName = FILE_PATH_LITERAL("trace_%d.bin");
+
+bool EventBefore(const TraceLog::Event& a, const TraceLog::Event& b) {
+  return a.timestamp < b.timestamp;
+}
+
+// Writes |data| into |file_name|, under |dir| or else in the current
+// directory.
+bool WriteTraceFile(const FilePath& dir,
+                    const FilePath::StringType& file_name,
+                    const char* data,
+                    int size) {
+  if (!dir.empty() &&
+      file_util::WriteFile(dir.Append(file_name), data, size) == size) {
+    return true;
+  }
+  return file_util::WriteFile(FilePath(file_name), data, size) == size;
+}
+
+}  // namespace
+
+// The events of one thread.  The thread writes the events in a ring buffer,
+// and publishes each of them by incrementing |num_events_|.  Readers copy the
+// buffer without stopping the thread, and then drop the events which the
+// thread may have overwritten during the copy.
+//
+// The TraceLog and the owning thread each hold a reference, so that neither
+// deletes the buffer while the other can still reach it.
+class TraceLog::ThreadBuffer
+    : public base::RefCountedThreadSafe<TraceLog::ThreadBuffer> {
+ public:
+  explicit ThreadBuffer(PlatformThreadId thread_id)
+      : events_(new Event[kEventsPerThread]),
+        num_events_(0),
+        thread_id_(thread_id),
+        retired_(0) {
+  }
+
+  // Whether the owning thread exited, leaving the buffer to another thread.
+  bool retired() const { return base::subtle::Acquire_Load(&retired_) != 0; }
+
+  // Called by the owning thread when it exits.  It adds no events after that.
+  void Retire() { base::subtle::Release_Store(&retired_, 1); }
+
+  // Hands a retired buffer to the calling thread, which becomes its owner.
+  // Called under the TraceLog's lock.
+  void Claim(PlatformThreadId thread_id) {
+    DCHECK(retired());
+    thread_id_ = thread_id;
+    base::subtle::NoBarrier_Store(&retired_, 0);
+  }
+
+  // Only called on the thread which owns the buffer.
+  void Add(const char* name, EventType type, const void* id,
+           const char* file, int line) {
+    uint32 index = static_cast<uint32>(
+        base::subtle::NoBarrier_Load(&num_events_));
+    Event& event = events_[index & (kEventsPerThread - 1)];
+#ifdef USE_UNRELIABLE_NOW
+    event.timestamp = TimeTicks::HighResNow();
+#else
+    event.timestamp = TimeTicks::Now();
+#endif
+    event.name = name;
+    event.id = id;
+    event.file = file;
+    event.line = line;
+    event.type = type;
+    event.thread_id = thread_id_;
+    // The barrier orders the writes of |event| before its publication, and
+    // the writes of the next event after it.
+    base::subtle::Barrier_AtomicIncrement(&num_events_, 1);
+  }
+
+  // Appends the events recorded since |start_time| to |events|.
+  void CopyEvents(TimeTicks start_time, std::vector<Event>* events) const {
+    uint32 end = static_cast<uint32>(
+        base::subtle::Acquire_Load(&num_events_));
+    uint32 count = std::min(end, static_cast<uint32>(kEventsPerThread));
+    std::vector<Event> copy(count);
+    for (uint32 i = 0; i < count; ++i)
+      copy[i] = events_[(end - count + i) & (kEventsPerThread - 1)];
+
+    // The thread may have overwritten the oldest events while we copied them:
+    // writing the event |new_end| overwrites the event |new_end| -
+    // kEventsPerThread.
+    base::subtle::MemoryBarrier();
+    uint32 new_end = static_cast<uint32>(
+        base::subtle::NoBarrier_Load(&num_events_));
+    for (uint32 i = 0; i < count; ++i) {
+      if (new_end - (end - count + i) >= static_cast<uint32>(kEventsPerThread))
+        continue;
+      if (copy[i].timestamp < start_time)
+        continue;
+      events->push_back(copy[i]);
+    }
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<TraceLog::ThreadBuffer>;
+
+  ~ThreadBuffer() {}
+
+  scoped_array<Event> events_;
+  // The number of events ever added.  Only the owning thread changes it.
+  base::subtle::Atomic32 num_events_;
+  // Only read and written by the owning thread.
+  PlatformThreadId thread_id_;
+  base::subtle::Atomic32 retired_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadBuffer);
 };
 
-static const FilePath::CharType* kLogFileName =
-    FILE_PATH_LITERAL("trace_%d.log");
+// static
+const int TraceLog::kEventsPerThread;
+
+// static
+const int TraceLog::kBinaryFormatVersion;
+
+// static
+base::subtle::Atomic32 TraceLog::tracing_ = 0;
 
-TraceLog::TraceLog() : enabled_(false), log_file_(NULL) {
+TraceLog::TraceLog() : thread_buffer_(&TraceLog::OnThreadExit) {
   base::ProcessHandle proc = base::GetCurrentProcessHandle();
 #if !defined(OS_MACOSX)
   process_metrics_.reset(base::ProcessMetrics::CreateProcessMetrics(proc));
@@ -40,13 +165,13 @@ TraceLog::TraceLog() : enabled_(false), log_file_(NULL) {
 }
 
 TraceLog::~TraceLog() {
-  Stop();
-}
-
-// static
-bool TraceLog::IsTracing() {
-  TraceLog* trace = Singleton<TraceLog>::get();
-  return trace->enabled_;
+  if (IsTracing()) {
+    Stop();
+    FlushToFiles();
+  }
+  // The threads which are still alive keep their buffers, and their reference
+  // leaks: the destructor of the slot does not run anymore.
+  thread_buffer_.Free();
 }
 
 // static
@@ -56,15 +181,19 @@ bool TraceLog::StartTracing() {
 }
 
 bool TraceLog::Start() {
-  if (enabled_)
+  if (IsTracing())
     return true;
-  enabled_ = OpenLogFile();
-  if (enabled_) {
-    Log("var raw_trace_events = [\n");
-    trace_start_time_ = TimeTicks::Now();
-    timer_.Start(TimeDelta::FromMilliseconds(250), this, &TraceLog::Heartbeat);
+  {
+    AutoLock locked(lock_);
+    if (!PathService::Get(base::DIR_EXE, &log_dir_))
+      log_dir_ = FilePath();
+    trace_start_time_ = TimeTicks::HighResNow();
   }
-  return enabled_;
+  base::subtle::Release_Store(&tracing_, 1);
+  // The heartbeat needs a MessageLoop.
+  if (MessageLoop::current())
+    timer_.Start(TimeDelta::FromMilliseconds(250), this, &TraceLog::Heartbeat);
+  return true;
 }
 
 // static
@@ -74,91 +203,164 @@ void TraceLog::StopTracing() {
 }
 
 void TraceLog::Stop() {
-  if (enabled_) {
-    enabled_ = false;
-    Log("];\n");
-    CloseLogFile();
+  if (IsTracing()) {
+    base::subtle::Release_Store(&tracing_, 0);
     timer_.Stop();
   }
 }
 
-void TraceLog::Heartbeat() {
-  std::string cpu = StringPrintf("%d", process_metrics_->GetCPUUsage());
-  TRACE_EVENT_INSTANT("heartbeat.cpu", 0, cpu);
+// static
+bool TraceLog::Flush() {
+  TraceLog* trace = Singleton<TraceLog>::get();
+  return trace->FlushToFiles();
 }
 
-void TraceLog::CloseLogFile() {
-  if (log_file_) {
-    file_util::CloseFile(log_file_);
+bool TraceLog::FlushToFiles() {
+  std::vector<Event> events;
+  GetEvents(&events);
+  TimeTicks start_time;
+  FilePath log_dir;
+  {
+    AutoLock locked(lock_);
+    start_time = trace_start_time_;
+    log_dir = log_dir_;
   }
+
+  int pid = base::GetCurrentProcId();
+  std::string json;
+  FormatJSON(events, start_time, &json);
+  bool written = WriteTraceFile(log_dir, StringPrintf(kJSONFileName, pid),
+                                json.data(), json.size());
+
+  Pickle pickle;
+  FormatBinary(events, start_time, &pickle);
+  written &= WriteTraceFile(log_dir, StringPrintf(kBinaryFileName, pid),
+                            static_cast<const char*>(pickle.data()),
+                            pickle.size());
+  return written;
 }
 
-bool TraceLog::OpenLogFile() {
-  FilePath::StringType pid_filename =
-      StringPrintf(kLogFileName, base::GetCurrentProcId());
-  FilePath log_file_path;
-  if (!PathService::Get(base::DIR_EXE, &log_file_path))
-    return false;
-  log_file_path = log_file_path.Append(pid_filename);
-  log_file_ = file_util::OpenFile(log_file_path, "a");
-  if (!log_file_) {
-    // try the current directory
-    log_file_ = file_util::OpenFile(FilePath(pid_filename), "a");
-    if (!log_file_) {
-      return false;
-    }
-  }
-  return true;
+void TraceLog::Heartbeat() {
+  TRACE_EVENT_INSTANT("heartbeat.cpu", process_metrics_->GetCPUUsage(), "");
 }
 
-void TraceLog::Trace(const std::string& name,
+void TraceLog::Trace(const char* name,
                      EventType type,
                      const void* id,
-                     const std::wstring& extra,
                      const char* file,
                      int line) {
-  if (!enabled_)
+  if (!IsTracing())
     return;
-  Trace(name, type, id, WideToUTF8(extra), file, line);
+  GetThreadBuffer()->Add(name, type, id, file, line);
 }
 
-void TraceLog::Trace(const std::string& name,
-                     EventType type,
-                     const void* id,
-                     const std::string& extra,
-                     const char* file,
-                     int line) {
-  if (!enabled_)
-    return;
+TraceLog::ThreadBuffer* TraceLog::GetThreadBuffer() {
+  ThreadBuffer* buffer = static_cast<ThreadBuffer*>(thread_buffer_.Get());
+  if (buffer)
+    return buffer;
 
-#ifdef USE_UNRELIABLE_NOW
-  TimeTicks tick = TimeTicks::HighResNow();
-#else
-  TimeTicks tick = TimeTicks::Now();
-#endif
-  TimeDelta delta = tick - trace_start_time_;
-  int64 usec = delta.InMicroseconds();
-  std::string msg =
-    StringPrintf("{'pid':'0x%lx', 'tid':'0x%lx', 'type':'%s', "
-                 "'name':'%s', 'id':'%p', 'extra':'%s', 'file':'%s', "
-                 "'line_number':'%d', 'usec_begin': %" PRId64 "},\n",
-                 static_cast<unsigned long>(base::GetCurrentProcId()),
-                 static_cast<unsigned long>(PlatformThread::CurrentId()),
-                 kEventTypeNames[type],
-                 name.c_str(),
-                 id,
-                 extra.c_str(),
-                 file,
-                 line,
-                 usec);
-
-  Log(msg);
-}
-
-void TraceLog::Log(const std::string& msg) {
-  AutoLock lock(file_lock_);
-
-  fprintf(log_file_, "%s", msg.c_str());
+  PlatformThreadId thread_id = PlatformThread::CurrentId();
+  {
+    AutoLock locked(lock_);
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      if (buffers_[i]->retired()) {
+        buffer = buffers_[i];
+        buffer->Claim(thread_id);
+        break;
+      }
+    }
+    if (!buffer) {
+      buffer = new ThreadBuffer(thread_id);
+      buffers_.push_back(buffer);
+    }
+  }
+  // Released by OnThreadExit().
+  buffer->AddRef();
+  thread_buffer_.Set(buffer);
+  return buffer;
+}
+
+// static
+void TraceLog::OnThreadExit(void* buffer) {
+  ThreadBuffer* thread_buffer = static_cast<ThreadBuffer*>(buffer);
+  thread_buffer->Retire();
+  thread_buffer->Release();
+}
+
+void TraceLog::GetEvents(std::vector<Event>* events) {
+  events->clear();
+  {
+    AutoLock locked(lock_);
+    for (size_t i = 0; i < buffers_.size(); ++i)
+      buffers_[i]->CopyEvents(trace_start_time_, events);
+  }
+  std::stable_sort(events->begin(), events->end(), EventBefore);
+}
+
+// static
+void TraceLog::FormatJSON(const std::vector<Event>& events,
+                          TimeTicks start_time,
+                          std::string* output) {
+  int pid = base::GetCurrentProcId();
+  output->append("{\"traceEvents\":[\n");
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& event = events[i];
+    if (i)
+      output->append(",\n");
+    output->append("{\"name\":");
+    JsonDoubleQuote(std::string(event.name), true, output);
+    StringAppendF(output,
+                  ",\"cat\":\"chromium\",\"ph\":\"%s\",\"pid\":%d,"
+                  "\"tid\":%lu,\"ts\":%" PRId64 ",",
+                  kEventPhases[event.type],
+                  pid,
+                  static_cast<unsigned long>(event.thread_id),
+                  (event.timestamp - start_time).InMicroseconds());
+    if (event.type == EVENT_INSTANT)
+      output->append("\"s\":\"t\",");
+    StringAppendF(output, "\"args\":{\"id\":\"0x%" PRIx64 "\",\"file\":",
+                  static_cast<uint64>(reinterpret_cast<uintptr_t>(event.id)));
+    JsonDoubleQuote(std::string(event.file), true, output);
+    StringAppendF(output, ",\"line\":%d}}", event.line);
+  }
+  output->append("]}\n");
+}
+
+// static
+void TraceLog::FormatBinary(const std::vector<Event>& events,
+                            TimeTicks start_time,
+                            Pickle* pickle) {
+  pickle->WriteInt(kBinaryFormatVersion);
+  pickle->WriteInt(base::GetCurrentProcId());
+
+  // The names and the files are written once, and referred to by index.
+  std::map<const char*, int> string_indexes;
+  std::vector<const char*> strings;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const char* event_strings[] = { events[i].name, events[i].file };
+    for (size_t j = 0; j < arraysize(event_strings); ++j) {
+      int index = static_cast<int>(strings.size());
+      if (string_indexes.insert(std::make_pair(event_strings[j],
+                                               index)).second) {
+        strings.push_back(event_strings[j]);
+      }
+    }
+  }
+  pickle->WriteInt(static_cast<int>(strings.size()));
+  for (size_t i = 0; i < strings.size(); ++i)
+    pickle->WriteString(strings[i]);
+
+  pickle->WriteInt(static_cast<int>(events.size()));
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& event = events[i];
+    pickle->WriteInt64((event.timestamp - start_time).InMicroseconds());
+    pickle->WriteUInt64(reinterpret_cast<uintptr_t>(event.id));
+    pickle->WriteInt(string_indexes[event.name]);
+    pickle->WriteInt(string_indexes[event.file]);
+    pickle->WriteInt(event.line);
+    pickle->WriteInt(event.type);
+    pickle->WriteInt(static_cast<int>(event.thread_id));
+  }
 }
 
 } // namespace base
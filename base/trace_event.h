@@ -2,15 +2,17 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// Trace events to track application performance.  Events consist of a name
-// a type (BEGIN, END or INSTANT), a tracking id and extra string data.
-// In addition, the current process id, thread id, a timestamp down to the
-// microsecond and a file and line number of the calling location.
+// Trace events to track application performance.  Events consist of a name,
+// a type (BEGIN, END or INSTANT) and a tracking id.  In addition, the current
+// thread id, a timestamp down to the microsecond and a file and line number of
+// the calling location are recorded.
 //
-// The current implementation logs these events into a log file of the form
-// trace_<pid>.log where it's designed to be post-processed to generate a
-// trace report.  In the future, it may use another mechansim to facilitate
-// real-time analysis.
+// Events are recorded in memory, into a fixed-size ring buffer per thread, so
+// recording an event takes no lock and does no allocation.  Each buffer keeps
+// the last events of its thread, see kEventsPerThread.  The recorded events are
+// written out on demand, by Flush(), into trace_<pid>.json, which can be
+// loaded in about:tracing and the other viewers of the trace event format,
+// and into trace_<pid>.bin, a compact binary dump.
 
 #ifndef BASE_TRACE_EVENT_H_
 #define BASE_TRACE_EVENT_H_
@@ -22,14 +24,22 @@
 #endif
 
 #include <string>
+#include <vector>
 
+#include "base/atomicops.h"
+#include "base/file_path.h"
 #include "base/lock.h"
+#include "base/platform_thread.h"
+#include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
 #include "base/singleton.h"
+#include "base/thread_local_storage.h"
 #include "base/time.h"
 #include "base/timer.h"
 
-#ifndef CHROMIUM_ENABLE_TRACE_EVENT
+class Pickle;
+
+#ifdef CHROMIUM_DISABLE_TRACE_EVENT
 #define TRACE_EVENT_BEGIN(name, id, extra) ((void) 0)
 #define TRACE_EVENT_END(name, id, extra) ((void) 0)
 #define TRACE_EVENT_INSTANT(name, id, extra) ((void) 0)
@@ -40,36 +50,36 @@
 // TRACE_EVENT_BEGIN("v8.run", documentId, scriptLocation);
 // RunScript(script);
 // TRACE_EVENT_END("v8.run", documentId, scriptLocation);
+//
+// Only a pointer to |name| is recorded, so it must be a string literal, or
+// otherwise outlive the TraceLog.  |extra| is not recorded, nor evaluated.
 
 // Record that an event (of name, id) has begun.  All BEGIN events should have
 // corresponding END events with a matching (name, id).
 #define TRACE_EVENT_BEGIN(name, id, extra) \
-  Singleton<base::TraceLog>::get()->Trace(name, \
-                                          base::TraceLog::EVENT_BEGIN, \
-                                          reinterpret_cast<const void*>(id), \
-                                          extra, \
-                                          __FILE__, \
-                                          __LINE__)
+  base::TraceLog::AddEvent(name, \
+                           base::TraceLog::EVENT_BEGIN, \
+                           reinterpret_cast<const void*>(id), \
+                           __FILE__, \
+                           __LINE__)
 
 // Record that an event (of name, id) has ended.  All END events should have
 // corresponding BEGIN events with a matching (name, id).
 #define TRACE_EVENT_END(name, id, extra) \
-  Singleton<base::TraceLog>::get()->Trace(name, \
-                                          base::TraceLog::EVENT_END, \
-                                          reinterpret_cast<const void*>(id), \
-                                          extra, \
-                                          __FILE__, \
-                                          __LINE__)
+  base::TraceLog::AddEvent(name, \
+                           base::TraceLog::EVENT_END, \
+                           reinterpret_cast<const void*>(id), \
+                           __FILE__, \
+                           __LINE__)
 
 // Record that an event (of name, id) with no duration has happened.
 #define TRACE_EVENT_INSTANT(name, id, extra) \
-  Singleton<base::TraceLog>::get()->Trace(name, \
-                                          base::TraceLog::EVENT_INSTANT, \
-                                          reinterpret_cast<const void*>(id), \
-                                          extra, \
-                                          __FILE__, \
-                                          __LINE__)
-#endif  // CHROMIUM_ENABLE_TRACE_EVENT
+  base::TraceLog::AddEvent(name, \
+                           base::TraceLog::EVENT_INSTANT, \
+                           reinterpret_cast<const void*>(id), \
+                           __FILE__, \
+                           __LINE__)
+#endif  // CHROMIUM_DISABLE_TRACE_EVENT
 
 namespace base {
 class ProcessMetrics;
@@ -85,45 +95,116 @@ class TraceLog {
     EVENT_INSTANT
   };
 
+  // A recorded event.  |name| and |file| point to the strings passed to
+  // Trace(), they are not copied.
+  struct Event {
+    TimeTicks timestamp;
+    const char* name;
+    const void* id;
+    const char* file;
+    int line;
+    EventType type;
+    PlatformThreadId thread_id;
+  };
+
+  // The size of the ring buffer of each thread.  Must be a power of two.  The
+  // oldest event of a full buffer is the next one to be overwritten, so a
+  // thread's last kEventsPerThread - 1 events are kept.
+  static const int kEventsPerThread = 4096;
+
+  // The version of the binary format written by FormatBinary().
+  static const int kBinaryFormatVersion = 1;
+
   // Is tracing currently enabled.
-  static bool IsTracing();
-  // Start logging trace events.
+  static bool IsTracing() {
+    return base::subtle::NoBarrier_Load(&tracing_) != 0;
+  }
+  // Start recording trace events.
   static bool StartTracing();
-  // Stop logging trace events.
+  // Stop recording trace events.  The recorded events are kept until the
+  // next StartTracing().
   static void StopTracing();
-
-  // Log a trace event of (name, type, id) with the optional extra string.
-  void Trace(const std::string& name,
-             EventType type,
-             const void* id,
-             const std::wstring& extra,
-             const char* file,
-             int line);
-  void Trace(const std::string& name,
+  // Writes the events recorded since the last StartTracing() into
+  // trace_<pid>.json and trace_<pid>.bin.  Returns false if the files could
+  // not be written.
+  static bool Flush();
+
+  // Records an event if tracing is enabled.  This is what the TRACE_EVENT_*
+  // macros call.
+  static void AddEvent(const char* name,
+                       EventType type,
+                       const void* id,
+                       const char* file,
+                       int line) {
+    if (IsTracing())
+      Singleton<TraceLog>::get()->Trace(name, type, id, file, line);
+  }
+
+  // Log a trace event of (name, type, id).  Only the calling thread writes
+  // into its buffer, so this does not lock.
+  void Trace(const char* name,
              EventType type,
              const void* id,
-             const std::string& extra,
              const char* file,
              int line);
 
+  // Copies the events of all the threads recorded since the last
+  // StartTracing() into |events|, sorted by timestamp.  Can be called while
+  // other threads record events.
+  void GetEvents(std::vector<Event>* events);
+
+  // Formats |events| in the JSON trace event format, with timestamps relative
+  // to |start_time|, and appends them to |output|.
+  static void FormatJSON(const std::vector<Event>& events,
+                         TimeTicks start_time,
+                         std::string* output);
+
+  // Writes |events| into |pickle|: the format version, the process id,
+  // the table of the names and files, and then one record per event.
+  static void FormatBinary(const std::vector<Event>& events,
+                           TimeTicks start_time,
+                           Pickle* pickle);
+
  private:
   // This allows constructor and destructor to be private and usable only
   // by the Singleton class.
   friend struct DefaultSingletonTraits<TraceLog>;
 
+  class ThreadBuffer;
+
   TraceLog();
   ~TraceLog();
-  bool OpenLogFile();
-  void CloseLogFile();
   bool Start();
   void Stop();
+  bool FlushToFiles();
   void Heartbeat();
-  void Log(const std::string& msg);
 
-  bool enabled_;
-  FILE* log_file_;
-  Lock file_lock_;
+  // Returns the calling thread's buffer.  The first time, the thread takes
+  // over the buffer of a thread which exited, or creates a new one.
+  ThreadBuffer* GetThreadBuffer();
+
+  // Called when a thread which recorded events exits, with its buffer.
+  static void OnThreadExit(void* buffer);
+
+  // Non-zero while events are recorded.  A static, so that the TRACE_EVENT_*
+  // macros do not create the TraceLog when tracing is off.
+  static base::subtle::Atomic32 tracing_;
+
+  // Holds a reference to the calling thread's buffer, released when the
+  // thread exits.
+  ThreadLocalStorage::Slot thread_buffer_;
+
+  Lock lock_;  // Protects the variables below.
+  // The buffers of all the threads which recorded an event.  The buffer of a
+  // thread which exited is handed to the next new thread, so there are never
+  // more buffers than threads recording at once, and the events of the old
+  // thread are kept until the new one overwrites them.
+  std::vector<scoped_refptr<ThreadBuffer> > buffers_;
   TimeTicks trace_start_time_;
+  // Where Flush() writes the trace files.  Found by Start(), in case the
+  // PathService is gone when the trace is flushed at exit.
+  FilePath log_dir_;
+
   scoped_ptr<base::ProcessMetrics> process_metrics_;
   RepeatingTimer<TraceLog> timer_;
 };
@@ -0,0 +1,33 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event.h"
+
+#include "base/perftimer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kNumEvents = 1000000;
+
+}  // namespace
+
+// Measures the cost of the TRACE_EVENT_* macros, with tracing on and off.
+TEST(TraceEventPerfTest, RecordingOverhead) {
+  ASSERT_TRUE(TraceLog::StartTracing());
+  PerfTimeLogger tracing_timer("Trace_event_record");
+  for (int i = 0; i < kNumEvents; ++i)
+    TRACE_EVENT_INSTANT("test.overhead", i, "");
+  tracing_timer.Done();
+
+  TraceLog::StopTracing();
+  PerfTimeLogger not_tracing_timer("Trace_event_record_not_tracing");
+  for (int i = 0; i < kNumEvents; ++i)
+    TRACE_EVENT_INSTANT("test.overhead", i, "");
+  not_tracing_timer.Done();
+}
+
+}  // namespace base
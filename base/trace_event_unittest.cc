@@ -0,0 +1,255 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event.h"
+
+#include <string.h>
+
+#include "base/json/json_reader.h"
+#include "base/pickle.h"
+#include "base/platform_thread.h"
+#include "base/scoped_ptr.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kEventsPerThread = TraceLog::kEventsPerThread;
+
+class TraceEventTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(TraceLog::StartTracing());
+  }
+
+  virtual void TearDown() {
+    TraceLog::StopTracing();
+  }
+
+  // Returns the events recorded since SetUp().
+  std::vector<TraceLog::Event> GetEvents() {
+    std::vector<TraceLog::Event> events;
+    Singleton<TraceLog>::get()->GetEvents(&events);
+    return events;
+  }
+};
+
+// Records |num_events| INSTANT events, with ids from 0.
+class TracingThread : public PlatformThread::Delegate {
+ public:
+  explicit TracingThread(int num_events)
+      : num_events_(num_events), thread_id_(0) {}
+
+  PlatformThreadId thread_id() const { return thread_id_; }
+
+  virtual void ThreadMain() {
+    thread_id_ = PlatformThread::CurrentId();
+    for (int i = 0; i < num_events_; ++i)
+      TRACE_EVENT_INSTANT("test.thread", i, "");
+  }
+
+ private:
+  const int num_events_;
+  PlatformThreadId thread_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracingThread);
+};
+
+}  // namespace
+
+TEST_F(TraceEventTest, BeginEndInstant) {
+  int object;
+  TRACE_EVENT_BEGIN("test.load", &object, "extra");
+  TRACE_EVENT_INSTANT("test.progress", &object, std::string("extra"));
+  TRACE_EVENT_END("test.load", &object, "");
+  TraceLog::StopTracing();
+  TRACE_EVENT_INSTANT("test.not_recorded", &object, "");
+
+  std::vector<TraceLog::Event> events = GetEvents();
+  ASSERT_EQ(3u, events.size());
+  EXPECT_STREQ("test.load", events[0].name);
+  EXPECT_EQ(TraceLog::EVENT_BEGIN, events[0].type);
+  EXPECT_STREQ("test.progress", events[1].name);
+  EXPECT_EQ(TraceLog::EVENT_INSTANT, events[1].type);
+  EXPECT_STREQ("test.load", events[2].name);
+  EXPECT_EQ(TraceLog::EVENT_END, events[2].type);
+  for (size_t i = 0; i < events.size(); ++i) {
+    EXPECT_EQ(&object, events[i].id);
+    EXPECT_EQ(PlatformThread::CurrentId(), events[i].thread_id);
+    EXPECT_STREQ(__FILE__, events[i].file);
+    if (i)
+      EXPECT_FALSE(events[i].timestamp < events[i - 1].timestamp);
+  }
+}
+
+// Restarting the trace drops the events recorded before.
+TEST_F(TraceEventTest, Restart) {
+  TRACE_EVENT_INSTANT("test.first", 0, "");
+  TraceLog::StopTracing();
+  PlatformThread::Sleep(2);
+  TraceLog::StartTracing();
+  TRACE_EVENT_INSTANT("test.second", 0, "");
+
+  std::vector<TraceLog::Event> events = GetEvents();
+  ASSERT_EQ(1u, events.size());
+  EXPECT_STREQ("test.second", events[0].name);
+}
+
+// A thread's buffer keeps its last kEventsPerThread - 1 events.
+TEST_F(TraceEventTest, RingBuffer) {
+  const int kNumEvents = kEventsPerThread + 100;
+  const int kNumKept = kEventsPerThread - 1;
+  for (int i = 0; i < kNumEvents; ++i)
+    TRACE_EVENT_INSTANT("test.ring", i, "");
+
+  std::vector<TraceLog::Event> events = GetEvents();
+  ASSERT_EQ(static_cast<size_t>(kNumKept), events.size());
+  for (int i = 0; i < kNumKept; ++i) {
+    EXPECT_EQ(reinterpret_cast<const void*>(kNumEvents - kNumKept + i),
+              events[i].id);
+  }
+}
+
+TEST_F(TraceEventTest, ManyThreads) {
+  const int kNumThreads = 4;
+  const int kNumEvents = 1000;
+  TracingThread* delegates[kNumThreads];
+  PlatformThreadHandle threads[kNumThreads];
+  for (int i = 0; i < kNumThreads; ++i) {
+    delegates[i] = new TracingThread(kNumEvents);
+    ASSERT_TRUE(PlatformThread::Create(0, delegates[i], &threads[i]));
+  }
+  // Read the buffers while the threads record events.
+  std::vector<TraceLog::Event> events = GetEvents();
+  for (int i = 0; i < kNumThreads; ++i)
+    PlatformThread::Join(threads[i]);
+
+  events = GetEvents();
+  EXPECT_EQ(static_cast<size_t>(kNumThreads * kNumEvents), events.size());
+  for (int i = 0; i < kNumThreads; ++i) {
+    // The events of each thread are in order.
+    int next_id = 0;
+    for (size_t j = 0; j < events.size(); ++j) {
+      if (events[j].thread_id != delegates[i]->thread_id())
+        continue;
+      EXPECT_EQ(reinterpret_cast<const void*>(next_id), events[j].id);
+      ++next_id;
+    }
+    EXPECT_EQ(kNumEvents, next_id);
+    delete delegates[i];
+  }
+}
+
+// A thread which starts after another one exited reuses its buffer, after the
+// events of the first one.
+TEST_F(TraceEventTest, ThreadExit) {
+  const int kNumThreads = 3;
+  const int kNumEvents = 100;
+  TracingThread* delegates[kNumThreads];
+  for (int i = 0; i < kNumThreads; ++i) {
+    delegates[i] = new TracingThread(kNumEvents);
+    PlatformThreadHandle thread;
+    ASSERT_TRUE(PlatformThread::Create(0, delegates[i], &thread));
+    PlatformThread::Join(thread);
+  }
+
+  std::vector<TraceLog::Event> events = GetEvents();
+  ASSERT_EQ(static_cast<size_t>(kNumThreads * kNumEvents), events.size());
+  for (int i = 0; i < kNumThreads; ++i) {
+    for (int j = 0; j < kNumEvents; ++j) {
+      const TraceLog::Event& event = events[i * kNumEvents + j];
+      EXPECT_EQ(delegates[i]->thread_id(), event.thread_id);
+      EXPECT_EQ(reinterpret_cast<const void*>(j), event.id);
+    }
+    delete delegates[i];
+  }
+}
+
+TEST_F(TraceEventTest, FormatJSON) {
+  TRACE_EVENT_BEGIN("test.\"quoted\"", 0x10, "");
+  TRACE_EVENT_END("test.\"quoted\"", 0x10, "");
+  TRACE_EVENT_INSTANT("test.instant", 0x20, "");
+
+  std::string json;
+  TraceLog::FormatJSON(GetEvents(), TimeTicks(), &json);
+  scoped_ptr<Value> root(JSONReader::Read(json, false));
+  ASSERT_TRUE(root.get());
+  ASSERT_TRUE(root->IsType(Value::TYPE_DICTIONARY));
+  ListValue* trace_events = NULL;
+  ASSERT_TRUE(static_cast<DictionaryValue*>(root.get())->GetList(
+      L"traceEvents", &trace_events));
+  ASSERT_EQ(3u, trace_events->GetSize());
+
+  const char* kNames[] = { "test.\"quoted\"", "test.\"quoted\"",
+                           "test.instant" };
+  const char* kPhases[] = { "B", "E", "i" };
+  const char* kIds[] = { "0x10", "0x10", "0x20" };
+  for (size_t i = 0; i < arraysize(kNames); ++i) {
+    DictionaryValue* event = NULL;
+    ASSERT_TRUE(trace_events->GetDictionary(i, &event));
+    std::string value;
+    EXPECT_TRUE(event->GetString(L"name", &value));
+    EXPECT_EQ(kNames[i], value);
+    EXPECT_TRUE(event->GetString(L"ph", &value));
+    EXPECT_EQ(kPhases[i], value);
+    EXPECT_TRUE(event->GetString(L"args.id", &value));
+    EXPECT_EQ(kIds[i], value);
+    int tid = 0;
+    EXPECT_TRUE(event->GetInteger(L"tid", &tid));
+    EXPECT_EQ(static_cast<int>(PlatformThread::CurrentId()), tid);
+  }
+}
+
+TEST_F(TraceEventTest, FormatBinary) {
+  TRACE_EVENT_BEGIN("test.binary", 1, "");
+  TRACE_EVENT_INSTANT("test.other", 2, "");
+  TRACE_EVENT_END("test.binary", 1, "");
+  std::vector<TraceLog::Event> events = GetEvents();
+  ASSERT_EQ(3u, events.size());
+
+  Pickle pickle;
+  TraceLog::FormatBinary(events, TimeTicks(), &pickle);
+
+  void* iter = NULL;
+  int value;
+  ASSERT_TRUE(pickle.ReadInt(&iter, &value));
+  EXPECT_EQ(TraceLog::kBinaryFormatVersion, value);
+  ASSERT_TRUE(pickle.ReadInt(&iter, &value));
+
+  // The two names and this file.
+  int num_strings;
+  ASSERT_TRUE(pickle.ReadInt(&iter, &num_strings));
+  ASSERT_EQ(3, num_strings);
+  std::vector<std::string> strings(num_strings);
+  for (int i = 0; i < num_strings; ++i)
+    ASSERT_TRUE(pickle.ReadString(&iter, &strings[i]));
+
+  int num_events;
+  ASSERT_TRUE(pickle.ReadInt(&iter, &num_events));
+  ASSERT_EQ(3, num_events);
+  for (int i = 0; i < num_events; ++i) {
+    int64 timestamp;
+    uint64 id;
+    int name, file, line, type, thread_id;
+    ASSERT_TRUE(pickle.ReadInt64(&iter, &timestamp));
+    ASSERT_TRUE(pickle.ReadUInt64(&iter, &id));
+    ASSERT_TRUE(pickle.ReadInt(&iter, &name));
+    ASSERT_TRUE(pickle.ReadInt(&iter, &file));
+    ASSERT_TRUE(pickle.ReadInt(&iter, &line));
+    ASSERT_TRUE(pickle.ReadInt(&iter, &type));
+    ASSERT_TRUE(pickle.ReadInt(&iter, &thread_id));
+    EXPECT_EQ(events[i].timestamp.ToInternalValue(), timestamp);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(events[i].id), id);
+    ASSERT_LT(name, num_strings);
+    EXPECT_EQ(events[i].name, strings[name]);
+    ASSERT_LT(file, num_strings);
+    EXPECT_EQ(__FILE__, strings[file]);
+    EXPECT_EQ(events[i].line, line);
+    EXPECT_EQ(events[i].type, type);
+  }
+}
+
+}  // namespace base
@@ -5,12 +5,16 @@
 #include "base/worker_pool.h"
 #include "base/worker_pool_linux.h"
 
+#include <algorithm>
+
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
 #include "base/string_util.h"
+#include "base/sys_info.h"
 #include "base/task.h"
+#include "base/time.h"
 
 namespace {
 
@@ -19,6 +23,10 @@ const int kIdleSecondsBeforeExit = 10 * 60;
 // function of NSS because of NSS bug 439169.
 const int kWorkerThreadStackSize = 256 * 1024;
 
+// The number of times a spinning worker yields, and looks for tasks again,
+// before it goes to sleep.
+const int kSpinRounds = 64;
+
 class WorkerPoolImpl {
  public:
   WorkerPoolImpl();
@@ -28,12 +36,15 @@ class WorkerPoolImpl {
                 bool task_is_slow);
 
  private:
-  scoped_refptr<base::LinuxDynamicThreadPool> pool_;
+  scoped_refptr<base::WorkStealingThreadPool> pool_;
 };
 
-WorkerPoolImpl::WorkerPoolImpl()
-    : pool_(new base::LinuxDynamicThreadPool(
-        "WorkerPool", kIdleSecondsBeforeExit)) {}
+WorkerPoolImpl::WorkerPoolImpl() {
+  int num_processors = base::SysInfo::NumberOfProcessors();
+  pool_ = new base::WorkStealingThreadPool(
+      "WorkerPool", num_processors, std::max(1, num_processors / 2),
+      kIdleSecondsBeforeExit);
+}
 
 WorkerPoolImpl::~WorkerPoolImpl() {
   pool_->Terminate();
@@ -42,36 +53,53 @@ WorkerPoolImpl::~WorkerPoolImpl() {
 void WorkerPoolImpl::PostTask(const tracked_objects::Location& from_here,
                               Task* task, bool task_is_slow) {
   task->SetBirthPlace(from_here);
-  pool_->PostTask(task);
+  pool_->PostTask(task, task_is_slow ?
+      base::WorkStealingThreadPool::PRIORITY_BLOCKING_IO :
+      base::WorkStealingThreadPool::PRIORITY_CPU);
 }
 
 base::LazyInstance<WorkerPoolImpl> g_lazy_worker_pool(base::LINKER_INITIALIZED);
 
-class WorkerThread : public PlatformThread::Delegate {
+}  // namespace
+
+bool WorkerPool::PostTask(const tracked_objects::Location& from_here,
+                          Task* task, bool task_is_slow) {
+  g_lazy_worker_pool.Pointer()->PostTask(from_here, task, task_is_slow);
+  return true;
+}
+
+namespace base {
+
+class WorkStealingThreadPool::WorkerThread : public PlatformThread::Delegate {
  public:
-  WorkerThread(const std::string& name_prefix, int idle_seconds_before_exit,
-               base::LinuxDynamicThreadPool* pool)
+  WorkerThread(const std::string& name_prefix, int home_queue,
+               WorkStealingThreadPool* pool)
       : name_prefix_(name_prefix),
-        idle_seconds_before_exit_(idle_seconds_before_exit),
+        home_queue_(home_queue),
         pool_(pool) {}
 
+  int home_queue() const { return home_queue_; }
+
   virtual void ThreadMain();
 
  private:
   const std::string name_prefix_;
-  const int idle_seconds_before_exit_;
-  scoped_refptr<base::LinuxDynamicThreadPool> pool_;
+  const int home_queue_;
+  scoped_refptr<WorkStealingThreadPool> pool_;
 
   DISALLOW_COPY_AND_ASSIGN(WorkerThread);
 };
 
-void WorkerThread::ThreadMain() {
+void WorkStealingThreadPool::WorkerThread::ThreadMain() {
   const std::string name =
       StringPrintf("%s/%d", name_prefix_.c_str(), PlatformThread::CurrentId());
   PlatformThread::SetName(name.c_str());
+  pool_->current_worker_.Set(this);
 
+  // A new worker is started by WakeUpWorker, as a spinning thread.
+  bool spinning = true;
   for (;;) {
-    Task* task = pool_->WaitForTask();
+    Task* task = pool_->WaitForTask(home_queue_, &spinning);
     if (!task)
       break;
     task->Run();
@@ -79,90 +107,249 @@ void WorkerThread::ThreadMain() {
   }
 
   // The WorkerThread is non-joinable, so it deletes itself.
+  pool_->current_worker_.Set(NULL);
   delete this;
 }
 
-}  // namespace
-
-bool WorkerPool::PostTask(const tracked_objects::Location& from_here,
-                          Task* task, bool task_is_slow) {
-  g_lazy_worker_pool.Pointer()->PostTask(from_here, task, task_is_slow);
-  return true;
-}
-
-namespace base {
-
-LinuxDynamicThreadPool::LinuxDynamicThreadPool(
+WorkStealingThreadPool::WorkStealingThreadPool(
     const std::string& name_prefix,
+    int num_queues,
+    int max_spinning_threads,
     int idle_seconds_before_exit)
     : name_prefix_(name_prefix),
+      num_queues_(num_queues),
+      max_spinning_threads_(max_spinning_threads),
       idle_seconds_before_exit_(idle_seconds_before_exit),
+      queues_(new TaskQueue[num_queues]),
+      next_queue_(0),
+      num_queued_tasks_(0),
+      num_spinning_threads_(0),
+      terminated_(0),
       tasks_available_cv_(&lock_),
-      num_idle_threads_(0),
-      terminated_(false),
-      num_idle_threads_cv_(NULL) {}
-
-LinuxDynamicThreadPool::~LinuxDynamicThreadPool() {
-  while (!tasks_.empty()) {
-    Task* task = tasks_.front();
-    tasks_.pop();
-    delete task;
+      num_threads_(0),
+      num_sleeping_threads_(0),
+      num_pending_wakeups_(0),
+      num_threads_cv_(NULL) {
+  DCHECK_GT(num_queues, 0);
+  DCHECK_GT(max_spinning_threads, 0);
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  for (int i = 0; i < num_queues_; ++i) {
+    for (int priority = 0; priority < NUM_PRIORITIES; ++priority) {
+      std::deque<Task*>& tasks = queues_[i].tasks[priority];
+      while (!tasks.empty()) {
+        Task* task = tasks.front();
+        tasks.pop_front();
+        delete task;
+      }
+    }
   }
 }
 
-void LinuxDynamicThreadPool::Terminate() {
+void WorkStealingThreadPool::Terminate() {
   {
     AutoLock locked(lock_);
     DCHECK(!terminated_) << "Thread pool is already terminated.";
-    terminated_ = true;
+    base::subtle::Release_Store(&terminated_, 1);
   }
   tasks_available_cv_.Broadcast();
 }
 
-void LinuxDynamicThreadPool::PostTask(Task* task) {
-  AutoLock locked(lock_);
-  DCHECK(!terminated_) <<
+void WorkStealingThreadPool::PostTask(Task* task, Priority priority) {
+  DCHECK(!base::subtle::NoBarrier_Load(&terminated_)) <<
       "This thread pool is already terminated.  Do not post new tasks.";
 
-  tasks_.push(task);
-
-  // We have enough worker threads.
-  if (static_cast<size_t>(num_idle_threads_) >= tasks_.size()) {
-    tasks_available_cv_.Signal();
+  // Tasks posted by a worker stay on its queue, the others are spread over
+  // all the queues.
+  int index;
+  WorkerThread* worker = current_worker_.Get();
+  if (worker) {
+    index = worker->home_queue();
   } else {
-    // The new PlatformThread will take ownership of the WorkerThread object,
-    // which will delete itself on exit.
-    WorkerThread* worker =
-        new WorkerThread(name_prefix_, idle_seconds_before_exit_, this);
-    PlatformThread::CreateNonJoinable(kWorkerThreadStackSize, worker);
+    uint32 next = static_cast<uint32>(
+        base::subtle::NoBarrier_AtomicIncrement(&next_queue_, 1));
+    index = next % num_queues_;
   }
+
+  TaskQueue& queue = queues_[index];
+  {
+    AutoLock locked(queue.lock);
+    queue.tasks[priority].push_back(task);
+    base::subtle::NoBarrier_Store(&queue.num_tasks, queue.num_tasks + 1);
+  }
+
+  // This barrier pairs with the one in WaitForTask, when a worker stops
+  // spinning: either the worker sees the task, or we see that nobody spins.
+  base::subtle::Barrier_AtomicIncrement(&num_queued_tasks_, 1);
+  if (base::subtle::NoBarrier_Load(&num_spinning_threads_) > 0)
+    return;  // The spinning worker will find |task|.
+  WakeUpWorker();
 }
 
-Task* LinuxDynamicThreadPool::WaitForTask() {
-  AutoLock locked(lock_);
+Task* WorkStealingThreadPool::WaitForTask(int home_queue, bool* spinning) {
+  for (;;) {
+    if (base::subtle::Acquire_Load(&terminated_))
+      return NULL;
 
-  if (terminated_)
-    return NULL;
+    Task* task = TakeTask(home_queue);
+    if (task) {
+      if (*spinning)
+        StopSpinning(spinning);
+      return task;
+    }
+
+    if (*spinning || StartSpinning()) {
+      *spinning = true;
+      for (int i = 0; i < kSpinRounds && !task; ++i) {
+        PlatformThread::YieldCurrentThread();
+        task = TakeTask(home_queue);
+      }
+      if (task) {
+        StopSpinning(spinning);
+        return task;
+      }
+
+      // Give up.  This barrier pairs with the one in PostTask: either we see
+      // the tasks posted from now on, or their poster sees that nobody spins.
+      *spinning = false;
+      base::subtle::Barrier_AtomicIncrement(&num_spinning_threads_, -1);
+      if (base::subtle::NoBarrier_Load(&num_queued_tasks_) > 0)
+        continue;
+    }
 
-  if (tasks_.empty()) {  // No work available, wait for work.
-    num_idle_threads_++;
-    if (num_idle_threads_cv_.get())
-      num_idle_threads_cv_->Signal();
-    tasks_available_cv_.TimedWait(
-        TimeDelta::FromSeconds(kIdleSecondsBeforeExit));
-    num_idle_threads_--;
-    if (num_idle_threads_cv_.get())
-      num_idle_threads_cv_->Signal();
-    if (tasks_.empty()) {
-      // We waited for work, but there's still no work.  Return NULL to signal
-      // the thread to terminate.
+    if (!Sleep(spinning))
       return NULL;
+  }
+}
+
+Task* WorkStealingThreadPool::TakeTask(int home_queue) {
+  if (!base::subtle::Acquire_Load(&num_queued_tasks_))
+    return NULL;
+
+  for (int priority = 0; priority < NUM_PRIORITIES; ++priority) {
+    for (int i = 0; i < num_queues_; ++i) {
+      TaskQueue& queue = queues_[(home_queue + i) % num_queues_];
+      if (!base::subtle::NoBarrier_Load(&queue.num_tasks))
+        continue;
+
+      AutoLock locked(queue.lock);
+      std::deque<Task*>& tasks = queue.tasks[priority];
+      if (tasks.empty())
+        continue;
+      Task* task = tasks.front();
+      tasks.pop_front();
+      base::subtle::NoBarrier_Store(&queue.num_tasks, queue.num_tasks - 1);
+      base::subtle::NoBarrier_AtomicIncrement(&num_queued_tasks_, -1);
+      return task;
     }
   }
+  return NULL;
+}
+
+bool WorkStealingThreadPool::StartSpinning() {
+  for (;;) {
+    base::subtle::Atomic32 spinning =
+        base::subtle::NoBarrier_Load(&num_spinning_threads_);
+    if (spinning >= max_spinning_threads_)
+      return false;
+    if (base::subtle::NoBarrier_CompareAndSwap(&num_spinning_threads_,
+                                               spinning, spinning + 1) ==
+        spinning) {
+      return true;
+    }
+  }
+}
+
+void WorkStealingThreadPool::StopSpinning(bool* spinning) {
+  *spinning = false;
+  // The last spinning worker wakes up another one for the remaining tasks, so
+  // that they do not wait until the current one is done.
+  if (base::subtle::Barrier_AtomicIncrement(&num_spinning_threads_, -1) == 0 &&
+      base::subtle::NoBarrier_Load(&num_queued_tasks_) > 0) {
+    WakeUpWorker();
+  }
+}
+
+void WorkStealingThreadPool::WakeUpWorker() {
+  // Only one worker is woken up at a time.  It counts as spinning right away,
+  // so that the tasks posted until it runs do not wake up others.
+  if (base::subtle::NoBarrier_CompareAndSwap(&num_spinning_threads_, 0, 1))
+    return;
+
+  AutoLock locked(lock_);
+  if (base::subtle::NoBarrier_Load(&terminated_)) {
+    base::subtle::NoBarrier_AtomicIncrement(&num_spinning_threads_, -1);
+    return;
+  }
+  if (num_sleeping_threads_ > num_pending_wakeups_) {
+    ++num_pending_wakeups_;
+    tasks_available_cv_.Signal();
+  } else {
+    StartWorkerThread();
+  }
+}
 
-  Task* task = tasks_.front();
-  tasks_.pop();
-  return task;
+void WorkStealingThreadPool::StartWorkerThread() {
+  lock_.AssertAcquired();
+  // The new PlatformThread will take ownership of the WorkerThread object,
+  // which will delete itself on exit.
+  WorkerThread* worker =
+      new WorkerThread(name_prefix_, num_threads_ % num_queues_, this);
+  if (!PlatformThread::CreateNonJoinable(kWorkerThreadStackSize, worker)) {
+    // The worker was counted as spinning by WakeUpWorker().  The queued tasks
+    // wait for the next wake up.
+    LOG(ERROR) << "Unable to start a worker thread";
+    base::subtle::NoBarrier_AtomicIncrement(&num_spinning_threads_, -1);
+    delete worker;
+    return;
+  }
+  ++num_threads_;
+  if (num_threads_cv_.get())
+    num_threads_cv_->Signal();
+}
+
+bool WorkStealingThreadPool::Sleep(bool* spinning) {
+  AutoLock locked(lock_);
+
+  TimeTicks idle_since = TimeTicks::Now();
+  TimeDelta idle_time_before_exit =
+      TimeDelta::FromSeconds(idle_seconds_before_exit_);
+  num_sleeping_threads_++;
+  if (num_threads_cv_.get())
+    num_threads_cv_->Signal();
+  for (;;) {
+    if (base::subtle::NoBarrier_Load(&terminated_))
+      break;
+    if (num_pending_wakeups_)
+      break;
+    // One thread per queue stays around.
+    if (num_threads_ <= num_queues_) {
+      tasks_available_cv_.Wait();
+      continue;
+    }
+    TimeDelta idle_time = TimeTicks::Now() - idle_since;
+    if (idle_time >= idle_time_before_exit)
+      break;
+    tasks_available_cv_.TimedWait(idle_time_before_exit - idle_time);
+  }
+  num_sleeping_threads_--;
+
+  bool keep_running = true;
+  if (num_pending_wakeups_) {
+    // WakeUpWorker made us a spinning thread.
+    num_pending_wakeups_--;
+    *spinning = true;
+  } else if (base::subtle::NoBarrier_Load(&terminated_)) {
+    keep_running = false;
+  } else {
+    // We were idle for too long.
+    num_threads_--;
+    keep_running = false;
+  }
+  if (num_threads_cv_.get())
+    num_threads_cv_->Signal();
+  return keep_running;
 }
 
 }  // namespace base
@@ -2,20 +2,36 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 //
-// The thread pool used in the Linux implementation of WorkerPool dynamically
-// adds threads as necessary to handle all tasks.  It keeps old threads around
-// for a period of time to allow them to be reused.  After this waiting period,
-// the threads exit.  This thread pool uses non-joinable threads, therefore
-// worker threads are not joined during process shutdown.  This means that
-// potentially long running tasks (such as DNS lookup) do not block process
-// shutdown, but also means that process shutdown may "leak" objects.  Note that
-// although LinuxDynamicThreadPool spawns the worker threads and manages the
-// task queue, it does not own the worker threads.  The worker threads ask the
-// LinuxDynamicThreadPool for work and eventually clean themselves up.  The
-// worker threads all maintain scoped_refptrs to the LinuxDynamicThreadPool
-// instance, which prevents LinuxDynamicThreadPool from disappearing before all
-// worker threads exit.  The owner of LinuxDynamicThreadPool should likewise
-// maintain a scoped_refptr to the LinuxDynamicThreadPool instance.
+// The thread pool used in the Linux implementation of WorkerPool is a work
+// stealing pool.  Tasks are spread over a fixed number of queues, each with its
+// own lock.  Tasks posted from outside the pool are distributed round robin,
+// and tasks posted by a worker thread go to the worker's own queue.  A worker
+// runs the tasks of its queue first, and steals from the other queues when its
+// queue is empty.
+//
+// A worker which runs out of work spins for a while, looking for tasks to
+// steal, before it goes to sleep.  At most |max_spinning_threads| workers spin
+// at the same time.  While a worker spins, posting a task does not need to
+// wake up or create a thread.  Otherwise, PostTask wakes up one sleeping
+// worker, or creates a new one if none are sleeping.  The woken worker spins
+// in turn, and when it finds a task, it wakes up the next worker if more tasks
+// are queued.  This way, a burst of tasks wakes up workers one at a time, as
+// fast as they pick up the tasks.
+//
+// The pool dynamically adds threads as necessary to handle all tasks.  It
+// keeps one thread per queue alive.  The other threads exit after they have
+// been idle for |idle_seconds_before_exit|.  This thread pool uses non-joinable
+// threads, therefore worker threads are not joined during process shutdown.
+// This means that potentially long running tasks (such as DNS lookup) do not
+// block process shutdown, but also means that process shutdown may "leak"
+// objects.  Note that although WorkStealingThreadPool spawns the worker threads
+// and manages the task queues, it does not own the worker threads.  The worker
+// threads ask the WorkStealingThreadPool for work and eventually clean
+// themselves up.  The worker threads all maintain scoped_refptrs to the
+// WorkStealingThreadPool instance, which prevents WorkStealingThreadPool from
+// disappearing before all worker threads exit.  The owner of
+// WorkStealingThreadPool should likewise maintain a scoped_refptr to the
+// WorkStealingThreadPool instance.
 //
 // NOTE: The classes defined in this file are only meant for use by the Linux
 // implementation of WorkerPool.  No one else should be using these classes.
@@ -24,63 +40,135 @@
 #ifndef BASE_WORKER_POOL_LINUX_H_
 #define BASE_WORKER_POOL_LINUX_H_
 
-#include <queue>
+#include <deque>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/condition_variable.h"
 #include "base/lock.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
+#include "base/thread_local.h"
 
 class Task;
 
 namespace base {
 
-class LinuxDynamicThreadPool
-    : public RefCountedThreadSafe<LinuxDynamicThreadPool> {
+class WorkStealingThreadPool
+    : public RefCountedThreadSafe<WorkStealingThreadPool> {
  public:
-  class LinuxDynamicThreadPoolPeer;
-
-  // All worker threads will share the same |name_prefix|.  They will exit after
+  class WorkStealingThreadPoolPeer;
+
+  // Workers take the tasks of a higher priority first, from any queue.
+  enum Priority {
+    // Short tasks, which keep a CPU busy while they run.
+    PRIORITY_CPU,
+    // Tasks which mostly wait for the disk or the network.
+    PRIORITY_BLOCKING_IO,
+    NUM_PRIORITIES
+  };
+
+  // All worker threads will share the same |name_prefix|.  Tasks are spread
+  // over |num_queues| queues.  Threads above one per queue will exit after
   // |idle_seconds_before_exit|.
-  LinuxDynamicThreadPool(const std::string& name_prefix,
+  WorkStealingThreadPool(const std::string& name_prefix,
+                         int num_queues,
+                         int max_spinning_threads,
                          int idle_seconds_before_exit);
-  ~LinuxDynamicThreadPool();
+  ~WorkStealingThreadPool();
 
   // Indicates that the thread pool is going away.  Stops handing out tasks to
   // worker threads.  Wakes up all the idle threads to let them exit.
   void Terminate();
 
-  // Adds |task| to the thread pool.  LinuxDynamicThreadPool assumes ownership
+  // Adds |task| to the thread pool.  WorkStealingThreadPool assumes ownership
   // of |task|.
-  void PostTask(Task* task);
+  void PostTask(Task* task, Priority priority);
 
-  // Worker thread method to wait for up to |idle_seconds_before_exit| for more
-  // work from the thread pool.  Returns NULL if no work is available.
-  Task* WaitForTask();
+  // Worker thread method to find the next task to run.  The worker's own queue
+  // is |home_queue|, and |*spinning| says whether the worker counts as one of
+  // the spinning threads.  Returns NULL when the worker should exit.
+  Task* WaitForTask(int home_queue, bool* spinning);
 
  private:
-  friend class LinuxDynamicThreadPoolPeer;
+  friend class WorkStealingThreadPoolPeer;
+
+  class WorkerThread;
+
+  // The tasks of one queue, by priority.  |num_tasks| is kept up to date under
+  // |lock|, and read without it to skip empty queues.
+  struct TaskQueue {
+    TaskQueue() : num_tasks(0) {}
+
+    Lock lock;
+    std::deque<Task*> tasks[NUM_PRIORITIES];
+    base::subtle::Atomic32 num_tasks;
+  };
+
+  // Pops the oldest task of the highest priority, looking at |home_queue|
+  // first.  Returns NULL if all the queues are empty.
+  Task* TakeTask(int home_queue);
+
+  // Makes the calling worker one of the spinning threads, unless there are
+  // |max_spinning_threads_| already.  Returns true on success.
+  bool StartSpinning();
+
+  // Called when a spinning worker found a task.  Hands the spinning over to
+  // another worker if tasks are still queued.
+  void StopSpinning(bool* spinning);
+
+  // Wakes up a sleeping worker, or starts a new one, as a spinning thread.
+  // Does nothing if a worker is spinning already.
+  void WakeUpWorker();
+
+  // Creates a new worker thread.  |lock_| must be held.
+  void StartWorkerThread();
+
+  // Puts the calling worker to sleep until WakeUpWorker picks it.  Returns
+  // false if the worker should exit instead.
+  bool Sleep(bool* spinning);
 
   const std::string name_prefix_;
+  const int num_queues_;
+  const int max_spinning_threads_;
   const int idle_seconds_before_exit_;
 
+  scoped_array<TaskQueue> queues_;
+
+  // The worker thread's WorkerThread, if any.
+  ThreadLocalPointer<WorkerThread> current_worker_;
+
+  // Used to distribute the tasks posted from outside the pool.
+  base::subtle::Atomic32 next_queue_;
+
+  // The number of tasks in all the queues.
+  base::subtle::Atomic32 num_queued_tasks_;
+
+  // The number of workers looking for tasks to steal.  WakeUpWorker counts
+  // the worker it wakes up before it actually starts spinning.
+  base::subtle::Atomic32 num_spinning_threads_;
+
+  // Non-zero once Terminate() has been called.
+  base::subtle::Atomic32 terminated_;
+
   Lock lock_;  // Protects all the variables below.
 
-  // Signal()s worker threads to let them know more tasks are available.
-  // Also used for Broadcast()'ing to worker threads to let them know the pool
-  // is being deleted and they can exit.
+  // Signal()s sleeping worker threads to let them know more tasks are
+  // available.  Also used for Broadcast()'ing to worker threads to let them
+  // know the pool is being deleted and they can exit.
   ConditionVariable tasks_available_cv_;
-  int num_idle_threads_;
-  std::queue<Task*> tasks_;
-  bool terminated_;
+  int num_threads_;
+  int num_sleeping_threads_;
+  // The number of sleeping threads which were Signal()ed, and have not woken
+  // up yet.
+  int num_pending_wakeups_;
   // Only used for tests to ensure correct thread ordering.  It will always be
   // NULL in non-test code.
-  scoped_ptr<ConditionVariable> num_idle_threads_cv_;
+  scoped_ptr<ConditionVariable> num_threads_cv_;
 
-  DISALLOW_COPY_AND_ASSIGN(LinuxDynamicThreadPool);
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingThreadPool);
 };
 
 }  // namespace base
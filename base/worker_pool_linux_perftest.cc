@@ -0,0 +1,99 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/worker_pool_linux.h"
+
+#include <algorithm>
+
+#include "base/lock.h"
+#include "base/logging.h"
+#include "base/perftimer.h"
+#include "base/platform_thread.h"
+#include "base/ref_counted.h"
+#include "base/sys_info.h"
+#include "base/task.h"
+#include "base/time.h"
+#include "base/waitable_event.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Records how long it waited in the pool, and signals |done| when all the
+// tasks of a burst ran.
+class LatencyRecordingTask : public Task {
+ public:
+  LatencyRecordingTask(Lock* lock, base::TimeDelta* total_latency,
+                       base::TimeDelta* max_latency, int* tasks_left,
+                       base::WaitableEvent* done)
+      : lock_(lock),
+        total_latency_(total_latency),
+        max_latency_(max_latency),
+        tasks_left_(tasks_left),
+        done_(done),
+        posted_at_(base::TimeTicks::Now()) {}
+
+  virtual void Run() {
+    base::TimeDelta latency = base::TimeTicks::Now() - posted_at_;
+    AutoLock locked(*lock_);
+    *total_latency_ += latency;
+    *max_latency_ = std::max(*max_latency_, latency);
+    if (--(*tasks_left_) == 0)
+      done_->Signal();
+  }
+
+ private:
+  Lock* lock_;
+  base::TimeDelta* total_latency_;
+  base::TimeDelta* max_latency_;
+  int* tasks_left_;
+  base::WaitableEvent* done_;
+  base::TimeTicks posted_at_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyRecordingTask);
+};
+
+}  // namespace
+
+// Measures the latency and the throughput of the pool, under bursts of short
+// tasks.
+TEST(WorkStealingThreadPoolPerfTest, BurstyLoad) {
+  const int kNumBursts = 50;
+  const int kTasksPerBurst = 200;
+  const int kMillisecondsBetweenBursts = 5;
+
+  int num_processors = base::SysInfo::NumberOfProcessors();
+  scoped_refptr<base::WorkStealingThreadPool> pool =
+      new base::WorkStealingThreadPool("work_stealing_pool", num_processors,
+                                       std::max(1, num_processors / 2),
+                                       60*60);
+
+  Lock lock;
+  base::TimeDelta total_latency;
+  base::TimeDelta max_latency;
+  base::TimeDelta busy_time;
+  for (int burst = 0; burst < kNumBursts; ++burst) {
+    int tasks_left = kTasksPerBurst;
+    base::WaitableEvent done(false, false);
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kTasksPerBurst; ++i) {
+      pool->PostTask(
+          new LatencyRecordingTask(&lock, &total_latency, &max_latency,
+                                   &tasks_left, &done),
+          base::WorkStealingThreadPool::PRIORITY_CPU);
+    }
+    CHECK(done.Wait());
+    busy_time += base::TimeTicks::Now() - start;
+    PlatformThread::Sleep(kMillisecondsBetweenBursts);
+  }
+  pool->Terminate();
+
+  const int kNumTasks = kNumBursts * kTasksPerBurst;
+  LogPerfResult("Worker_pool_bursty_load_mean_latency",
+                static_cast<double>(total_latency.InMicroseconds()) / kNumTasks,
+                "us");
+  LogPerfResult("Worker_pool_bursty_load_max_latency",
+                static_cast<double>(max_latency.InMicroseconds()), "us");
+  LogPerfResult("Worker_pool_bursty_load_throughput",
+                kNumTasks / busy_time.InSecondsF(), "tasks/s");
+}
@@ -8,36 +8,46 @@
 
 #include "base/condition_variable.h"
 #include "base/lock.h"
+#include "base/logging.h"
 #include "base/platform_thread.h"
+#include "base/scoped_ptr.h"
 #include "base/task.h"
 #include "base/waitable_event.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
 
-// Peer class to provide passthrough access to LinuxDynamicThreadPool internals.
-class LinuxDynamicThreadPool::LinuxDynamicThreadPoolPeer {
+// Peer class to provide passthrough access to WorkStealingThreadPool internals.
+class WorkStealingThreadPool::WorkStealingThreadPoolPeer {
  public:
-  explicit LinuxDynamicThreadPoolPeer(LinuxDynamicThreadPool* pool)
+  explicit WorkStealingThreadPoolPeer(WorkStealingThreadPool* pool)
       : pool_(pool) {}
 
   Lock* lock() { return &pool_->lock_; }
-  ConditionVariable* tasks_available_cv() {
-    return &pool_->tasks_available_cv_;
+  int num_threads() const { return pool_->num_threads_; }
+  int num_sleeping_threads() const { return pool_->num_sleeping_threads_; }
+  ConditionVariable* num_threads_cv() {
+    return pool_->num_threads_cv_.get();
   }
-  const std::queue<Task*>& tasks() const { return pool_->tasks_; }
-  int num_idle_threads() const { return pool_->num_idle_threads_; }
-  ConditionVariable* num_idle_threads_cv() {
-    return pool_->num_idle_threads_cv_.get();
+  void set_num_threads_cv(ConditionVariable* cv) {
+    pool_->num_threads_cv_.reset(cv);
   }
-  void set_num_idle_threads_cv(ConditionVariable* cv) {
-    pool_->num_idle_threads_cv_.reset(cv);
+
+  // Queues |task| on |queue| without waking up any worker.
+  void PushTask(Task* task, Priority priority, int queue) {
+    TaskQueue& task_queue = pool_->queues_[queue];
+    AutoLock locked(task_queue.lock);
+    task_queue.tasks[priority].push_back(task);
+    task_queue.num_tasks++;
+    pool_->num_queued_tasks_++;
   }
 
+  Task* TakeTask(int home_queue) { return pool_->TakeTask(home_queue); }
+
  private:
-  LinuxDynamicThreadPool* pool_;
+  WorkStealingThreadPool* pool_;
 
-  DISALLOW_COPY_AND_ASSIGN(LinuxDynamicThreadPoolPeer);
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingThreadPoolPeer);
 };
 
 }  // namespace base
@@ -120,18 +130,49 @@ class BlockingIncrementingTask : public Task {
   DISALLOW_COPY_AND_ASSIGN(BlockingIncrementingTask);
 };
 
-class LinuxDynamicThreadPoolTest : public testing::Test {
+// Signals |done| when it runs.
+class SignalingTask : public Task {
+ public:
+  explicit SignalingTask(base::WaitableEvent* done) : done_(done) {}
+
+  virtual void Run() {
+    done_->Signal();
+  }
+
+ private:
+  base::WaitableEvent* done_;
+
+  DISALLOW_COPY_AND_ASSIGN(SignalingTask);
+};
+
+// Posts a SignalingTask from a worker thread, and waits for it to run.  The
+// new task lands on the queue of the blocked worker, so another worker has to
+// steal it.
+class PostAndWaitTask : public Task {
+ public:
+  explicit PostAndWaitTask(base::WorkStealingThreadPool* pool) : pool_(pool) {}
+
+  virtual void Run() {
+    base::WaitableEvent done(false, false);
+    pool_->PostTask(new SignalingTask(&done),
+                    base::WorkStealingThreadPool::PRIORITY_CPU);
+    CHECK(done.Wait());
+  }
+
+ private:
+  base::WorkStealingThreadPool* pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(PostAndWaitTask);
+};
+
+class WorkStealingThreadPoolTest : public testing::Test {
  protected:
-  LinuxDynamicThreadPoolTest()
-      : pool_(new base::LinuxDynamicThreadPool("dynamic_pool", 60*60)),
-        peer_(pool_.get()),
-        counter_(0),
+  WorkStealingThreadPoolTest()
+      : counter_(0),
         num_waiting_to_start_(0),
         num_waiting_to_start_cv_(&num_waiting_to_start_lock_),
-        start_(true, false) {}
-
-  virtual void SetUp() {
-    peer_.set_num_idle_threads_cv(new ConditionVariable(peer_.lock()));
+        start_(true, false) {
+    CreatePool(1, 60*60);
   }
 
   virtual void TearDown() {
@@ -139,6 +180,19 @@ class LinuxDynamicThreadPoolTest : public testing::Test {
     if (pool_.get()) pool_->Terminate();
   }
 
+  // Replaces |pool_| with a pool of |num_queues| queues, and one spinning
+  // thread.
+  void CreatePool(int num_queues, int idle_seconds_before_exit) {
+    if (pool_.get())
+      pool_->Terminate();
+    pool_ = new base::WorkStealingThreadPool(
+        "work_stealing_pool", num_queues, 1, idle_seconds_before_exit);
+    peer_.reset(
+        new base::WorkStealingThreadPool::WorkStealingThreadPoolPeer(
+            pool_.get()));
+    peer_->set_num_threads_cv(new ConditionVariable(peer_->lock()));
+  }
+
   void WaitForTasksToStart(int num_tasks) {
     AutoLock num_waiting_to_start_locked(num_waiting_to_start_lock_);
     while (num_waiting_to_start_ < num_tasks) {
@@ -146,10 +200,12 @@ class LinuxDynamicThreadPoolTest : public testing::Test {
     }
   }
 
-  void WaitForIdleThreads(int num_idle_threads) {
-    AutoLock pool_locked(*peer_.lock());
-    while (peer_.num_idle_threads() < num_idle_threads) {
-      peer_.num_idle_threads_cv()->Wait();
+  // Waits until the pool has |num_threads| threads, all of them sleeping.
+  void WaitForSleepingThreads(int num_threads) {
+    AutoLock pool_locked(*peer_->lock());
+    while (peer_->num_threads() != num_threads ||
+           peer_->num_sleeping_threads() != num_threads) {
+      peer_->num_threads_cv()->Wait();
     }
   }
 
@@ -165,8 +221,12 @@ class LinuxDynamicThreadPoolTest : public testing::Test {
         &num_waiting_to_start_cv_, &start_);
   }
 
-  scoped_refptr<base::LinuxDynamicThreadPool> pool_;
-  base::LinuxDynamicThreadPool::LinuxDynamicThreadPoolPeer peer_;
+  void PostTask(Task* task) {
+    pool_->PostTask(task, base::WorkStealingThreadPool::PRIORITY_CPU);
+  }
+
+  scoped_refptr<base::WorkStealingThreadPool> pool_;
+  scoped_ptr<base::WorkStealingThreadPool::WorkStealingThreadPoolPeer> peer_;
   Lock counter_lock_;
   int counter_;
   Lock unique_threads_lock_;
@@ -177,92 +237,109 @@ class LinuxDynamicThreadPoolTest : public testing::Test {
   base::WaitableEvent start_;
 };
 
-TEST_F(LinuxDynamicThreadPoolTest, Basic) {
-  EXPECT_EQ(0, peer_.num_idle_threads());
+TEST_F(WorkStealingThreadPoolTest, Basic) {
+  EXPECT_EQ(0, peer_->num_threads());
   EXPECT_EQ(0U, unique_threads_.size());
-  EXPECT_EQ(0U, peer_.tasks().size());
 
   // Add one task and wait for it to be completed.
-  pool_->PostTask(CreateNewIncrementingTask());
+  PostTask(CreateNewIncrementingTask());
 
-  WaitForIdleThreads(1);
+  WaitForSleepingThreads(1);
 
   EXPECT_EQ(1U, unique_threads_.size()) <<
       "There should be only one thread allocated for one task.";
-  EXPECT_EQ(1, peer_.num_idle_threads());
   EXPECT_EQ(1, counter_);
 }
 
-TEST_F(LinuxDynamicThreadPoolTest, ReuseIdle) {
+TEST_F(WorkStealingThreadPoolTest, ReuseIdle) {
   // Add one task and wait for it to be completed.
-  pool_->PostTask(CreateNewIncrementingTask());
+  PostTask(CreateNewIncrementingTask());
 
-  WaitForIdleThreads(1);
+  WaitForSleepingThreads(1);
 
   // Add another 2 tasks.  One should reuse the existing worker thread.
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
 
   WaitForTasksToStart(2);
   start_.Signal();
-  WaitForIdleThreads(2);
+  WaitForSleepingThreads(2);
 
   EXPECT_EQ(2U, unique_threads_.size());
-  EXPECT_EQ(2, peer_.num_idle_threads());
   EXPECT_EQ(3, counter_);
 }
 
-TEST_F(LinuxDynamicThreadPoolTest, TwoActiveTasks) {
+TEST_F(WorkStealingThreadPoolTest, TwoActiveTasks) {
   // Add two blocking tasks.
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
 
   EXPECT_EQ(0, counter_) << "Blocking tasks should not have started yet.";
 
   WaitForTasksToStart(2);
   start_.Signal();
-  WaitForIdleThreads(2);
+  WaitForSleepingThreads(2);
 
   EXPECT_EQ(2U, unique_threads_.size());
-  EXPECT_EQ(2, peer_.num_idle_threads()) << "Existing threads are now idle.";
   EXPECT_EQ(2, counter_);
 }
 
-TEST_F(LinuxDynamicThreadPoolTest, Complex) {
-  // Add two non blocking tasks and wait for them to finish.
-  pool_->PostTask(CreateNewIncrementingTask());
+TEST_F(WorkStealingThreadPoolTest, IdleThreadsExit) {
+  // Threads above one per queue exit as soon as they are idle.
+  CreatePool(1, 0);
 
-  WaitForIdleThreads(1);
-
-  // Add two blocking tasks, start them simultaneously, and wait for them to
-  // finish.
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
-  pool_->PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
+  PostTask(CreateNewBlockingIncrementingTask());
 
   WaitForTasksToStart(2);
   start_.Signal();
-  WaitForIdleThreads(2);
+  WaitForSleepingThreads(1);
 
-  EXPECT_EQ(3, counter_);
-  EXPECT_EQ(2, peer_.num_idle_threads());
   EXPECT_EQ(2U, unique_threads_.size());
+  EXPECT_EQ(2, counter_);
 
-  // Wake up all idle threads so they can exit.
-  {
-    AutoLock locked(*peer_.lock());
-    while (peer_.num_idle_threads() > 0) {
-      peer_.tasks_available_cv()->Signal();
-      peer_.num_idle_threads_cv()->Wait();
-    }
-  }
+  // Add another task.  It reuses the remaining thread.  |start_| is still
+  // signaled, so it does not block.
+  PostTask(CreateNewBlockingIncrementingTask());
+  WaitForTasksToStart(3);
+  WaitForSleepingThreads(1);
+
+  EXPECT_EQ(2U, unique_threads_.size());
+  EXPECT_EQ(3, counter_);
+}
+
+TEST_F(WorkStealingThreadPoolTest, TakeTaskOrder) {
+  // No threads are started: the tasks are pushed directly on the queues.
+  CreatePool(2, 60*60);
+
+  Task* io_task = CreateNewIncrementingTask();
+  Task* home_cpu_task = CreateNewIncrementingTask();
+  Task* other_cpu_task = CreateNewIncrementingTask();
+  peer_->PushTask(io_task,
+                  base::WorkStealingThreadPool::PRIORITY_BLOCKING_IO, 0);
+  peer_->PushTask(other_cpu_task,
+                  base::WorkStealingThreadPool::PRIORITY_CPU, 1);
+  peer_->PushTask(home_cpu_task,
+                  base::WorkStealingThreadPool::PRIORITY_CPU, 0);
+
+  // CPU tasks come first, from the home queue first.  The blocking task is
+  // taken last, even though it is on the home queue.
+  EXPECT_EQ(home_cpu_task, peer_->TakeTask(0));
+  EXPECT_EQ(other_cpu_task, peer_->TakeTask(0));
+  EXPECT_EQ(io_task, peer_->TakeTask(0));
+  EXPECT_TRUE(peer_->TakeTask(0) == NULL);
+  EXPECT_TRUE(peer_->TakeTask(1) == NULL);
+
+  delete io_task;
+  delete home_cpu_task;
+  delete other_cpu_task;
+}
 
-  // Add another non blocking task.  There are no threads to reuse.
-  pool_->PostTask(CreateNewIncrementingTask());
-  WaitForIdleThreads(1);
+TEST_F(WorkStealingThreadPoolTest, StealFromBlockedWorker) {
+  CreatePool(2, 60*60);
 
-  EXPECT_EQ(3U, unique_threads_.size());
-  EXPECT_EQ(1, peer_.num_idle_threads());
-  EXPECT_EQ(4, counter_);
+  PostTask(new PostAndWaitTask(pool_.get()));
+  WaitForSleepingThreads(2);
 }
 
 }  // namespace
@@ -24,6 +24,7 @@
 #include "net/ftp/ftp_network_layer.h"
 #include "net/http/http_cache.h"
 #include "net/http/http_network_layer.h"
+#include "net/http/http_network_session.h"
 #include "net/http/http_util.h"
 #include "net/proxy/proxy_config_service_fixed.h"
 #include "net/proxy/proxy_script_fetcher.h"
@@ -170,6 +171,11 @@ ChromeURLRequestContext* FactoryForOriginal::Create() {
   }
   context->set_http_transaction_factory(cache);
 
+  // The dns prefetch system shares the global host resolver with this context,
+  // so it also preconnects through its sockets and proxies.
+  chrome_browser_net::SetPreconnectSocketPool(
+      cache->GetSession()->tcp_socket_pool(), context->proxy_service());
+
   context->set_ftp_transaction_factory(
       new net::FtpNetworkLayer(context->host_resolver()));
 
@@ -156,6 +156,14 @@ static bool AccruePrefetchBenefits(const GURL& referrer,
   return dns_master->AccruePrefetchBenefits(referrer, navigation_info);
 }
 
+void SetPreconnectSocketPool(net::ClientSocketPool* socket_pool,
+                             net::ProxyService* proxy_service) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::IO));
+  if (NULL == dns_master)
+    return;
+  dns_master->SetPreconnectSocketPool(socket_pool, proxy_service);
+}
+
 // When we navigate, we may know in advance some other domains that will need to
 // be resolved.  This function initiates those side effects.
 static void NavigatingTo(const std::string& host_name) {
@@ -43,6 +43,12 @@ void FreeDnsPrefetchResources();
 // the IO thread.
 net::HostResolver* GetGlobalHostResolver();
 
+// Lets the dns prefetch system open connections ahead of time, on the
+// |socket_pool| of the main URLRequestContext, through the proxies selected by
+// its |proxy_service|.  Called on the IO thread.
+void SetPreconnectSocketPool(net::ClientSocketPool* socket_pool,
+                             net::ProxyService* proxy_service);
+
 //------------------------------------------------------------------------------
 // Global APIs relating to Prefetching in browser
 void EnableDnsPrefetch(bool enable);
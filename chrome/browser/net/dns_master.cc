@@ -14,15 +14,23 @@
 #include "base/string_util.h"
 #include "base/time.h"
 #include "chrome/browser/chrome_thread.h"
+#include "googleurl/src/gurl.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
 #include "net/base/host_resolver.h"
 #include "net/base/net_errors.h"
+#include "net/proxy/proxy_info.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/client_socket_pool.h"
 
 using base::TimeDelta;
 
 namespace chrome_browser_net {
 
+// A subresource host is preconnected when its prefetches have saved at least
+// this much latency.
+static const int kPreconnectMinimumBenefitMs = 100;
+
 class DnsMaster::LookupRequest {
  public:
   LookupRequest(DnsMaster* master,
@@ -68,6 +76,52 @@ class DnsMaster::LookupRequest {
   DISALLOW_COPY_AND_ASSIGN(LookupRequest);
 };
 
+class DnsMaster::PreconnectRequest {
+ public:
+  PreconnectRequest(DnsMaster* master, net::ProxyService* proxy_service,
+                    const GURL& url)
+      : ALLOW_THIS_IN_INITIALIZER_LIST(
+          net_callback_(this, &PreconnectRequest::OnProxyResolved)),
+        master_(master),
+        proxy_service_(proxy_service),
+        url_(url),
+        pac_request_(NULL) {
+  }
+
+  ~PreconnectRequest() {
+    if (pac_request_)
+      proxy_service_->CancelPacRequest(pac_request_);
+  }
+
+  // Returns the result of the proxy resolution, or net::ERR_IO_PENDING if the
+  // master will be called back with it.
+  int Start() {
+    return proxy_service_->ResolveProxy(url_, &proxy_info_, &net_callback_,
+                                        &pac_request_, NULL);
+  }
+
+  const GURL& url() const { return url_; }
+  const net::ProxyInfo& proxy_info() const { return proxy_info_; }
+
+ private:
+  void OnProxyResolved(int result) {
+    pac_request_ = NULL;
+    master_->OnPreconnectProxyResolved(this, result);
+  }
+
+  // ProxyService will call us using this callback when resolution is complete.
+  net::CompletionCallbackImpl<PreconnectRequest> net_callback_;
+
+  DnsMaster* master_;  // Master which started us.
+  scoped_refptr<net::ProxyService> proxy_service_;
+
+  const GURL url_;  // Origin to connect to.
+  net::ProxyInfo proxy_info_;
+  net::ProxyService::PacRequest* pac_request_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreconnectRequest);
+};
+
 DnsMaster::DnsMaster(net::HostResolver* host_resolver,
                      TimeDelta max_queue_delay,
                      size_t max_concurrent)
@@ -90,6 +144,15 @@ void DnsMaster::Shutdown() {
   std::set<LookupRequest*>::iterator it;
   for (it = pending_lookups_.begin(); it != pending_lookups_.end(); ++it)
     delete *it;
+
+  std::set<PreconnectRequest*>::iterator preconnect;
+  for (preconnect = pending_preconnects_.begin();
+       preconnect != pending_preconnects_.end(); ++preconnect)
+    delete *preconnect;
+  pending_preconnects_.clear();
+
+  preconnect_socket_pool_ = NULL;
+  preconnect_proxy_service_ = NULL;
 }
 
 // Overloaded Resolve() to take a vector of names.
@@ -193,9 +256,76 @@ void DnsMaster::NavigatingTo(const std::string& host_name) {
         DnsHostInfo::LEARNED_REFERAL_MOTIVATED);
     if (queued_info)
       queued_info->SetReferringHostname(host_name);
+    if (future_host->second.latency() >=
+        TimeDelta::FromMilliseconds(kPreconnectMinimumBenefitMs))
+      Preconnect(future_host->first);
   }
 }
 
+void DnsMaster::SetPreconnectSocketPool(net::ClientSocketPool* socket_pool,
+                                        net::ProxyService* proxy_service) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::IO));
+  DCHECK(!socket_pool || proxy_service);
+  preconnect_socket_pool_ = socket_pool;
+  preconnect_proxy_service_ = proxy_service;
+}
+
+void DnsMaster::Preconnect(const std::string& hostname) {
+  if (!preconnect_socket_pool_ || shutdown_)
+    return;
+
+  GURL url("http://" + hostname + "/");
+  if (!url.is_valid())
+    return;
+
+  PreconnectRequest* request =
+      new PreconnectRequest(this, preconnect_proxy_service_, url);
+  int result = request->Start();
+  if (net::ERR_IO_PENDING == result) {
+    pending_preconnects_.insert(request);
+    return;
+  }
+
+  if (net::OK == result)
+    PreconnectWithProxy(request->url(), request->proxy_info());
+  delete request;
+}
+
+void DnsMaster::OnPreconnectProxyResolved(PreconnectRequest* request,
+                                          int result) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::IO));
+  pending_preconnects_.erase(request);
+  if (net::OK == result && preconnect_socket_pool_)
+    PreconnectWithProxy(request->url(), request->proxy_info());
+  delete request;
+}
+
+void DnsMaster::PreconnectWithProxy(const GURL& url,
+                                    const net::ProxyInfo& proxy_info) {
+  // See HttpNetworkTransaction::DoInitConnection.  The url is always http, so
+  // connections through an http proxy are shared by all the origins.
+  std::string connection_group;
+  std::string host;
+  int port;
+  if (proxy_info.is_direct()) {
+    host = url.HostNoBrackets();
+    port = url.EffectiveIntPort();
+  } else {
+    net::ProxyServer proxy_server = proxy_info.proxy_server();
+    connection_group = "proxy/" + proxy_server.ToURI() + "/";
+    host = proxy_server.HostNoBrackets();
+    port = proxy_server.port();
+  }
+
+  if (proxy_info.is_direct() || proxy_info.proxy_server().is_socks())
+    connection_group.append(url.GetOrigin().spec());
+
+  net::HostResolver::RequestInfo resolve_info(host, port);
+  resolve_info.set_is_speculative(true);
+  preconnect_socket_pool_->RequestSockets(connection_group, &resolve_info, 1,
+                                          NULL);
+}
+
 // Provide sort order so all .com's are together, etc.
 struct RightToLeftStringSorter {
   bool operator()(const std::string& left, const std::string& right) const {
@@ -27,8 +27,13 @@
 
 using base::TimeDelta;
 
+class GURL;
+
 namespace net {
+class ClientSocketPool;
 class HostResolver;
+class ProxyInfo;
+class ProxyService;
 }
 
 namespace chrome_browser_net {
@@ -66,9 +71,16 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
                               DnsHostInfo* navigation_info);
 
   // Instigate prefetch of any domains we predict will be needed after this
-  // navigation.
+  // navigation.  The hosts that proved most useful are also preconnected,
+  // when a socket pool was provided with SetPreconnectSocketPool().
   void NavigatingTo(const std::string& host_name);
 
+  // Sets the pool used to open connections ahead of time to the hosts we
+  // predict will be needed, and the |proxy_service| that decides where those
+  // connections go.  A NULL |socket_pool| disables the preconnection.
+  void SetPreconnectSocketPool(net::ClientSocketPool* socket_pool,
+                               net::ProxyService* proxy_service);
+
   // Record details of a navigation so that we can preresolve the host name
   // ahead of time the next time the users navigates to the indicated host.
   // TODO(eroman): can this be a const& instead?
@@ -115,11 +127,13 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   FRIEND_TEST(DnsMasterTest, MassiveConcurrentLookupTest);
   FRIEND_TEST(DnsMasterTest, PriorityQueuePushPopTest);
   FRIEND_TEST(DnsMasterTest, PriorityQueueReorderTest);
+  FRIEND_TEST(DnsMasterTest, PreconnectTest);
   friend class WaitForResolutionHelper;  // For testing.
 
   ~DnsMaster();
 
   class LookupRequest;
+  class PreconnectRequest;
 
   // A simple priority queue for handling host names.
   // Some names that are queued up have |motivation| that requires very rapid
@@ -203,6 +217,20 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   // asynchronously, provided we don't exceed concurrent resolution limit.
   void StartSomeQueuedResolutions();
 
+  // Asks |preconnect_socket_pool_| for an idle connection to |hostname|, once
+  // we know which proxy (if any) is used to reach it.  The referrers only know
+  // about host names, so we assume plain http on the default port; https
+  // origins and other ports are not preconnected.
+  void Preconnect(const std::string& hostname);
+
+  // Access method for use by async preconnect requests to pass the proxy
+  // resolution result.
+  void OnPreconnectProxyResolved(PreconnectRequest* request, int result);
+
+  // Requests one connection to |url| through |proxy_info|, on the same group
+  // that HttpNetworkTransaction uses for it.
+  void PreconnectWithProxy(const GURL& url, const net::ProxyInfo& proxy_info);
+
   // work_queue_ holds a list of names we need to look up.
   HostNameQueue work_queue_;
 
@@ -238,6 +266,15 @@ class DnsMaster : public base::RefCountedThreadSafe<DnsMaster> {
   // The host resovler we warm DNS entries for.
   scoped_refptr<net::HostResolver> host_resolver_;
 
+  // The socket pool we warm connections in, if any.
+  scoped_refptr<net::ClientSocketPool> preconnect_socket_pool_;
+
+  // The proxy service of the context that owns |preconnect_socket_pool_|.
+  scoped_refptr<net::ProxyService> preconnect_proxy_service_;
+
+  // Preconnections waiting for the proxy to use.
+  std::set<PreconnectRequest*> pending_preconnects_;
+
   DISALLOW_COPY_AND_ASSIGN(DnsMaster);
 };
 
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "base/message_loop.h"
 #include "base/scoped_ptr.h"
@@ -18,7 +19,11 @@
 #include "chrome/common/net/dns.h"
 #include "net/base/address_list.h"
 #include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
 #include "net/base/winsock_init.h"
+#include "net/proxy/proxy_config.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/client_socket_pool.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::Time;
@@ -57,6 +62,65 @@ class WaitForResolutionHelper {
   HelperTimer* timer_;
 };
 
+// Records the connections requested by the preconnection code.
+class RecordingSocketPool : public net::ClientSocketPool {
+ public:
+  RecordingSocketPool() {}
+
+  virtual int RequestSocket(const std::string& group_name,
+                            const void* params,
+                            net::RequestPriority priority,
+                            net::ClientSocketHandle* handle,
+                            net::CompletionCallback* callback,
+                            net::LoadLog* load_log) {
+    NOTREACHED();
+    return net::ERR_FAILED;
+  }
+
+  virtual void RequestSockets(const std::string& group_name,
+                              const void* params,
+                              int num_sockets,
+                              net::LoadLog* load_log) {
+    const net::HostResolver::RequestInfo* resolve_info =
+        static_cast<const net::HostResolver::RequestInfo*>(params);
+    requests_.push_back(StringPrintf("%s %s:%d", group_name.c_str(),
+                                     resolve_info->hostname().c_str(),
+                                     resolve_info->port()));
+  }
+
+  virtual void CancelRequest(const std::string& group_name,
+                             const net::ClientSocketHandle* handle) {
+    NOTREACHED();
+  }
+
+  virtual void ReleaseSocket(const std::string& group_name,
+                             net::ClientSocket* socket) {
+    NOTREACHED();
+  }
+
+  virtual void CloseIdleSockets() {}
+  virtual int IdleSocketCount() const { return 0; }
+  virtual int IdleSocketCountInGroup(const std::string& group_name) const {
+    return 0;
+  }
+
+  virtual net::LoadState GetLoadState(
+      const std::string& group_name,
+      const net::ClientSocketHandle* handle) const {
+    return net::LOAD_STATE_IDLE;
+  }
+
+  // The group and the host of each request, as "group host:port".
+  const std::vector<std::string>& requests() const { return requests_; }
+
+ private:
+  virtual ~RecordingSocketPool() {}
+
+  std::vector<std::string> requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingSocketPool);
+};
+
 class DnsMasterTest : public testing::Test {
  public:
   DnsMasterTest()
@@ -550,4 +614,33 @@ TEST_F(DnsMasterTest, PriorityQueueReorderTest) {
   EXPECT_TRUE(queue.IsEmpty());
 }
 
+// Preconnections go to the same group (and host) that a request for the same
+// origin would use, given the proxy settings.
+TEST_F(DnsMasterTest, PreconnectTest) {
+  scoped_refptr<DnsMaster> testing_master = new DnsMaster(host_resolver_,
+      default_max_queueing_delay_, DnsPrefetcherInit::kMaxConcurrentLookups);
+
+  const char* kProxyRules[] = { "", "proxy:8080", "socks=sockshost:1080" };
+  const char* kExpectedRequests[] = {
+    "http://www.google.com/ www.google.com:80",
+    "proxy/proxy:8080/ proxy:8080",
+    "proxy/socks4://sockshost:1080/http://www.google.com/ sockshost:1080",
+  };
+  for (size_t i = 0; i < arraysize(kProxyRules); i++) {
+    net::ProxyConfig config;
+    config.proxy_rules.ParseFromString(kProxyRules[i]);
+    scoped_refptr<RecordingSocketPool> pool = new RecordingSocketPool();
+    testing_master->SetPreconnectSocketPool(
+        pool, net::ProxyService::CreateFixed(config));
+
+    testing_master->Preconnect("www.google.com");
+    MessageLoop::current()->RunAllPending();
+
+    ASSERT_EQ(1U, pool->requests().size());
+    EXPECT_EQ(kExpectedRequests[i], pool->requests()[0]);
+  }
+
+  testing_master->Shutdown();
+}
+
 }  // namespace chrome_browser_net
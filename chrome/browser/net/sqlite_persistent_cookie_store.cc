@@ -5,15 +5,19 @@
 #include "chrome/browser/net/sqlite_persistent_cookie_store.h"
 
 #include <list>
+#include <map>
 
 #include "app/sql/statement.h"
 #include "app/sql/transaction.h"
 #include "base/basictypes.h"
+#include "base/histogram.h"
 #include "base/logging.h"
 #include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
 #include "base/string_util.h"
 #include "base/thread.h"
+#include "base/time.h"
+#include "base/waitable_event.h"
 #include "chrome/browser/chrome_thread.h"
 #include "chrome/browser/diagnostics/sqlite_diagnostics.h"
 
@@ -21,6 +25,11 @@ using base::Time;
 
 // This class is designed to be shared between any calling threads and the
 // database thread.  It batches operations and commits them on a timer.
+//
+// It also loads the cookies on the database thread, one domain (see
+// CookieMonster::DomainForKey()) at a time.  The cookies of a domain that the
+// CookieMonster needs before they are read are loaded ahead of the others,
+// while the calling thread waits.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
@@ -28,15 +37,31 @@ class SQLitePersistentCookieStore::Backend
   // take ownership.
   explicit Backend(sql::Connection* db)
       : db_(db),
-        num_pending_(0) {
+        num_pending_(0),
+        keys_loaded_(false) {
     DCHECK(db_) << "Database must exist.";
   }
 
+  // Starts loading the cookies on the database thread.
+  void StartLoading();
+
+  // Returns the cookies of |domain| that were not returned yet, waiting for
+  // the database thread to read them if necessary.
+  void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
+
+  // Returns all the cookies that were not returned yet, waiting for the
+  // database thread to read them.
+  void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
+
   // Batch a cookie addition.
   void AddCookie(const std::string& key,
                  const net::CookieMonster::CanonicalCookie& cc);
 
-  // Batch a cookie access time update.
+  // Batch a cookie access time update.  Updates of the same cookie are
+  // coalesced until the next commit.
   void UpdateCookieAccessTime(const net::CookieMonster::CanonicalCookie& cc);
 
   // Batch a cookie deletion.
@@ -49,17 +74,27 @@ class SQLitePersistentCookieStore::Backend
  private:
   friend class base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend>;
 
+  typedef std::vector<net::CookieMonster::KeyedCanonicalCookie> CookieVector;
+
   // You should call Close() before destructing this object.
   ~Backend() {
     DCHECK(!db_) << "Close should have already been called.";
-    DCHECK(num_pending_ == 0 && pending_.empty());
+    DCHECK(num_pending_ == 0 && pending_.empty() &&
+           pending_access_times_.empty());
+
+    // Free the cookies that were read but never used.
+    for (DomainCookiesMap::iterator it = loaded_cookies_.begin();
+         it != loaded_cookies_.end(); ++it) {
+      for (CookieVector::iterator cookie = it->second.begin();
+           cookie != it->second.end(); ++cookie)
+        delete cookie->second;
+    }
   }
 
   class PendingOperation {
    public:
     typedef enum {
       COOKIE_ADD,
-      COOKIE_UPDATEACCESS,
       COOKIE_DELETE,
     } OperationType;
 
@@ -83,21 +118,251 @@ class SQLitePersistentCookieStore::Backend
   void BatchOperation(PendingOperation::OperationType op,
                       const std::string& key,
                       const net::CookieMonster::CanonicalCookie& cc);
+  // Counts a new pending operation, and schedules a commit if needed.  Must be
+  // called with |pending_lock_| held.
+  void OnOperationPending();
   // Commit our pending operations to the database.
   void Commit();
   // Close() executed on the background thread.
   void InternalBackgroundClose();
 
+  // Runs |task| on the database thread and waits for it to signal |event|.
+  void RunOnDatabaseThreadAndWait(Task* task, base::WaitableEvent* event);
+  // Moves the cookies of |domain| out of |loaded_cookies_|.
+  void TakeLoadedCookies(const std::string& domain, CookieVector* cookies);
+
+  // Database thread: reads the keys of all the cookies, then reads the
+  // cookies one domain at a time.
+  void LoadKeys();
+  void LoadNextDomain();
+  // Database thread: reads the cookies of |domain| (or of all the domains not
+  // read yet) right away, then signals |event|.
+  void LoadDomainNow(const std::string& domain, base::WaitableEvent* event);
+  void LoadAllNow(base::WaitableEvent* event);
+  // Database thread: reads the cookies of |domain|, which must be in
+  // |domains_to_load_|, into |loaded_cookies_|.
+  void LoadDomain(const std::string& domain);
+
   sql::Connection* db_;
 
   typedef std::list<PendingOperation*> PendingOperationsList;
   PendingOperationsList pending_;
+  // The last access time of the cookies to update, by creation time.
+  typedef std::map<int64, int64> AccessTimeMap;
+  AccessTimeMap pending_access_times_;
   PendingOperationsList::size_type num_pending_;
-  Lock pending_lock_;  // Guard pending_ and num_pending_
+  // Guard pending_, pending_access_times_ and num_pending_
+  Lock pending_lock_;
+
+  // The keys of the cookies not read yet, by domain.
+  typedef std::map<std::string, std::vector<std::string> > DomainKeysMap;
+  DomainKeysMap domains_to_load_;
+  // The cookies read but not returned yet, by domain.
+  typedef std::map<std::string, CookieVector> DomainCookiesMap;
+  DomainCookiesMap loaded_cookies_;
+  // Whether |domains_to_load_| was filled.
+  bool keys_loaded_;
+  // Guard domains_to_load_, loaded_cookies_ and keys_loaded_.  Only the
+  // database thread modifies domains_to_load_ and keys_loaded_.
+  Lock load_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(Backend);
 };
 
+void SQLitePersistentCookieStore::Backend::StartLoading() {
+  ChromeThread::PostTask(
+      ChromeThread::DB, FROM_HERE, NewRunnableMethod(this, &Backend::LoadKeys));
+}
+
+void SQLitePersistentCookieStore::Backend::LoadCookiesForDomain(
+    const std::string& domain,
+    CookieVector* cookies) {
+  DCHECK(!ChromeThread::CurrentlyOn(ChromeThread::DB));
+  bool pending;
+  {
+    AutoLock locked(load_lock_);
+    pending = !keys_loaded_ ||
+              domains_to_load_.find(domain) != domains_to_load_.end();
+  }
+
+  if (pending) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    base::WaitableEvent event(false, false);
+    RunOnDatabaseThreadAndWait(
+        NewRunnableMethod(this, &Backend::LoadDomainNow, domain, &event),
+        &event);
+    UMA_HISTOGRAM_TIMES("Cookie.LoadDomainBlockingTime",
+                        base::TimeTicks::Now() - start);
+  }
+  TakeLoadedCookies(domain, cookies);
+}
+
+void SQLitePersistentCookieStore::Backend::LoadRemainingCookies(
+    CookieVector* cookies) {
+  DCHECK(!ChromeThread::CurrentlyOn(ChromeThread::DB));
+  base::WaitableEvent event(false, false);
+  RunOnDatabaseThreadAndWait(
+      NewRunnableMethod(this, &Backend::LoadAllNow, &event), &event);
+
+  AutoLock locked(load_lock_);
+  for (DomainCookiesMap::iterator it = loaded_cookies_.begin();
+       it != loaded_cookies_.end(); ++it)
+    cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+  loaded_cookies_.clear();
+}
+
+void SQLitePersistentCookieStore::Backend::RunOnDatabaseThreadAndWait(
+    Task* task,
+    base::WaitableEvent* event) {
+  // If the database thread is gone, the cookies are not loaded.
+  if (ChromeThread::PostTask(ChromeThread::DB, FROM_HERE, task))
+    event->Wait();
+}
+
+void SQLitePersistentCookieStore::Backend::TakeLoadedCookies(
+    const std::string& domain,
+    CookieVector* cookies) {
+  AutoLock locked(load_lock_);
+  DomainCookiesMap::iterator it = loaded_cookies_.find(domain);
+  if (it == loaded_cookies_.end())
+    return;
+  cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+  loaded_cookies_.erase(it);
+}
+
+namespace {
+
+// Reads the current row of a SELECT on the cookies table into a new cookie.
+net::CookieMonster::KeyedCanonicalCookie ReadCookie(sql::Statement* smt) {
+  net::CookieMonster::CanonicalCookie* cc =
+      new net::CookieMonster::CanonicalCookie(
+          smt->ColumnString(2),                            // name
+          smt->ColumnString(3),                            // value
+          smt->ColumnString(4),                            // path
+          smt->ColumnInt(6) != 0,                          // secure
+          smt->ColumnInt(7) != 0,                          // httponly
+          Time::FromInternalValue(smt->ColumnInt64(0)),    // creation_utc
+          Time::FromInternalValue(smt->ColumnInt64(8)),    // last_access_utc
+          true,                                            // has_expires
+          Time::FromInternalValue(smt->ColumnInt64(5)));   // expires_utc
+  DLOG_IF(WARNING,
+          cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
+  return net::CookieMonster::KeyedCanonicalCookie(smt->ColumnString(1), cc);
+}
+
+}  // namespace
+
+void SQLitePersistentCookieStore::Backend::LoadKeys() {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
+  DomainKeysMap domains;
+  if (db_) {
+    db_->Preload();
+
+    sql::Statement smt(db_->GetUniqueStatement(
+        "SELECT DISTINCT host_key FROM cookies"));
+    if (!smt) {
+      NOTREACHED() << "select statement prep failed";
+    } else {
+      while (smt.Step()) {
+        std::string key = smt.ColumnString(0);
+        domains[net::CookieMonster::DomainForKey(key)].push_back(key);
+      }
+    }
+  }
+
+  {
+    AutoLock locked(load_lock_);
+    domains_to_load_.swap(domains);
+    keys_loaded_ = true;
+  }
+  LoadNextDomain();
+}
+
+void SQLitePersistentCookieStore::Backend::LoadNextDomain() {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
+  std::string domain;
+  {
+    AutoLock locked(load_lock_);
+    if (domains_to_load_.empty())
+      return;
+    domain = domains_to_load_.begin()->first;
+  }
+  LoadDomain(domain);
+
+  // Read one domain per task, so that the domains requested by
+  // LoadDomainNow() don't wait for the whole database to be read.
+  ChromeThread::PostTask(
+      ChromeThread::DB, FROM_HERE,
+      NewRunnableMethod(this, &Backend::LoadNextDomain));
+}
+
+void SQLitePersistentCookieStore::Backend::LoadDomainNow(
+    const std::string& domain,
+    base::WaitableEvent* event) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
+  bool pending;
+  {
+    AutoLock locked(load_lock_);
+    pending = domains_to_load_.find(domain) != domains_to_load_.end();
+  }
+  if (pending)
+    LoadDomain(domain);
+  event->Signal();
+}
+
+void SQLitePersistentCookieStore::Backend::LoadAllNow(
+    base::WaitableEvent* event) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
+  for (;;) {
+    std::string domain;
+    {
+      AutoLock locked(load_lock_);
+      if (domains_to_load_.empty())
+        break;
+      domain = domains_to_load_.begin()->first;
+    }
+    LoadDomain(domain);
+  }
+  event->Signal();
+}
+
+void SQLitePersistentCookieStore::Backend::LoadDomain(
+    const std::string& domain) {
+  DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
+  std::vector<std::string> keys;
+  {
+    AutoLock locked(load_lock_);
+    DomainKeysMap::iterator it = domains_to_load_.find(domain);
+    DCHECK(it != domains_to_load_.end());
+    keys.swap(it->second);
+  }
+
+  CookieVector cookies;
+  if (db_) {
+    sql::Statement smt(db_->GetCachedStatement(SQL_FROM_HERE,
+        "SELECT creation_utc, host_key, name, value, path, expires_utc, "
+        "secure, httponly, last_access_utc FROM cookies WHERE host_key = ?"));
+    if (!smt) {
+      NOTREACHED() << "select statement prep failed";
+    } else {
+      for (std::vector<std::string>::const_iterator key = keys.begin();
+           key != keys.end(); ++key) {
+        smt.Reset();
+        smt.BindString(0, *key);
+        while (smt.Step())
+          cookies.push_back(ReadCookie(&smt));
+      }
+    }
+  }
+
+  // The domain leaves |domains_to_load_| when its cookies are available, so
+  // that LoadCookiesForDomain() always finds them in one of the two maps.
+  AutoLock locked(load_lock_);
+  CookieVector& loaded = loaded_cookies_[domain];
+  loaded.insert(loaded.end(), cookies.begin(), cookies.end());
+  domains_to_load_.erase(domain);
+}
+
 void SQLitePersistentCookieStore::Backend::AddCookie(
     const std::string& key,
     const net::CookieMonster::CanonicalCookie& cc) {
@@ -106,7 +371,18 @@ void SQLitePersistentCookieStore::Backend::AddCookie(
 
 void SQLitePersistentCookieStore::Backend::UpdateCookieAccessTime(
     const net::CookieMonster::CanonicalCookie& cc) {
-  BatchOperation(PendingOperation::COOKIE_UPDATEACCESS, std::string(), cc);
+  DCHECK(!ChromeThread::CurrentlyOn(ChromeThread::DB));
+  AutoLock locked(pending_lock_);
+  std::pair<AccessTimeMap::iterator, bool> result =
+      pending_access_times_.insert(std::make_pair(
+          cc.CreationDate().ToInternalValue(),
+          cc.LastAccessDate().ToInternalValue()));
+  if (!result.second) {
+    // Only the last update of a cookie needs to be written.
+    result.first->second = cc.LastAccessDate().ToInternalValue();
+    return;
+  }
+  OnOperationPending();
 }
 
 void SQLitePersistentCookieStore::Backend::DeleteCookie(
@@ -118,23 +394,26 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
     PendingOperation::OperationType op,
     const std::string& key,
     const net::CookieMonster::CanonicalCookie& cc) {
-  // Commit every 30 seconds.
-  static const int kCommitIntervalMs = 30 * 1000;
-  // Commit right away if we have more than 512 outstanding operations.
-  static const size_t kCommitAfterBatchSize = 512;
   DCHECK(!ChromeThread::CurrentlyOn(ChromeThread::DB));
 
   // We do a full copy of the cookie here, and hopefully just here.
   scoped_ptr<PendingOperation> po(new PendingOperation(op, key, cc));
   CHECK(po.get());
 
-  PendingOperationsList::size_type num_pending;
-  {
-    AutoLock locked(pending_lock_);
-    pending_.push_back(po.release());
-    num_pending = ++num_pending_;
-  }
+  AutoLock locked(pending_lock_);
+  if (op == PendingOperation::COOKIE_DELETE)
+    pending_access_times_.erase(cc.CreationDate().ToInternalValue());
+  pending_.push_back(po.release());
+  OnOperationPending();
+}
 
+void SQLitePersistentCookieStore::Backend::OnOperationPending() {
+  // Commit every 30 seconds.
+  static const int kCommitIntervalMs = 30 * 1000;
+  // Commit right away if we have more than 512 outstanding operations.
+  static const size_t kCommitAfterBatchSize = 512;
+
+  PendingOperationsList::size_type num_pending = ++num_pending_;
   if (num_pending == 1) {
     // We've gotten our first entry for this batch, fire off the timer.
     ChromeThread::PostDelayedTask(
@@ -150,14 +429,16 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
 void SQLitePersistentCookieStore::Backend::Commit() {
   DCHECK(ChromeThread::CurrentlyOn(ChromeThread::DB));
   PendingOperationsList ops;
+  AccessTimeMap access_times;
   {
     AutoLock locked(pending_lock_);
     pending_.swap(ops);
+    pending_access_times_.swap(access_times);
     num_pending_ = 0;
   }
 
   // Maybe an old timer fired or we are already Close()'ed.
-  if (!db_ || ops.empty())
+  if (!db_ || (ops.empty() && access_times.empty()))
     return;
 
   sql::Statement add_smt(db_->GetCachedStatement(SQL_FROM_HERE,
@@ -208,16 +489,6 @@ void SQLitePersistentCookieStore::Backend::Commit() {
           NOTREACHED() << "Could not add a cookie to the DB.";
         break;
 
-      case PendingOperation::COOKIE_UPDATEACCESS:
-        update_access_smt.Reset();
-        update_access_smt.BindInt64(0,
-            po->cc().LastAccessDate().ToInternalValue());
-        update_access_smt.BindInt64(1,
-            po->cc().CreationDate().ToInternalValue());
-        if (!update_access_smt.Run())
-          NOTREACHED() << "Could not update cookie last access time in the DB.";
-        break;
-
       case PendingOperation::COOKIE_DELETE:
         del_smt.Reset();
         del_smt.BindInt64(0, po->cc().CreationDate().ToInternalValue());
@@ -230,6 +501,17 @@ void SQLitePersistentCookieStore::Backend::Commit() {
         break;
     }
   }
+
+  // The access time updates go last: the cookies they refer to may have been
+  // added in this batch, and the ones that were deleted are not in the map.
+  for (AccessTimeMap::const_iterator it = access_times.begin();
+       it != access_times.end(); ++it) {
+    update_access_smt.Reset();
+    update_access_smt.BindInt64(0, it->second);
+    update_access_smt.BindInt64(1, it->first);
+    if (!update_access_smt.Run())
+      NOTREACHED() << "Could not update cookie last access time in the DB.";
+  }
   transaction.Commit();
 }
 
@@ -296,9 +578,11 @@ bool InitTable(sql::Connection* db) {
       return false;
   }
 
-  // Try to create the index every time. Older versions did not have this index,
-  // so we want those people to get it. Ignore errors, since it may exist.
+  // Try to create the indexes every time. Older versions did not have them,
+  // so we want those people to get them. Ignore errors, since they may exist.
   db->Execute("CREATE INDEX cookie_times ON cookies (creation_utc)");
+  // Used to load the cookies of a domain (see Backend::LoadDomain()).
+  db->Execute("CREATE INDEX cookie_host_keys ON cookies (host_key)");
   return true;
 }
 
@@ -319,39 +603,30 @@ bool SQLitePersistentCookieStore::Load(
     return false;
   }
 
-  db->Preload();
+  // Create the backend, this will take ownership of the db pointer.  The
+  // cookies are read on the database thread: the CookieMonster requests the
+  // cookies of each domain as it needs them (see LoadsOnDemand()), so the
+  // first requests don't wait for the whole database to be read.
+  backend_ = new Backend(db.release());
+  backend_->StartLoading();
+  return true;
+}
 
-  // Slurp all the cookies into the out-vector.
-  sql::Statement smt(db->GetUniqueStatement(
-      "SELECT creation_utc, host_key, name, value, path, expires_utc, secure, "
-      "httponly, last_access_utc FROM cookies"));
-  if (!smt) {
-    NOTREACHED() << "select statement prep failed";
-    return false;
-  }
+bool SQLitePersistentCookieStore::LoadsOnDemand() {
+  return true;
+}
 
-  while (smt.Step()) {
-    scoped_ptr<net::CookieMonster::CanonicalCookie> cc(
-        new net::CookieMonster::CanonicalCookie(
-            smt.ColumnString(2),                            // name
-            smt.ColumnString(3),                            // value
-            smt.ColumnString(4),                            // path
-            smt.ColumnInt(6) != 0,                          // secure
-            smt.ColumnInt(7) != 0,                          // httponly
-            Time::FromInternalValue(smt.ColumnInt64(0)),    // creation_utc
-            Time::FromInternalValue(smt.ColumnInt64(8)),    // last_access_utc
-            true,                                           // has_expires
-            Time::FromInternalValue(smt.ColumnInt64(5))));  // expires_utc
-    DLOG_IF(WARNING,
-            cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
-    cookies->push_back(
-        net::CookieMonster::KeyedCanonicalCookie(smt.ColumnString(1),
-                                                 cc.release()));
-  }
+void SQLitePersistentCookieStore::LoadCookiesForDomain(
+    const std::string& domain,
+    std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+  if (backend_.get())
+    backend_->LoadCookiesForDomain(domain, cookies);
+}
 
-  // Create the backend, this will take ownership of the db pointer.
-  backend_ = new Backend(db.release());
-  return true;
+void SQLitePersistentCookieStore::LoadRemainingCookies(
+    std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+  if (backend_.get())
+    backend_->LoadRemainingCookies(cookies);
 }
 
 bool SQLitePersistentCookieStore::EnsureDatabaseVersion(sql::Connection* db) {
@@ -25,6 +25,12 @@ class SQLitePersistentCookieStore
   ~SQLitePersistentCookieStore();
 
   virtual bool Load(std::vector<net::CookieMonster::KeyedCanonicalCookie>*);
+  virtual bool LoadsOnDemand();
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies);
 
   virtual void AddCookie(const std::string&,
                          const net::CookieMonster::CanonicalCookie&);
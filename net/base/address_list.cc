@@ -146,6 +146,47 @@ AddressList AddressList::CreateIPv6Address(unsigned char data[16]) {
   return AddressList(new Data(ai, false /*is_system_created*/));
 }
 
+// static
+AddressList AddressList::CreateFromIPAddresses(
+    const std::vector<std::string>& packed_addresses, int port) {
+  DCHECK(!packed_addresses.empty());
+  struct addrinfo* head = NULL;
+  struct addrinfo** next = &head;
+  for (size_t i = 0; i < packed_addresses.size(); ++i) {
+    const std::string& packed = packed_addresses[i];
+    struct addrinfo* ai = new struct addrinfo;
+    memset(ai, 0, sizeof(struct addrinfo));
+    ai->ai_socktype = SOCK_STREAM;
+
+    if (packed.size() == 4) {
+      ai->ai_family = AF_INET;
+      ai->ai_addrlen = sizeof(struct sockaddr_in);
+      struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(
+          new char[ai->ai_addrlen]);
+      memset(addr, 0, sizeof(struct sockaddr_in));
+      addr->sin_family = AF_INET;
+      addr->sin_port = htons(port);
+      memcpy(&addr->sin_addr, packed.data(), 4);
+      ai->ai_addr = reinterpret_cast<struct sockaddr*>(addr);
+    } else {
+      DCHECK_EQ(16u, packed.size());
+      ai->ai_family = AF_INET6;
+      ai->ai_addrlen = sizeof(struct sockaddr_in6);
+      struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(
+          new char[ai->ai_addrlen]);
+      memset(addr6, 0, sizeof(struct sockaddr_in6));
+      addr6->sin6_family = AF_INET6;
+      addr6->sin6_port = htons(port);
+      memcpy(&addr6->sin6_addr, packed.data(), 16);
+      ai->ai_addr = reinterpret_cast<struct sockaddr*>(addr6);
+    }
+
+    *next = ai;
+    next = &ai->ai_next;
+  }
+  return AddressList(new Data(head, false /*is_system_created*/));
+}
+
 AddressList::Data::~Data() {
   // Call either freeaddrinfo(head), or FreeMyAddrinfo(head), depending who
   // created the data.
@@ -5,6 +5,9 @@
 #ifndef NET_BASE_ADDRESS_LIST_H_
 #define NET_BASE_ADDRESS_LIST_H_
 
+#include <string>
+#include <vector>
+
 #include "base/ref_counted.h"
 
 struct addrinfo;
@@ -47,6 +50,12 @@ class AddressList {
   // Used by unit-tests to manually set the TCP socket address.
   static AddressList CreateIPv6Address(unsigned char data[16]);
 
+  // Creates a list of the addresses of |packed_addresses|, in network order
+  // (4 bytes for IPv4 addresses and 16 bytes for IPv6 addresses), with port
+  // |port|. |packed_addresses| must not be empty.
+  static AddressList CreateFromIPAddresses(
+      const std::vector<std::string>& packed_addresses, int port);
+
   // Get access to the head of the addrinfo list.
   const struct addrinfo* head() const { return data_->head; }
 
@@ -91,7 +91,10 @@ void CookieMonster::EnableFileScheme() {
 }
 
 CookieMonster::CookieMonster()
-    : initialized_(false),
+    : initialized_(0),
+      load_on_demand_(false),
+      all_loaded_(0),
+      num_cookies_(0),
       store_(NULL),
       last_access_threshold_(
           TimeDelta::FromSeconds(kDefaultAccessUpdateThresholdSeconds)) {
@@ -99,7 +102,10 @@ CookieMonster::CookieMonster()
 }
 
 CookieMonster::CookieMonster(PersistentCookieStore* store)
-    : initialized_(false),
+    : initialized_(0),
+      load_on_demand_(false),
+      all_loaded_(0),
+      num_cookies_(0),
       store_(store),
       last_access_threshold_(
           TimeDelta::FromSeconds(kDefaultAccessUpdateThresholdSeconds)) {
@@ -110,6 +116,16 @@ CookieMonster::~CookieMonster() {
   DeleteAll(false);
 }
 
+void CookieMonster::InitOnce() {
+  AutoLock autolock(init_lock_);
+  if (initialized_)
+    return;
+
+  if (store_)
+    InitStore();
+  base::subtle::Release_Store(&initialized_, 1);
+}
+
 void CookieMonster::InitStore() {
   DCHECK(store_) << "Store must exist to initialize";
 
@@ -123,8 +139,11 @@ void CookieMonster::InitStore() {
   store_->Load(&cookies);
   for (std::vector<KeyedCanonicalCookie>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it) {
-    InternalInsertCookie(it->first, it->second, false);
+    Shard* shard = ShardForKey(it->first);
+    AutoLock autolock(shard->lock);
+    InternalInsertCookie(shard, it->first, it->second, false);
   }
+  load_on_demand_ = store_->LoadsOnDemand();
 }
 
 void CookieMonster::SetDefaultCookieableSchemes() {
@@ -134,6 +153,76 @@ void CookieMonster::SetDefaultCookieableSchemes() {
   SetCookieableSchemes(kDefaultCookieableSchemes, num_schemes);
 }
 
+CookieMonster::Shard* CookieMonster::ShardForDomain(const std::string& domain) {
+  // Any string hash will do, as long as it is stable.
+  uint32 hash = 0;
+  for (size_t i = 0; i < domain.length(); ++i)
+    hash = hash * 31 + static_cast<unsigned char>(domain[i]);
+  return &shards_[hash % kNumShards];
+}
+
+// static
+std::string CookieMonster::DomainForKey(const std::string& key) {
+  // A domain key, like ".www.google.com", has the same domain and registry as
+  // the hosts that can read it (see GetCookieDomainKey()).
+  const std::string domain(
+      RegistryControlledDomainService::GetDomainAndRegistry(key));
+  return domain.empty() ? key : domain;
+}
+
+CookieMonster::Shard* CookieMonster::ShardForKey(const std::string& key) {
+  return ShardForDomain(DomainForKey(key));
+}
+
+void CookieMonster::LoadDomainIfNecessary(Shard* shard,
+                                          const std::string& domain) {
+  if (!load_on_demand_ || base::subtle::Acquire_Load(&all_loaded_))
+    return;
+  if (!shard->loaded_domains.insert(domain).second)
+    return;
+
+  // This blocks the other domains of |shard| while the store reads the
+  // cookies, but it only happens once per domain.
+  std::vector<KeyedCanonicalCookie> cookies;
+  store_->LoadCookiesForDomain(domain, &cookies);
+  for (std::vector<KeyedCanonicalCookie>::const_iterator it = cookies.begin();
+       it != cookies.end(); ++it) {
+    DCHECK(ShardForKey(it->first) == shard);
+    InternalInsertCookie(shard, it->first, it->second, false);
+  }
+}
+
+void CookieMonster::LoadAllIfNecessary() {
+  if (!load_on_demand_ || base::subtle::Acquire_Load(&all_loaded_))
+    return;
+
+  // Once the store handed out the cookies of a domain, a concurrent
+  // LoadDomainIfNecessary() would find none of them, so they must be on their
+  // shards before any shard is unlocked.
+  LockAllShards();
+  if (!base::subtle::NoBarrier_Load(&all_loaded_)) {
+    std::vector<KeyedCanonicalCookie> cookies;
+    store_->LoadRemainingCookies(&cookies);
+    for (std::vector<KeyedCanonicalCookie>::const_iterator it = cookies.begin();
+         it != cookies.end(); ++it) {
+      InternalInsertCookie(ShardForKey(it->first), it->first, it->second,
+                           false);
+    }
+    base::subtle::Release_Store(&all_loaded_, 1);
+  }
+  UnlockAllShards();
+}
+
+void CookieMonster::LockAllShards() {
+  for (int i = 0; i < kNumShards; ++i)
+    shards_[i].lock.Acquire();
+}
+
+void CookieMonster::UnlockAllShards() {
+  for (int i = kNumShards - 1; i >= 0; --i)
+    shards_[i].lock.Release();
+}
+
 // The system resolution is not high enough, so we can have multiple
 // set cookies that result in the same system time.  When this happens, we
 // increment by one Time unit.  Let's hope computers don't get too fast.
@@ -402,7 +491,7 @@ bool CookieMonster::SetCookieWithOptions(const GURL& url,
                                          const CookieOptions& options) {
   Time creation_date;
   {
-    AutoLock autolock(lock_);
+    AutoLock autolock(time_lock_);
     creation_date = CurrentTime();
     last_time_seen_ = creation_date;
   }
@@ -433,7 +522,6 @@ bool CookieMonster::SetCookieWithCreationTimeWithOptions(
     return false;
   }
 
-  AutoLock autolock(lock_);
   InitIfNecessary();
 
   COOKIE_DLOG(INFO) << "SetCookie() line: " << cookie_line;
@@ -471,26 +559,38 @@ bool CookieMonster::SetCookieWithCreationTimeWithOptions(
     return false;
   }
 
-  if (DeleteAnyEquivalentCookie(cookie_domain,
-                                *cc,
-                                options.exclude_httponly())) {
-    COOKIE_DLOG(INFO) << "SetCookie() not clobbering httponly cookie";
-    return false;
-  }
+  {
+    const std::string domain(DomainForKey(cookie_domain));
+    Shard* shard = ShardForDomain(domain);
+    AutoLock autolock(shard->lock);
+    LoadDomainIfNecessary(shard, domain);
+
+    if (DeleteAnyEquivalentCookie(shard,
+                                  cookie_domain,
+                                  *cc,
+                                  options.exclude_httponly())) {
+      COOKIE_DLOG(INFO) << "SetCookie() not clobbering httponly cookie";
+      return false;
+    }
+
+    COOKIE_DLOG(INFO) << "SetCookie() cc: " << cc->DebugString();
 
-  COOKIE_DLOG(INFO) << "SetCookie() cc: " << cc->DebugString();
+    // Realize that we might be setting an expired cookie, and the only point
+    // was to delete the cookie which we've already done.
+    if (!cc->IsExpired(creation_time))
+      InternalInsertCookie(shard, cookie_domain, cc.release(), true);
 
-  // Realize that we might be setting an expired cookie, and the only point
-  // was to delete the cookie which we've already done.
-  if (!cc->IsExpired(creation_time))
-    InternalInsertCookie(cookie_domain, cc.release(), true);
+    // We assume that hopefully setting a cookie will be less common than
+    // querying a cookie.  Since setting a cookie can put us over our limits,
+    // make sure that we garbage collect...  We can also make the assumption
+    // that if a cookie was set, in the common case it will be used soon after,
+    // and we will purge the expired cookies in GetCookies().
+    GarbageCollect(shard, creation_time, cookie_domain);
+  }
 
-  // We assume that hopefully setting a cookie will be less common than
-  // querying a cookie.  Since setting a cookie can put us over our limits,
-  // make sure that we garbage collect...  We can also make the assumption that
-  // if a cookie was set, in the common case it will be used soon after,
-  // and we will purge the expired cookies in GetCookies().
-  GarbageCollect(creation_time, cookie_domain);
+  // The global limit needs all the shards, so it is checked once the lock of
+  // this one has been released.
+  GarbageCollectAll(creation_time);
 
   return true;
 }
@@ -510,12 +610,14 @@ void CookieMonster::SetCookiesWithOptions(
     SetCookieWithOptions(url, *iter, options);
 }
 
-void CookieMonster::InternalInsertCookie(const std::string& key,
+void CookieMonster::InternalInsertCookie(Shard* shard,
+                                         const std::string& key,
                                          CanonicalCookie* cc,
                                          bool sync_to_store) {
   if (cc->IsPersistent() && store_ && sync_to_store)
     store_->AddCookie(key, *cc);
-  cookies_.insert(CookieMap::value_type(key, cc));
+  shard->cookies.insert(CookieMap::value_type(key, cc));
+  base::subtle::NoBarrier_AtomicIncrement(&num_cookies_, 1);
 }
 
 void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc) {
@@ -532,22 +634,25 @@ void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc) {
     store_->UpdateCookieAccessTime(*cc);
 }
 
-void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
+void CookieMonster::InternalDeleteCookie(Shard* shard,
+                                         CookieMap::iterator it,
                                          bool sync_to_store) {
   CanonicalCookie* cc = it->second;
   COOKIE_DLOG(INFO) << "InternalDeleteCookie() cc: " << cc->DebugString();
   if (cc->IsPersistent() && store_ && sync_to_store)
     store_->DeleteCookie(*cc);
-  cookies_.erase(it);
+  shard->cookies.erase(it);
+  base::subtle::NoBarrier_AtomicIncrement(&num_cookies_, -1);
   delete cc;
 }
 
-bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
+bool CookieMonster::DeleteAnyEquivalentCookie(Shard* shard,
+                                              const std::string& key,
                                               const CanonicalCookie& ecc,
                                               bool skip_httponly) {
   bool found_equivalent_cookie = false;
   bool skipped_httponly = false;
-  for (CookieMapItPair its = cookies_.equal_range(key);
+  for (CookieMapItPair its = shard->cookies.equal_range(key);
        its.first != its.second; ) {
     CookieMap::iterator curit = its.first;
     CanonicalCookie* cc = curit->second;
@@ -561,7 +666,7 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
       if (skip_httponly && cc->IsHttpOnly()) {
         skipped_httponly = true;
       } else {
-        InternalDeleteCookie(curit, true);
+        InternalDeleteCookie(shard, curit, true);
       }
       found_equivalent_cookie = true;
 #ifdef NDEBUG
@@ -574,80 +679,118 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
   return skipped_httponly;
 }
 
-int CookieMonster::GarbageCollect(const Time& current,
+int CookieMonster::GarbageCollect(Shard* shard,
+                                  const Time& current,
                                   const std::string& key) {
   int num_deleted = 0;
 
   // Collect garbage for this key.
-  if (cookies_.count(key) > kNumCookiesPerHost) {
+  if (shard->cookies.count(key) > kNumCookiesPerHost) {
     COOKIE_DLOG(INFO) << "GarbageCollect() key: " << key;
-    num_deleted += GarbageCollectRange(current, cookies_.equal_range(key),
-        kNumCookiesPerHost, kNumCookiesPerHostPurge);
+    num_deleted += GarbageCollectRange(shard, current,
+        shard->cookies.equal_range(key), kNumCookiesPerHost,
+        kNumCookiesPerHostPurge);
   }
 
-  // Collect garbage for everything.
-  if (cookies_.size() > kNumCookiesTotal) {
+  return num_deleted;
+}
+
+int CookieMonster::GarbageCollectAll(const Time& current) {
+  if (static_cast<size_t>(base::subtle::NoBarrier_Load(&num_cookies_)) <=
+      kNumCookiesTotal)
+    return 0;
+
+  LockAllShards();
+
+  // Another thread may have collected the garbage while we were waiting.
+  int num_deleted = 0;
+  if (static_cast<size_t>(base::subtle::NoBarrier_Load(&num_cookies_)) >
+      kNumCookiesTotal) {
     COOKIE_DLOG(INFO) << "GarbageCollect() everything";
-    num_deleted += GarbageCollectRange(current,
-        CookieMapItPair(cookies_.begin(), cookies_.end()), kNumCookiesTotal,
-        kNumCookiesTotalPurge);
+    std::vector<ShardedCookie> cookie_its;
+    for (int i = 0; i < kNumShards; ++i) {
+      Shard* shard = &shards_[i];
+      num_deleted += GarbageCollectExpired(
+          shard, current,
+          CookieMapItPair(shard->cookies.begin(), shard->cookies.end()),
+          &cookie_its);
+    }
+    num_deleted += PurgeLeastRecentlyAccessed(&cookie_its, kNumCookiesTotal,
+                                              kNumCookiesTotalPurge);
   }
 
+  UnlockAllShards();
   return num_deleted;
 }
 
-static bool LRUCookieSorter(const CookieMonster::CookieMap::iterator& it1,
-                            const CookieMonster::CookieMap::iterator& it2) {
+static bool LRUCookieSorter(const CookieMonster::CanonicalCookie* cc1,
+                            const CookieMonster::CanonicalCookie* cc2) {
   // Cookies accessed less recently should be deleted first.
-  if (it1->second->LastAccessDate() != it2->second->LastAccessDate())
-    return it1->second->LastAccessDate() < it2->second->LastAccessDate();
+  if (cc1->LastAccessDate() != cc2->LastAccessDate())
+    return cc1->LastAccessDate() < cc2->LastAccessDate();
 
   // In rare cases we might have two cookies with identical last access times.
   // To preserve the stability of the sort, in these cases prefer to delete
   // older cookies over newer ones.  CreationDate() is guaranteed to be unique.
-  return it1->second->CreationDate() < it2->second->CreationDate();
+  return cc1->CreationDate() < cc2->CreationDate();
+}
+
+// Same as LRUCookieSorter(), for CookieMonster::ShardedCookie.
+template <typename T>
+static bool LRUShardedCookieSorter(const T& c1, const T& c2) {
+  return LRUCookieSorter(c1.it->second, c2.it->second);
 }
 
-int CookieMonster::GarbageCollectRange(const Time& current,
+int CookieMonster::GarbageCollectRange(Shard* shard,
+                                       const Time& current,
                                        const CookieMapItPair& itpair,
                                        size_t num_max,
                                        size_t num_purge) {
   // First, delete anything that's expired.
-  std::vector<CookieMap::iterator> cookie_its;
-  int num_deleted = GarbageCollectExpired(current, itpair, &cookie_its);
+  std::vector<ShardedCookie> cookie_its;
+  int num_deleted = GarbageCollectExpired(shard, current, itpair, &cookie_its);
 
   // If the range still has too many cookies, delete the least recently used.
-  if (cookie_its.size() > num_max) {
-    COOKIE_DLOG(INFO) << "GarbageCollectRange() Deep Garbage Collect.";
-    // Purge down to (|num_max| - |num_purge|) total cookies.
-    DCHECK(num_purge <= num_max);
-    num_purge += cookie_its.size() - num_max;
-
-    std::partial_sort(cookie_its.begin(), cookie_its.begin() + num_purge,
-                      cookie_its.end(), LRUCookieSorter);
-    for (size_t i = 0; i < num_purge; ++i)
-      InternalDeleteCookie(cookie_its[i], true);
-
-    num_deleted += num_purge;
-  }
+  num_deleted += PurgeLeastRecentlyAccessed(&cookie_its, num_max, num_purge);
 
   return num_deleted;
 }
 
+int CookieMonster::PurgeLeastRecentlyAccessed(
+    std::vector<ShardedCookie>* cookie_its,
+    size_t num_max,
+    size_t num_purge) {
+  if (cookie_its->size() <= num_max)
+    return 0;
+
+  COOKIE_DLOG(INFO) << "GarbageCollectRange() Deep Garbage Collect.";
+  // Purge down to (|num_max| - |num_purge|) total cookies.
+  DCHECK(num_purge <= num_max);
+  num_purge += cookie_its->size() - num_max;
+
+  std::partial_sort(cookie_its->begin(), cookie_its->begin() + num_purge,
+                    cookie_its->end(), LRUShardedCookieSorter<ShardedCookie>);
+  for (size_t i = 0; i < num_purge; ++i)
+    InternalDeleteCookie((*cookie_its)[i].shard, (*cookie_its)[i].it, true);
+
+  return num_purge;
+}
+
 int CookieMonster::GarbageCollectExpired(
+    Shard* shard,
     const Time& current,
     const CookieMapItPair& itpair,
-    std::vector<CookieMap::iterator>* cookie_its) {
+    std::vector<ShardedCookie>* cookie_its) {
   int num_deleted = 0;
   for (CookieMap::iterator it = itpair.first, end = itpair.second; it != end;) {
     CookieMap::iterator curit = it;
     ++it;
 
     if (curit->second->IsExpired(current)) {
-      InternalDeleteCookie(curit, true);
+      InternalDeleteCookie(shard, curit, true);
       ++num_deleted;
     } else if (cookie_its) {
-      cookie_its->push_back(curit);
+      cookie_its->push_back(ShardedCookie(shard, curit));
     }
   }
 
@@ -655,15 +798,22 @@ int CookieMonster::GarbageCollectExpired(
 }
 
 int CookieMonster::DeleteAll(bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  // The cookies not loaded yet only need to be deleted from the store.
+  if (sync_to_store)
+    LoadAllIfNecessary();
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    ++it;
-    InternalDeleteCookie(curit, sync_to_store);
-    ++num_deleted;
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock autolock(shard->lock);
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end();) {
+      CookieMap::iterator curit = it;
+      ++it;
+      InternalDeleteCookie(shard, curit, sync_to_store);
+      ++num_deleted;
+    }
   }
 
   return num_deleted;
@@ -672,19 +822,25 @@ int CookieMonster::DeleteAll(bool sync_to_store) {
 int CookieMonster::DeleteAllCreatedBetween(const Time& delete_begin,
                                            const Time& delete_end,
                                            bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  if (sync_to_store)
+    LoadAllIfNecessary();
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock autolock(shard->lock);
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end();) {
+      CookieMap::iterator curit = it;
+      CanonicalCookie* cc = curit->second;
+      ++it;
 
-    if (cc->CreationDate() >= delete_begin &&
-        (delete_end.is_null() || cc->CreationDate() < delete_end)) {
-      InternalDeleteCookie(curit, sync_to_store);
-      ++num_deleted;
+      if (cc->CreationDate() >= delete_begin &&
+          (delete_end.is_null() || cc->CreationDate() < delete_end)) {
+        InternalDeleteCookie(shard, curit, sync_to_store);
+        ++num_deleted;
+      }
     }
   }
 
@@ -699,14 +855,17 @@ int CookieMonster::DeleteAllCreatedAfter(const Time& delete_begin,
 bool CookieMonster::DeleteCookie(const std::string& domain,
                                  const CanonicalCookie& cookie,
                                  bool sync_to_store) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
 
-  for (CookieMapItPair its = cookies_.equal_range(domain);
+  const std::string key_domain(DomainForKey(domain));
+  Shard* shard = ShardForDomain(key_domain);
+  AutoLock autolock(shard->lock);
+  LoadDomainIfNecessary(shard, key_domain);
+  for (CookieMapItPair its = shard->cookies.equal_range(domain);
        its.first != its.second; ++its.first) {
     // The creation date acts as our unique index...
     if (its.first->second->CreationDate() == cookie.CreationDate()) {
-      InternalDeleteCookie(its.first, sync_to_store);
+      InternalDeleteCookie(shard, its.first, sync_to_store);
       return true;
     }
   }
@@ -748,7 +907,8 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
 
   // Get the cookies for this host and its domain(s).
   std::vector<CanonicalCookie*> cookies;
-  FindCookiesForHostAndDomain(url, options, &cookies);
+  Shard* shard;
+  FindCookiesForHostAndDomain(url, options, &shard, &cookies);
   std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line;
@@ -759,10 +919,13 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
     // In Mozilla if you set a cookie like AAAA, it will have an empty token
     // and a value of AAAA.  When it sends the cookie back, it will send AAAA,
     // so we need to avoid sending =AAAA for a blank token value.
-    if (!(*it)->Name().empty())
-      cookie_line += (*it)->Name() + "=";
+    if (!(*it)->Name().empty()) {
+      cookie_line += (*it)->Name();
+      cookie_line += '=';
+    }
     cookie_line += (*it)->Value();
   }
+  shard->lock.Release();
 
   COOKIE_DLOG(INFO) << "GetCookies() result: " << cookie_line;
 
@@ -779,12 +942,14 @@ void CookieMonster::GetRawCookies(const GURL& url,
   options.set_include_httponly();
   // Get the cookies for this host and its domain(s).
   std::vector<CanonicalCookie*> cookies;
-  FindCookiesForHostAndDomain(url, options, &cookies);
+  Shard* shard;
+  FindCookiesForHostAndDomain(url, options, &shard, &cookies);
   std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it)
     raw_cookies->push_back(*(*it));
+  shard->lock.Release();
 }
 
 void CookieMonster::DeleteCookie(const GURL& url,
@@ -796,7 +961,8 @@ void CookieMonster::DeleteCookie(const GURL& url,
   options.set_include_httponly();
   // Get the cookies for this host and its domain(s).
   std::vector<CanonicalCookie*> cookies;
-  FindCookiesForHostAndDomain(url, options, &cookies);
+  Shard* shard;
+  FindCookiesForHostAndDomain(url, options, &shard, &cookies);
   std::set<CanonicalCookie*> matching_cookies;
 
   for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
@@ -808,17 +974,25 @@ void CookieMonster::DeleteCookie(const GURL& url,
     matching_cookies.insert(*it);
   }
 
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
+  // All the cookies of |url| are in |shard|.
+  for (CookieMap::iterator it = shard->cookies.begin();
+       it != shard->cookies.end();) {
     CookieMap::iterator curit = it;
     ++it;
     if (matching_cookies.find(curit->second) != matching_cookies.end())
-      InternalDeleteCookie(curit, true);
+      InternalDeleteCookie(shard, curit, true);
   }
+  shard->lock.Release();
+}
+
+static bool CookieListPairSorter(const CookieMonster::CookieListPair& p1,
+                                 const CookieMonster::CookieListPair& p2) {
+  return p1.first < p2.first;
 }
 
 CookieMonster::CookieList CookieMonster::GetAllCookies() {
-  AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllIfNecessary();
 
   // This function is being called to scrape the cookie list for management UI
   // or similar.  We shouldn't show expired cookies in this list since it will
@@ -828,52 +1002,76 @@ CookieMonster::CookieList CookieMonster::GetAllCookies() {
   //
   // Note that this does not prune cookies to be below our limits (if we've
   // exceeded them) the way that calling GarbageCollect() would.
-  GarbageCollectExpired(Time::Now(),
-                        CookieMapItPair(cookies_.begin(), cookies_.end()),
-                        NULL);
-
+  const Time current(Time::Now());
   CookieList cookie_list;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end(); ++it)
-    cookie_list.push_back(CookieListPair(it->first, *it->second));
+  for (int i = 0; i < kNumShards; ++i) {
+    Shard* shard = &shards_[i];
+    AutoLock autolock(shard->lock);
+    GarbageCollectExpired(
+        shard, current,
+        CookieMapItPair(shard->cookies.begin(), shard->cookies.end()), NULL);
+
+    for (CookieMap::iterator it = shard->cookies.begin();
+         it != shard->cookies.end(); ++it)
+      cookie_list.push_back(CookieListPair(it->first, *it->second));
+  }
 
+  // Keep the cookies sorted by key, like a single map would.  All the cookies
+  // with the same key come from the same shard, so a stable sort keeps them in
+  // order too.
+  std::stable_sort(cookie_list.begin(), cookie_list.end(),
+                   CookieListPairSorter);
   return cookie_list;
 }
 
 void CookieMonster::FindCookiesForHostAndDomain(
     const GURL& url,
     const CookieOptions& options,
+    Shard** shard,
     std::vector<CanonicalCookie*>* cookies) {
-  AutoLock autolock(lock_);
   InitIfNecessary();
 
-  const Time current_time(CurrentTime());
+  // Reading cookies doesn't need a unique time, so |time_lock_| is not used.
+  const Time current_time(Time::Now());
+
+  // All the cookies that |url| can see are in the shard of its domain and
+  // registry (or of its host, if there is no domain).
+  const std::string& host = url.host();
+  const std::string domain(
+      RegistryControlledDomainService::GetDomainAndRegistry(host));
+  const std::string& shard_domain = domain.empty() ? host : domain;
+  *shard = ShardForDomain(shard_domain);
+  (*shard)->lock.Acquire();
+  LoadDomainIfNecessary(*shard, shard_domain);
 
   // Query for the full host, For example: 'a.c.blah.com'.
-  std::string key(url.host());
-  FindCookiesForKey(key, url, options, current_time, cookies);
+  FindCookiesForKey(*shard, host, url, options, current_time, cookies);
 
   // See if we can search for domain cookies, i.e. if the host has a TLD + 1.
-  const std::string domain(
-      RegistryControlledDomainService::GetDomainAndRegistry(key));
   if (domain.empty())
     return;
-  DCHECK_LE(domain.length(), key.length());
-  DCHECK_EQ(0, key.compare(key.length() - domain.length(), domain.length(),
-                           domain));
+  DCHECK_LE(domain.length(), host.length());
+  DCHECK_EQ(0, host.compare(host.length() - domain.length(), domain.length(),
+                            domain));
 
   // Walk through the string and query at the dot points (GURL should have
   // canonicalized the dots, so this should be safe).  Stop once we reach the
   // domain + registry; we can't write cookies past this point, and with some
   // registrars other domains can, in which case we don't want to read their
-  // cookies.
-  for (key = "." + key; key.length() > domain.length(); ) {
-    FindCookiesForKey(key, url, options, current_time, cookies);
+  // cookies.  The keys are built in place in a single buffer.
+  std::string key;
+  key.reserve(host.length() + 1);
+  key += '.';
+  key += host;
+  while (key.length() > domain.length()) {
+    FindCookiesForKey(*shard, key, url, options, current_time, cookies);
     const size_t next_dot = key.find('.', 1);  // Skip over leading dot.
     key.erase(0, next_dot);
   }
 }
 
 void CookieMonster::FindCookiesForKey(
+    Shard* shard,
     const std::string& key,
     const GURL& url,
     const CookieOptions& options,
@@ -881,7 +1079,7 @@ void CookieMonster::FindCookiesForKey(
     std::vector<CanonicalCookie*>* cookies) {
   bool secure = url.SchemeIsSecure();
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
+  for (CookieMapItPair its = shard->cookies.equal_range(key);
        its.first != its.second; ) {
     CookieMap::iterator curit = its.first;
     CanonicalCookie* cc = curit->second;
@@ -889,7 +1087,7 @@ void CookieMonster::FindCookiesForKey(
 
     // If the cookie is expired, delete it.
     if (cc->IsExpired(current)) {
-      InternalDeleteCookie(curit, true);
+      InternalDeleteCookie(shard, curit, true);
       continue;
     }
 
@@ -911,7 +1109,6 @@ void CookieMonster::FindCookiesForKey(
   }
 }
 
-
 CookieMonster::ParsedCookie::ParsedCookie(const std::string& cookie_line)
     : is_valid_(false),
       path_index_(0),
@@ -8,10 +8,12 @@
 #define NET_BASE_COOKIE_MONSTER_H_
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/basictypes.h"
 #include "base/lock.h"
 #include "base/time.h"
@@ -29,6 +31,12 @@ namespace net {
 // This class IS thread-safe. Normally, it is only used on the I/O thread, but
 // is also accessed directly through Automation for UI testing.
 //
+// The cookies are spread over several shards, each with its own lock.  The
+// shard of a cookie is chosen from the domain and registry of its key (the
+// "eTLD+1", e.g. google.com for .www.google.com), so all the cookies that a
+// URL can see live in a single shard, and requests for different sites
+// usually don't wait for each other.
+//
 // TODO(deanm) Implement CookieMonster, the cookie database.
 //  - Verify that our domain enforcement and non-dotted handling is correct
 class CookieMonster : public CookieStore {
@@ -61,7 +69,10 @@ class CookieMonster : public CookieStore {
 
 #ifdef UNIT_TEST
   CookieMonster(int last_access_threshold_milliseconds)
-      : initialized_(false),
+      : initialized_(0),
+        load_on_demand_(false),
+        all_loaded_(0),
+        num_cookies_(0),
         store_(NULL),
         last_access_threshold_(base::TimeDelta::FromMilliseconds(
             last_access_threshold_milliseconds)) {
@@ -72,6 +83,11 @@ class CookieMonster : public CookieStore {
   // Parse the string with the cookie time (very forgivingly).
   static base::Time ParseCookieTime(const std::string& time_string);
 
+  // Returns the domain and registry of a cookie key (e.g. google.com for
+  // .www.google.com), or the key itself if it has none.  The cookies are
+  // loaded by domain from the stores that load them on demand.
+  static std::string DomainForKey(const std::string& key);
+
   // CookieStore implementation.
   virtual bool SetCookie(const GURL& url, const std::string& cookie_line);
   virtual bool SetCookieWithOptions(const GURL& url,
@@ -136,29 +152,70 @@ class CookieMonster : public CookieStore {
  private:
   ~CookieMonster();
 
+  // A subset of the cookies, and the lock that protects it.
+  struct Shard {
+    Lock lock;
+    CookieMap cookies;
+    // The domains already loaded from a store that loads on demand.
+    std::set<std::string> loaded_domains;
+  };
+
+  // A cookie in a given shard.
+  struct ShardedCookie {
+    ShardedCookie(Shard* shard, CookieMap::iterator it)
+        : shard(shard), it(it) {}
+    Shard* shard;
+    CookieMap::iterator it;
+  };
+
+  static const int kNumShards = 16;
+
   // Called by all non-static functions to ensure that the cookies store has
   // been initialized. This is not done during creating so it doesn't block
   // the window showing.
-  // Note: this method should always be called with lock_ held.
+  // Note: this method should never be called with a shard lock held.
   void InitIfNecessary() {
-    if (!initialized_) {
-      if (store_)
-        InitStore();
-      initialized_ = true;
-    }
+    if (!base::subtle::Acquire_Load(&initialized_))
+      InitOnce();
   }
 
+  // Initializes the cookie store if no other thread did it first.
+  void InitOnce();
+
   // Initializes the backing store and reads existing cookies from it.
-  // Should only be called by InitIfNecessary().
+  // Should only be called by InitOnce().
   void InitStore();
 
   void SetDefaultCookieableSchemes();
 
+  // Returns the shard holding the cookies of |domain|, which is the domain and
+  // registry of a host, or the host itself if it has none.
+  Shard* ShardForDomain(const std::string& domain);
+
+  // Returns the shard holding the cookies with the given key.
+  Shard* ShardForKey(const std::string& key);
+
+  // When the store loads its cookies on demand, makes sure that the cookies of
+  // |domain| were loaded into |shard|, which must be locked.
+  void LoadDomainIfNecessary(Shard* shard, const std::string& domain);
+
+  // Same as above, for all the cookies.  No shard must be locked.
+  void LoadAllIfNecessary();
+
+  // Acquires and releases the locks of all the shards, in a fixed order.
+  void LockAllShards();
+  void UnlockAllShards();
+
+  // Locks the shard that holds the cookies of |url|, and returns it in
+  // |shard|.  Then finds the cookies that should be sent to |url|.  The
+  // caller must release the lock of |shard|.
   void FindCookiesForHostAndDomain(const GURL& url,
                                    const CookieOptions& options,
+                                   Shard** shard,
                                    std::vector<CanonicalCookie*>* cookies);
 
-  void FindCookiesForKey(const std::string& key,
+  void FindCookiesForKey(Shard* shard,
+                         const std::string& key,
                          const GURL& url,
                          const CookieOptions& options,
                          const base::Time& current,
@@ -168,25 +225,30 @@ class CookieMonster : public CookieStore {
   // If |skip_httponly| is true, httponly cookies will not be deleted.  The
   // return value with be true if |skip_httponly| skipped an httponly cookie.
   // NOTE: There should never be more than a single matching equivalent cookie.
-  bool DeleteAnyEquivalentCookie(const std::string& key,
+  bool DeleteAnyEquivalentCookie(Shard* shard,
+                                 const std::string& key,
                                  const CanonicalCookie& ecc,
                                  bool skip_httponly);
 
-  void InternalInsertCookie(const std::string& key,
+  // The following methods must be called with the lock of |shard| held.
+
+  void InternalInsertCookie(Shard* shard,
+                            const std::string& key,
                             CanonicalCookie* cc,
                             bool sync_to_store);
 
   void InternalUpdateCookieAccessTime(CanonicalCookie* cc);
 
-  void InternalDeleteCookie(CookieMap::iterator it, bool sync_to_store);
+  void InternalDeleteCookie(Shard* shard, CookieMap::iterator it,
+                            bool sync_to_store);
 
-  // If the number of cookies for host |key|, or globally, are over preset
-  // maximums, garbage collects, first for the host and then globally, as
-  // described by GarbageCollectRange().  The limits can be found as constants
-  // at the top of the function body.
+  // If the number of cookies for host |key| is over the preset maximum,
+  // garbage collects, as described by GarbageCollectRange().  The limits can
+  // be found as constants at the top of the file.
   //
   // Returns the number of cookies deleted (useful for debugging).
-  int GarbageCollect(const base::Time& current, const std::string& key);
+  int GarbageCollect(Shard* shard, const base::Time& current,
+                     const std::string& key);
 
   // Deletes all expired cookies in |itpair|;
   // then, if the number of remaining cookies is greater than |num_max|,
@@ -194,7 +256,8 @@ class CookieMonster : public CookieStore {
   // (|num_max| - |num_purge|) cookies remain.
   //
   // Returns the number of cookies deleted.
-  int GarbageCollectRange(const base::Time& current,
+  int GarbageCollectRange(Shard* shard,
+                          const base::Time& current,
                           const CookieMapItPair& itpair,
                           size_t num_max,
                           size_t num_purge);
@@ -204,24 +267,48 @@ class CookieMonster : public CookieStore {
   // populated with all the non-expired cookies from |itpair|.
   //
   // Returns the number of cookies deleted.
-  int GarbageCollectExpired(const base::Time& current,
+  int GarbageCollectExpired(Shard* shard,
+                            const base::Time& current,
                             const CookieMapItPair& itpair,
-                            std::vector<CookieMap::iterator>* cookie_its);
+                            std::vector<ShardedCookie>* cookie_its);
+
+  // Same as GarbageCollectRange(), but on all the cookies, if there are more
+  // of them than the preset maximum.  Must be called without any shard lock
+  // held.
+  int GarbageCollectAll(const base::Time& current);
+
+  // Removes the least recently accessed cookies of |cookie_its| until only
+  // |num_max| - |num_purge| remain, if there are more than |num_max|.
+  // Returns the number of cookies deleted.
+  int PurgeLeastRecentlyAccessed(std::vector<ShardedCookie>* cookie_its,
+                                 size_t num_max,
+                                 size_t num_purge);
 
   bool HasCookieableScheme(const GURL& url);
 
-  CookieMap cookies_;
+  Shard shards_[kNumShards];
 
   // Indicates whether the cookie store has been initialized. This happens
-  // lazily in InitStoreIfNecessary().
-  bool initialized_;
+  // lazily in InitIfNecessary().
+  base::subtle::Atomic32 initialized_;
+  Lock init_lock_;
+
+  // Whether |store_| loads its cookies on demand, and whether all of them were
+  // loaded already.  |load_on_demand_| is set before |initialized_|.
+  bool load_on_demand_;
+  base::subtle::Atomic32 all_loaded_;
+
+  // The total number of cookies, in all shards.
+  base::subtle::Atomic32 num_cookies_;
 
   scoped_refptr<PersistentCookieStore> store_;
 
   // The resolution of our time isn't enough, so we do something
   // ugly and increment when we've seen the same time twice.
+  // Note: this method should always be called with time_lock_ held.
   base::Time CurrentTime();
   base::Time last_time_seen_;
+  Lock time_lock_;
 
   // Minimum delay after updating a cookie's LastAccessDate before we will
   // update it again.
@@ -229,9 +316,6 @@ class CookieMonster : public CookieStore {
 
   std::vector<std::string> cookieable_schemes_;
 
-  // Lock for thread-safety
-  Lock lock_;
-
   DISALLOW_COPY_AND_ASSIGN(CookieMonster);
 };
 
@@ -379,9 +463,24 @@ class CookieMonster::PersistentCookieStore
   virtual ~PersistentCookieStore() { }
 
   // Initializes the store and retrieves the existing cookies. This will be
-  // called only once at startup.
+  // called only once at startup.  Stores that load on demand may return only
+  // some of the cookies, or none.
   virtual bool Load(std::vector<CookieMonster::KeyedCanonicalCookie>*) = 0;
 
+  // Returns true if the cookies not returned by Load() must be retrieved with
+  // LoadCookiesForDomain() and LoadRemainingCookies().  Called after Load().
+  virtual bool LoadsOnDemand() { return false; }
+
+  // Retrieves the cookies whose domain (see CookieMonster::DomainForKey()) is
+  // |domain|, unless they were retrieved already.
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<CookieMonster::KeyedCanonicalCookie>* cookies) {}
+
+  // Retrieves all the cookies that were not retrieved yet.
+  virtual void LoadRemainingCookies(
+      std::vector<CookieMonster::KeyedCanonicalCookie>* cookies) {}
+
   virtual void AddCookie(const std::string&, const CanonicalCookie&) = 0;
   virtual void UpdateCookieAccessTime(const CanonicalCookie&) = 0;
   virtual void DeleteCookie(const CanonicalCookie&) = 0;
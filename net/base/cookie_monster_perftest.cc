@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include "base/perftimer.h"
+#include "base/platform_thread.h"
+#include "base/scoped_vector.h"
 #include "base/string_util.h"
 #include "net/base/cookie_monster.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -14,6 +16,8 @@ namespace {
 }
 
 static const int kNumCookies = 20000;
+static const int kNumManyCookies = 100000;
+static const int kNumThreads = 4;
 static const char kCookieLine[] = "A  = \"b=;\\\"\"  ;secure;;;";
 
 TEST(ParsedCookieTest, TestParseCookies) {
@@ -93,3 +97,94 @@ TEST(CookieMonsterTest, TestAddCookieOnManyHosts) {
   cm->DeleteAll(false);
   timer3.Done();
 }
+
+// The cookies stored through CookieMonster are kept below its total limit, so
+// this mostly measures the cost of the garbage collection.
+TEST(CookieMonsterTest, TestAddManyCookiesOnManyHosts) {
+  scoped_refptr<net::CookieMonster> cm(new net::CookieMonster);
+  std::vector<GURL> gurls;
+  for (int i = 0; i < kNumManyCookies; ++i) {
+    gurls.push_back(GURL(StringPrintf("http://a%03d.b%03d.izzle",
+                                      i % 100, i / 100)));
+  }
+
+  PerfTimeLogger timer("Cookie_monster_add_100k_cookies");
+  for (int i = 0; i < kNumManyCookies; ++i)
+    EXPECT_TRUE(cm->SetCookie(gurls[i], StringPrintf("a%06d=b", i)));
+  timer.Done();
+
+  PerfTimeLogger timer2("Cookie_monster_query_100k_cookies");
+  for (std::vector<GURL>::const_iterator it = gurls.begin();
+       it != gurls.end(); ++it) {
+    cm->GetCookies(*it);
+  }
+  timer2.Done();
+
+  PerfTimeLogger timer3("Cookie_monster_deleteall_100k_cookies");
+  cm->DeleteAll(false);
+  timer3.Done();
+}
+
+namespace {
+
+// Sets and gets cookies on its own hosts.
+class CookieThread : public PlatformThread::Delegate {
+ public:
+  CookieThread(net::CookieMonster* cm, int id, bool set)
+      : cm_(cm), id_(id), set_(set), handle_(0) {
+  }
+
+  bool Start() {
+    return PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Join() {
+    PlatformThread::Join(handle_);
+  }
+
+  virtual void ThreadMain() {
+    std::string cookie(kCookieLine);
+    for (int i = 0; i < kNumCookies; ++i) {
+      GURL url(StringPrintf("http://a%02d.t%d.izzle", i % 50, id_));
+      if (set_)
+        cm_->SetCookie(url, cookie);
+      else
+        cm_->GetCookies(url);
+    }
+  }
+
+ private:
+  net::CookieMonster* cm_;
+  int id_;
+  bool set_;
+  PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(CookieThread);
+};
+
+void RunCookieThreads(net::CookieMonster* cm, bool set, const char* name) {
+  ScopedVector<CookieThread> threads;
+  for (int i = 0; i < kNumThreads; ++i)
+    threads.push_back(new CookieThread(cm, i, set));
+
+  PerfTimeLogger timer(name);
+  for (int i = 0; i < kNumThreads; ++i)
+    ASSERT_TRUE(threads[i]->Start());
+  for (int i = 0; i < kNumThreads; ++i)
+    threads[i]->Join();
+  timer.Done();
+}
+
+}  // namespace
+
+// Each thread works on a different domain, so the threads should not contend
+// with each other.
+TEST(CookieMonsterTest, TestMultiThreadedAddAndQuery) {
+  scoped_refptr<net::CookieMonster> cm(new net::CookieMonster);
+  RunCookieThreads(cm, true, "Cookie_monster_add_4_threads");
+  RunCookieThreads(cm, false, "Cookie_monster_query_4_threads");
+
+  PerfTimeLogger timer("Cookie_monster_deleteall_4_threads");
+  cm->DeleteAll(false);
+  timer.Done();
+}
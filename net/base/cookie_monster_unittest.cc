@@ -4,13 +4,16 @@
 
 #include <time.h>
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/platform_thread.h"
 #include "base/ref_counted.h"
 #include "base/string_util.h"
 #include "base/time.h"
+#include "base/waitable_event.h"
 #include "googleurl/src/gurl.h"
 #include "net/base/cookie_monster.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -1002,4 +1005,151 @@ TEST(CookieMonsterTest, DeleteCookieByName) {
   }
 }
 
+// The cookies are stored in several shards; make sure that GetAllCookies()
+// still returns them sorted by domain, and that the total limit applies to all
+// of them.
+TEST(CookieMonsterTest, CookiesOnManyDomains) {
+  scoped_refptr<net::CookieMonster> cm(new net::CookieMonster);
+  for (int i = 0; i < 4000; ++i) {
+    GURL url(StringPrintf("http://www.domain%04d.izzle", i));
+    EXPECT_TRUE(cm->SetCookie(url, "A=B"));
+  }
+
+  net::CookieMonster::CookieList cookies = cm->GetAllCookies();
+  EXPECT_GE(3300U, cookies.size());
+  EXPECT_LE(3000U, cookies.size());
+  for (size_t i = 1; i < cookies.size(); ++i)
+    EXPECT_LT(cookies[i - 1].first, cookies[i].first);
+
+  // The least recently accessed cookies were evicted.
+  EXPECT_EQ("", cm->GetCookies(GURL("http://www.domain0000.izzle")));
+  EXPECT_EQ("A=B", cm->GetCookies(GURL("http://www.domain3999.izzle")));
+}
+
+namespace {
+
+// A store that loads its cookies on demand, one domain at a time.
+class OnDemandCookieStore : public net::CookieMonster::PersistentCookieStore {
+ public:
+  OnDemandCookieStore() {}
+
+  // Adds a cookie that is already in the store.
+  void AddStoredCookie(const std::string& key, const std::string& name,
+                       const Time& creation_time) {
+    std::string domain = net::CookieMonster::DomainForKey(key);
+    cookies_[domain].push_back(net::CookieMonster::KeyedCanonicalCookie(
+        key, new net::CookieMonster::CanonicalCookie(
+            name, "B", "/", false, false, creation_time, creation_time,
+            true, creation_time + TimeDelta::FromDays(1))));
+  }
+
+  const std::vector<std::string>& loaded_domains() const {
+    return loaded_domains_;
+  }
+
+  virtual bool Load(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    return true;
+  }
+  virtual bool LoadsOnDemand() { return true; }
+  virtual void LoadCookiesForDomain(
+      const std::string& domain,
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    loaded_domains_.push_back(domain);
+    cookies->insert(cookies->end(), cookies_[domain].begin(),
+                    cookies_[domain].end());
+    cookies_.erase(domain);
+  }
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    for (CookiesByDomain::iterator it = cookies_.begin();
+         it != cookies_.end(); ++it)
+      cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+    cookies_.clear();
+  }
+
+  virtual void AddCookie(const std::string&,
+                         const net::CookieMonster::CanonicalCookie&) {}
+  virtual void UpdateCookieAccessTime(
+      const net::CookieMonster::CanonicalCookie&) {}
+  virtual void DeleteCookie(const net::CookieMonster::CanonicalCookie&) {}
+
+ private:
+  typedef std::map<std::string,
+                   std::vector<net::CookieMonster::KeyedCanonicalCookie> >
+      CookiesByDomain;
+  CookiesByDomain cookies_;
+  std::vector<std::string> loaded_domains_;
+
+  DISALLOW_COPY_AND_ASSIGN(OnDemandCookieStore);
+};
+
+// Signals |cookies_taken| when LoadRemainingCookies() took the cookies out of
+// the store, and then returns them late.
+class SlowRemainingCookieStore : public OnDemandCookieStore {
+ public:
+  SlowRemainingCookieStore() : cookies_taken(false, false) {}
+
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::KeyedCanonicalCookie>* cookies) {
+    OnDemandCookieStore::LoadRemainingCookies(cookies);
+    cookies_taken.Signal();
+    PlatformThread::Sleep(100);
+  }
+
+  base::WaitableEvent cookies_taken;
+};
+
+class GetAllCookiesThread : public PlatformThread::Delegate {
+ public:
+  explicit GetAllCookiesThread(net::CookieMonster* cm) : cm_(cm) {}
+
+  virtual void ThreadMain() {
+    cm_->GetAllCookies();
+  }
+
+ private:
+  net::CookieMonster* cm_;
+
+  DISALLOW_COPY_AND_ASSIGN(GetAllCookiesThread);
+};
+
+}  // namespace
+
+TEST(CookieMonsterTest, LoadOnDemand) {
+  scoped_refptr<OnDemandCookieStore> store(new OnDemandCookieStore);
+  Time now = Time::Now();
+  store->AddStoredCookie("www.google.izzle", "A", now);
+  store->AddStoredCookie(".google.izzle", "B", now + TimeDelta::FromSeconds(1));
+  store->AddStoredCookie("www.foo.izzle", "C", now + TimeDelta::FromSeconds(2));
+  scoped_refptr<net::CookieMonster> cm(new net::CookieMonster(store));
+
+  // Only the domain of the URL is loaded, once.
+  EXPECT_EQ("A=B; B=B", cm->GetCookies(GURL("http://www.google.izzle")));
+  EXPECT_EQ("B=B", cm->GetCookies(GURL("http://mail.google.izzle")));
+  ASSERT_EQ(1U, store->loaded_domains().size());
+  EXPECT_EQ(net::CookieMonster::DomainForKey("www.google.izzle"),
+            store->loaded_domains()[0]);
+
+  // Listing the cookies loads all of them.
+  EXPECT_EQ(3U, cm->GetAllCookies().size());
+  EXPECT_EQ("C=B", cm->GetCookies(GURL("http://www.foo.izzle")));
+  EXPECT_EQ(1U, store->loaded_domains().size());
+}
+
+// The cookies of a domain can be read while all the cookies are loaded.
+TEST(CookieMonsterTest, LoadOnDemandWhileLoadingAll) {
+  scoped_refptr<SlowRemainingCookieStore> store(new SlowRemainingCookieStore);
+  store->AddStoredCookie("www.google.izzle", "A", Time::Now());
+  scoped_refptr<net::CookieMonster> cm(new net::CookieMonster(store));
+
+  GetAllCookiesThread delegate(cm);
+  PlatformThreadHandle thread;
+  ASSERT_TRUE(PlatformThread::Create(0, &delegate, &thread));
+  store->cookies_taken.Wait();
+  EXPECT_EQ("A=B", cm->GetCookies(GURL("http://www.google.izzle")));
+  PlatformThread::Join(thread);
+  EXPECT_EQ(1U, cm->GetAllCookies().size());
+}
+
 // TODO test overwrite cookie
@@ -0,0 +1,61 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_CLIENT_H_
+#define NET_BASE_DNS_CLIENT_H_
+
+#include <string>
+
+#include "base/time.h"
+#include "net/base/address_family.h"
+#include "net/base/completion_callback.h"
+
+namespace net {
+
+class AddressList;
+struct DnsConfig;
+
+// Resolves hostnames by sending DNS queries from the current thread, rather
+// than by calling getaddrinfo() on a worker thread. HostResolverImpl uses it
+// when one is set with HostResolverImpl::set_dns_client().
+//
+// A DnsClient must only be used from the thread that created it.
+class DnsClient {
+ public:
+  // Opaque type used to cancel a request.
+  typedef void* RequestHandle;
+
+  // If any completion callbacks are pending when the client is destroyed,
+  // the requests are cancelled, and the callbacks will not be called.
+  virtual ~DnsClient() {}
+
+  // Resolves |hostname| to the addresses of |address_family|. Returns OK if
+  // the addresses are known right away (for example from the hosts file),
+  // ERR_IO_PENDING if |callback| will be run with the result, or a net
+  // error code. On success, |addresses| is set (with port 0), and |ttl| is
+  // set to how long the addresses can be cached (zero if the default of the
+  // cache should be used).
+  //
+  // |out_req| is set to a handle that can be passed to CancelRequest().
+  virtual int Resolve(const std::string& hostname,
+                      AddressFamily address_family,
+                      AddressList* addresses,
+                      base::TimeDelta* ttl,
+                      CompletionCallback* callback,
+                      RequestHandle* out_req) = 0;
+
+  // Cancels the pending request |req|. Its callback will not be run.
+  virtual void CancelRequest(RequestHandle req) = 0;
+};
+
+#if defined(OS_POSIX)
+// Creates a DnsClient that queries the name servers of |config| over UDP
+// (and over TCP when a response is truncated), using the libevent message
+// pump of the current MessageLoopForIO.
+DnsClient* CreateAsyncDnsClient(const DnsConfig& config);
+#endif
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_CLIENT_H_
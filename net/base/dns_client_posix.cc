@@ -0,0 +1,610 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_client.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "base/eintr_wrapper.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/rand_util.h"
+#include "base/stl_util-inl.h"
+#include "base/string_util.h"
+#include "base/timer.h"
+#include "net/base/address_list.h"
+#include "net/base/dns_config.h"
+#include "net/base/dns_message.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
+
+namespace net {
+
+namespace {
+
+// Without EDNS0, a UDP response is at most 512 bytes; a TCP response is at
+// most 64KB.
+const size_t kMaxUdpResponseSize = 512;
+const size_t kMaxTcpResponseSize = 2 + 65535;
+
+// Returns the addresses of |addresses| that belong to |address_family|.
+std::vector<std::string> FilterAddresses(
+    const std::vector<std::string>& addresses, AddressFamily address_family) {
+  std::vector<std::string> filtered;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    size_t size = addresses[i].size();
+    if ((address_family == ADDRESS_FAMILY_IPV4 && size != 4) ||
+        (address_family == ADDRESS_FAMILY_IPV6 && size != 16)) {
+      continue;
+    }
+    filtered.push_back(addresses[i]);
+  }
+  return filtered;
+}
+
+class AsyncDnsClient;
+
+// Resolves one hostname: goes through the names to try (see BuildNames()),
+// and for each name through the query types, sending each query to the name
+// servers in turn until one of them answers.
+class Transaction : public MessageLoopForIO::Watcher {
+ public:
+  Transaction(AsyncDnsClient* client,
+              const DnsConfig& config,
+              const std::vector<std::string>& names,
+              AddressFamily address_family,
+              AddressList* addresses,
+              base::TimeDelta* ttl,
+              CompletionCallback* callback);
+  virtual ~Transaction();
+
+  // Sends the first query. Returns ERR_IO_PENDING, or a net error code if no
+  // query could be sent.
+  int Start();
+
+  CompletionCallback* callback() const { return callback_; }
+
+  // MessageLoopForIO::Watcher methods.
+  virtual void OnFileCanReadWithoutBlocking(int fd);
+  virtual void OnFileCanWriteWithoutBlocking(int fd);
+
+ private:
+  enum QueryResult {
+    QUERY_PENDING,
+    QUERY_ANSWERED,       // The response has addresses.
+    QUERY_NO_DATA,        // The name exists, without records of that type.
+    QUERY_NXDOMAIN,       // The name does not exist.
+    QUERY_SERVER_FAILED,  // Try the next name server.
+  };
+
+  enum State {
+    STATE_NONE,
+    STATE_UDP_READ,
+    STATE_TCP_CONNECT,
+    STATE_TCP_WRITE,
+    STATE_TCP_READ,
+  };
+
+  // Moves on after a query finished with |result|, sending queries until
+  // one of them is pending. Returns ERR_IO_PENDING, or the final result of
+  // the transaction.
+  int ProcessResult(QueryResult result);
+
+  // Move to the next server, query type or name. Return false when there are
+  // none left.
+  bool NextServer();
+  bool NextQueryType();
+  bool NextName();
+
+  // Sends the current query over UDP.
+  QueryResult SendUdpQuery();
+
+  // Sends the current query again over TCP, after a truncated response.
+  QueryResult SendTcpQuery();
+
+  // Opens a nonblocking socket of |type| to the current name server.
+  // Returns a net error code.
+  int OpenSocket(int type);
+  void CloseSocket();
+
+  // Waits for |socket_| to be ready for |mode|.
+  bool Watch(MessageLoopForIO::Mode mode);
+
+  // Reads the response to the current query.
+  QueryResult DoUdpRead();
+  QueryResult DoTcpWrite();
+  QueryResult DoTcpRead();
+
+  // Interprets a complete response.
+  QueryResult HandleResponse(const DnsResponse& response);
+
+  void OnTimeout();
+
+  // Called when the current query has finished with |result|.
+  void OnQueryComplete(QueryResult result);
+
+  AsyncDnsClient* const client_;
+  const DnsConfig& config_;
+  const std::vector<std::string> names_;
+  std::vector<uint16> query_types_;
+
+  // The position in the iteration.
+  size_t name_index_;
+  size_t query_type_index_;
+  size_t server_index_;
+  int attempt_;
+
+  // The current query.
+  State state_;
+  std::string query_;
+  int socket_;
+  MessageLoopForIO::FileDescriptorWatcher watcher_;
+  base::OneShotTimer<Transaction> timer_;
+  std::string buffer_;      // Framed query, or response being read (TCP).
+  size_t buffer_offset_;
+
+  // The results.
+  AddressList* const addresses_;
+  base::TimeDelta* const ttl_;
+  CompletionCallback* const callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(Transaction);
+};
+
+class AsyncDnsClient : public DnsClient {
+ public:
+  explicit AsyncDnsClient(const DnsConfig& config) : config_(config) {}
+
+  virtual ~AsyncDnsClient() {
+    STLDeleteElements(&transactions_);
+  }
+
+  // DnsClient methods:
+  virtual int Resolve(const std::string& hostname,
+                      AddressFamily address_family,
+                      AddressList* addresses,
+                      base::TimeDelta* ttl,
+                      CompletionCallback* callback,
+                      RequestHandle* out_req);
+  virtual void CancelRequest(RequestHandle req);
+
+  // Called by |transaction| when it has finished with |result|.
+  void OnTransactionComplete(Transaction* transaction, int result);
+
+ private:
+  typedef std::set<Transaction*> TransactionSet;
+
+  // Returns the names to query for |hostname|, in order, according to the
+  // search domains of the configuration.
+  std::vector<std::string> BuildNames(const std::string& hostname) const;
+
+  const DnsConfig config_;
+  TransactionSet transactions_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncDnsClient);
+};
+
+//-----------------------------------------------------------------------------
+
+Transaction::Transaction(AsyncDnsClient* client,
+                         const DnsConfig& config,
+                         const std::vector<std::string>& names,
+                         AddressFamily address_family,
+                         AddressList* addresses,
+                         base::TimeDelta* ttl,
+                         CompletionCallback* callback)
+    : client_(client),
+      config_(config),
+      names_(names),
+      name_index_(0),
+      query_type_index_(0),
+      server_index_(0),
+      attempt_(0),
+      state_(STATE_NONE),
+      socket_(-1),
+      buffer_offset_(0),
+      addresses_(addresses),
+      ttl_(ttl),
+      callback_(callback) {
+  // The AAAA query is only sent if there is no A record.
+  if (address_family != ADDRESS_FAMILY_IPV6)
+    query_types_.push_back(DNS_TYPE_A);
+  if (address_family != ADDRESS_FAMILY_IPV4)
+    query_types_.push_back(DNS_TYPE_AAAA);
+}
+
+Transaction::~Transaction() {
+  CloseSocket();
+}
+
+int Transaction::Start() {
+  QueryResult result = SendUdpQuery();
+  if (result == QUERY_PENDING)
+    return ERR_IO_PENDING;
+  return ProcessResult(result);
+}
+
+int Transaction::ProcessResult(QueryResult result) {
+  for (;;) {
+    bool more = false;
+    switch (result) {
+      case QUERY_ANSWERED:
+        return OK;
+      case QUERY_NO_DATA:
+        more = NextQueryType() || NextName();
+        break;
+      case QUERY_NXDOMAIN:
+        more = NextName();
+        break;
+      case QUERY_SERVER_FAILED:
+        more = NextServer();
+        break;
+      default:
+        NOTREACHED();
+        break;
+    }
+    if (!more)
+      return ERR_NAME_NOT_RESOLVED;
+
+    result = SendUdpQuery();
+    if (result == QUERY_PENDING)
+      return ERR_IO_PENDING;
+  }
+}
+
+bool Transaction::NextServer() {
+  if (++server_index_ < config_.nameservers.size())
+    return true;
+  server_index_ = 0;
+  return ++attempt_ < config_.attempts;
+}
+
+bool Transaction::NextQueryType() {
+  server_index_ = 0;
+  attempt_ = 0;
+  return ++query_type_index_ < query_types_.size();
+}
+
+bool Transaction::NextName() {
+  server_index_ = 0;
+  attempt_ = 0;
+  query_type_index_ = 0;
+  return ++name_index_ < names_.size();
+}
+
+Transaction::QueryResult Transaction::SendUdpQuery() {
+  uint16 id = static_cast<uint16>(base::RandInt(0, kuint16max));
+  if (!BuildDnsQuery(id, names_[name_index_], query_types_[query_type_index_],
+                     &query_)) {
+    // The name is not valid in DNS, so it can't exist.
+    return QUERY_NXDOMAIN;
+  }
+
+  if (OpenSocket(SOCK_DGRAM) != OK)
+    return QUERY_SERVER_FAILED;
+
+  // The socket is connected, so we only receive datagrams from the server.
+  ssize_t rv = HANDLE_EINTR(send(socket_, query_.data(), query_.size(), 0));
+  if (rv != static_cast<ssize_t>(query_.size()) ||
+      !Watch(MessageLoopForIO::WATCH_READ)) {
+    CloseSocket();
+    return QUERY_SERVER_FAILED;
+  }
+
+  state_ = STATE_UDP_READ;
+  timer_.Start(config_.timeout, this, &Transaction::OnTimeout);
+  return QUERY_PENDING;
+}
+
+Transaction::QueryResult Transaction::SendTcpQuery() {
+  if (OpenSocket(SOCK_STREAM) != OK)
+    return QUERY_SERVER_FAILED;
+
+  // The query is prefixed with its length.
+  buffer_.clear();
+  buffer_.push_back(static_cast<char>(query_.size() >> 8));
+  buffer_.push_back(static_cast<char>(query_.size() & 0xff));
+  buffer_.append(query_);
+  buffer_offset_ = 0;
+
+  const struct addrinfo* ai = config_.nameservers[server_index_].head();
+  int rv = HANDLE_EINTR(connect(socket_, ai->ai_addr,
+                                static_cast<int>(ai->ai_addrlen)));
+  if (rv == 0) {
+    state_ = STATE_TCP_WRITE;
+    return DoTcpWrite();
+  }
+  if (errno != EINPROGRESS || !Watch(MessageLoopForIO::WATCH_WRITE)) {
+    CloseSocket();
+    return QUERY_SERVER_FAILED;
+  }
+  state_ = STATE_TCP_CONNECT;
+  return QUERY_PENDING;
+}
+
+int Transaction::OpenSocket(int type) {
+  CloseSocket();
+  const struct addrinfo* ai = config_.nameservers[server_index_].head();
+  socket_ = socket(ai->ai_family, type, 0);
+  if (socket_ < 0)
+    return ERR_UNEXPECTED;
+  if (SetNonBlocking(socket_)) {
+    CloseSocket();
+    return ERR_UNEXPECTED;
+  }
+  if (type == SOCK_DGRAM &&
+      HANDLE_EINTR(connect(socket_, ai->ai_addr,
+                           static_cast<int>(ai->ai_addrlen))) != 0) {
+    CloseSocket();
+    return ERR_ADDRESS_UNREACHABLE;
+  }
+  return OK;
+}
+
+void Transaction::CloseSocket() {
+  timer_.Stop();
+  watcher_.StopWatchingFileDescriptor();
+  if (socket_ >= 0) {
+    HANDLE_EINTR(close(socket_));
+    socket_ = -1;
+  }
+  state_ = STATE_NONE;
+}
+
+bool Transaction::Watch(MessageLoopForIO::Mode mode) {
+  watcher_.StopWatchingFileDescriptor();
+  return MessageLoopForIO::current()->WatchFileDescriptor(
+      socket_, true, mode, &watcher_, this);
+}
+
+void Transaction::OnFileCanReadWithoutBlocking(int fd) {
+  QueryResult result = QUERY_PENDING;
+  if (state_ == STATE_UDP_READ) {
+    result = DoUdpRead();
+  } else if (state_ == STATE_TCP_READ) {
+    result = DoTcpRead();
+  } else {
+    NOTREACHED();
+  }
+  if (result != QUERY_PENDING)
+    OnQueryComplete(result);
+}
+
+void Transaction::OnFileCanWriteWithoutBlocking(int fd) {
+  QueryResult result = QUERY_PENDING;
+  if (state_ == STATE_TCP_CONNECT) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &length) != 0 ||
+        error != 0) {
+      result = QUERY_SERVER_FAILED;
+    } else {
+      state_ = STATE_TCP_WRITE;
+      result = DoTcpWrite();
+    }
+  } else if (state_ == STATE_TCP_WRITE) {
+    result = DoTcpWrite();
+  } else {
+    NOTREACHED();
+  }
+  if (result != QUERY_PENDING)
+    OnQueryComplete(result);
+}
+
+Transaction::QueryResult Transaction::DoUdpRead() {
+  char data[kMaxUdpResponseSize];
+  ssize_t rv = HANDLE_EINTR(recv(socket_, data, sizeof(data), 0));
+  if (rv < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return QUERY_PENDING;
+    // For example ICMP port unreachable.
+    return QUERY_SERVER_FAILED;
+  }
+
+  DnsResponse response;
+  if (!ParseDnsResponse(data, rv, query_, query_types_[query_type_index_],
+                        &response)) {
+    // Not a response to our query, keep waiting.
+    return QUERY_PENDING;
+  }
+  if (response.truncated) {
+    // Retry over TCP, within the same timeout.
+    timer_.Stop();
+    QueryResult result = SendTcpQuery();
+    if (result == QUERY_PENDING)
+      timer_.Start(config_.timeout, this, &Transaction::OnTimeout);
+    return result;
+  }
+  return HandleResponse(response);
+}
+
+Transaction::QueryResult Transaction::DoTcpWrite() {
+  while (buffer_offset_ < buffer_.size()) {
+    ssize_t rv = HANDLE_EINTR(write(socket_, buffer_.data() + buffer_offset_,
+                                    buffer_.size() - buffer_offset_));
+    if (rv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!Watch(MessageLoopForIO::WATCH_WRITE))
+          return QUERY_SERVER_FAILED;
+        return QUERY_PENDING;
+      }
+      return QUERY_SERVER_FAILED;
+    }
+    buffer_offset_ += rv;
+  }
+
+  buffer_.clear();
+  state_ = STATE_TCP_READ;
+  if (!Watch(MessageLoopForIO::WATCH_READ))
+    return QUERY_SERVER_FAILED;
+  return QUERY_PENDING;
+}
+
+Transaction::QueryResult Transaction::DoTcpRead() {
+  char data[4096];
+  for (;;) {
+    ssize_t rv = HANDLE_EINTR(read(socket_, data, sizeof(data)));
+    if (rv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return QUERY_PENDING;
+      return QUERY_SERVER_FAILED;
+    }
+    if (rv == 0)
+      return QUERY_SERVER_FAILED;  // Closed before the end of the response.
+    buffer_.append(data, rv);
+    if (buffer_.size() > kMaxTcpResponseSize)
+      return QUERY_SERVER_FAILED;
+
+    if (buffer_.size() < 2)
+      continue;
+    size_t length = (static_cast<uint8>(buffer_[0]) << 8) |
+                    static_cast<uint8>(buffer_[1]);
+    if (buffer_.size() < 2 + length)
+      continue;
+
+    DnsResponse response;
+    if (!ParseDnsResponse(buffer_.data() + 2, length, query_,
+                          query_types_[query_type_index_], &response)) {
+      return QUERY_SERVER_FAILED;
+    }
+    return HandleResponse(response);
+  }
+}
+
+Transaction::QueryResult Transaction::HandleResponse(
+    const DnsResponse& response) {
+  switch (response.rcode) {
+    case DNS_RCODE_NOERROR:
+      if (response.addresses.empty())
+        return QUERY_NO_DATA;
+      *addresses_ = AddressList::CreateFromIPAddresses(response.addresses, 0);
+      *ttl_ = response.ttl;
+      return QUERY_ANSWERED;
+    case DNS_RCODE_NXDOMAIN:
+      return QUERY_NXDOMAIN;
+    default:
+      return QUERY_SERVER_FAILED;
+  }
+}
+
+void Transaction::OnTimeout() {
+  OnQueryComplete(QUERY_SERVER_FAILED);
+}
+
+void Transaction::OnQueryComplete(QueryResult result) {
+  CloseSocket();
+  int rv = ProcessResult(result);
+  if (rv != ERR_IO_PENDING)
+    client_->OnTransactionComplete(this, rv);  // Deletes |this|.
+}
+
+//-----------------------------------------------------------------------------
+
+int AsyncDnsClient::Resolve(const std::string& hostname,
+                            AddressFamily address_family,
+                            AddressList* addresses,
+                            base::TimeDelta* ttl,
+                            CompletionCallback* callback,
+                            RequestHandle* out_req) {
+  DCHECK(callback);
+  *ttl = base::TimeDelta();
+
+  // IP literals and the entries of the hosts file are answered right away.
+  std::string packed;
+  if (ParseIPLiteral(hostname, &packed)) {
+    std::vector<std::string> literal = FilterAddresses(
+        std::vector<std::string>(1, packed), address_family);
+    if (literal.empty())
+      return ERR_NAME_NOT_RESOLVED;
+    *addresses = AddressList::CreateFromIPAddresses(literal, 0);
+    return OK;
+  }
+
+  std::string lower_hostname = StringToLowerASCII(hostname);
+  DnsConfig::HostsMap::const_iterator it =
+      config_.hosts.find(lower_hostname);
+  if (it != config_.hosts.end()) {
+    std::vector<std::string> hosts_addresses =
+        FilterAddresses(it->second, address_family);
+    if (!hosts_addresses.empty()) {
+      *addresses = AddressList::CreateFromIPAddresses(hosts_addresses, 0);
+      return OK;
+    }
+  }
+
+  if (config_.nameservers.empty())
+    return ERR_NAME_NOT_RESOLVED;
+
+  std::vector<std::string> names = BuildNames(lower_hostname);
+  if (names.empty())
+    return ERR_NAME_NOT_RESOLVED;
+
+  Transaction* transaction = new Transaction(
+      this, config_, names, address_family, addresses, ttl, callback);
+  int rv = transaction->Start();
+  if (rv != ERR_IO_PENDING) {
+    delete transaction;
+    return rv;
+  }
+
+  transactions_.insert(transaction);
+  if (out_req)
+    *out_req = reinterpret_cast<RequestHandle>(transaction);
+  return ERR_IO_PENDING;
+}
+
+void AsyncDnsClient::CancelRequest(RequestHandle req) {
+  Transaction* transaction = reinterpret_cast<Transaction*>(req);
+  size_t erased = transactions_.erase(transaction);
+  DCHECK_EQ(1u, erased);
+  delete transaction;
+}
+
+void AsyncDnsClient::OnTransactionComplete(Transaction* transaction,
+                                           int result) {
+  CompletionCallback* callback = transaction->callback();
+  transactions_.erase(transaction);
+  delete transaction;
+  callback->Run(result);
+}
+
+std::vector<std::string> AsyncDnsClient::BuildNames(
+    const std::string& hostname) const {
+  std::vector<std::string> names;
+  if (hostname.empty())
+    return names;
+
+  // A fully qualified name is only queried as is.
+  if (hostname[hostname.size() - 1] == '.') {
+    if (hostname.size() > 1)
+      names.push_back(hostname.substr(0, hostname.size() - 1));
+    return names;
+  }
+
+  int dots = static_cast<int>(std::count(hostname.begin(), hostname.end(),
+                                         '.'));
+  if (dots >= config_.ndots)
+    names.push_back(hostname);
+  for (size_t i = 0; i < config_.search.size(); ++i)
+    names.push_back(hostname + "." + config_.search[i]);
+  if (dots < config_.ndots)
+    names.push_back(hostname);
+  return names;
+}
+
+}  // namespace
+
+DnsClient* CreateAsyncDnsClient(const DnsConfig& config) {
+  return new AsyncDnsClient(config);
+}
+
+}  // namespace net
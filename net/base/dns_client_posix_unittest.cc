@@ -0,0 +1,251 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_client.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "base/eintr_wrapper.h"
+#include "base/message_loop.h"
+#include "base/scoped_ptr.h"
+#include "net/base/address_list.h"
+#include "net/base/dns_config.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/test_completion_callback.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// A name server on the loopback interface, which answers the A queries for
+// the names under "test" with 10.0.0.1, and NXDOMAIN for the other names.
+// If |respond| is false, it never answers.
+class LocalDnsServer : public MessageLoopForIO::Watcher {
+ public:
+  explicit LocalDnsServer(bool respond)
+      : respond_(respond), socket_(-1), port_(0), queries_(0) {
+  }
+
+  virtual ~LocalDnsServer() {
+    watcher_.StopWatchingFileDescriptor();
+    if (socket_ >= 0)
+      HANDLE_EINTR(close(socket_));
+  }
+
+  bool Start() {
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_ < 0 || SetNonBlocking(socket_))
+      return false;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    if (bind(socket_, reinterpret_cast<struct sockaddr*>(&addr), length) ||
+        getsockname(socket_, reinterpret_cast<struct sockaddr*>(&addr),
+                    &length)) {
+      return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    return MessageLoopForIO::current()->WatchFileDescriptor(
+        socket_, true, MessageLoopForIO::WATCH_READ, &watcher_, this);
+  }
+
+  AddressList address() const {
+    return AddressList::CreateFromIPAddresses(
+        std::vector<std::string>(1, std::string("\x7f\x00\x00\x01", 4)),
+        port_);
+  }
+
+  // The names that were queried, in order.
+  const std::vector<std::string>& queried_names() const {
+    return queried_names_;
+  }
+
+  int queries() const { return queries_; }
+
+  virtual void OnFileCanReadWithoutBlocking(int fd) {
+    char query[512];
+    struct sockaddr_storage from;
+    socklen_t from_length = sizeof(from);
+    ssize_t length = HANDLE_EINTR(recvfrom(
+        socket_, query, sizeof(query), 0,
+        reinterpret_cast<struct sockaddr*>(&from), &from_length));
+    if (length < 12 + 5)
+      return;
+    ++queries_;
+
+    // Decode the question name (queries are not compressed).
+    std::string name;
+    size_t pos = 12;
+    while (pos < static_cast<size_t>(length) && query[pos]) {
+      if (!name.empty())
+        name.push_back('.');
+      name.append(query + pos + 1, query[pos]);
+      pos += query[pos] + 1;
+    }
+    queried_names_.push_back(name);
+    if (!respond_)
+      return;
+    bool is_a = query[pos + 1] == 0 && query[pos + 2] == 1;
+    bool exists = name.size() > 5 &&
+                  name.compare(name.size() - 5, 5, ".test") == 0;
+
+    std::string response(query, length);
+    response[2] = '\x81';
+    response[3] = exists ? '\x80' : '\x83';
+    if (exists && is_a) {
+      response[7] = 1;  // ANCOUNT
+      // The owner name points to the question, with TTL 60.
+      response.append("\xc0\x0c\x00\x01\x00\x01\x00\x00\x00\x3c\x00\x04"
+                      "\x0a\x00\x00\x01", 16);
+    }
+    HANDLE_EINTR(sendto(socket_, response.data(), response.size(), 0,
+                        reinterpret_cast<struct sockaddr*>(&from),
+                        from_length));
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int fd) {}
+
+ private:
+  bool respond_;
+  int socket_;
+  int port_;
+  int queries_;
+  std::vector<std::string> queried_names_;
+  MessageLoopForIO::FileDescriptorWatcher watcher_;
+};
+
+class DnsClientTest : public testing::Test {
+ protected:
+  DnsClientTest() : server_(true), silent_server_(false) {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(server_.Start());
+    ASSERT_TRUE(silent_server_.Start());
+    config_.nameservers.push_back(server_.address());
+    config_.timeout = base::TimeDelta::FromMilliseconds(100);
+    config_.attempts = 1;
+  }
+
+  LocalDnsServer server_;
+  LocalDnsServer silent_server_;
+  DnsConfig config_;
+};
+
+TEST_F(DnsClientTest, Resolve) {
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  DnsClient::RequestHandle req = NULL;
+  int rv = client->Resolve("Host.Test", ADDRESS_FAMILY_UNSPECIFIED,
+                           &addresses, &ttl, &callback, &req);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_TRUE(req != NULL);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("10.0.0.1", NetAddressToString(addresses.head()));
+  EXPECT_EQ(60, ttl.InSeconds());
+  EXPECT_EQ(1, server_.queries());
+}
+
+TEST_F(DnsClientTest, SearchDomains) {
+  config_.search.push_back("example");
+  config_.search.push_back("test");
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  int rv = client->Resolve("host", ADDRESS_FAMILY_IPV4, &addresses, &ttl,
+                           &callback, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  // "host" has less than ndots dots, so the search domains come first.
+  ASSERT_EQ(2u, server_.queried_names().size());
+  EXPECT_EQ("host.example", server_.queried_names()[0]);
+  EXPECT_EQ("host.test", server_.queried_names()[1]);
+}
+
+TEST_F(DnsClientTest, NameNotResolved) {
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  int rv = client->Resolve("host.invalid", ADDRESS_FAMILY_IPV4, &addresses,
+                           &ttl, &callback, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, callback.WaitForResult());
+}
+
+// The next name server is used when the first one does not answer in time.
+TEST_F(DnsClientTest, Timeout) {
+  config_.nameservers.insert(config_.nameservers.begin(),
+                             silent_server_.address());
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  int rv = client->Resolve("host.test", ADDRESS_FAMILY_IPV4, &addresses,
+                           &ttl, &callback, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ(1, silent_server_.queries());
+  EXPECT_EQ(1, server_.queries());
+}
+
+TEST_F(DnsClientTest, HostsAndLiterals) {
+  config_.hosts["myhost"].push_back(std::string("\x0a\x00\x00\x07", 4));
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(OK, client->Resolve("MyHost", ADDRESS_FAMILY_UNSPECIFIED,
+                                &addresses, &ttl, &callback, NULL));
+  EXPECT_EQ("10.0.0.7", NetAddressToString(addresses.head()));
+
+  EXPECT_EQ(OK, client->Resolve("192.168.1.2", ADDRESS_FAMILY_IPV4,
+                                &addresses, &ttl, &callback, NULL));
+  EXPECT_EQ("192.168.1.2", NetAddressToString(addresses.head()));
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED,
+            client->Resolve("192.168.1.2", ADDRESS_FAMILY_IPV6, &addresses,
+                            &ttl, &callback, NULL));
+  EXPECT_EQ(0, server_.queries());
+}
+
+TEST_F(DnsClientTest, Cancel) {
+  config_.nameservers[0] = silent_server_.address();
+  scoped_ptr<DnsClient> client(CreateAsyncDnsClient(config_));
+
+  TestCompletionCallback callback;
+  AddressList addresses;
+  base::TimeDelta ttl;
+  DnsClient::RequestHandle req = NULL;
+  int rv = client->Resolve("host.test", ADDRESS_FAMILY_IPV4, &addresses,
+                           &ttl, &callback, &req);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  client->CancelRequest(req);
+
+  // Destroying the client with a pending request cancels it too.
+  rv = client->Resolve("host.test", ADDRESS_FAMILY_IPV4, &addresses, &ttl,
+                       &callback, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  client.reset();
+  EXPECT_FALSE(callback.have_result());
+}
+
+}  // namespace
+
+}  // namespace net
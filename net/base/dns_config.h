@@ -0,0 +1,65 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_CONFIG_H_
+#define NET_BASE_DNS_CONFIG_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/time.h"
+#include "net/base/address_list.h"
+
+namespace net {
+
+// The configuration of the built-in DNS client (see dns_client.h), as read
+// from /etc/resolv.conf and /etc/hosts.
+struct DnsConfig {
+  // Maps a lowercase hostname to its addresses, in network order (4 bytes for
+  // IPv4 addresses and 16 bytes for IPv6 addresses).
+  typedef std::map<std::string, std::vector<std::string> > HostsMap;
+
+  DnsConfig()
+      : ndots(1),
+        timeout(base::TimeDelta::FromSeconds(5)),
+        attempts(2) {
+  }
+
+  // The name servers to query, in order (each on port 53).
+  std::vector<AddressList> nameservers;
+
+  // The domains that are appended to the names that have less than |ndots|
+  // dots.
+  std::vector<std::string> search;
+  int ndots;
+
+  // How long to wait for the response of a name server, and how many times
+  // to go through the list of name servers.
+  base::TimeDelta timeout;
+  int attempts;
+
+  // The static entries, answered without sending a query.
+  HostsMap hosts;
+};
+
+// Parses the IPv4 or IPv6 literal |text| into |packed|, in network order.
+// Returns false if |text| is not an IP literal.
+bool ParseIPLiteral(const std::string& text, std::string* packed);
+
+// Parses |contents|, in the resolv.conf(5) format, into |config|. The
+// directives that we don't use are ignored. Returns false if |contents| has
+// no valid name server.
+bool ParseResolvConf(const std::string& contents, DnsConfig* config);
+
+// Parses |contents|, in the hosts(5) format, and adds its entries to |hosts|.
+void ParseHosts(const std::string& contents, DnsConfig::HostsMap* hosts);
+
+// Reads /etc/resolv.conf and /etc/hosts into |config|. Returns false if there
+// is no usable name server.
+bool ReadSystemDnsConfig(DnsConfig* config);
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_CONFIG_H_
@@ -0,0 +1,145 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_config.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/string_util.h"
+
+namespace net {
+
+namespace {
+
+const int kDnsPort = 53;
+
+// Bounds of the resolv.conf options, as in resolv.conf(5).
+const int kMaxNdots = 15;
+const int kMaxTimeoutSeconds = 30;
+const int kMaxAttempts = 5;
+
+// Splits |contents| into lines of whitespace separated tokens, without the
+// comments.
+void TokenizeLines(const std::string& contents,
+                   std::vector<std::vector<std::string> >* lines) {
+  std::vector<std::string> raw_lines;
+  SplitString(contents, '\n', &raw_lines);
+  for (size_t i = 0; i < raw_lines.size(); ++i) {
+    std::string line = raw_lines[i];
+    size_t comment = line.find_first_of("#;");
+    if (comment != std::string::npos)
+      line.erase(comment);
+    std::vector<std::string> tokens;
+    SplitStringAlongWhitespace(line, &tokens);
+    if (!tokens.empty())
+      lines->push_back(tokens);
+  }
+}
+
+// Parses the "name:n" option |option| into |*value|, clamped to |max|.
+bool ParseOption(const std::string& option, const char* name, int max,
+                 int* value) {
+  std::string prefix = std::string(name) + ":";
+  if (!StartsWithASCII(option, prefix, true))
+    return false;
+  int parsed;
+  if (StringToInt(option.substr(prefix.size()), &parsed) && parsed >= 0)
+    *value = std::min(parsed, max);
+  return true;
+}
+
+}  // namespace
+
+bool ParseIPLiteral(const std::string& text, std::string* packed) {
+  struct in_addr addr;
+  if (inet_pton(AF_INET, text.c_str(), &addr) == 1) {
+    packed->assign(reinterpret_cast<const char*>(&addr), sizeof(addr));
+    return true;
+  }
+  struct in6_addr addr6;
+  if (inet_pton(AF_INET6, text.c_str(), &addr6) == 1) {
+    packed->assign(reinterpret_cast<const char*>(&addr6), sizeof(addr6));
+    return true;
+  }
+  return false;
+}
+
+bool ParseResolvConf(const std::string& contents, DnsConfig* config) {
+  std::vector<std::vector<std::string> > lines;
+  TokenizeLines(contents, &lines);
+
+  config->nameservers.clear();
+  config->search.clear();
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const std::vector<std::string>& tokens = lines[i];
+    const std::string& keyword = tokens[0];
+    if (keyword == "nameserver") {
+      std::string packed;
+      if (tokens.size() < 2 || !ParseIPLiteral(tokens[1], &packed))
+        continue;
+      config->nameservers.push_back(AddressList::CreateFromIPAddresses(
+          std::vector<std::string>(1, packed), kDnsPort));
+    } else if (keyword == "search" || keyword == "domain") {
+      // The last of the "search" and "domain" directives wins.
+      config->search.assign(tokens.begin() + 1, tokens.end());
+      if (keyword == "domain" && config->search.size() > 1)
+        config->search.resize(1);
+    } else if (keyword == "options") {
+      for (size_t j = 1; j < tokens.size(); ++j) {
+        int seconds = static_cast<int>(config->timeout.InSeconds());
+        if (ParseOption(tokens[j], "timeout", kMaxTimeoutSeconds, &seconds)) {
+          config->timeout = base::TimeDelta::FromSeconds(std::max(seconds, 1));
+          continue;
+        }
+        if (ParseOption(tokens[j], "attempts", kMaxAttempts,
+                        &config->attempts)) {
+          config->attempts = std::max(config->attempts, 1);
+          continue;
+        }
+        ParseOption(tokens[j], "ndots", kMaxNdots, &config->ndots);
+      }
+    }
+  }
+  return !config->nameservers.empty();
+}
+
+void ParseHosts(const std::string& contents, DnsConfig::HostsMap* hosts) {
+  std::vector<std::vector<std::string> > lines;
+  TokenizeLines(contents, &lines);
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const std::vector<std::string>& tokens = lines[i];
+    std::string packed;
+    if (tokens.size() < 2 || !ParseIPLiteral(tokens[0], &packed))
+      continue;
+    for (size_t j = 1; j < tokens.size(); ++j) {
+      std::vector<std::string>& addresses = (*hosts)[StringToLowerASCII(
+          tokens[j])];
+      if (std::find(addresses.begin(), addresses.end(), packed) ==
+          addresses.end()) {
+        addresses.push_back(packed);
+      }
+    }
+  }
+}
+
+bool ReadSystemDnsConfig(DnsConfig* config) {
+  std::string contents;
+  if (!file_util::ReadFileToString(FilePath("/etc/resolv.conf"), &contents) ||
+      !ParseResolvConf(contents, config)) {
+    return false;
+  }
+
+  config->hosts.clear();
+  if (file_util::ReadFileToString(FilePath("/etc/hosts"), &contents))
+    ParseHosts(contents, &config->hosts);
+  return true;
+}
+
+}  // namespace net
@@ -0,0 +1,67 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_config.h"
+
+#include "net/base/net_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+TEST(DnsConfigTest, ParseResolvConf) {
+  const char kResolvConf[] =
+      "# Generated by NetworkManager\n"
+      "domain ignored.example\n"
+      "search corp.example example.com  ; comment\n"
+      "nameserver 10.0.0.1\n"
+      "nameserver bogus\n"
+      "nameserver ::1\n"
+      "options rotate ndots:2 timeout:3 attempts:9\n";
+
+  DnsConfig config;
+  ASSERT_TRUE(ParseResolvConf(kResolvConf, &config));
+
+  ASSERT_EQ(2u, config.nameservers.size());
+  EXPECT_EQ("10.0.0.1", NetAddressToString(config.nameservers[0].head()));
+  EXPECT_EQ(53, config.nameservers[0].GetPort());
+  EXPECT_EQ("::1", NetAddressToString(config.nameservers[1].head()));
+
+  ASSERT_EQ(2u, config.search.size());
+  EXPECT_EQ("corp.example", config.search[0]);
+  EXPECT_EQ("example.com", config.search[1]);
+
+  EXPECT_EQ(2, config.ndots);
+  EXPECT_EQ(3, config.timeout.InSeconds());
+  EXPECT_EQ(5, config.attempts);  // Clamped.
+
+  // Without name server.
+  EXPECT_FALSE(ParseResolvConf("search example.com\n", &config));
+}
+
+TEST(DnsConfigTest, ParseHosts) {
+  const char kHosts[] =
+      "127.0.0.1   localhost\n"
+      "::1         localhost ip6-localhost  # comment\n"
+      "# 10.0.0.9  commented.out\n"
+      "10.0.0.1    Host.Example host\n"
+      "10.0.0.2    host\n"
+      "10.0.0.2    host\n"
+      "not-an-ip   broken\n";
+
+  DnsConfig::HostsMap hosts;
+  ParseHosts(kHosts, &hosts);
+
+  EXPECT_EQ(4u, hosts.size());
+  ASSERT_EQ(2u, hosts["localhost"].size());
+  EXPECT_EQ(std::string("\x7f\x00\x00\x01", 4), hosts["localhost"][0]);
+  EXPECT_EQ(16u, hosts["localhost"][1].size());
+  EXPECT_EQ(1u, hosts["ip6-localhost"].size());
+  EXPECT_EQ(1u, hosts["host.example"].size());
+  ASSERT_EQ(2u, hosts["host"].size());
+  EXPECT_EQ(std::string("\x0a\x00\x00\x02", 4), hosts["host"][1]);
+  EXPECT_TRUE(hosts.find("commented.out") == hosts.end());
+  EXPECT_TRUE(hosts.find("broken") == hosts.end());
+}
+
+}  // namespace net
@@ -0,0 +1,254 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_message.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "net/base/dns_util.h"
+
+namespace net {
+
+namespace {
+
+const size_t kHeaderSize = 12;
+
+// Flags of the header.
+const uint16 kFlagResponse = 0x8000;
+const uint16 kFlagTruncated = 0x0200;
+const uint16 kFlagRecursionDesired = 0x0100;
+const uint16 kRcodeMask = 0x000f;
+
+const uint16 kClassIN = 1;
+
+// Bound on the length of the CNAME chains we follow.
+const int kMaxCnameChain = 8;
+
+void AppendU16(uint16 value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xff));
+}
+
+// Reads the fields of a DNS message.
+class DnsReader {
+ public:
+  DnsReader(const char* data, size_t length)
+      : data_(reinterpret_cast<const uint8*>(data)),
+        length_(length),
+        offset_(0) {
+  }
+
+  size_t offset() const { return offset_; }
+
+  bool Skip(size_t count) {
+    if (length_ - offset_ < count)
+      return false;
+    offset_ += count;
+    return true;
+  }
+
+  bool ReadU16(uint16* value) {
+    if (length_ - offset_ < 2)
+      return false;
+    *value = (data_[offset_] << 8) | data_[offset_ + 1];
+    offset_ += 2;
+    return true;
+  }
+
+  bool ReadU32(uint32* value) {
+    uint16 high, low;
+    if (!ReadU16(&high) || !ReadU16(&low))
+      return false;
+    *value = (static_cast<uint32>(high) << 16) | low;
+    return true;
+  }
+
+  bool ReadBytes(size_t count, std::string* out) {
+    if (length_ - offset_ < count)
+      return false;
+    out->assign(reinterpret_cast<const char*>(data_ + offset_), count);
+    offset_ += count;
+    return true;
+  }
+
+  // Reads a possibly compressed name, in lowercase dotted form.
+  bool ReadName(std::string* dotted) {
+    dotted->clear();
+    size_t pos = offset_;
+    bool jumped = false;
+    // Each jump must go backwards, which bounds the number of jumps.
+    size_t limit = length_;
+    for (;;) {
+      if (pos >= length_)
+        return false;
+      uint8 label_length = data_[pos];
+      if ((label_length & 0xc0) == 0xc0) {
+        if (pos + 1 >= length_)
+          return false;
+        size_t target = ((label_length & 0x3f) << 8) | data_[pos + 1];
+        if (!jumped)
+          offset_ = pos + 2;
+        jumped = true;
+        if (target >= limit)
+          return false;
+        limit = target;
+        pos = target;
+        continue;
+      }
+      if (label_length & 0xc0)
+        return false;  // Reserved label types.
+      ++pos;
+      if (!label_length)
+        break;
+      if (length_ - pos < label_length)
+        return false;
+      if (!dotted->empty())
+        dotted->push_back('.');
+      dotted->append(reinterpret_cast<const char*>(data_ + pos),
+                     label_length);
+      pos += label_length;
+    }
+    if (!jumped)
+      offset_ = pos;
+    StringToLowerASCII(dotted);
+    return true;
+  }
+
+ private:
+  const uint8* data_;
+  size_t length_;
+  size_t offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsReader);
+};
+
+struct Record {
+  uint16 type;
+  uint32 ttl;
+  std::string rdata;  // For CNAME records, the dotted target name.
+};
+
+}  // namespace
+
+bool BuildDnsQuery(uint16 id, const std::string& hostname, uint16 qtype,
+                   std::string* query) {
+  std::string qname;
+  if (!DNSDomainFromDot(hostname, &qname) || qname.empty())
+    return false;
+
+  query->clear();
+  AppendU16(id, query);
+  AppendU16(kFlagRecursionDesired, query);
+  AppendU16(1, query);  // QDCOUNT
+  AppendU16(0, query);  // ANCOUNT
+  AppendU16(0, query);  // NSCOUNT
+  AppendU16(0, query);  // ARCOUNT
+  query->append(qname);
+  query->push_back('\0');  // DNSDomainFromDot() drops the root label.
+  AppendU16(qtype, query);
+  AppendU16(kClassIN, query);
+  return true;
+}
+
+bool ParseDnsResponse(const char* data, size_t length,
+                      const std::string& query, uint16 qtype,
+                      DnsResponse* response) {
+  DCHECK_GT(query.size(), kHeaderSize);
+  DnsReader reader(data, length);
+
+  uint16 id, flags, qdcount, ancount;
+  if (!reader.ReadU16(&id) || !reader.ReadU16(&flags) ||
+      !reader.ReadU16(&qdcount) || !reader.ReadU16(&ancount) ||
+      !reader.Skip(4)) {
+    return false;
+  }
+  uint16 query_id = (static_cast<uint8>(query[0]) << 8) |
+                    static_cast<uint8>(query[1]);
+  if (id != query_id || !(flags & kFlagResponse))
+    return false;
+
+  response->rcode = flags & kRcodeMask;
+  response->truncated = (flags & kFlagTruncated) != 0;
+  response->addresses.clear();
+  response->ttl = base::TimeDelta();
+
+  // The question must be the one we asked.
+  size_t question_size = query.size() - kHeaderSize;
+  if (qdcount != 1 || length - kHeaderSize < question_size ||
+      memcmp(data + kHeaderSize, query.data() + kHeaderSize, question_size)) {
+    return false;
+  }
+  reader.Skip(question_size);
+  DnsReader question_reader(query.data(), query.size());
+  question_reader.Skip(kHeaderSize);
+  std::string name;
+  question_reader.ReadName(&name);
+
+  // A truncated response is retried over TCP, don't bother parsing it.
+  if (response->truncated || response->rcode != DNS_RCODE_NOERROR)
+    return true;
+
+  std::multimap<std::string, Record> records;
+  for (int i = 0; i < ancount; ++i) {
+    std::string owner;
+    uint16 type, rclass, rdlength;
+    Record record;
+    if (!reader.ReadName(&owner) || !reader.ReadU16(&type) ||
+        !reader.ReadU16(&rclass) || !reader.ReadU32(&record.ttl) ||
+        !reader.ReadU16(&rdlength)) {
+      return false;
+    }
+    record.type = type;
+    size_t rdata_end = reader.offset() + rdlength;
+    if (rclass != kClassIN) {
+      if (!reader.Skip(rdlength))
+        return false;
+      continue;
+    }
+    if (type == DNS_TYPE_CNAME) {
+      if (!reader.ReadName(&record.rdata) || reader.offset() != rdata_end)
+        return false;
+    } else if (type == qtype) {
+      size_t expected = qtype == DNS_TYPE_A ? 4 : 16;
+      if (rdlength != expected || !reader.ReadBytes(rdlength, &record.rdata))
+        return false;
+    } else {
+      if (!reader.Skip(rdlength))
+        return false;
+      continue;
+    }
+    records.insert(std::make_pair(owner, record));
+  }
+
+  // Follow the CNAME chain from the name we asked for.
+  uint32 ttl = kuint32max;
+  for (int i = 0; i < kMaxCnameChain; ++i) {
+    typedef std::multimap<std::string, Record>::const_iterator Iterator;
+    std::pair<Iterator, Iterator> range = records.equal_range(name);
+    std::string cname;
+    for (Iterator it = range.first; it != range.second; ++it) {
+      if (it->second.type == DNS_TYPE_CNAME) {
+        cname = it->second.rdata;
+        ttl = std::min(ttl, it->second.ttl);
+      } else {
+        response->addresses.push_back(it->second.rdata);
+        ttl = std::min(ttl, it->second.ttl);
+      }
+    }
+    if (!response->addresses.empty() || cname.empty())
+      break;
+    name = cname;
+  }
+
+  if (!response->addresses.empty())
+    response->ttl = base::TimeDelta::FromSeconds(ttl);
+  return true;
+}
+
+}  // namespace net
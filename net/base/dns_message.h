@@ -0,0 +1,63 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Builds DNS queries and parses the responses (RFC 1035), for the built-in
+// DNS client (see dns_client.h).
+
+#ifndef NET_BASE_DNS_MESSAGE_H_
+#define NET_BASE_DNS_MESSAGE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+
+namespace net {
+
+// The query types that we use.
+enum DnsQueryType {
+  DNS_TYPE_A = 1,
+  DNS_TYPE_CNAME = 5,
+  DNS_TYPE_AAAA = 28,
+};
+
+// The response codes that we care about.
+enum DnsResponseCode {
+  DNS_RCODE_NOERROR = 0,
+  DNS_RCODE_SERVFAIL = 2,
+  DNS_RCODE_NXDOMAIN = 3,
+};
+
+// Builds a recursive query for the records of type |qtype| of |hostname|.
+// Returns false if |hostname| is not a valid DNS name.
+bool BuildDnsQuery(uint16 id, const std::string& hostname, uint16 qtype,
+                   std::string* query);
+
+// The interesting parts of a response.
+struct DnsResponse {
+  DnsResponse() : rcode(0), truncated(false) {}
+
+  int rcode;
+  bool truncated;
+
+  // The addresses found in the answer section, in network order (4 bytes for
+  // A records, 16 bytes for AAAA records).
+  std::vector<std::string> addresses;
+
+  // The lowest TTL of the records that led to |addresses|.
+  base::TimeDelta ttl;
+};
+
+// Parses the |length| bytes of |data|, a response to |query|. Returns false
+// if the data is not a valid response to |query|, which should then be
+// ignored. The addresses of type |qtype| of the answer section are returned,
+// following the CNAME records of the answer section.
+bool ParseDnsResponse(const char* data, size_t length,
+                      const std::string& query, uint16 qtype,
+                      DnsResponse* response);
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_MESSAGE_H_
@@ -0,0 +1,129 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_message.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The query for the A records of "www.example.com", with id 0xbeef.
+const char kQuery[] =
+    "\xbe\xef\x01\x00\x00\x01\x00\x00\x00\x00\x00\x00"
+    "\x03www\x07" "example\x03" "com\x00"
+    "\x00\x01\x00\x01";
+
+// A response to |kQuery|: www.example.com is a CNAME (TTL 300) for
+// web.example.com (using a compressed name), which has two A records with
+// TTLs 100 and 200, plus an unrelated A record.
+const char kResponse[] =
+    "\xbe\xef\x81\x80\x00\x01\x00\x04\x00\x00\x00\x00"
+    "\x03www\x07" "example\x03" "com\x00"
+    "\x00\x01\x00\x01"
+    // www.example.com CNAME web.example.com
+    "\xc0\x0c\x00\x05\x00\x01\x00\x00\x01\x2c\x00\x06"
+    "\x03web\xc0\x10"
+    // web.example.com A 10.0.0.1
+    "\xc0\x2d\x00\x01\x00\x01\x00\x00\x00\x64\x00\x04"
+    "\x0a\x00\x00\x01"
+    // web.example.com A 10.0.0.2
+    "\xc0\x2d\x00\x01\x00\x01\x00\x00\x00\xc8\x00\x04"
+    "\x0a\x00\x00\x02"
+    // other.example.com A 10.0.0.3
+    "\x05other\xc0\x10\x00\x01\x00\x01\x00\x00\x00\x01\x00\x04"
+    "\x0a\x00\x00\x03";
+
+std::string Query() {
+  return std::string(kQuery, sizeof(kQuery) - 1);
+}
+
+}  // namespace
+
+TEST(DnsMessageTest, BuildQuery) {
+  std::string query;
+  EXPECT_TRUE(BuildDnsQuery(0xbeef, "www.example.com", DNS_TYPE_A, &query));
+  EXPECT_EQ(Query(), query);
+
+  EXPECT_FALSE(BuildDnsQuery(0xbeef, "", DNS_TYPE_A, &query));
+  EXPECT_FALSE(BuildDnsQuery(
+      0xbeef,
+      "a123456789a123456789a123456789a123456789a123456789a123456789a1234.com",
+      DNS_TYPE_A, &query));
+}
+
+TEST(DnsMessageTest, ParseResponse) {
+  DnsResponse response;
+  ASSERT_TRUE(ParseDnsResponse(kResponse, sizeof(kResponse) - 1, Query(),
+                               DNS_TYPE_A, &response));
+  EXPECT_EQ(DNS_RCODE_NOERROR, response.rcode);
+  EXPECT_FALSE(response.truncated);
+  ASSERT_EQ(2u, response.addresses.size());
+  EXPECT_EQ(std::string("\x0a\x00\x00\x01", 4), response.addresses[0]);
+  EXPECT_EQ(std::string("\x0a\x00\x00\x02", 4), response.addresses[1]);
+  EXPECT_EQ(100, response.ttl.InSeconds());
+
+  // No AAAA record.
+  ASSERT_TRUE(ParseDnsResponse(kResponse, sizeof(kResponse) - 1, Query(),
+                               DNS_TYPE_AAAA, &response));
+  EXPECT_TRUE(response.addresses.empty());
+}
+
+TEST(DnsMessageTest, ParseBadResponse) {
+  std::string response(kResponse, sizeof(kResponse) - 1);
+  DnsResponse parsed;
+
+  // Truncated data.
+  for (size_t length = 0; length < 12 + 21; ++length) {
+    EXPECT_FALSE(ParseDnsResponse(response.data(), length, Query(),
+                                  DNS_TYPE_A, &parsed));
+  }
+  EXPECT_FALSE(ParseDnsResponse(response.data(), response.size() - 1,
+                                Query(), DNS_TYPE_A, &parsed));
+
+  // Wrong id.
+  std::string bad = response;
+  bad[1] = '\x00';
+  EXPECT_FALSE(ParseDnsResponse(bad.data(), bad.size(), Query(), DNS_TYPE_A,
+                                &parsed));
+
+  // Not a response.
+  bad = response;
+  bad[2] = '\x01';
+  EXPECT_FALSE(ParseDnsResponse(bad.data(), bad.size(), Query(), DNS_TYPE_A,
+                                &parsed));
+
+  // Another question.
+  bad = response;
+  bad[13] = 'x';
+  EXPECT_FALSE(ParseDnsResponse(bad.data(), bad.size(), Query(), DNS_TYPE_A,
+                                &parsed));
+
+  // A compression pointer that loops.
+  bad = response;
+  bad[50] = '\x2d';
+  EXPECT_FALSE(ParseDnsResponse(bad.data(), bad.size(), Query(), DNS_TYPE_A,
+                                &parsed));
+}
+
+TEST(DnsMessageTest, ParseNxdomainAndTruncated) {
+  std::string response(kResponse, 12 + 21);
+  response[3] = '\x83';  // NXDOMAIN
+  response[7] = '\x00';  // No answer.
+  DnsResponse parsed;
+  ASSERT_TRUE(ParseDnsResponse(response.data(), response.size(), Query(),
+                               DNS_TYPE_A, &parsed));
+  EXPECT_EQ(DNS_RCODE_NXDOMAIN, parsed.rcode);
+  EXPECT_TRUE(parsed.addresses.empty());
+
+  response = std::string(kResponse, sizeof(kResponse) - 1);
+  response[2] = '\x83';  // TC
+  ASSERT_TRUE(ParseDnsResponse(response.data(), response.size(), Query(),
+                               DNS_TYPE_A, &parsed));
+  EXPECT_TRUE(parsed.truncated);
+  EXPECT_TRUE(parsed.addresses.empty());
+}
+
+}  // namespace net
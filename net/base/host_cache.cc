@@ -34,49 +34,85 @@ HostCache::~HostCache() {
 }
 
 const HostCache::Entry* HostCache::Lookup(const Key& key,
-                                          base::TimeTicks now) const {
+                                          base::TimeTicks now) {
   if (caching_is_disabled())
     return NULL;
 
-  EntryMap::const_iterator it = entries_.find(key);
+  EntryMap::iterator it = entries_.find(key);
   if (it == entries_.end())
     return NULL;  // Not found.
 
-  Entry* entry = it->second.get();
-  if (CanUseEntry(entry, now))
-    return entry;
+  Entry* entry = &it->second;
+  if (!CanUseEntry(entry, now))
+    return NULL;
 
-  return NULL;
+  MoveToFront(entry);
+  return entry;
+}
+
+const HostCache::Entry* HostCache::LookupStale(const Key& key,
+                                               base::TimeTicks now,
+                                               bool* is_stale) {
+  *is_stale = false;
+  if (caching_is_disabled())
+    return NULL;
+
+  EntryMap::iterator it = entries_.find(key);
+  if (it == entries_.end())
+    return NULL;  // Not found.
+
+  Entry* entry = &it->second;
+  if (!CanUseEntry(entry, now)) {
+    // Failures are never served stale.
+    if (entry->error != OK || entry->expiration + max_stale_ <= now)
+      return NULL;
+    *is_stale = true;
+  }
+
+  MoveToFront(entry);
+  return entry;
 }
 
 HostCache::Entry* HostCache::Set(const Key& key,
                                  int error,
                                  const AddressList addrlist,
                                  base::TimeTicks now) {
+  return Set(key, error, addrlist, now,
+             error == OK ? success_entry_ttl_ : failure_entry_ttl_);
+}
+
+HostCache::Entry* HostCache::Set(const Key& key,
+                                 int error,
+                                 const AddressList addrlist,
+                                 base::TimeTicks now,
+                                 base::TimeDelta ttl) {
   if (caching_is_disabled())
     return NULL;
 
-  base::TimeTicks expiration = now +
-      (error == OK ? success_entry_ttl_ : failure_entry_ttl_);
-
-  scoped_refptr<Entry>& entry = entries_[key];
-  if (!entry) {
-    // Entry didn't exist, creating one now.
-    Entry* ptr = new Entry(error, addrlist, expiration);
-    entry = ptr;
-
-    // Compact the cache if we grew it beyond limit -- exclude |entry| from
-    // being pruned though!
-    if (entries_.size() > max_entries_)
-      Compact(now, ptr);
-    return ptr;
-  } else {
+  base::TimeTicks expiration = now + ttl;
+
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
     // Update an existing cache entry.
+    Entry* entry = &it->second;
     entry->error = error;
     entry->addrlist = addrlist;
     entry->expiration = expiration;
-    return entry.get();
+    MoveToFront(entry);
+    return entry;
   }
+
+  // Entry didn't exist, creating one now.
+  it = entries_.insert(
+      std::make_pair(key, Entry(error, addrlist, expiration))).first;
+  lru_list_.push_front(&it->first);
+  it->second.lru_position = lru_list_.begin();
+
+  // Compact the cache if we grew it beyond limit -- the new entry is the most
+  // recently used one, so it is not pruned.
+  if (entries_.size() > max_entries_)
+    Compact();
+  return &it->second;
 }
 
 // static
@@ -84,36 +120,16 @@ bool HostCache::CanUseEntry(const Entry* entry, const base::TimeTicks now) {
   return entry->expiration > now;
 }
 
-void HostCache::Compact(base::TimeTicks now, const Entry* pinned_entry) {
-  // Clear out expired entries.
-  for (EntryMap::iterator it = entries_.begin(); it != entries_.end(); ) {
-    Entry* entry = (it->second).get();
-    if (entry != pinned_entry && !CanUseEntry(entry, now)) {
-      entries_.erase(it++);
-    } else {
-      ++it;
-    }
-  }
+void HostCache::MoveToFront(Entry* entry) {
+  lru_list_.splice(lru_list_.begin(), lru_list_, entry->lru_position);
+}
 
-  if (entries_.size() <= max_entries_)
-    return;
-
-  // If we still have too many entries, start removing unexpired entries
-  // at random.
-  // TODO(eroman): this eviction policy could be better (access count FIFO
-  // or whatever).
-  for (EntryMap::iterator it = entries_.begin();
-       it != entries_.end() && entries_.size() > max_entries_; ) {
-    Entry* entry = (it->second).get();
-    if (entry != pinned_entry) {
-      entries_.erase(it++);
-    } else {
-      ++it;
-    }
+void HostCache::Compact() {
+  while (entries_.size() > max_entries_) {
+    EntryMap::iterator it = entries_.find(*lru_list_.back());
+    lru_list_.pop_back();
+    entries_.erase(it);
   }
-
-  if (entries_.size() > max_entries_)
-    DLOG(WARNING) << "Still above max entries limit";
 }
 
 }  // namespace net
@@ -5,10 +5,10 @@
 #ifndef NET_BASE_HOST_CACHE_H_
 #define NET_BASE_HOST_CACHE_H_
 
+#include <list>
 #include <map>
 #include <string>
 
-#include "base/ref_counted.h"
 #include "base/time.h"
 #include "net/base/address_family.h"
 #include "net/base/address_list.h"
@@ -17,25 +17,12 @@
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
+//
+// When the cache is full, the least recently used entry is evicted.  Expired
+// entries can still be returned by LookupStale() for a while (see
+// set_max_stale()), so that the caller can use them while it refreshes them.
 class HostCache {
  public:
-  // Stores the latest address list that was looked up for a hostname.
-  struct Entry : public base::RefCounted<Entry> {
-    Entry(int error, const AddressList& addrlist, base::TimeTicks expiration);
-
-    // The resolve results for this entry.
-    int error;
-    AddressList addrlist;
-
-    // The time when this entry expires.
-    base::TimeTicks expiration;
-
-   private:
-    friend class base::RefCounted<Entry>;
-
-    ~Entry();
-  };
-
   struct Key {
     Key(const std::string& hostname, AddressFamily address_family)
         : hostname(hostname), address_family(address_family) {}
@@ -55,7 +42,30 @@ class HostCache {
     AddressFamily address_family;
   };
 
-  typedef std::map<Key, scoped_refptr<Entry> > EntryMap;
+  // The keys of the entries, from the most recently used to the least
+  // recently used.
+  typedef std::list<const Key*> KeyList;
+
+  // Stores the latest address list that was looked up for a hostname.
+  struct Entry {
+    Entry(int error, const AddressList& addrlist, base::TimeTicks expiration);
+    ~Entry();
+
+    // The resolve results for this entry.
+    int error;
+    AddressList addrlist;
+
+    // The time when this entry expires.
+    base::TimeTicks expiration;
+
+   private:
+    friend class HostCache;
+
+    // The position of this entry in |HostCache::lru_list_|.
+    KeyList::iterator lru_position;
+  };
+
+  typedef std::map<Key, Entry> EntryMap;
 
   // Constructs a HostCache that caches successful host resolves for
   // |success_entry_ttl| time, and failed host resolves for
@@ -68,7 +78,12 @@ class HostCache {
 
   // Returns a pointer to the entry for |key|, which is valid at time
   // |now|. If there is no such entry, returns NULL.
-  const Entry* Lookup(const Key& key, base::TimeTicks now) const;
+  const Entry* Lookup(const Key& key, base::TimeTicks now);
+
+  // Same as Lookup(), but also returns a successful entry that expired less
+  // than max_stale() before |now|, in which case |*is_stale| is set to true.
+  const Entry* LookupStale(const Key& key, base::TimeTicks now,
+                           bool* is_stale);
 
   // Overwrites or creates an entry for |key|. Returns the pointer to the
   // entry, or NULL on failure (fails if caching is disabled).
@@ -79,6 +94,14 @@ class HostCache {
              const AddressList addrlist,
              base::TimeTicks now);
 
+  // Same as Set(), but the entry expires after |ttl| rather than after the
+  // default TTL (for example the TTL of the DNS records of |addrlist|).
+  Entry* Set(const Key& key,
+             int error,
+             const AddressList addrlist,
+             base::TimeTicks now,
+             base::TimeDelta ttl);
+
   // Returns true if this HostCache can contain no entries.
   bool caching_is_disabled() const {
     return max_entries_ == 0;
@@ -101,6 +124,16 @@ class HostCache {
     return failure_entry_ttl_;
   }
 
+  // How long after their expiration the successful entries can be returned by
+  // LookupStale().  Zero (the default) disables stale entries.
+  base::TimeDelta max_stale() const {
+    return max_stale_;
+  }
+
+  void set_max_stale(base::TimeDelta max_stale) {
+    max_stale_ = max_stale;
+  }
+
   // Note that this map may contain expired entries.
   const EntryMap& entries() const {
     return entries_;
@@ -113,9 +146,12 @@ class HostCache {
   // Returns true if this cache entry's result is valid at time |now|.
   static bool CanUseEntry(const Entry* entry, const base::TimeTicks now);
 
-  // Prunes entries from the cache to bring it below max entry bound. Entries
-  // matching |pinned_entry| will NOT be pruned.
-  void Compact(base::TimeTicks now, const Entry* pinned_entry);
+  // Marks |entry| as the most recently used one.
+  void MoveToFront(Entry* entry);
+
+  // Removes the least recently used entries, until the cache is below its max
+  // entry bound.
+  void Compact();
 
   // Bound on total size of the cache.
   size_t max_entries_;
@@ -124,10 +160,15 @@ class HostCache {
   base::TimeDelta success_entry_ttl_;
   base::TimeDelta failure_entry_ttl_;
 
+  base::TimeDelta max_stale_;
+
   // Map from hostname (presumably in lowercase canonicalized format) to
   // a resolved result entry.
   EntryMap entries_;
 
+  // The keys of |entries_|, in LRU order.
+  KeyList lru_list_;
+
   DISALLOW_COPY_AND_ASSIGN(HostCache);
 };
 
@@ -176,61 +176,69 @@ TEST(HostCacheTest, Compact) {
   // t=10
   base::TimeTicks now = base::TimeTicks() + base::TimeDelta::FromSeconds(10);
 
-  // Add five valid entries at t=10.
-  for (int i = 0; i < 5; ++i) {
-    std::string hostname = StringPrintf("valid%d", i);
+  // Add ten valid entries at t=10.
+  for (int i = 0; i < 10; ++i) {
+    std::string hostname = StringPrintf("host%d", i);
     cache.Set(Key(hostname), OK, AddressList(), now);
   }
-  EXPECT_EQ(5U, cache.size());
-
-  // Add 3 expired entries at t=0.
-  for (int i = 0; i < 3; ++i) {
-    std::string hostname = StringPrintf("expired%d", i);
-    base::TimeTicks t = now - base::TimeDelta::FromSeconds(10);
-    cache.Set(Key(hostname), OK, AddressList(), t);
-  }
-  EXPECT_EQ(8U, cache.size());
+  EXPECT_EQ(10U, cache.size());
 
-  // Add 2 negative entries at t=10
-  for (int i = 0; i < 2; ++i) {
-    std::string hostname = StringPrintf("negative%d", i);
-    cache.Set(Key(hostname), ERR_NAME_NOT_RESOLVED, AddressList(), now);
+  // Use the first five entries again.
+  for (int i = 0; i < 5; ++i) {
+    std::string hostname = StringPrintf("host%d", i);
+    EXPECT_FALSE(cache.Lookup(Key(hostname), now) == NULL);
   }
-  EXPECT_EQ(10U, cache.size());
 
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid0")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid1")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid2")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid3")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid4")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("expired0")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("expired1")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("expired2")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("negative0")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("negative1")));
-
-  // Shrink the max constraints bound and compact. We expect the "negative"
-  // and "expired" entries to have been dropped.
+  // Shrink the max constraints bound and compact. We expect the least recently
+  // used entries to have been dropped.
   cache.max_entries_ = 5;
-  cache.Compact(now, NULL);
+  cache.Compact();
   EXPECT_EQ(5U, cache.entries_.size());
 
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid0")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid1")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid2")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid3")));
-  EXPECT_TRUE(ContainsKey(cache.entries_, Key("valid4")));
-  EXPECT_FALSE(ContainsKey(cache.entries_, Key("expired0")));
-  EXPECT_FALSE(ContainsKey(cache.entries_, Key("expired1")));
-  EXPECT_FALSE(ContainsKey(cache.entries_, Key("expired2")));
-  EXPECT_FALSE(ContainsKey(cache.entries_, Key("negative0")));
-  EXPECT_FALSE(ContainsKey(cache.entries_, Key("negative1")));
-
-  // Shrink further -- this time the compact will start dropping valid entries
-  // to make space.
+  for (int i = 0; i < 10; ++i) {
+    std::string hostname = StringPrintf("host%d", i);
+    EXPECT_EQ(i < 5, ContainsKey(cache.entries_, Key(hostname)));
+  }
+
+  // Shrink further -- this time host0 and host1 are dropped.
   cache.max_entries_ = 3;
-  cache.Compact(now, NULL);
+  cache.Compact();
   EXPECT_EQ(3U, cache.size());
+  EXPECT_FALSE(ContainsKey(cache.entries_, Key("host0")));
+  EXPECT_FALSE(ContainsKey(cache.entries_, Key("host1")));
+  EXPECT_TRUE(ContainsKey(cache.entries_, Key("host4")));
+}
+
+// Successful entries can be used for max_stale() after they expire.
+TEST(HostCacheTest, LookupStale) {
+  HostCache cache(kMaxCacheEntries, kSuccessEntryTTL,
+                  base::TimeDelta::FromSeconds(10));
+  cache.set_max_stale(base::TimeDelta::FromSeconds(5));
+
+  // t=0.
+  base::TimeTicks now;
+  bool is_stale;
+
+  cache.Set(Key("foobar.com"), OK, AddressList(), now);
+  cache.Set(Key("failure.com"), ERR_NAME_NOT_RESOLVED, AddressList(), now);
+  EXPECT_FALSE(cache.LookupStale(Key("foobar.com"), now, &is_stale) == NULL);
+  EXPECT_FALSE(is_stale);
+
+  // Advance to t=12; both entries are expired.
+  now += base::TimeDelta::FromSeconds(12);
+  EXPECT_TRUE(cache.Lookup(Key("foobar.com"), now) == NULL);
+  EXPECT_FALSE(cache.LookupStale(Key("foobar.com"), now, &is_stale) == NULL);
+  EXPECT_TRUE(is_stale);
+  EXPECT_TRUE(cache.LookupStale(Key("failure.com"), now, &is_stale) == NULL);
+
+  // Advance to t=15; the entry is too old.
+  now += base::TimeDelta::FromSeconds(3);
+  EXPECT_TRUE(cache.LookupStale(Key("foobar.com"), now, &is_stale) == NULL);
+
+  // Refreshing the entry makes it fresh again.
+  cache.Set(Key("foobar.com"), OK, AddressList(), now);
+  EXPECT_FALSE(cache.LookupStale(Key("foobar.com"), now, &is_stale) == NULL);
+  EXPECT_FALSE(is_stale);
 }
 
 // Add entries while the cache is at capacity, causing evictions.
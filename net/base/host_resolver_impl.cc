@@ -130,7 +130,7 @@ class HostResolverImpl::Request {
 //-----------------------------------------------------------------------------
 
 // This class represents a request to the worker pool for a "getaddrinfo()"
-// call.
+// call, or to the DNS client when the resolver has one.
 class HostResolverImpl::Job
     : public base::RefCountedThreadSafe<HostResolverImpl::Job> {
  public:
@@ -139,6 +139,10 @@ class HostResolverImpl::Job
         resolver_(resolver),
         origin_loop_(MessageLoop::current()),
         resolver_proc_(resolver->effective_resolver_proc()),
+        dns_client_(resolver->dns_client_.get()),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            dns_callback_(this, &Job::OnDnsComplete)),
+        dns_request_(NULL),
         error_(OK) {
   }
 
@@ -151,6 +155,20 @@ class HostResolverImpl::Job
 
   // Called from origin loop.
   void Start() {
+    if (dns_client_) {
+      int rv = dns_client_->Resolve(key_.hostname, key_.address_family,
+                                    &results_, &ttl_, &dns_callback_,
+                                    &dns_request_);
+      if (rv != ERR_IO_PENDING) {
+        // As below, we can't complete from within Resolve().
+        dns_request_ = NULL;
+        error_ = rv;
+        MessageLoop::current()->PostTask(
+            FROM_HERE, NewRunnableMethod(this, &Job::OnLookupComplete));
+      }
+      return;
+    }
+
     // Dispatch the job to a worker thread.
     if (!WorkerPool::PostTask(FROM_HERE,
             NewRunnableMethod(this, &Job::DoLookup), true)) {
@@ -177,6 +195,11 @@ class HostResolverImpl::Job
       origin_loop_ = NULL;
     }
 
+    if (dns_request_) {
+      dns_client_->CancelRequest(dns_request_);
+      dns_request_ = NULL;
+    }
+
     // We will call HostResolverImpl::CancelRequest(Request*) on each one
     // in order to notify any observers.
     for (RequestsList::const_iterator it = requests_.begin();
@@ -233,6 +256,13 @@ class HostResolverImpl::Job
     delete reply;
   }
 
+  // Callback for when the DNS client completes (runs on origin thread).
+  void OnDnsComplete(int result) {
+    dns_request_ = NULL;
+    error_ = result;
+    OnLookupComplete();
+  }
+
   // Callback for when DoLookup() completes (runs on origin thread).
   void OnLookupComplete() {
     // Should be running on origin loop.
@@ -244,13 +274,12 @@ class HostResolverImpl::Job
     if (was_cancelled())
       return;
 
-    DCHECK(!requests_.empty());
-
-     // Use the port number of the first request.
-    if (error_ == OK)
+    // Use the port number of the first request.  A job that refreshes a
+    // cache entry may have no request at all.
+    if (error_ == OK && !requests_.empty())
       results_.SetPort(requests_[0]->port());
 
-    resolver_->OnJobComplete(this, error_, results_);
+    resolver_->OnJobComplete(this, error_, results_, ttl_);
   }
 
   // Set on the origin thread, read on the worker thread.
@@ -270,9 +299,16 @@ class HostResolverImpl::Job
   // reference ensures that it remains valid until we are done.
   scoped_refptr<HostResolverProc> resolver_proc_;
 
+  // The DNS client to use instead of |resolver_proc_|, if not NULL. Only used
+  // on the origin thread.
+  DnsClient* dns_client_;
+  CompletionCallbackImpl<Job> dns_callback_;
+  DnsClient::RequestHandle dns_request_;
+
   // Assigned on the worker thread, read on the origin thread.
   int error_;
   AddressList results_;
+  base::TimeDelta ttl_;  // Set by the DNS client.
 
   DISALLOW_COPY_AND_ASSIGN(Job);
 };
@@ -324,15 +360,20 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
   if (key.address_family == ADDRESS_FAMILY_UNSPECIFIED)
     key.address_family = default_address_family_;
 
-  // If we have an unexpired cache entry, use it.
+  // If we have an unexpired cache entry, use it.  An entry that expired
+  // recently is used too, while a job refreshes it in the background.
   if (info.allow_cached_response() && cache_.get()) {
-    const HostCache::Entry* cache_entry = cache_->Lookup(
-        key, base::TimeTicks::Now());
+    bool is_stale;
+    const HostCache::Entry* cache_entry = cache_->LookupStale(
+        key, base::TimeTicks::Now(), &is_stale);
     if (cache_entry) {
       int error = cache_entry->error;
       if (error == OK)
         addresses->SetFrom(cache_entry->addrlist, info.port());
 
+      if (is_stale)
+        RefreshCacheEntry(key);
+
       // Update the load log and notify registered observers.
       OnFinishRequest(load_log, request_id, info, error);
 
@@ -422,6 +463,16 @@ void HostResolverImpl::RemoveObserver(Observer* observer) {
   observers_.erase(it);
 }
 
+void HostResolverImpl::RefreshCacheEntry(const Key& key) {
+  if (FindOutstandingJob(key))
+    return;
+
+  // The job has no request: it only updates the cache when it completes.
+  scoped_refptr<Job> job = new Job(this, key);
+  AddOutstandingJob(job);
+  job->Start();
+}
+
 HostCache* HostResolverImpl::GetHostCache() {
   return cache_.get();
 }
@@ -457,12 +508,17 @@ void HostResolverImpl::RemoveOutstandingJob(Job* job) {
 
 void HostResolverImpl::OnJobComplete(Job* job,
                                      int error,
-                                     const AddressList& addrlist) {
+                                     const AddressList& addrlist,
+                                     base::TimeDelta ttl) {
   RemoveOutstandingJob(job);
 
   // Write result to the cache.
-  if (cache_.get())
-    cache_->Set(job->key(), error, addrlist, base::TimeTicks::Now());
+  if (cache_.get()) {
+    if (error == OK && ttl > base::TimeDelta())
+      cache_->Set(job->key(), error, addrlist, base::TimeTicks::Now(), ttl);
+    else
+      cache_->Set(job->key(), error, addrlist, base::TimeTicks::Now());
+  }
 
   // Make a note that we are executing within OnJobComplete() in case the
   // HostResolver is deleted by a callback invocation.
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "base/scoped_ptr.h"
+#include "net/base/dns_client.h"
 #include "net/base/host_cache.h"
 #include "net/base/host_resolver.h"
 #include "net/base/host_resolver_proc.h"
@@ -37,6 +38,10 @@ namespace net {
 // When a HostResolverImpl::Job finishes its work in the threadpool, the
 // callbacks of each waiting request are run on the origin thread.
 //
+// If a DnsClient is set (see set_dns_client()), the jobs use it instead of
+// the worker pool, and the results are cached for the TTL of their DNS
+// records.
+//
 // Thread safety: This class is not threadsafe, and must only be called
 // from one thread!
 //
@@ -72,6 +77,14 @@ class HostResolverImpl : public HostResolver {
     default_address_family_ = address_family;
   }
 
+  // Resolves the hostnames with |dns_client| rather than with the
+  // HostResolverProc, except for synchronous requests. Takes ownership of
+  // |dns_client|. Must be called before the first request.
+  void set_dns_client(DnsClient* dns_client) {
+    DCHECK(jobs_.empty());
+    dns_client_.reset(dns_client);
+  }
+
  private:
   class Job;
   class Request;
@@ -100,8 +113,15 @@ class HostResolverImpl : public HostResolver {
   // Removes |job| from the outstanding jobs list.
   void RemoveOutstandingJob(Job* job);
 
-  // Callback for when |job| has completed with |error| and |addrlist|.
-  void OnJobComplete(Job* job, int error, const AddressList& addrlist);
+  // Starts a job that resolves |key| again to refresh its cache entry, unless
+  // one is already outstanding.
+  void RefreshCacheEntry(const Key& key);
+
+  // Callback for when |job| has completed with |error| and |addrlist|, which
+  // can be cached for |ttl| (or for the default TTL of the cache if |ttl| is
+  // zero).
+  void OnJobComplete(Job* job, int error, const AddressList& addrlist,
+                     base::TimeDelta ttl);
 
   // Called when a request has just been started.
   void OnStartRequest(LoadLog* load_log,
@@ -140,6 +160,9 @@ class HostResolverImpl : public HostResolver {
   // in the case of unit-tests which inject custom host resolving behaviors.
   scoped_refptr<HostResolverProc> resolver_proc_;
 
+  // The DNS client to use instead of |resolver_proc_|, or NULL.
+  scoped_ptr<DnsClient> dns_client_;
+
   // Address family to use when the request doesn't specify one.
   AddressFamily default_address_family_;
 
@@ -14,6 +14,7 @@
 #include "net/base/load_log_unittest.h"
 #include "net/base/mock_host_resolver.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
 #include "net/base/sys_addrinfo.h"
 #include "net/base/test_completion_callback.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -740,6 +741,40 @@ TEST_F(HostResolverImplTest, BypassCache) {
   MessageLoop::current()->Run();
 }
 
+// Test that an expired cache entry is served while a job refreshes it.
+TEST_F(HostResolverImplTest, ServeStaleEntry) {
+  scoped_refptr<RuleBasedHostResolverProc> rules =
+      new RuleBasedHostResolverProc(NULL);
+  rules->AddRule("a", "192.168.1.42");
+  scoped_refptr<CapturingHostResolverProc> resolver_proc =
+      new CapturingHostResolverProc(rules);
+  resolver_proc->Signal();
+
+  // The entries expire right away, but can be used for an hour.
+  HostCache* cache = new HostCache(100, base::TimeDelta(), base::TimeDelta());
+  cache->set_max_stale(base::TimeDelta::FromHours(1));
+  scoped_refptr<HostResolver> host_resolver(
+      new HostResolverImpl(resolver_proc, cache));
+
+  AddressList addrlist;
+  HostResolver::RequestInfo info("a", 80);
+  EXPECT_EQ(OK, host_resolver->Resolve(info, &addrlist, NULL, NULL, NULL));
+  EXPECT_EQ(1u, resolver_proc->GetCaptureList().size());
+
+  // The stale entry is used synchronously, even with a callback.
+  EXPECT_EQ(OK, host_resolver->Resolve(info, &addrlist, &callback_, NULL,
+                                       NULL));
+
+  // A request that bypasses the cache is attached to the refresh job.
+  info.set_allow_cached_response(false);
+  EXPECT_EQ(ERR_IO_PENDING,
+            host_resolver->Resolve(info, &addrlist, &callback_, NULL, NULL));
+  MessageLoop::current()->Run();
+  EXPECT_TRUE(callback_called_);
+  EXPECT_EQ(OK, callback_result_);
+  EXPECT_EQ(2u, resolver_proc->GetCaptureList().size());
+}
+
 bool operator==(const HostResolver::RequestInfo& a,
                 const HostResolver::RequestInfo& b) {
    return a.hostname() == b.hostname() &&
@@ -960,5 +995,93 @@ TEST_F(HostResolverImplTest, CancellationObserver) {
               CapturingObserver::StartOrCancelEntry(1, info));
 }
 
+// A DnsClient that completes its requests when told to.
+class FakeDnsClient : public DnsClient {
+ public:
+  FakeDnsClient() : callback_(NULL), addresses_(NULL), ttl_(NULL) {}
+
+  virtual int Resolve(const std::string& hostname,
+                      AddressFamily address_family,
+                      AddressList* addresses,
+                      base::TimeDelta* ttl,
+                      CompletionCallback* callback,
+                      RequestHandle* out_req) {
+    EXPECT_TRUE(callback_ == NULL);
+    hostname_ = hostname;
+    addresses_ = addresses;
+    ttl_ = ttl;
+    callback_ = callback;
+    *out_req = reinterpret_cast<RequestHandle>(this);
+    return ERR_IO_PENDING;
+  }
+
+  virtual void CancelRequest(RequestHandle req) {
+    EXPECT_EQ(reinterpret_cast<RequestHandle>(this), req);
+    callback_ = NULL;
+  }
+
+  // Completes the pending request with the IPv4 address |packed| (in
+  // network order), valid for |ttl|.
+  void Complete(const std::string& packed, base::TimeDelta ttl) {
+    ASSERT_TRUE(callback_ != NULL);
+    *addresses_ = AddressList::CreateFromIPAddresses(
+        std::vector<std::string>(1, packed), 0);
+    *ttl_ = ttl;
+    CompletionCallback* callback = callback_;
+    callback_ = NULL;
+    callback->Run(OK);
+  }
+
+  const std::string& hostname() const { return hostname_; }
+  bool has_pending_request() const { return callback_ != NULL; }
+
+ private:
+  std::string hostname_;
+  CompletionCallback* callback_;
+  AddressList* addresses_;
+  base::TimeDelta* ttl_;
+};
+
+// Tests that the DNS client is used instead of the HostResolverProc, and
+// that its results are cached for the TTL of the records.
+TEST_F(HostResolverImplTest, DnsClient) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc =
+      new RuleBasedHostResolverProc(NULL);
+  resolver_proc->AddRule("*", "192.168.1.1");
+
+  scoped_refptr<HostResolverImpl> host_resolver =
+      new HostResolverImpl(resolver_proc, CreateDefaultCache());
+  FakeDnsClient* dns_client = new FakeDnsClient;
+  host_resolver->set_dns_client(dns_client);
+
+  TestCompletionCallback callback;
+  HostResolver::RequestInfo info("just.testing", 80);
+  AddressList addrlist;
+  int rv = host_resolver->Resolve(info, &addrlist, &callback, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ("just.testing", dns_client->hostname());
+
+  base::TimeTicks before = base::TimeTicks::Now();
+  dns_client->Complete(std::string("\x0a\x00\x00\x01", 4),
+                       base::TimeDelta::FromHours(1));
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("10.0.0.1", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(80, addrlist.GetPort());
+
+  // The default TTL of the cache is one minute.
+  const HostCache::Entry* entry = host_resolver->GetHostCache()->Lookup(
+      HostCache::Key("just.testing", ADDRESS_FAMILY_UNSPECIFIED),
+      before + base::TimeDelta::FromMinutes(30));
+  ASSERT_TRUE(entry != NULL);
+  EXPECT_EQ(OK, entry->error);
+
+  // Destroying the resolver cancels the request of the DNS client.
+  rv = host_resolver->Resolve(HostResolver::RequestInfo("other.testing", 80),
+                              &addrlist, &callback, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_TRUE(dns_client->has_pending_request());
+  host_resolver = NULL;
+}
+
 }  // namespace
 }  // namespace net
@@ -101,6 +101,14 @@ EVENT_TYPE(SOCKET_POOL_CONNECT_JOB)
 // Whether the connect job timed out.
 EVENT_TYPE(SOCKET_POOL_CONNECT_JOB_TIMED_OUT)
 
+// ------------------------------------------------------------------------
+// TCPConnectJob
+// ------------------------------------------------------------------------
+
+// The start/end of a staggered connect to the addresses of a host. The
+// addresses that are tried, and the one that is used, are logged as strings.
+EVENT_TYPE(TCP_CONNECT_JOB_STAGGERED)
+
 // ------------------------------------------------------------------------
 // ClientSocketPoolBaseHelper
 // ------------------------------------------------------------------------
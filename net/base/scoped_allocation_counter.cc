@@ -0,0 +1,72 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/scoped_allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+
+namespace {
+
+// Whether a ScopedAllocationCounter is alive, and what it counted so far.
+base::subtle::Atomic32 g_counting = 0;
+base::subtle::Atomic32 g_allocations = 0;
+base::subtle::Atomic32 g_bytes = 0;
+
+void* Allocate(size_t size) {
+  if (base::subtle::NoBarrier_Load(&g_counting)) {
+    base::subtle::NoBarrier_AtomicIncrement(&g_allocations, 1);
+    base::subtle::NoBarrier_AtomicIncrement(
+        &g_bytes, static_cast<base::subtle::Atomic32>(size));
+  }
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  return Allocate(size);
+}
+
+void* operator new[](size_t size) {
+  return Allocate(size);
+}
+
+void operator delete(void* p) throw() {
+  free(p);
+}
+
+void operator delete[](void* p) throw() {
+  free(p);
+}
+
+namespace net {
+
+ScopedAllocationCounter::ScopedAllocationCounter() {
+  DCHECK(!base::subtle::NoBarrier_Load(&g_counting));
+  base::subtle::NoBarrier_Store(&g_allocations, 0);
+  base::subtle::NoBarrier_Store(&g_bytes, 0);
+  base::subtle::Release_Store(&g_counting, 1);
+}
+
+ScopedAllocationCounter::~ScopedAllocationCounter() {
+  base::subtle::Release_Store(&g_counting, 0);
+}
+
+int64 ScopedAllocationCounter::allocations() const {
+  return base::subtle::Acquire_Load(&g_allocations);
+}
+
+int64 ScopedAllocationCounter::bytes() const {
+  return static_cast<uint32>(base::subtle::Acquire_Load(&g_bytes));
+}
+
+}  // namespace net
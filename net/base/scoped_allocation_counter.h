@@ -0,0 +1,33 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_SCOPED_ALLOCATION_COUNTER_H_
+#define NET_BASE_SCOPED_ALLOCATION_COUNTER_H_
+
+#include "base/basictypes.h"
+
+namespace net {
+
+// Counts the heap allocations made through operator new during its lifetime,
+// for the perf tests to report.  The implementation replaces the global
+// operator new and delete, so it must only be linked into net_perftests.
+// Counters can not be nested, and the allocations are counted on all
+// threads.
+class ScopedAllocationCounter {
+ public:
+  ScopedAllocationCounter();
+  ~ScopedAllocationCounter();
+
+  // The number of allocations, and the number of bytes they requested, so
+  // far.  The byte count wraps around at 4GB.
+  int64 allocations() const;
+  int64 bytes() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedAllocationCounter);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_SCOPED_ALLOCATION_COUNTER_H_
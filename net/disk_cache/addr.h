@@ -18,9 +18,12 @@ enum FileType {
   BLOCK_256,
   BLOCK_1K,
   BLOCK_4K,
+  BLOCK_16K,
+  BLOCK_64K,
 };
 
 const int kMaxBlockSize = 4096 * 4;
+const int kMaxLargeBlockSize = 65536 * 4;
 const int kMaxBlockFile = 255;
 const int kMaxNumBlocks = 4;
 const int kFirstAdditionlBlockFile = 4;
@@ -37,6 +40,8 @@ const int kFirstAdditionlBlockFile = 4;
 //   2 = 256 byte block file
 //   3 = 1k byte block file
 //   4 = 4k byte block file
+//   5 = 16k byte block file
+//   6 = 64k byte block file
 //
 // If separate file:
 //   0000 1111 1111 1111 1111 1111 1111 1111 : file#  0 - 268,435,456 (2^28)
@@ -102,6 +107,10 @@ class Addr {
         return 1024;
       case BLOCK_4K:
         return 4096;
+      case BLOCK_16K:
+        return 16384;
+      case BLOCK_64K:
+        return 65536;
       default:
         return 0;
     }
@@ -114,10 +123,25 @@ class Addr {
       return BLOCK_1K;
     else if (size <= 4096 * 4)
       return BLOCK_4K;
+    else if (size <= 16384 * 4)
+      return BLOCK_16K;
+    else if (size <= 65536 * 4)
+      return BLOCK_64K;
     else
       return EXTERNAL;
   }
 
+  // Returns the type of a block file that stores blocks of |block_size| bytes,
+  // or EXTERNAL if there is no such block file.
+  static FileType FileTypeForBlockSize(int block_size) {
+    for (int i = RANKINGS; i <= BLOCK_64K; i++) {
+      FileType file_type = static_cast<FileType>(i);
+      if (BlockSizeForFileType(file_type) == block_size)
+        return file_type;
+    }
+    return EXTERNAL;
+  }
+
  private:
   static const uint32 kInitializedMask    = 0x80000000;
   static const uint32 kFileTypeMask       = 0x70000000;
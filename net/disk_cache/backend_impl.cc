@@ -4,6 +4,8 @@
 
 #include "net/disk_cache/backend_impl.h"
 
+#include <algorithm>
+
 #include "base/field_trial.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
@@ -14,12 +16,14 @@
 #include "base/sys_info.h"
 #include "base/timer.h"
 #include "base/worker_pool.h"
+#include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/entry_impl.h"
 #include "net/disk_cache/errors.h"
 #include "net/disk_cache/hash.h"
 #include "net/disk_cache/file.h"
+#include "net/disk_cache/sparse_control.h"
 
 // This has to be defined before including histogram_macros.h from this file.
 #define NET_DISK_CACHE_BACKEND_IMPL_CC_
@@ -31,6 +35,7 @@ using base::TimeDelta;
 namespace {
 
 const char* kIndexName = "index";
+const char* kJournalName = "journal";
 const int kMaxOldFolders = 100;
 
 // Seems like ~240 MB correspond to less than 50k entries for 99% of the people.
@@ -38,6 +43,26 @@ const int k64kEntriesStore = 240 * 1000 * 1000;
 const int kBaseTableLen = 64 * 1024;
 const int kDefaultCacheSize = 80 * 1024 * 1024;
 
+// Limits for every step of PackExternalFiles(): number of entries inspected,
+// and bytes of data moved. The step ends with the entry that reaches the byte
+// limit, so a few streams of up to kMaxLargeBlockSize bytes can go over it.
+const int kPackBatchSize = 100;
+const int kPackBatchBytes = 1024 * 1024;
+
+// Limits for the work done by WarmUp(): bytes of the index and number of entries
+// read on every step, and total number of entries to read.
+const size_t kWarmUpIndexBatch = 256 * 1024;
+const int kWarmUpBatchSize = 100;
+const int kMaxWarmUpEntries = 5000;
+const size_t kPageSize = 4096;
+
+// The LRU lists read by WarmUp(), starting with the most valuable entries.
+const disk_cache::Rankings::List kWarmUpLists[] = {
+  disk_cache::Rankings::HIGH_USE,
+  disk_cache::Rankings::LOW_USE,
+  disk_cache::Rankings::NO_USE
+};
+
 int DesiredIndexTableLen(int32 storage_size) {
   if (storage_size <= k64kEntriesStore)
     return kBaseTableLen;
@@ -173,8 +198,11 @@ namespace disk_cache {
 
 Backend* CreateCacheBackend(const FilePath& full_path, bool force,
                             int max_bytes, net::CacheType type) {
-  // Create a backend without extra flags.
-  return BackendImpl::CreateBackend(full_path, force, max_bytes, type, kNone);
+  // Only the main cache is big enough to benefit from warming up, and busy
+  // enough to benefit from batching the updates of the rankings nodes.
+  int flags = type == net::DISK_CACHE ? kWarmUp | kWriteBehind : kNone;
+  return BackendImpl::CreateBackend(full_path, force, max_bytes, type,
+                                    static_cast<BackendFlags>(flags));
 }
 
 int PreferedCacheSize(int64 available) {
@@ -310,6 +338,20 @@ bool BackendImpl::Init() {
   if (!stats_.Init(this, &data_->header.stats))
     return false;
 
+  // Pending records from a previous run must reach the block files before the
+  // rankings are checked, even if we are not using the journal anymore.
+  if (!read_only_) {
+    FilePath journal_name = path_.AppendASCII(kJournalName);
+    if ((user_flags_ & kWriteBehind) || file_util::PathExists(journal_name)) {
+      if (!journal_.Init(journal_name, data_->header.create_time, this))
+        LOG(ERROR) << "Unable to open the journal";
+    }
+    if (user_flags_ & kWriteBehind)
+      block_files_.SetJournal(&journal_);
+    else
+      journal_.Close();
+  }
+
   disabled_ = !rankings_.Init(this, new_eviction_);
   eviction_.Init(this);
 
@@ -317,6 +359,13 @@ bool BackendImpl::Init() {
   if (cache_type() == net::DISK_CACHE)
     SetFieldTrialInfo(GetSizeGroup());
 
+  // There is nothing to warm up after a restart: the cache is empty.
+  if ((user_flags_ & kWarmUp) && !restarted_ && !read_only_ && !disabled_) {
+    warm_up_start_ = Time::Now();
+    MessageLoop::current()->PostTask(FROM_HERE,
+        factory_.NewRunnableMethod(&BackendImpl::WarmUp));
+  }
+
   return !disabled_;
 }
 
@@ -325,6 +374,9 @@ BackendImpl::~BackendImpl() {
   if (!init_)
     return;
 
+  EndEnumeration(&pack_iterator_);
+  block_files_.SetJournal(NULL);
+  journal_.Close();
   if (data_)
     data_->header.crash = 0;
 
@@ -767,6 +819,9 @@ void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
     DecreaseNumEntries();
   }
 
+  if (entry->entry()->Data()->flags & CHILD_ENTRY)
+    NotifyParentOfDoomedChild(key);
+
   stats_.OnEvent(Stats::DOOM_ENTRY);
 }
 
@@ -810,6 +865,14 @@ int BackendImpl::MaxFileSize() const {
   return max_size_ / 8;
 }
 
+bool BackendImpl::UseLargeBlocks() const {
+  return !(user_flags_ & kNoLargeBlocks);
+}
+
+bool BackendImpl::ShouldCompressData() const {
+  return (user_flags_ & kCompressData) && !read_only_;
+}
+
 void BackendImpl::ModifyStorageSize(int32 old_size, int32 new_size) {
   if (disabled_ || old_size == new_size)
     return;
@@ -926,6 +989,10 @@ void BackendImpl::OnEvent(Stats::Counters an_event) {
   stats_.OnEvent(an_event);
 }
 
+void BackendImpl::OnCompressData(int32 data_size, int32 stored_size) {
+  stats_.OnCompressData(data_size, stored_size);
+}
+
 void BackendImpl::OnStatsTimer() {
   stats_.OnEvent(Stats::TIMER);
   int64 time = stats_.GetCounter(Stats::TIMER);
@@ -955,6 +1022,9 @@ void BackendImpl::OnStatsTimer() {
   // Save stats to disk at 5 min intervals.
   if (time % 10 == 0)
     stats_.Store();
+
+  if (data_ && !data_->header.large_blocks)
+    PackExternalFiles();
 }
 
 void BackendImpl::IncrementIoCount() {
@@ -980,6 +1050,11 @@ void BackendImpl::SetNewEviction() {
   new_eviction_ = true;
 }
 
+void BackendImpl::SetEvictionPolicy(EvictionPolicyType type) {
+  DCHECK(type >= LRU_POLICY && type < NUM_EVICTION_POLICIES);
+  eviction_policy_ = type;
+}
+
 void BackendImpl::SetFlags(uint32 flags) {
   user_flags_ |= flags;
 }
@@ -1012,6 +1087,96 @@ bool BackendImpl::OpenPrevEntry(void** iter, Entry** prev_entry) {
   return OpenFollowingEntry(false, iter, prev_entry);
 }
 
+// Right after startup, the first lookups for every bucket fault in the pages of
+// the index, and the rankings and entry blocks, one at a time. In order to pay
+// that cost before the requests arrive, we read the whole index, and then walk
+// the LRU lists from the head, loading the rankings node and entry block of the
+// most recently used entries. Note that we are not using Rankings to walk the
+// lists: this is just a hint for the OS, so instead of dealing with corruption
+// we stop reading a list as soon as something looks wrong.
+void BackendImpl::WarmUp() {
+  if (!IsWarmingUp())
+    return;
+
+  Time start = Time::Now();
+  size_t index_size = index_->GetLength();
+  if (warm_up_offset_ < index_size) {
+    const char* buffer = reinterpret_cast<const char*>(index_->buffer());
+    size_t end = std::min(warm_up_offset_ + kWarmUpIndexBatch, index_size);
+    for (; warm_up_offset_ < end; warm_up_offset_ += kPageSize) {
+      warm_up_checksum_ += buffer[warm_up_offset_];
+      stats_.OnEvent(Stats::WARM_UP_PAGES);
+    }
+    MessageLoop::current()->PostTask(FROM_HERE,
+        factory_.NewRunnableMethod(&BackendImpl::WarmUp));
+    return;
+  }
+
+  for (int i = 0; i < kWarmUpBatchSize; i++) {
+    if (disabled_ || warm_up_entries_ >= kMaxWarmUpEntries ||
+        warm_up_entries_ >= data_->header.num_entries) {
+      warm_up_list_ = arraysize(kWarmUpLists);
+      break;
+    }
+
+    Rankings::List list = kWarmUpLists[warm_up_list_];
+    Addr address(warm_up_next_ ? warm_up_next_ :
+                                 data_->header.lru.heads[list]);
+    MappedFile* file = NULL;
+    if ((new_eviction_ || list == Rankings::NO_USE) &&
+        address.is_initialized() && address.file_type() == RANKINGS)
+      file = File(address);
+
+    scoped_ptr<CacheRankingsBlock> node;
+    if (file)
+      node.reset(new CacheRankingsBlock(file, address));
+    if (!node.get() || !node->Load() || !node->Data()->contents) {
+      // Move to the next list.
+      warm_up_next_ = 0;
+      if (++warm_up_list_ == arraysize(kWarmUpLists))
+        break;
+      continue;
+    }
+
+    Addr entry_address(node->Data()->contents);
+    if (entry_address.is_initialized() &&
+        entry_address.file_type() == BLOCK_256) {
+      file = File(entry_address);
+      CacheEntryBlock entry(file, entry_address);
+      if (file && entry.Load())
+        stats_.OnEvent(Stats::WARM_UP_ENTRIES);
+    }
+    warm_up_entries_++;
+
+    if (address.value() == data_->header.lru.tails[list] ||
+        address.value() == node->Data()->next) {
+      warm_up_next_ = 0;
+      if (++warm_up_list_ == arraysize(kWarmUpLists))
+        break;
+    } else {
+      warm_up_next_ = node->Data()->next;
+    }
+
+    if ((Time::Now() - start).InMilliseconds() > 20)
+      break;
+  }
+
+  if (IsWarmingUp()) {
+    MessageLoop::current()->PostTask(FROM_HERE,
+        factory_.NewRunnableMethod(&BackendImpl::WarmUp));
+    return;
+  }
+
+  stats_.SetCounter(Stats::WARM_UP_TIME,
+                    (Time::Now() - warm_up_start_).InMilliseconds());
+  CACHE_UMA(AGE_MS, "WarmUpTime", 0, warm_up_start_);
+}
+
+bool BackendImpl::IsWarmingUp() const {
+  return !disabled_ && !warm_up_start_.is_null() &&
+         warm_up_list_ < arraysize(kWarmUpLists);
+}
+
 // ------------------------------------------------------------------------
 
 // We just created a new file so we're going to write the header and set the
@@ -1022,12 +1187,16 @@ bool BackendImpl::CreateBackingStore(disk_cache::File* file) {
   IndexHeader header;
   header.table_len = DesiredIndexTableLen(max_size_);
 
-  // We need file version 2.1 for the new eviction algorithm.
+  // We need file version 3.1 for the new eviction algorithm.
   if (new_eviction_)
-    header.version = 0x20001;
+    header.version = 0x30001;
 
   header.create_time = Time::Now().ToInternalValue();
 
+  // There is nothing to pack on a new cache.
+  if (UseLargeBlocks())
+    header.large_blocks = 1;
+
   if (!file->Write(&header, sizeof(header), 0))
     return false;
 
@@ -1120,6 +1289,9 @@ void BackendImpl::RestartCache() {
 }
 
 void BackendImpl::PrepareForRestart() {
+  EndEnumeration(&pack_iterator_);
+  warm_up_list_ = arraysize(kWarmUpLists);
+
   // Reset the mask_ if it was not given by the user.
   if (!(user_flags_ & kMask))
     mask_ = 0;
@@ -1127,6 +1299,9 @@ void BackendImpl::PrepareForRestart() {
   if (!(user_flags_ & kNewEviction))
     new_eviction_ = false;
 
+  block_files_.SetJournal(NULL);
+  journal_.Close();
+
   data_->header.crash = 0;
   index_ = NULL;
   data_ = NULL;
@@ -1455,6 +1630,23 @@ void BackendImpl::DestroyInvalidEntryFromEnumeration(EntryImpl* entry) {
   entry->Release();
 }
 
+void BackendImpl::NotifyParentOfDoomedChild(const std::string& child_key) {
+  std::string parent_key;
+  int64 child_id;
+  if (!SparseControl::ParseChildName(child_key, &parent_key, &child_id))
+    return;
+
+  // There is no need to update the rankings of the parent, so we don't go
+  // through OpenEntry.
+  EntryImpl* parent = MatchEntry(parent_key, Hash(parent_key), false);
+  if (!parent)
+    return;
+
+  if (ENTRY_NORMAL == parent->entry()->Data()->state)
+    parent->OnChildDoomed(child_key, child_id);
+  parent->Release();
+}
+
 void BackendImpl::AddStorageSize(int32 bytes) {
   data_->header.num_bytes += bytes;
   DCHECK(data_->header.num_bytes >= 0);
@@ -1538,6 +1730,8 @@ void BackendImpl::ReportStats() {
 
   CACHE_UMA(HOURS, "UseTime", 0, static_cast<int>(use_hours));
   CACHE_UMA(PERCENTAGE, "HitRatio", 0, stats_.GetHitRatio());
+  if (ShouldCompressData())
+    CACHE_UMA(PERCENTAGE, "CompressionRatio", 0, stats_.GetCompressionRatio());
 
   int64 trim_rate = stats_.GetCounter(Stats::TRIM_ENTRY) / use_hours;
   CACHE_UMA(COUNTS, "TrimRate", 0, static_cast<int>(trim_rate));
@@ -1565,14 +1759,55 @@ void BackendImpl::ReportStats() {
   stats_.SetCounter(Stats::TRIM_ENTRY, 0);
 }
 
-void BackendImpl::UpgradeTo2_1() {
-  // 2.1 is basically the same as 2.0, except that new fields are actually
+void BackendImpl::UpgradeTo3_0() {
+  // 3.0 can read everything written by 2.0 or 2.1, where no entry has the
+  // COMPRESSED_DATA flag. Data stored on separate files is moved to large
+  // blocks in the background, see PackExternalFiles().
+  DCHECK(0x20000 == (data_->header.version & 0xFFFF0000));
+  data_->header.version = kCurrentVersion | (data_->header.version & 0xFFFF);
+  data_->header.large_blocks = 0;
+}
+
+void BackendImpl::UpgradeTo3_1() {
+  // 3.1 is basically the same as 3.0, except that new fields are actually
   // updated by the new eviction algorithm.
-  DCHECK(0x20000 == data_->header.version);
-  data_->header.version = 0x20001;
+  DCHECK(0x30000 == data_->header.version);
+  data_->header.version = 0x30001;
   data_->header.lru.sizes[Rankings::NO_USE] = data_->header.num_entries;
 }
 
+// Caches created before medium-sized data could be stored on block-files (the
+// index header doesn't have large_blocks set) may have plenty of small files,
+// so they are migrated in the background: every time this method runs a few
+// more entries are moved, as long as nothing else is going on. This runs on
+// the cache thread and the IO is synchronous, so the work is kept small.
+void BackendImpl::PackExternalFiles() {
+  if (disabled_ || read_only_ || !UseLargeBlocks())
+    return;
+
+  // There is no way to exclude an ongoing operation from the data that we are
+  // moving, so we need the cache to be idle.
+  if (num_pending_io_)
+    return;
+
+  int bytes_moved = 0;
+  for (int i = 0; i < kPackBatchSize && bytes_moved < kPackBatchBytes; i++) {
+    Entry* entry;
+    if (!OpenFollowingEntry(true, &pack_iterator_, &entry)) {
+      // We are done with the whole cache.
+      DCHECK(!pack_iterator_);
+      if (!disabled_)
+        data_->header.large_blocks = 1;
+      return;
+    }
+
+    EntryImpl* cache_entry = reinterpret_cast<EntryImpl*>(entry);
+    if (!cache_entry->PackExternalData(&bytes_moved))
+      LOG(ERROR) << "Unable to move data to block-files";
+    cache_entry->Release();
+  }
+}
+
 bool BackendImpl::CheckIndex() {
   DCHECK(data_);
 
@@ -1582,16 +1817,19 @@ bool BackendImpl::CheckIndex() {
     return false;
   }
 
+  if (kIndexMagic == data_->header.magic && 2 == data_->header.version >> 16)
+    UpgradeTo3_0();
+
   if (new_eviction_) {
-    // We support versions 2.0 and 2.1, upgrading 2.0 to 2.1.
+    // We support versions 3.0 and 3.1, upgrading 3.0 to 3.1.
     if (kIndexMagic != data_->header.magic ||
         kCurrentVersion >> 16 != data_->header.version >> 16) {
       LOG(ERROR) << "Invalid file version or magic";
       return false;
     }
     if (kCurrentVersion == data_->header.version) {
-      // We need file version 2.1 for the new eviction algorithm.
-      UpgradeTo2_1();
+      // We need file version 3.1 for the new eviction algorithm.
+      UpgradeTo3_1();
     }
   } else {
     if (kIndexMagic != data_->header.magic ||
@@ -13,6 +13,8 @@
 #include "net/disk_cache/block_files.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/eviction.h"
+#include "net/disk_cache/eviction_policy.h"
+#include "net/disk_cache/journal.h"
 #include "net/disk_cache/rankings.h"
 #include "net/disk_cache/stats.h"
 #include "net/disk_cache/trace.h"
@@ -27,7 +29,11 @@ enum BackendFlags {
   kUpgradeMode = 1 << 3,        // This is the upgrade tool (dump).
   kNewEviction = 1 << 4,        // Use of new eviction was specified.
   kNoRandom = 1 << 5,           // Don't add randomness to the behavior.
-  kNoLoadProtection = 1 << 6    // Don't act conservatively under load.
+  kNoLoadProtection = 1 << 6,   // Don't act conservatively under load.
+  kNoLargeBlocks = 1 << 7,      // Keep data bigger than 16 KB on separate files.
+  kWarmUp = 1 << 8,             // Prefetch the index and the hottest entries.
+  kCompressData = 1 << 9,       // Compress the data stream of entries.
+  kWriteBehind = 1 << 10        // Batch the updates of rankings nodes.
 };
 
 // This class implements the Backend interface. An object of this
@@ -39,14 +45,18 @@ class BackendImpl : public Backend {
       : path_(path), block_files_(path), mask_(0), max_size_(0),
         cache_type_(net::DISK_CACHE), uma_report_(0), user_flags_(0),
         init_(false), restarted_(false), unit_test_(false), read_only_(false),
-        new_eviction_(false), first_timer_(true),
+        new_eviction_(false), eviction_policy_(LRU_POLICY), first_timer_(true),
+        pack_iterator_(NULL), warm_up_list_(0), warm_up_next_(0),
+        warm_up_offset_(0), warm_up_entries_(0), warm_up_checksum_(0),
         ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)) {}
   // mask can be used to limit the usable size of the hash table, for testing.
   BackendImpl(const FilePath& path, uint32 mask)
       : path_(path), block_files_(path), mask_(mask), max_size_(0),
         cache_type_(net::DISK_CACHE), uma_report_(0), user_flags_(kMask),
         init_(false), restarted_(false), unit_test_(false), read_only_(false),
-        new_eviction_(false), first_timer_(true),
+        new_eviction_(false), eviction_policy_(LRU_POLICY), first_timer_(true),
+        pack_iterator_(NULL), warm_up_list_(0), warm_up_next_(0),
+        warm_up_offset_(0), warm_up_entries_(0), warm_up_checksum_(0),
         ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)) {}
   ~BackendImpl();
 
@@ -138,6 +148,13 @@ class BackendImpl : public Backend {
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
+  // Returns true if data up to kMaxLargeBlockSize bytes should be stored on
+  // block-files instead of separate files.
+  bool UseLargeBlocks() const;
+
+  // Returns true if the data stream of entries should be stored compressed.
+  bool ShouldCompressData() const;
+
   // A user data block is being created, extended or truncated.
   void ModifyStorageSize(int32 old_size, int32 new_size);
 
@@ -176,6 +193,10 @@ class BackendImpl : public Backend {
   // Called when an interesting event should be logged (counted).
   void OnEvent(Stats::Counters an_event);
 
+  // Called when |data_size| bytes of user data are stored as |stored_size|
+  // bytes of compressed data.
+  void OnCompressData(int32 data_size, int32 stored_size);
+
   // Timer callback to calculate usage statistics.
   void OnStatsTimer();
 
@@ -192,6 +213,11 @@ class BackendImpl : public Backend {
   // Sets the eviction algorithm to version 2.
   void SetNewEviction();
 
+  // Sets the replacement policy used by the original eviction algorithm (see
+  // eviction_policy.h). The policy is kept in memory, so it has to be loaded
+  // with all the entries when the cache is initialized.
+  void SetEvictionPolicy(EvictionPolicyType type);
+
   // Sets an explicit set of BackendFlags.
   void SetFlags(uint32 flags);
 
@@ -205,6 +231,12 @@ class BackendImpl : public Backend {
   // Same bahavior as OpenNextEntry but walks the list from back to front.
   bool OpenPrevEntry(void** iter, Entry** prev_entry);
 
+  // Reads part of the index and of the most recently used entries, so that the
+  // first requests don't have to wait for the disk. Every call does a little
+  // work and posts the next step, until IsWarmingUp() returns false.
+  void WarmUp();
+  bool IsWarmingUp() const;
+
  private:
   typedef base::hash_map<CacheAddr, EntryImpl*> EntriesMap;
 
@@ -246,6 +278,10 @@ class BackendImpl : public Backend {
   void DestroyInvalidEntry(EntryImpl* entry);
   void DestroyInvalidEntryFromEnumeration(EntryImpl* entry);
 
+  // Lets the parent of the sparse child named |child_key| know that the child
+  // was doomed, so that it stops tracking the data stored there.
+  void NotifyParentOfDoomedChild(const std::string& child_key);
+
   // Handles the used storage count.
   void AddStorageSize(int32 bytes);
   void SubstractStorageSize(int32 bytes);
@@ -262,12 +298,20 @@ class BackendImpl : public Backend {
   // Send UMA stats.
   void ReportStats();
 
-  // Upgrades the index file to version 2.1.
-  void UpgradeTo2_1();
+  // Upgrades the index file from version 2.x to 3.x.
+  void UpgradeTo3_0();
+
+  // Upgrades the index file to version 3.1.
+  void UpgradeTo3_1();
 
   // Performs basic checks on the index file. Returns false on failure.
   bool CheckIndex();
 
+  // Moves some of the data stored on separate files by an older version of the
+  // cache to block-files. This is done a few entries at a time, until the whole
+  // cache has been processed.
+  void PackExternalFiles();
+
   // Part of the selt test. Returns the number or dirty entries, or an error.
   int CheckAllEntries();
 
@@ -278,6 +322,7 @@ class BackendImpl : public Backend {
   FilePath path_;  // Path to the folder used as backing storage.
   Index* data_;  // Pointer to the index data.
   BlockFiles block_files_;  // Set of files used to store all data.
+  Journal journal_;  // Pending updates of rankings nodes.
   Rankings rankings_;  // Rankings to be able to trim the cache.
   uint32 mask_;  // Binary mask to map a hash to the hash table.
   int32 max_size_;  // Maximum data size for this instance.
@@ -295,7 +340,16 @@ class BackendImpl : public Backend {
   bool read_only_;  // Prevents updates of the rankings data (used by tools).
   bool disabled_;
   bool new_eviction_;  // What eviction algorithm should be used.
+  EvictionPolicyType eviction_policy_;  // Used by the original eviction.
   bool first_timer_;  // True if the timer has not been called.
+  void* pack_iterator_;  // Enumeration used by PackExternalFiles().
+  size_t warm_up_list_;  // Position on kWarmUpLists of the list being read.
+  CacheAddr warm_up_next_;  // Next rankings node to read by WarmUp().
+  size_t warm_up_offset_;  // Amount of the index already read by WarmUp().
+  int warm_up_entries_;  // Number of entries visited by WarmUp().
+  uint32 warm_up_checksum_;  // Sum of the index bytes touched by WarmUp(), so
+                             // that the reads are not optimized away.
+  base::Time warm_up_start_;
 
   Stats stats_;  // Usage statistcs.
   base::RepeatingTimer<BackendImpl> timer_;  // Usage timer.
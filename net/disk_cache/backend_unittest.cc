@@ -6,7 +6,9 @@
 #include "base/file_util.h"
 #include "base/path_service.h"
 #include "base/platform_thread.h"
+#include "base/scoped_vector.h"
 #include "base/string_util.h"
+#include "base/thread.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
@@ -35,6 +37,43 @@ bool CopyTestCache(const std::wstring& name) {
   return file_util::CopyDirectory(path, dest, false);
 }
 
+// Opens or creates entries on |cache|, using keys that are shared with other
+// threads, and reads and writes data to them. Some of the entries are doomed.
+void UseCacheFromThread(disk_cache::Backend* cache, int thread_id) {
+  const int kSize = 2000;
+  const int kNumKeys = 50;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+
+  for (int i = 0; i < 1000; i++) {
+    int key_id = (i * (thread_id + 1)) % kNumKeys;
+    std::string key = StringPrintf("key %d", key_id);
+    disk_cache::Entry* entry;
+    if (!cache->OpenEntry(key, &entry) && !cache->CreateEntry(key, &entry))
+      continue;
+
+    // Every thread writes the same data for a given key.
+    memset(buffer1->data(), key_id, kSize);
+    EXPECT_EQ(kSize, entry->WriteData(0, 0, buffer1, kSize, NULL, true));
+    int rv = entry->ReadData(0, 0, buffer2, kSize, NULL);
+    EXPECT_LE(0, rv);
+    EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), rv));
+    if (i % 7 == thread_id)
+      entry->Doom();
+    entry->Close();
+  }
+}
+
+// Returns the number of files in |path| that match |pattern|.
+int NumberOfFiles(const FilePath& path, const FilePath::StringType& pattern) {
+  file_util::FileEnumerator iter(path, false, file_util::FileEnumerator::FILES,
+                                 pattern);
+  int count = 0;
+  for (FilePath file = iter.Next(); !file.value().empty(); file = iter.Next())
+    count++;
+  return count;
+}
+
 }  // namespace
 
 // Tests that can run with different types of caches.
@@ -199,7 +238,7 @@ TEST_F(DiskCacheBackendTest, ExternalFiles) {
   // Now let's create a file with the cache.
   disk_cache::Entry* entry;
   ASSERT_TRUE(cache_->CreateEntry("key", &entry));
-  ASSERT_EQ(0, entry->WriteData(0, 20000, buffer1, 0, NULL, false));
+  ASSERT_EQ(0, entry->WriteData(0, 300000, buffer1, 0, NULL, false));
   entry->Close();
 
   // And verify that the first file is still there.
@@ -208,6 +247,287 @@ TEST_F(DiskCacheBackendTest, ExternalFiles) {
   EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
 }
 
+// Tests that data stored on separate files by an older cache is moved to
+// block-files.
+TEST_F(DiskCacheTest, PackExternalFiles) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+  FilePath filename = path.AppendASCII("f_000001");
+
+  const int kSize = 100000;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kNoLargeBlocks);
+  ASSERT_TRUE(cache->Init());
+
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache->CreateEntry("key", &entry));
+  EXPECT_EQ(kSize, entry->WriteData(1, 0, buffer1, kSize, NULL, false));
+  entry->Close();
+  EXPECT_TRUE(file_util::PathExists(filename));
+  delete cache;
+
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+
+  // Simulate the timer, that will move the data in the background.
+  cache->OnStatsTimer();
+  EXPECT_FALSE(file_util::PathExists(filename));
+
+  ASSERT_TRUE(cache->OpenEntry("key", &entry));
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
+// Tests that every step of the migration to block-files moves a limited amount
+// of data.
+TEST_F(DiskCacheTest, PackExternalFilesInSteps) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  const int kSize = 100000;
+  const int kNumEntries = 20;
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kNoLargeBlocks);
+  ASSERT_TRUE(cache->Init());
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry(StringPrintf("key %d", i), &entry));
+    EXPECT_EQ(kSize, entry->WriteData(1, 0, buffer, kSize, NULL, false));
+    entry->Close();
+  }
+  delete cache;
+  FilePath::StringType pattern(FILE_PATH_LITERAL("f_*"));
+  EXPECT_EQ(kNumEntries, NumberOfFiles(path, pattern));
+
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+
+  // The first step stops after moving about 1 MB.
+  cache->OnStatsTimer();
+  int num_files = NumberOfFiles(path, pattern);
+  EXPECT_LT(0, num_files);
+  EXPECT_GT(kNumEntries, num_files);
+
+  cache->OnStatsTimer();
+  cache->OnStatsTimer();
+  EXPECT_EQ(0, NumberOfFiles(path, pattern));
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
+// Tests that a cache from version 2.0 is upgraded when it is opened, and that
+// its data is then moved to block-files.
+TEST_F(DiskCacheTest, UpgradeFromVersion2) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache->CreateEntry("key", &entry));
+  entry->Close();
+  delete cache;
+
+  // Turn the files into version 2.0 files.
+  scoped_refptr<disk_cache::MappedFile> index(new disk_cache::MappedFile);
+  disk_cache::IndexHeader* header = static_cast<disk_cache::IndexHeader*>(
+      index->Init(path.AppendASCII("index"), sizeof(disk_cache::IndexHeader)));
+  ASSERT_TRUE(header);
+  EXPECT_EQ(1, header->large_blocks);
+  header->version = 0x20000;
+  scoped_refptr<disk_cache::MappedFile> block_file(new disk_cache::MappedFile);
+  disk_cache::BlockFileHeader* block_header =
+      static_cast<disk_cache::BlockFileHeader*>(block_file->Init(
+          path.AppendASCII("data_1"), sizeof(disk_cache::BlockFileHeader)));
+  ASSERT_TRUE(block_header);
+  block_header->version = 0x20000;
+  block_file = NULL;
+
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  EXPECT_EQ(disk_cache::kCurrentVersion, header->version);
+  EXPECT_EQ(0, header->large_blocks);
+  ASSERT_TRUE(cache->OpenEntry("key", &entry));
+  entry->Close();
+
+  cache->OnStatsTimer();
+  EXPECT_EQ(1, header->large_blocks);
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
+// Tests that the warm-up stage reads the index and every entry of the cache.
+TEST_F(DiskCacheTest, WarmUp) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  EXPECT_FALSE(cache->IsWarmingUp());
+
+  const int kNumEntries = 20;
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry(StringPrintf("key %d", i), &entry));
+    entry->Close();
+  }
+  delete cache;
+
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kWarmUp);
+  ASSERT_TRUE(cache->Init());
+  EXPECT_TRUE(cache->IsWarmingUp());
+
+  // Every step of the warm-up posts the next one.
+  while (cache->IsWarmingUp())
+    MessageLoop::current()->RunAllPending();
+
+  disk_cache::StatsItems stats;
+  cache->GetStats(&stats);
+  bool found = false;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Warm up entries") {
+      EXPECT_EQ(StringPrintf("0x%x", kNumEntries), stats[i].second);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+
+  // The cache should still be usable.
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache->OpenEntry("key 0", &entry));
+  entry->Close();
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
+// Tests that updates of the rankings nodes are kept on the journal, and that
+// they are not lost if the cache goes away without flushing them.
+TEST_F(DiskCacheTest, WriteBehindJournal) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kWriteBehind);
+  ASSERT_TRUE(cache->Init());
+
+  const int kNumEntries = 20;
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry(StringPrintf("key %d", i), &entry));
+    entry->Close();
+  }
+
+  disk_cache::StatsItems stats;
+  cache->GetStats(&stats);
+  int found = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Journal records") {
+      EXPECT_NE("0x0", stats[i].second);
+      found++;
+    } else if (stats[i].first == "Journal writes") {
+      EXPECT_EQ("0x0", stats[i].second);
+      found++;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  // Simulate a crash: a copy of the files has all the nodes on the journal.
+  ScopedTestCache copy("cache_journal");
+  ASSERT_TRUE(file_util::CopyDirectory(path, copy.path(), false));
+  EXPECT_TRUE(CheckCacheIntegrity(copy.path(), false));
+
+  // Nothing is lost when the delayed flush runs.
+  PlatformThread::Sleep(300);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  EXPECT_EQ(kNumEntries, cache->GetEntryCount());
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache->OpenEntry("key 0", &entry));
+  entry->Close();
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
+// Tests that the records left on the journal of a cache are not applied to
+// another set of files.
+TEST_F(DiskCacheTest, WriteBehindJournalOfAnotherIndex) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kWriteBehind);
+  ASSERT_TRUE(cache->Init());
+
+  for (int i = 0; i < 20; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry(StringPrintf("key %d", i), &entry));
+    entry->Close();
+  }
+
+  // Keep the journal with all the pending records.
+  ScopedTestCache copy("cache_journal");
+  FilePath journal = copy.path().AppendASCII("journal");
+  ASSERT_TRUE(file_util::CopyFile(path.AppendASCII("journal"), journal));
+  delete cache;
+
+  // A new set of files, with fewer entries.
+  PlatformThread::Sleep(10);
+  ASSERT_TRUE(DeleteCache(path));
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  const int kNumEntries = 5;
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry(StringPrintf("other key %d", i), &entry));
+    entry->Close();
+  }
+  delete cache;
+
+  ASSERT_TRUE(file_util::CopyFile(journal, path.AppendASCII("journal")));
+  cache = new disk_cache::BackendImpl(path);
+  cache->SetUnitTestMode();
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+  EXPECT_EQ(kNumEntries, cache->GetEntryCount());
+  EXPECT_EQ(0, cache->SelfCheck());
+  delete cache;
+}
+
 TEST_F(DiskCacheTest, ShutdownWithPendingIO) {
   TestCompletionCallback callback;
 
@@ -241,6 +561,82 @@ TEST_F(DiskCacheTest, ShutdownWithPendingIO) {
   MessageLoop::current()->RunAllPending();
 }
 
+// Tests that the asynchronous interface of the threaded backend works.
+TEST_F(DiskCacheBackendTest, ThreadedBasics) {
+  SetThreadedMode();
+  InitCache();
+
+  TestCompletionCallback cb;
+  disk_cache::Entry* entry1 = NULL;
+  int rv = cache_->OpenEntry("the first key", &entry1, &cb);
+  EXPECT_EQ(net::ERR_FAILED, cb.GetResult(rv));
+
+  rv = cache_->CreateEntry("the first key", &entry1, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_TRUE(NULL != entry1);
+  EXPECT_EQ("the first key", entry1->GetKey());
+
+  const int kSize = 2000;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  rv = entry1->WriteData(0, 0, buffer1, kSize, &cb, false);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(kSize, entry1->GetDataSize(0));
+
+  // Closing the entry should not affect an operation in flight.
+  rv = entry1->WriteData(1, 0, buffer1, kSize, &cb, false);
+  entry1->Close();
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+
+  disk_cache::Entry* entry2 = NULL;
+  rv = cache_->OpenEntry("the first key", &entry2, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  rv = entry2->ReadData(1, 0, buffer2, kSize, &cb);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  EXPECT_EQ(kSize, entry2->ReadData(0, 0, buffer2, kSize, NULL));
+  entry2->Close();
+
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  rv = cache_->DoomAllEntries(&cb);
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCacheTest, ThreadedShutdownWithPendingIO) {
+  TestCompletionCallback callback;
+
+  {
+    FilePath path = GetCacheFilePath();
+    ASSERT_TRUE(DeleteCache(path));
+
+    disk_cache::Backend* cache =
+        disk_cache::CreateThreadedCacheBackend(path, false, 0, net::DISK_CACHE);
+    ASSERT_TRUE(NULL != cache);
+
+    disk_cache::Entry* entry;
+    ASSERT_TRUE(cache->CreateEntry("some key", &entry));
+
+    const int kSize = 25000;
+    scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kSize);
+    CacheTestFillBuffer(buffer->data(), kSize, false);
+
+    int rv = entry->WriteData(0, 0, buffer, kSize, &callback, false);
+    EXPECT_EQ(net::ERR_IO_PENDING, rv);
+    entry->Close();
+
+    // The cache destructor will complete the pending write.
+    delete cache;
+    EXPECT_TRUE(callback.have_result());
+    EXPECT_EQ(kSize, callback.WaitForResult());
+  }
+
+  MessageLoop::current()->RunAllPending();
+}
+
 void DiskCacheBackendTest::BackendSetSize() {
   SetDirectMode();
   const int cache_size = 0x10000;  // 64 kB
@@ -300,6 +696,68 @@ TEST_F(DiskCacheBackendTest, MemoryOnlySetSize) {
   BackendSetSize();
 }
 
+// Tests that the entries to evict can be selected by GreedyDual instead of LRU:
+// large entries go away before the small ones, even if they were used more
+// recently.
+TEST_F(DiskCacheTest, GreedyDualEviction) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  const int kCacheSize = 4 * 1024 * 1024;
+  const int kSmallSize = 1024;
+  const int kLargeSize = 400 * 1024;
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kLargeSize);
+  CacheTestFillBuffer(buffer->data(), kLargeSize, false);
+
+  int num_large = 0;
+  for (int run = 0; run < 2; run++) {
+    disk_cache::BackendImpl* cache = new disk_cache::BackendImpl(path);
+    cache->SetUnitTestMode();
+    ASSERT_TRUE(cache->SetMaxSize(kCacheSize));
+    cache->SetFlags(disk_cache::kNoRandom);
+    cache->SetEvictionPolicy(disk_cache::GREEDY_DUAL_POLICY);
+    ASSERT_TRUE(cache->Init());
+
+    disk_cache::Entry* entry;
+    if (!run) {
+      for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(cache->CreateEntry(StringPrintf("small %d", i), &entry));
+        EXPECT_EQ(kSmallSize,
+                  entry->WriteData(1, 0, buffer, kSmallSize, NULL, false));
+        entry->Close();
+      }
+    }
+
+    // The cache is trimmed to 3 MB after going over 4 MB, so each run evicts
+    // the four oldest large entries. On the second run, the policy is loaded
+    // from the entries stored on disk.
+    int last_large = num_large + (run ? 4 : 11);
+    for (; num_large < last_large; num_large++) {
+      ASSERT_TRUE(cache->CreateEntry(StringPrintf("large %d", num_large),
+                                     &entry));
+      EXPECT_EQ(kLargeSize,
+                entry->WriteData(1, 0, buffer, kLargeSize, NULL, false));
+      entry->Close();
+    }
+    MessageLoop::current()->RunAllPending();
+
+    if (run) {
+      for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(cache->OpenEntry(StringPrintf("small %d", i), &entry));
+        entry->Close();
+      }
+      for (int i = 0; i < num_large; i++) {
+        bool evicted = i < 8;
+        EXPECT_EQ(!evicted,
+                  cache->OpenEntry(StringPrintf("large %d", i), &entry)) << i;
+        if (!evicted)
+          entry->Close();
+      }
+    }
+    delete cache;
+  }
+}
+
 void DiskCacheBackendTest::BackendLoad() {
   InitCache();
   int seed = static_cast<int>(Time::Now().ToInternalValue());
@@ -346,6 +804,38 @@ TEST_F(DiskCacheBackendTest, NewEvictionLoad) {
   BackendLoad();
 }
 
+// Uses the memory cache from multiple threads at the same time, while the
+// cache is trimmed.
+TEST_F(DiskCacheBackendTest, MemoryOnlyMultipleThreads) {
+  SetMemoryOnlyMode();
+  SetMaxSize(40 * 1024);
+  InitCache();
+
+  const int kNumThreads = 4;
+  ScopedVector<base::Thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    base::Thread* thread = new base::Thread("Cache user");
+    threads.push_back(thread);
+    ASSERT_TRUE(thread->Start());
+    thread->message_loop()->PostTask(FROM_HERE,
+        NewRunnableFunction(&UseCacheFromThread, cache_, i));
+  }
+
+  // Wait until all the threads are done.
+  threads.reset();
+
+  void* iter = NULL;
+  int count = 0;
+  disk_cache::Entry* entry;
+  while (cache_->OpenNextEntry(&iter, &entry)) {
+    EXPECT_EQ(2000, entry->GetDataSize(0));
+    entry->Close();
+    count++;
+  }
+  cache_->EndEnumeration(&iter);
+  EXPECT_EQ(count, cache_->GetEntryCount());
+}
+
 TEST_F(DiskCacheBackendTest, MemoryOnlyLoad) {
   // Work with a tiny index table (16 entries)
   SetMaxSize(0x100000);
@@ -691,6 +1181,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyEnumerations) {
   BackendEnumerations();
 }
 
+TEST_F(DiskCacheBackendTest, ThreadedEnumerations) {
+  SetThreadedMode();
+  BackendEnumerations();
+}
+
 // Verifies enumerations while entries are open.
 void DiskCacheBackendTest::BackendEnumerations2() {
   InitCache();
@@ -1373,7 +1868,9 @@ void DiskCacheBackendTest::BackendDisable4() {
   ASSERT_TRUE(cache_->CreateEntry(key2, &entry2));
   ASSERT_TRUE(cache_->CreateEntry(key3, &entry3));
 
-  const int kBufSize = 20000;
+  // The data of entry3 goes to separate files, which remain usable. Data on
+  // block-files is not available once the cache is disabled.
+  const int kBufSize = disk_cache::kMaxLargeBlockSize + 20000;
   scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(kBufSize);
   memset(buf->data(), 0, kBufSize);
   EXPECT_EQ(100, entry2->WriteData(0, 0, buf, 100, NULL, false));
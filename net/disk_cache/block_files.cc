@@ -4,12 +4,15 @@
 
 #include "net/disk_cache/block_files.h"
 
+#include <algorithm>
+
 #include "base/file_util.h"
 #include "base/histogram.h"
 #include "base/string_util.h"
 #include "base/time.h"
 #include "net/disk_cache/cache_util.h"
 #include "net/disk_cache/file_lock.h"
+#include "net/disk_cache/journal.h"
 
 using base::Time;
 
@@ -136,6 +139,23 @@ void FixAllocationCounters(disk_cache::BlockFileHeader* header) {
   }
 }
 
+// Returns the maximum number of blocks for a file that stores blocks of
+// |entry_size| bytes. Files of large blocks are capped so that they don't end
+// up being huge.
+int MaxBlocksForEntrySize(int entry_size) {
+  if (entry_size <= disk_cache::kMaxBlockSize / disk_cache::kMaxNumBlocks)
+    return disk_cache::kMaxBlocks;
+  return disk_cache::kMaxLargeBlockFileData / entry_size;
+}
+
+// Returns the type of the blocks stored on the file with this header.
+disk_cache::FileType GetFileType(const disk_cache::BlockFileHeader* header) {
+  disk_cache::FileType type =
+      disk_cache::Addr::FileTypeForBlockSize(header->entry_size);
+  DCHECK_NE(disk_cache::EXTERNAL, type);
+  return type;
+}
+
 // Returns true if the current block file should not be used as-is to store more
 // records. |block_count| is the number of blocks to allocate.
 bool NeedToGrowBlockFile(const disk_cache::BlockFileHeader* header,
@@ -148,7 +168,8 @@ bool NeedToGrowBlockFile(const disk_cache::BlockFileHeader* header,
       have_space = true;
   }
 
-  if (header->next_file && (empty_blocks < disk_cache::kMaxBlocks / 10)) {
+  int max_blocks = MaxBlocksForEntrySize(header->entry_size);
+  if (header->next_file && (empty_blocks < max_blocks / 10)) {
     // This file is almost full but we already created another one, don't use
     // this file yet so that it is easier to find empty blocks when we start
     // using this file again.
@@ -185,6 +206,15 @@ bool BlockFiles::Init(bool create_files) {
     RemoveEmptyFile(static_cast<FileType>(i + 1));
   }
 
+  // The chains of large blocks are only present if they were ever needed.
+  for (int i = BLOCK_16K; i <= BLOCK_64K; i++) {
+    FileType block_type = static_cast<FileType>(i);
+    if (!HeadFile(block_type, false))
+      continue;
+
+    RemoveEmptyFile(block_type);
+  }
+
   init_ = true;
   return true;
 }
@@ -200,6 +230,18 @@ void BlockFiles::CloseFiles() {
   block_files_.clear();
 }
 
+void BlockFiles::SetJournal(Journal* journal) {
+  journal_ = journal;
+  for (unsigned int i = 0; i < block_files_.size(); i++) {
+    if (!block_files_[i])
+      continue;
+    BlockFileHeader* header =
+        reinterpret_cast<BlockFileHeader*>(block_files_[i]->buffer());
+    if (GetFileType(header) == RANKINGS)
+      block_files_[i]->set_journal(journal, i);
+  }
+}
+
 FilePath BlockFiles::Name(int index) {
   // The file format allows for 256 files.
   DCHECK(index < 256 || index >= 0);
@@ -247,6 +289,11 @@ bool BlockFiles::OpenBlockFile(int index) {
   }
 
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
+  if (kBlockMagic == header->magic && 0x20000 == header->version) {
+    // Files from version 2.0 are valid as they are; the index was upgraded
+    // before the block-files are opened.
+    header->version = kCurrentVersion;
+  }
   if (kBlockMagic != header->magic || kCurrentVersion != header->version) {
     LOG(ERROR) << "Invalid file version or magic";
     return false;
@@ -258,6 +305,9 @@ bool BlockFiles::OpenBlockFile(int index) {
       return false;
   }
 
+  if (journal_ && GetFileType(header) == RANKINGS)
+    file->set_journal(journal_, index);
+
   DCHECK(!block_files_[index]);
   file.swap(&block_files_[index]);
   return true;
@@ -281,13 +331,15 @@ MappedFile* BlockFiles::GetFile(Addr address) {
 }
 
 bool BlockFiles::GrowBlockFile(MappedFile* file, BlockFileHeader* header) {
-  if (kMaxBlocks == header->max_entries)
+  int max_blocks = MaxBlocksForEntrySize(header->entry_size);
+  if (max_blocks <= header->max_entries)
     return false;
 
+  // Files of large blocks grow in smaller steps.
   DCHECK(!header->empty[3]);
-  int new_size = header->max_entries + 1024;
-  if (new_size > kMaxBlocks)
-    new_size = kMaxBlocks;
+  int new_size = header->max_entries + std::min(1024, max_blocks / 8);
+  if (new_size > max_blocks)
+    new_size = max_blocks;
 
   int new_size_bytes = new_size * header->entry_size + sizeof(*header);
 
@@ -309,14 +361,56 @@ bool BlockFiles::GrowBlockFile(MappedFile* file, BlockFileHeader* header) {
   return true;
 }
 
-MappedFile* BlockFiles::FileForNewBlock(FileType block_type, int block_count) {
+MappedFile* BlockFiles::HeadFile(FileType block_type, bool create) {
   COMPILE_ASSERT(RANKINGS == 1, invalid_fily_type);
-  MappedFile* file = block_files_[block_type - 1];
+  if (block_type < BLOCK_16K)
+    return block_files_[block_type - 1];
+
+  // The chains of large blocks are created on demand, so the rankings file
+  // keeps track of where they start.
+  BlockFileHeader* rankings_header =
+      reinterpret_cast<BlockFileHeader*>(block_files_[0]->buffer());
+  int32* head = &rankings_header->large_files[block_type - BLOCK_16K];
+  if (*head && (*head < kFirstAdditionlBlockFile || *head > kMaxBlockFile)) {
+    LOG(ERROR) << "Invalid head for the chain of large blocks";
+    *head = 0;
+  }
+
+  if (!*head) {
+    if (!create)
+      return NULL;
+
+    int new_file = CreateNextBlockFile(block_type);
+    if (!new_file)
+      return NULL;
+
+    FileLock lock(rankings_header);
+    *head = new_file;
+  }
+
+  // Only the block_file argument is relevant for what we want.
+  Addr address(BLOCK_256, 1, *head, 0);
+  MappedFile* file = GetFile(address);
+  if (!file)
+    return NULL;
+
+  BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
+  if (header->entry_size != Addr::BlockSizeForFileType(block_type)) {
+    LOG(ERROR) << "Unexpected block size for the chain of large blocks";
+    return NULL;
+  }
+  return file;
+}
+
+MappedFile* BlockFiles::FileForNewBlock(FileType block_type, int block_count) {
+  MappedFile* file = HeadFile(block_type, true);
+  if (!file)
+    return NULL;
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
 
   Time start = Time::Now();
   while (NeedToGrowBlockFile(header, block_count)) {
-    if (kMaxBlocks == header->max_entries) {
+    if (MaxBlocksForEntrySize(header->entry_size) <= header->max_entries) {
       file = NextFile(file);
       if (!file)
         return NULL;
@@ -336,13 +430,7 @@ MappedFile* BlockFiles::NextFile(const MappedFile* file) {
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
   int new_file = header->next_file;
   if (!new_file) {
-    // RANKINGS is not reported as a type for small entries, but we may be
-    // extending the rankings block file.
-    FileType type = Addr::RequiredFileType(header->entry_size);
-    if (header->entry_size == Addr::BlockSizeForFileType(RANKINGS))
-      type = RANKINGS;
-
-    new_file = CreateNextBlockFile(type);
+    new_file = CreateNextBlockFile(GetFileType(header));
     if (!new_file)
       return NULL;
 
@@ -366,7 +454,9 @@ int BlockFiles::CreateNextBlockFile(FileType block_type) {
 // We walk the list of files for this particular block type, deleting the ones
 // that are empty.
 void BlockFiles::RemoveEmptyFile(FileType block_type) {
-  MappedFile* file = block_files_[block_type - 1];
+  MappedFile* file = HeadFile(block_type, false);
+  if (!file)
+    return;
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
 
   while (header->next_file) {
@@ -402,7 +492,7 @@ void BlockFiles::RemoveEmptyFile(FileType block_type) {
 
 bool BlockFiles::CreateBlock(FileType block_type, int block_count,
                              Addr* block_address) {
-  if (block_type < RANKINGS || block_type > BLOCK_4K ||
+  if (block_type < RANKINGS || block_type > BLOCK_64K ||
       block_count < 1 || block_count > 4)
     return false;
   if (!init_)
@@ -437,27 +527,33 @@ void BlockFiles::DeleteBlock(Addr address, bool deep) {
     return;
 
   if (!zero_buffer_) {
-    zero_buffer_ = new char[Addr::BlockSizeForFileType(BLOCK_4K) * 4];
-    memset(zero_buffer_, 0, Addr::BlockSizeForFileType(BLOCK_4K) * 4);
+    zero_buffer_ = new char[kMaxBlockSize];
+    memset(zero_buffer_, 0, kMaxBlockSize);
   }
   MappedFile* file = GetFile(address);
   if (!file)
     return;
 
+  // A pending version of this node should not land on a free block.
+  if (journal_ && address.file_type() == RANKINGS)
+    journal_->Discard(address);
+
   size_t size = address.BlockSize() * address.num_blocks();
   size_t offset = address.start_block() * address.BlockSize() +
                   kBlockHeaderSize;
-  if (deep)
-    file->Write(zero_buffer_, size, offset);
+  if (deep) {
+    // Large blocks are cleared one piece at a time.
+    for (size_t done = 0; done < size; done += kMaxBlockSize) {
+      size_t len = std::min(size - done, static_cast<size_t>(kMaxBlockSize));
+      file->Write(zero_buffer_, len, offset + done);
+    }
+  }
 
   BlockFileHeader* header = reinterpret_cast<BlockFileHeader*>(file->buffer());
   DeleteMapBlock(address.start_block(), address.num_blocks(), header);
   if (!header->num_entries) {
     // This file is now empty. Let's try to delete it.
-    FileType type = Addr::RequiredFileType(header->entry_size);
-    if (Addr::BlockSizeForFileType(RANKINGS) == header->entry_size)
-      type = RANKINGS;
-    RemoveEmptyFile(type);
+    RemoveEmptyFile(GetFileType(header));
   }
 }
 
@@ -469,7 +565,9 @@ bool BlockFiles::FixBlockFileHeader(MappedFile* file) {
 
   int expected = header->entry_size * header->max_entries + sizeof(*header);
   if (file_size != expected) {
-    int max_expected = header->entry_size * kMaxBlocks + sizeof(*header);
+    int64 max_expected =
+        static_cast<int64>(header->entry_size) *
+        MaxBlocksForEntrySize(header->entry_size) + sizeof(*header);
     if (file_size < expected || header->empty[3] || file_size > max_expected) {
       NOTREACHED();
       LOG(ERROR) << "Unexpected file size";
@@ -17,12 +17,13 @@
 namespace disk_cache {
 
 class EntryImpl;
+class Journal;
 
 // This class handles the set of block-files open by the disk cache.
 class BlockFiles {
  public:
   explicit BlockFiles(const FilePath& path)
-      : init_(false), zero_buffer_(NULL), path_(path) {}
+      : init_(false), zero_buffer_(NULL), path_(path), journal_(NULL) {}
   ~BlockFiles();
 
   // Performs the object initialization. create_files indicates if the backing
@@ -46,6 +47,10 @@ class BlockFiles {
   // cache is being purged.
   void CloseFiles();
 
+  // Sends all reads and writes of rankings nodes through |journal|, or directly
+  // to the block files if |journal| is NULL.
+  void SetJournal(Journal* journal);
+
  private:
   // Set force to true to overwrite the file if it exists.
   bool CreateBlockFile(int index, FileType file_type, bool force);
@@ -54,6 +59,11 @@ class BlockFiles {
   // Attemp to grow this file. Fails if the file cannot be extended anymore.
   bool GrowBlockFile(MappedFile* file, BlockFileHeader* header);
 
+  // Returns the first file of the chain that stores blocks of |block_type|.
+  // The chains of large blocks are created only when |create| is true, so this
+  // method may return NULL.
+  MappedFile* HeadFile(FileType block_type, bool create);
+
   // Returns the appropriate file to use for a new block.
   MappedFile* FileForNewBlock(FileType block_type, int block_count);
 
@@ -76,6 +86,7 @@ class BlockFiles {
   char* zero_buffer_;  // Buffer to speed-up cleaning deleted entries.
   FilePath path_;  // Path to the backing folder.
   std::vector<MappedFile*> block_files_;  // The actual files.
+  Journal* journal_;  // Not owned.
 
   FRIEND_TEST(DiskCacheTest, BlockFiles_ZeroSizeFile);
   FRIEND_TEST(DiskCacheTest, BlockFiles_InvalidFile);
@@ -77,6 +77,49 @@ TEST_F(DiskCacheTest, BlockFiles_Shrink) {
   EXPECT_EQ(4, NumberOfFiles(path));
 }
 
+// The chains of 16 KB and 64 KB blocks are created when needed, and they are
+// limited in size.
+TEST_F(DiskCacheTest, BlockFiles_LargeBlocks) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+  ASSERT_TRUE(file_util::CreateDirectory(path));
+
+  {
+    BlockFiles files(path);
+    ASSERT_TRUE(files.Init(true));
+    EXPECT_EQ(4, NumberOfFiles(path));
+
+    Addr address;
+    EXPECT_TRUE(files.CreateBlock(BLOCK_64K, 2, &address));
+    EXPECT_EQ(BLOCK_64K, address.file_type());
+    EXPECT_EQ(65536, address.BlockSize());
+    EXPECT_EQ(5, NumberOfFiles(path));
+
+    // 64 MB worth of 16 KB blocks fill up the first file of the chain.
+    const int kMaxSize = kMaxLargeBlockFileData / (16384 * 4);
+    Addr addresses[kMaxSize + 1];
+    for (int i = 0; i < kMaxSize + 1; i++) {
+      EXPECT_TRUE(files.CreateBlock(BLOCK_16K, 4, &addresses[i]));
+      EXPECT_EQ(BLOCK_16K, addresses[i].file_type());
+    }
+    EXPECT_EQ(7, NumberOfFiles(path));
+
+    // The extra file goes away, but the first file of each chain stays.
+    for (int i = 0; i < kMaxSize + 1; i++) {
+      files.DeleteBlock(addresses[i], true);
+    }
+    EXPECT_EQ(6, NumberOfFiles(path));
+  }
+
+  // The chains should be found again.
+  BlockFiles files(path);
+  ASSERT_TRUE(files.Init(false));
+  Addr address;
+  EXPECT_TRUE(files.CreateBlock(BLOCK_16K, 1, &address));
+  EXPECT_TRUE(files.CreateBlock(BLOCK_64K, 1, &address));
+  EXPECT_EQ(6, NumberOfFiles(path));
+}
+
 // Handling of block files not properly closed.
 TEST_F(DiskCacheTest, BlockFiles_Recover) {
   FilePath path = GetCacheFilePath();
@@ -41,6 +41,14 @@ typedef net::CompletionCallback CompletionCallback;
 Backend* CreateCacheBackend(const FilePath& path, bool force,
                             int max_bytes, net::CacheType type);
 
+// Returns an instance of a disk Backend that performs all index, rankings and
+// block-file IO on a dedicated cache thread. The arguments have the same
+// meaning as for CreateCacheBackend(). Completion callbacks are invoked on the
+// thread that issued the request, which must have a MessageLoop; the
+// deprecated synchronous methods block until the cache thread is done.
+Backend* CreateThreadedCacheBackend(const FilePath& path, bool force,
+                                    int max_bytes, net::CacheType type);
+
 // Returns an instance of a Backend implemented only in memory. The returned
 // object should be deleted when not needed anymore. max_bytes is the maximum
 // size the cache can grow to. If zero is passed in as max_bytes, the cache will
@@ -2,17 +2,21 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/perftimer.h"
+#include "base/scoped_vector.h"
 #include "base/string_util.h"
 #include "base/test/test_file_util.h"
 #include "base/timer.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/block_files.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
@@ -132,6 +136,227 @@ int TimeRead(int num_entries, disk_cache::Backend* cache,
   return expected;
 }
 
+// Keeps track of a burst of simultaneous requests.
+struct RequestsBurst {
+  RequestsBurst() : pending(0), waiting(false) {}
+
+  std::vector<int64> latencies;  // In microseconds.
+  int pending;  // Number of requests not completed yet.
+  bool waiting;  // True while the message loop is running for this burst.
+};
+
+// Performs an open followed by a read of the data stream of a given entry, and
+// records the time elapsed since the request was issued.
+class ConcurrentRequest {
+ public:
+  ConcurrentRequest(disk_cache::Backend* cache, const TestEntry& entry,
+                    RequestsBurst* burst)
+      : cache_(cache), test_entry_(entry), entry_(NULL),
+        buffer_(new net::IOBuffer(kMaxSize)), burst_(burst), reading_(false),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            callback_(this, &ConcurrentRequest::OnIOComplete)) {}
+
+  // |start| is the time when the whole burst of requests was issued.
+  void Start(const base::TimeTicks& start) {
+    start_ = start;
+    burst_->pending++;
+    int rv = cache_->OpenEntry(test_entry_.key, &entry_, &callback_);
+    if (rv != net::ERR_IO_PENDING)
+      OnIOComplete(rv);
+  }
+
+ private:
+  void OnIOComplete(int result) {
+    if (!reading_ && result == net::OK) {
+      reading_ = true;
+      int rv = entry_->ReadData(1, 0, buffer_, test_entry_.data_len,
+                                &callback_);
+      if (rv != net::ERR_IO_PENDING)
+        OnIOComplete(rv);
+      return;
+    }
+
+    if (entry_)
+      entry_->Close();
+    entry_ = NULL;
+    base::TimeDelta latency = base::TimeTicks::Now() - start_;
+    burst_->latencies.push_back(latency.InMicroseconds());
+    if (!--burst_->pending && burst_->waiting)
+      MessageLoop::current()->Quit();
+  }
+
+  disk_cache::Backend* cache_;
+  TestEntry test_entry_;
+  disk_cache::Entry* entry_;
+  scoped_refptr<net::IOBuffer> buffer_;
+  RequestsBurst* burst_;
+  bool reading_;
+  base::TimeTicks start_;
+  net::CompletionCallbackImpl<ConcurrentRequest> callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentRequest);
+};
+
+// Issues open + read requests for every entry listed on |entries|, in bursts of
+// |concurrency| simultaneous requests, and logs the latency percentiles.
+void TimeConcurrentReads(const char* name, disk_cache::Backend* cache,
+                         const TestEntries& entries, int concurrency) {
+  RequestsBurst burst;
+
+  PerfTimeLogger timer(name);
+  for (size_t i = 0; i < entries.size(); i += concurrency) {
+    ScopedVector<ConcurrentRequest> requests;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t j = i; j < entries.size() && j < i + concurrency; j++) {
+      ConcurrentRequest* request =
+          new ConcurrentRequest(cache, entries[j], &burst);
+      requests.push_back(request);
+      request->Start(start);
+    }
+    if (burst.pending) {
+      burst.waiting = true;
+      MessageLoop::current()->Run();
+      burst.waiting = false;
+    }
+  }
+  timer.Done();
+
+  std::vector<int64>& latencies = burst.latencies;
+  ASSERT_FALSE(latencies.empty());
+  std::sort(latencies.begin(), latencies.end());
+  const int kPercentiles[] = { 50, 90, 99 };
+  for (size_t i = 0; i < arraysize(kPercentiles); i++) {
+    size_t index = latencies.size() * kPercentiles[i] / 100;
+    if (index >= latencies.size())
+      index = latencies.size() - 1;
+    std::string test_name = StringPrintf("%s p%d", name, kPercentiles[i]);
+    LogPerfResult(test_name.c_str(), static_cast<double>(latencies[index]),
+                  "us");
+  }
+}
+
+// Returns the number of files in this folder.
+int NumberOfFiles(const FilePath& path) {
+  file_util::FileEnumerator iter(path, false, file_util::FileEnumerator::FILES);
+  int count = 0;
+  for (FilePath file = iter.Next(); !file.value().empty(); file = iter.Next()) {
+    count++;
+  }
+  return count;
+}
+
+// Removes every file on this folder from the OS cache.
+bool EvictFilesFromSystemCache(const FilePath& path) {
+  file_util::FileEnumerator iter(path, false, file_util::FileEnumerator::FILES);
+  for (FilePath file = iter.Next(); !file.value().empty(); file = iter.Next()) {
+    if (!file_util::EvictFileFromSystemCache(file))
+      return false;
+  }
+  return true;
+}
+
+// Stores |num_entries| with 16 KB to 256 KB of data on a cache created with
+// |flags|, and measures the number of files used and the time it takes to read
+// the entries back.
+void TimeMediumSizedEntries(const char* name, uint32 flags, int num_entries) {
+  ScopedTestCache test_cache;
+  disk_cache::BackendImpl* cache =
+      new disk_cache::BackendImpl(test_cache.path());
+  cache->SetFlags(disk_cache::kNoRandom | flags);
+  ASSERT_TRUE(cache->Init());
+
+  const int kMaxDataSize = disk_cache::kMaxLargeBlockSize;
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(kMaxDataSize);
+  CacheTestFillBuffer(buffer->data(), kMaxDataSize, false);
+
+  TestEntries entries;
+  for (int i = 0; i < num_entries; i++) {
+    TestEntry entry;
+    entry.key = GenerateKey(true);
+    entry.data_len = disk_cache::kMaxBlockSize + 1 +
+                     rand() % (kMaxDataSize - disk_cache::kMaxBlockSize);
+    entries.push_back(entry);
+
+    disk_cache::Entry* cache_entry;
+    ASSERT_TRUE(cache->CreateEntry(entry.key, &cache_entry));
+    EXPECT_EQ(entry.data_len, cache_entry->WriteData(1, 0, buffer,
+                                                     entry.data_len, NULL,
+                                                     false));
+    cache_entry->Close();
+  }
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+
+  std::string test_name = StringPrintf("%s files", name);
+  LogPerfResult(test_name.c_str(), NumberOfFiles(test_cache.path()), "files");
+  ASSERT_TRUE(EvictFilesFromSystemCache(test_cache.path()));
+
+  cache = new disk_cache::BackendImpl(test_cache.path());
+  cache->SetFlags(disk_cache::kNoRandom | flags);
+  ASSERT_TRUE(cache->Init());
+
+  PerfTimeLogger timer(name);
+  for (int i = 0; i < num_entries; i++) {
+    disk_cache::Entry* cache_entry;
+    ASSERT_TRUE(cache->OpenEntry(entries[i].key, &cache_entry));
+    EXPECT_EQ(entries[i].data_len, cache_entry->ReadData(1, 0, buffer,
+                                                         entries[i].data_len,
+                                                         NULL));
+    cache_entry->Close();
+  }
+  timer.Done();
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
+// Stores |num_entries| on a cache, and measures the time it takes to open the
+// entries (from the most to the least recently used) after restarting the cache
+// with |flags| and an empty system cache. When the warm-up stage is enabled, it
+// runs to completion before the entries are opened.
+void TimeColdStart(const char* name, uint32 flags, int num_entries) {
+  ScopedTestCache test_cache;
+  disk_cache::BackendImpl* cache =
+      new disk_cache::BackendImpl(test_cache.path());
+  cache->SetFlags(disk_cache::kNoRandom);
+  ASSERT_TRUE(cache->Init());
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_entries; i++) {
+    keys.push_back(GenerateKey(true));
+    disk_cache::Entry* cache_entry;
+    ASSERT_TRUE(cache->CreateEntry(keys.back(), &cache_entry));
+    cache_entry->Close();
+  }
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+
+  ASSERT_TRUE(EvictFilesFromSystemCache(test_cache.path()));
+
+  cache = new disk_cache::BackendImpl(test_cache.path());
+  cache->SetFlags(disk_cache::kNoRandom | flags);
+  ASSERT_TRUE(cache->Init());
+
+  if (cache->IsWarmingUp()) {
+    std::string test_name = StringPrintf("%s, warm up", name);
+    PerfTimeLogger timer(test_name.c_str());
+    while (cache->IsWarmingUp())
+      MessageLoop::current()->RunAllPending();
+    timer.Done();
+  }
+
+  PerfTimeLogger timer(name);
+  for (int i = num_entries - 1; i >= 0; i--) {
+    disk_cache::Entry* cache_entry;
+    ASSERT_TRUE(cache->OpenEntry(keys[i], &cache_entry));
+    cache_entry->Close();
+  }
+  timer.Done();
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
@@ -197,6 +422,91 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   delete cache;
 }
 
+// Compares the latency of bursts of simultaneous requests when the cache runs
+// on the current thread with the latency observed when the cache runs on its
+// own thread. In the first case, every request has to wait for all previous
+// requests of the burst to finish.
+TEST_F(DiskCacheTest, CacheBackendConcurrency) {
+  MessageLoopForIO message_loop;
+
+  ScopedTestCache test_cache;
+  disk_cache::Backend* cache =
+      disk_cache::CreateCacheBackend(test_cache.path(), false, 0,
+                                     net::DISK_CACHE);
+  ASSERT_TRUE(NULL != cache);
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  TestEntries entries;
+  const int kNumEntries = 1000;
+  const int kConcurrency = 32;
+
+  int ret = TimeWrite(kNumEntries, cache, &entries);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+
+  const char* kFiles[] = { "index", "data_0", "data_1", "data_2", "data_3" };
+  for (size_t i = 0; i < arraysize(kFiles); i++) {
+    ASSERT_TRUE(file_util::EvictFileFromSystemCache(
+                test_cache.path().AppendASCII(kFiles[i])));
+  }
+
+  cache = disk_cache::CreateCacheBackend(test_cache.path(), false, 0,
+                                         net::DISK_CACHE);
+  ASSERT_TRUE(NULL != cache);
+  TimeConcurrentReads("Concurrent reads, same thread (cold)", cache, entries,
+                      kConcurrency);
+  TimeConcurrentReads("Concurrent reads, same thread (warm)", cache, entries,
+                      kConcurrency);
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+
+  for (size_t i = 0; i < arraysize(kFiles); i++) {
+    ASSERT_TRUE(file_util::EvictFileFromSystemCache(
+                test_cache.path().AppendASCII(kFiles[i])));
+  }
+
+  cache = disk_cache::CreateThreadedCacheBackend(test_cache.path(), false, 0,
+                                                 net::DISK_CACHE);
+  ASSERT_TRUE(NULL != cache);
+  TimeConcurrentReads("Concurrent reads, cache thread (cold)", cache, entries,
+                      kConcurrency);
+  TimeConcurrentReads("Concurrent reads, cache thread (warm)", cache, entries,
+                      kConcurrency);
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
+// Compares the number of files and the cold read time of data between 16 KB and
+// 256 KB, when it is stored on separate files and on large block-files.
+TEST_F(DiskCacheTest, LargeBlocksPerformance) {
+  MessageLoopForIO message_loop;
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  const int kNumEntries = 500;
+  TimeMediumSizedEntries("Read medium entries, separate files",
+                         disk_cache::kNoLargeBlocks, kNumEntries);
+  TimeMediumSizedEntries("Read medium entries, block-files", 0, kNumEntries);
+}
+
+// Measures the time it takes to open the first entries after starting a cache
+// that is not on the system cache, with and without the warm-up stage.
+TEST_F(DiskCacheTest, ColdStartPerformance) {
+  MessageLoopForIO message_loop;
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  const int kNumEntries = 2000;
+  TimeColdStart("First opens, no warm up", 0, kNumEntries);
+  TimeColdStart("First opens, warm up", disk_cache::kWarmUp, kNumEntries);
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
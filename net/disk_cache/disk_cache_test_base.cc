@@ -7,6 +7,7 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/threaded_backend.h"
 
 void DiskCacheTest::TearDown() {
   MessageLoop::current()->RunAllPending();
@@ -59,6 +60,14 @@ void DiskCacheTestWithCache::InitDiskCache() {
   if (implementation_)
     return InitDiskCacheImpl(path);
 
+  if (threaded_) {
+    disk_cache::ThreadedBackend* cache = new disk_cache::ThreadedBackend();
+    cache_ = cache;
+    ASSERT_TRUE(cache->Init(path, force_creation_, size_, net::DISK_CACHE,
+                            disk_cache::kNoRandom));
+    return;
+  }
+
   cache_ = disk_cache::BackendImpl::CreateBackend(path, force_creation_, size_,
                                                   net::DISK_CACHE,
                                                   disk_cache::kNoRandom);
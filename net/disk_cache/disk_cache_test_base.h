@@ -33,7 +33,8 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   DiskCacheTestWithCache()
       : cache_(NULL), cache_impl_(NULL), mem_cache_(NULL), mask_(0), size_(0),
         memory_only_(false), implementation_(false), force_creation_(false),
-        new_eviction_(false), first_cleanup_(true), integrity_(true) {}
+        new_eviction_(false), first_cleanup_(true), integrity_(true),
+        threaded_(false) {}
 
   void InitCache();
   virtual void TearDown();
@@ -72,6 +73,11 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     integrity_ = false;
   }
 
+  // Runs the disk cache on a dedicated cache thread.
+  void SetThreadedMode() {
+    threaded_ = true;
+  }
+
   // cache_ will always have a valid object, regardless of how the cache was
   // initialized. The implementation pointers can be NULL.
   disk_cache::Backend* cache_;
@@ -86,6 +92,7 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   bool new_eviction_;
   bool first_cleanup_;
   bool integrity_;
+  bool threaded_;
   // This is intentionally left uninitialized, to be used by any test.
   bool success_;
 
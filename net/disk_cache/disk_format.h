@@ -63,7 +63,10 @@ typedef uint32 CacheAddr;
 
 const int kIndexTablesize = 0x10000;
 const uint32 kIndexMagic = 0xC103CAC3;
-const uint32 kCurrentVersion = 0x20000;  // Version 2.0.
+// Version 3.0 stores medium-sized data on large blocks, and may store the data
+// stream of an entry compressed (COMPRESSED_DATA). Caches from version 2 are
+// upgraded when they are opened, and older code discards version 3 caches.
+const uint32 kCurrentVersion = 0x30000;  // Version 3.0.
 
 struct LruData {
   int32     pad1[2];
@@ -90,7 +93,8 @@ struct IndexHeader {
   int32       crash;         // Signals a previous crash.
   int32       experiment;    // Id of an ongoing test.
   uint64      create_time;   // Creation time for this set of files.
-  int32       pad[52];
+  int32       large_blocks;  // Medium-sized data is kept on block-files.
+  int32       pad[51];
   LruData     lru;           // Eviction control data.
   IndexHeader() {
     memset(this, 0, sizeof(*this));
@@ -124,7 +128,8 @@ struct EntryStore {
   int32       data_size[4];       // We can store up to 4 data streams for each
   CacheAddr   data_addr[4];       // entry.
   uint32      flags;              // Any combination of EntryFlags.
-  int32       pad[5];
+  int32       compressed_size;    // Stored size of data_addr[1] if compressed.
+  int32       pad[4];
   char        key[256 - 24 * 4];  // null terminated
 };
 
@@ -142,7 +147,8 @@ enum EntryState {
 // Flags that can be applied to an entry.
 enum EntryFlags {
   PARENT_ENTRY = 1,         // This entry has children (sparse) entries.
-  CHILD_ENTRY = 1 << 1      // Child entry that stores sparse data.
+  CHILD_ENTRY = 1 << 1,     // Child entry that stores sparse data.
+  COMPRESSED_DATA = 1 << 2  // The data of stream 1 is compressed with zlib.
 };
 
 #pragma pack(push, 4)
@@ -160,10 +166,41 @@ struct RankingsNode {
 
 COMPILE_ASSERT(sizeof(RankingsNode) == 36, bad_RankingsNode);
 
+// The write-behind journal of rankings nodes (see journal.h) is stored on its
+// own file, with a JournalHeader followed by kJournalRecords JournalRecords. A
+// record is valid if its index is below num_records. The records only apply to
+// the set of files with the same create_time (see IndexHeader).
+const uint32 kJournalMagic = 0xC105CAC3;
+const int kJournalRecords = 1024;
+
+struct JournalHeader {
+  uint32      magic;
+  uint32      version;
+  int32       num_records;      // Number of records not yet flushed.
+  int32       pad1;
+  uint64      create_time;      // Creation time of the index of the records.
+  int32       pad[10];
+};
+
+COMPILE_ASSERT(sizeof(JournalHeader) == 64, bad_JournalHeader);
+
+#pragma pack(push, 4)
+struct JournalRecord {
+  CacheAddr     address;        // Address of the rankings node.
+  RankingsNode  node;           // Last stored version of the node.
+};
+#pragma pack(pop)
+
+COMPILE_ASSERT(sizeof(JournalRecord) == 40, bad_JournalRecord);
+
 const uint32 kBlockMagic = 0xC104CAC3;
 const int kBlockHeaderSize = 8192;  // Two pages: almost 64k entries
 const int kMaxBlocks = (kBlockHeaderSize - 80) * 8;
 
+// Files that store 16k or 64k blocks are limited to this much data, so only the
+// first segment of their allocation bitmap is ever used.
+const int kMaxLargeBlockFileData = 64 * 1024 * 1024;
+
 // Bitmap to track used blocks on a block-file.
 typedef uint32 AllocBitmap[kMaxBlocks / 32];
 
@@ -186,7 +223,9 @@ struct BlockFileHeader {
   int32           empty[4];     // Counters of empty entries for each type.
   int32           hints[4];     // Last used position for each entry type.
   volatile int32  updating;     // Keep track of updates to the header.
-  int32           user[5];
+  int32           large_files[2];  // First file of the chains of 16k and 64k
+                                   // blocks (only used by the rankings file).
+  int32           user[3];
   AllocBitmap     allocation_map;
   BlockFileHeader() {
     memset(this, 0, sizeof(BlockFileHeader));
@@ -236,13 +275,29 @@ COMPILE_ASSERT(sizeof(BlockFileHeader) == kBlockHeaderSize, bad_header);
 // It is possible to write to a child entry in a way that causes the last block
 // to be only partialy filled. In that case, last_block and last_block_len will
 // keep track of that block.
+// If a parent entry has SPARSE_EXTENTS set on flags, the bitmap of children is
+// followed by num_extents SparseExtent structures that describe all the data
+// stored by the children.
 struct SparseHeader {
   int64 signature;          // The parent and children signature.
   uint32 magic;             // Structure identifier (equal to kIndexMagic).
   int32 parent_key_len;     // Key length for the parent entry.
   int32 last_block;         // Index of the last written block.
   int32 last_block_len;     // Lenght of the last written block.
-  int32 dummy[10];
+  uint32 flags;             // Any combination of SparseFlags.
+  int32 num_extents;        // Number of SparseExtent items stored.
+  int32 dummy[8];
+};
+
+// Flags that can be applied to a SparseHeader.
+enum SparseFlags {
+  SPARSE_EXTENTS = 1        // The parent keeps track of the stored ranges.
+};
+
+// A range of data, [start, end), stored by the children of a parent entry.
+struct SparseExtent {
+  int64 start;
+  int64 end;
 };
 
 // The SparseHeader will be followed by a bitmap, as described by this
@@ -15,6 +15,12 @@
 #include "net/disk_cache/histogram_macros.h"
 #include "net/disk_cache/sparse_control.h"
 
+#if defined(USE_SYSTEM_ZLIB)
+#include <zlib.h>
+#else
+#include "third_party/zlib/zlib.h"
+#endif
+
 using base::Time;
 using base::TimeDelta;
 
@@ -23,6 +29,13 @@ namespace {
 // Index for the file used to store the key, if any (files_[kKeyFileIndex]).
 const int kKeyFileIndex = 3;
 
+// Index of the stream that can be stored compressed, and the range of sizes
+// that we attempt to compress. The whole stream has to be uncompressed in
+// memory in order to read from it.
+const int kCompressedIndex = 1;
+const int kMinCompressSize = 2 * 1024;
+const int kMaxCompressSize = 1024 * 1024;
+
 // This class implements FileIOCallback to buffer the callback from a file IO
 // operation from the actual net class.
 class SyncCallback: public disk_cache::FileIOCallback {
@@ -88,6 +101,7 @@ EntryImpl::EntryImpl(BackendImpl* backend, Addr address)
     unreported_size_[i] = 0;
   }
   key_file_ = NULL;
+  compress_on_close_ = false;
 }
 
 // When an entry is deleted from the cache, we clean up all the data associated
@@ -115,6 +129,9 @@ EntryImpl::~EntryImpl() {
       }
     }
 
+    if (ret && compress_on_close_)
+      CompressData();
+
     if (!ret) {
       // There was a failure writing the actual data. Mark the entry as dirty.
       int current_id = backend_->GetCurrentEntryId();
@@ -208,6 +225,15 @@ int EntryImpl::ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
 
   backend_->OnEvent(Stats::READ_DATA);
 
+  if (index == kCompressedIndex && (GetEntryFlags() & COMPRESSED_DATA)) {
+    // The whole stream is kept in memory while the entry is open.
+    if (!uncompressed_data_.get() && !LoadCompressedData())
+      return net::ERR_FAILED;
+    memcpy(buf->data(), uncompressed_data_.get() + offset, buf_len);
+    ReportIOTime(kRead, start);
+    return buf_len;
+  }
+
   if (user_buffers_[index].get()) {
     // Complete the operation locally.
     DCHECK(kMaxBlockSize >= offset + buf_len);
@@ -272,6 +298,12 @@ int EntryImpl::WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
 
   Time start = Time::Now();
 
+  if (index == kCompressedIndex) {
+    if ((GetEntryFlags() & COMPRESSED_DATA) && !UncompressData())
+      return net::ERR_FAILED;
+    compress_on_close_ = backend_->ShouldCompressData();
+  }
+
   // Read the size at this point (it may change inside prepare).
   int entry_size = entry_.Data()->data_size[index];
   if (!PrepareTarget(index, offset, buf_len, truncate))
@@ -321,6 +353,15 @@ int EntryImpl::WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
   if (address.is_block_file()) {
     file_offset += address.start_block() * address.BlockSize() +
                    kBlockHeaderSize;
+    // Large blocks are written in place, and a block may hold old data past
+    // the end of the stream, so a gap before this write has to be cleared.
+    if (offset > entry_size) {
+      int gap = offset - entry_size;
+      scoped_array<char> zeros(new char[gap]);
+      memset(zeros.get(), 0, gap);
+      if (!file->Write(zeros.get(), gap, file_offset - gap, NULL, NULL))
+        return net::ERR_FAILED;
+    }
   } else if (truncate) {
     if (!file->SetLength(offset + buf_len))
       return net::ERR_FAILED;
@@ -472,6 +513,13 @@ void EntryImpl::InternalDoom() {
   doomed_ = true;
 }
 
+void EntryImpl::OnChildDoomed(const std::string& child_key, int64 child_id) {
+  if (!(GetEntryFlags() & PARENT_ENTRY) || net::OK != InitSparseData())
+    return;
+
+  sparse_->OnChildDoomed(child_key, child_id);
+}
+
 void EntryImpl::DeleteEntryData(bool everything) {
   DCHECK(doomed_ || !everything);
 
@@ -487,9 +535,11 @@ void EntryImpl::DeleteEntryData(bool everything) {
   for (int index = 0; index < kNumStreams; index++) {
     Addr address(entry_.Data()->data_addr[index]);
     if (address.is_initialized()) {
+      int32 stored_size = entry_.Data()->data_size[index];
+      if (index == kCompressedIndex && (GetEntryFlags() & COMPRESSED_DATA))
+        stored_size = entry_.Data()->compressed_size;
       DeleteData(address, index);
-      backend_->ModifyStorageSize(entry_.Data()->data_size[index] -
-                                      unreported_size_[index], 0);
+      backend_->ModifyStorageSize(stored_size - unreported_size_[index], 0);
       entry_.Data()->data_addr[index] = 0;
       entry_.Data()->data_size[index] = 0;
     }
@@ -637,6 +687,9 @@ bool EntryImpl::CreateBlock(int size, Addr* address) {
   DCHECK(!address->is_initialized());
 
   FileType file_type = Addr::RequiredFileType(size);
+  if (file_type > BLOCK_4K && !backend_->UseLargeBlocks())
+    file_type = EXTERNAL;
+
   if (EXTERNAL == file_type) {
     if (size > backend_->MaxFileSize())
       return false;
@@ -732,10 +785,14 @@ bool EntryImpl::GrowUserBuffer(int index, int offset, int buf_len,
   Addr address(entry_.Data()->data_addr[index]);
 
   if (offset + buf_len > kMaxBlockSize) {
-    // The data has to be stored externally.
+    // The data has to be stored on a large block or externally.
     if (address.is_initialized()) {
       if (address.is_separate_file())
         return true;
+      if (offset + buf_len <= address.BlockSize() * address.num_blocks())
+        return true;
+      if (entry_.Data()->data_size[index] > kMaxBlockSize)
+        return MoveData(index, offset + buf_len);
       if (!MoveToLocalBuffer(index))
         return false;
     }
@@ -802,6 +859,73 @@ bool EntryImpl::MoveToLocalBuffer(int index) {
   return true;
 }
 
+bool EntryImpl::MoveData(int index, int size) {
+  Addr address(entry_.Data()->data_addr[index]);
+  DCHECK(!user_buffers_[index].get());
+  DCHECK(address.is_initialized());
+
+  int len = entry_.Data()->data_size[index];
+  DCHECK(len <= size);
+  scoped_array<char> buffer(new char[std::max(len, 1)]);
+
+  File* file = GetBackingFile(address, index);
+  size_t offset = 0;
+  if (address.is_block_file())
+    offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
+
+  if (!file || !file->Read(buffer.get(), len, offset, NULL, NULL))
+    return false;
+
+  Addr new_address;
+  if (!CreateBlock(size, &new_address))
+    return false;
+
+  // The object used to access an external file is cached by files_[index], and
+  // the slot may be needed for the new storage.
+  if (address.is_separate_file())
+    files_[index] = NULL;
+
+  file = GetBackingFile(new_address, index);
+  offset = 0;
+  if (new_address.is_block_file()) {
+    offset = new_address.start_block() * new_address.BlockSize() +
+             kBlockHeaderSize;
+  }
+
+  if (!file || !file->Write(buffer.get(), len, offset, NULL, NULL)) {
+    DeleteData(new_address, index);
+    return false;
+  }
+
+  entry_.Data()->data_addr[index] = new_address.value();
+  entry_.Store();
+
+  DeleteData(address, index);
+  return true;
+}
+
+bool EntryImpl::PackExternalData(int* bytes_moved) {
+  if (doomed_)
+    return true;
+
+  for (int index = 0; index < kNumStreams; index++) {
+    Addr address(entry_.Data()->data_addr[index]);
+    int size = entry_.Data()->data_size[index];
+    if (!address.is_initialized() || address.is_block_file() || !size ||
+        size > kMaxLargeBlockSize || user_buffers_[index].get())
+      continue;
+
+    // Compressed data is never stored on a separate file by this version.
+    if (index == kCompressedIndex && (GetEntryFlags() & COMPRESSED_DATA))
+      continue;
+
+    if (!MoveData(index, size))
+      return false;
+    *bytes_moved += size;
+  }
+  return true;
+}
+
 bool EntryImpl::ImportSeparateFile(int index, int offset, int buf_len) {
   if (entry_.Data()->data_size[index] > offset + buf_len) {
     unreported_size_[index] += offset + buf_len -
@@ -817,6 +941,149 @@ bool EntryImpl::ImportSeparateFile(int index, int offset, int buf_len) {
   return true;
 }
 
+// Text resources are often received uncompressed, so in order to make a better
+// use of the available space, we compress the data stream when the entry is
+// closed, as long as the data is not too small or too big, and the result is
+// smaller than the original data. Sparse data is not compressed. The storage
+// size reported to the backend is the size of the compressed data, while the
+// size seen by the user of the entry is the size of the original data.
+void EntryImpl::CompressData() {
+  compress_on_close_ = false;
+  int size = entry_.Data()->data_size[kCompressedIndex];
+  if (size < kMinCompressSize || size > kMaxCompressSize ||
+      (GetEntryFlags() & (PARENT_ENTRY | CHILD_ENTRY | COMPRESSED_DATA)))
+    return;
+
+  Addr address(entry_.Data()->data_addr[kCompressedIndex]);
+  DCHECK(!user_buffers_[kCompressedIndex].get());
+  if (!address.is_initialized())
+    return;
+
+  File* file = GetBackingFile(address, kCompressedIndex);
+  size_t offset = 0;
+  if (address.is_block_file())
+    offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
+
+  scoped_array<char> buffer(new char[size]);
+  if (!file || !file->Read(buffer.get(), size, offset, NULL, NULL))
+    return;
+
+  uLongf compressed_len = compressBound(size);
+  scoped_array<char> compressed(new char[compressed_len]);
+  if (compress2(reinterpret_cast<Bytef*>(compressed.get()), &compressed_len,
+                reinterpret_cast<Bytef*>(buffer.get()), size,
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+    return;
+
+  // Don't bother if we cannot save at least one eighth of the space.
+  int stored_size = static_cast<int>(compressed_len);
+  if (stored_size > size - size / 8)
+    return;
+
+  Addr new_address;
+  if (!CreateBlock(stored_size, &new_address))
+    return;
+
+  // The object used to access an external file is cached by files_[index], and
+  // the slot may be needed for the new storage.
+  if (address.is_separate_file())
+    files_[kCompressedIndex] = NULL;
+
+  file = GetBackingFile(new_address, kCompressedIndex);
+  offset = 0;
+  if (new_address.is_block_file()) {
+    offset = new_address.start_block() * new_address.BlockSize() +
+             kBlockHeaderSize;
+  }
+
+  if (!file || !file->Write(compressed.get(), stored_size, offset, NULL,
+                            NULL)) {
+    DeleteData(new_address, kCompressedIndex);
+    return;
+  }
+
+  entry_.Data()->data_addr[kCompressedIndex] = new_address.value();
+  entry_.Data()->compressed_size = stored_size;
+  entry_.Data()->flags |= COMPRESSED_DATA;
+  entry_.Store();
+
+  DeleteData(address, kCompressedIndex);
+  backend_->ModifyStorageSize(size, stored_size);
+  backend_->OnCompressData(size, stored_size);
+}
+
+bool EntryImpl::LoadCompressedData() {
+  Addr address(entry_.Data()->data_addr[kCompressedIndex]);
+  DCHECK(GetEntryFlags() & COMPRESSED_DATA);
+  DCHECK(!uncompressed_data_.get());
+
+  int size = entry_.Data()->data_size[kCompressedIndex];
+  int stored_size = entry_.Data()->compressed_size;
+  if (!address.is_initialized() || size <= 0 || size > kMaxCompressSize ||
+      stored_size <= 0 || stored_size > size)
+    return false;
+
+  File* file = GetBackingFile(address, kCompressedIndex);
+  size_t offset = 0;
+  if (address.is_block_file())
+    offset = address.start_block() * address.BlockSize() + kBlockHeaderSize;
+
+  scoped_array<char> compressed(new char[stored_size]);
+  if (!file || !file->Read(compressed.get(), stored_size, offset, NULL, NULL))
+    return false;
+
+  scoped_array<char> buffer(new char[size]);
+  uLongf len = size;
+  if (uncompress(reinterpret_cast<Bytef*>(buffer.get()), &len,
+                 reinterpret_cast<Bytef*>(compressed.get()),
+                 stored_size) != Z_OK || len != static_cast<uLongf>(size)) {
+    LOG(ERROR) << "Unable to uncompress cache data";
+    return false;
+  }
+
+  uncompressed_data_.swap(buffer);
+  return true;
+}
+
+bool EntryImpl::UncompressData() {
+  if (!uncompressed_data_.get() && !LoadCompressedData())
+    return false;
+
+  Addr address(entry_.Data()->data_addr[kCompressedIndex]);
+  int size = entry_.Data()->data_size[kCompressedIndex];
+  int stored_size = entry_.Data()->compressed_size;
+
+  Addr new_address;
+  if (!CreateBlock(size, &new_address))
+    return false;
+
+  if (address.is_separate_file())
+    files_[kCompressedIndex] = NULL;
+
+  File* file = GetBackingFile(new_address, kCompressedIndex);
+  size_t offset = 0;
+  if (new_address.is_block_file()) {
+    offset = new_address.start_block() * new_address.BlockSize() +
+             kBlockHeaderSize;
+  }
+
+  if (!file || !file->Write(uncompressed_data_.get(), size, offset, NULL,
+                            NULL)) {
+    DeleteData(new_address, kCompressedIndex);
+    return false;
+  }
+
+  entry_.Data()->data_addr[kCompressedIndex] = new_address.value();
+  entry_.Data()->compressed_size = 0;
+  entry_.Data()->flags &= ~COMPRESSED_DATA;
+  entry_.Store();
+
+  DeleteData(address, kCompressedIndex);
+  backend_->ModifyStorageSize(stored_size, size);
+  uncompressed_data_.reset();
+  return true;
+}
+
 // The common scenario is that this is called from the destructor of the entry,
 // to write to disk what we have buffered. We don't want to hold the destructor
 // until the actual IO finishes, so we'll send an asynchronous write that will
@@ -73,6 +73,10 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   // Permamently destroys this entry.
   void InternalDoom();
 
+  // Lets this sparse entry know that its child |child_id|, named |child_key|,
+  // was doomed.
+  void OnChildDoomed(const std::string& child_key, int64 child_id);
+
   // Deletes this entry from disk. If |everything| is false, only the user data
   // will be removed, leaving the key and control data intact.
   void DeleteEntryData(bool everything);
@@ -114,6 +118,11 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   // Generates a histogram for the time spent working on this operation.
   void ReportIOTime(Operation op, const base::Time& start);
 
+  // Moves the user data that is stored on separate files to block-files, as
+  // long as it fits there, and adds the number of bytes moved to
+  // |bytes_moved|. Returns false if the entry could not be updated.
+  bool PackExternalData(int* bytes_moved);
+
  private:
   enum {
      kNumStreams = 3
@@ -149,9 +158,23 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   // Reads from a block data file to this object's memory buffer.
   bool MoveToLocalBuffer(int index);
 
+  // Copies the data stored by this stream to new backing storage, big enough
+  // to hold |size| bytes, without going through the memory buffer.
+  bool MoveData(int index, int size);
+
   // Loads the external file to this object's memory buffer.
   bool ImportSeparateFile(int index, int offset, int buf_len);
 
+  // Stores the data stream compressed, if it is worth it. This is called when
+  // the entry is closed after writing to that stream.
+  void CompressData();
+
+  // Reads and uncompresses the data stream to |uncompressed_data_|.
+  bool LoadCompressedData();
+
+  // Stores the data stream uncompressed again, so that it can be modified.
+  bool UncompressData();
+
   // Flush the in-memory data to the backing storage.
   bool Flush(int index, int size, bool async);
 
@@ -187,6 +210,8 @@ class EntryImpl : public Entry, public base::RefCounted<EntryImpl> {
   mutable File* key_file_;
   int unreported_size_[kNumStreams];  // Bytes not reported yet to the backend.
   bool doomed_;               // True if this entry was removed from the cache.
+  bool compress_on_close_;    // True if the data stream should be compressed.
+  scoped_array<char> uncompressed_data_;  // Copy of the compressed stream.
   scoped_ptr<SparseControl> sparse_;  // Support for sparse entries.
 
   DISALLOW_EVIL_CONSTRUCTORS(EntryImpl);
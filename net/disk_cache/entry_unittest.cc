@@ -3,12 +3,14 @@
 // found in the LICENSE file.
 
 #include "base/basictypes.h"
+#include "base/file_util.h"
 #include "base/platform_thread.h"
 #include "base/timer.h"
 #include "base/string_util.h"
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
+#include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/entry_impl.h"
@@ -533,6 +535,117 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGrowData) {
   GrowData();
 }
 
+// Data up to 256 KB is stored on block-files, and it should be able to move
+// between the different sizes of blocks.
+TEST_F(DiskCacheEntryTest, LargeBlocks) {
+  InitCache();
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache_->CreateEntry("the first key", &entry));
+
+  const int kSize = 300000;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  // From an internal buffer to a 16 KB block.
+  EXPECT_EQ(10000, entry->WriteData(0, 0, buffer1, 10000, NULL, false));
+  EXPECT_EQ(50000, entry->WriteData(0, 0, buffer1, 50000, NULL, false));
+  entry->Close();
+  EXPECT_FALSE(file_util::PathExists(
+      GetCacheFilePath().AppendASCII("f_000001")));
+
+  // From a 16 KB block to a 64 KB block.
+  ASSERT_TRUE(cache_->OpenEntry("the first key", &entry));
+  EXPECT_EQ(50000, entry->ReadData(0, 0, buffer2, 50000, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), 50000));
+  EXPECT_EQ(150000, entry->WriteData(0, 0, buffer1, 150000, NULL, false));
+  entry->Close();
+  EXPECT_FALSE(file_util::PathExists(
+      GetCacheFilePath().AppendASCII("f_000001")));
+
+  // And finally to a separate file.
+  ASSERT_TRUE(cache_->OpenEntry("the first key", &entry));
+  EXPECT_EQ(150000, entry->ReadData(0, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), 150000));
+  EXPECT_EQ(kSize, entry->WriteData(0, 0, buffer1, kSize, NULL, false));
+  EXPECT_EQ(kSize, entry->ReadData(0, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+  EXPECT_TRUE(file_util::PathExists(
+      GetCacheFilePath().AppendASCII("f_000001")));
+}
+
+namespace {
+
+// Returns the value of the counter called |name| from the stats of |cache|.
+std::string GetStatsItem(disk_cache::Backend* cache, const char* name) {
+  disk_cache::StatsItems stats;
+  cache->GetStats(&stats);
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == name)
+      return stats[i].second;
+  }
+  return std::string();
+}
+
+}  // namespace
+
+// Tests that the data stream is stored compressed when it is worth it, and
+// that compressed data can be read and modified.
+TEST_F(DiskCacheEntryTest, CompressedData) {
+  SetDirectMode();
+  InitCache();
+  cache_impl_->SetFlags(disk_cache::kCompressData);
+
+  const int kSize = 30000;
+  scoped_refptr<net::IOBuffer> buffer1 = new net::IOBuffer(kSize);
+  scoped_refptr<net::IOBuffer> buffer2 = new net::IOBuffer(kSize);
+  for (int i = 0; i < kSize; i++)
+    buffer1->data()[i] = "<html>some text</html>\n"[i % 23];
+
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache_->CreateEntry("the first key", &entry));
+  EXPECT_EQ(200, entry->WriteData(0, 0, buffer1, 200, NULL, false));
+  EXPECT_EQ(20000, entry->WriteData(1, 0, buffer1, 20000, NULL, false));
+  entry->Close();
+  EXPECT_EQ("0x4e20", GetStatsItem(cache_, "Compressed data size"));
+
+  // Read part of the data.
+  ASSERT_TRUE(cache_->OpenEntry("the first key", &entry));
+  EXPECT_EQ(20000, entry->GetDataSize(1));
+  EXPECT_EQ(1000, entry->ReadData(1, 5000, buffer2, 1000, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data() + 5000, buffer2->data(), 1000));
+  EXPECT_EQ(200, entry->ReadData(0, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), 200));
+
+  // Extend the data (and compress it again).
+  EXPECT_EQ(10000, entry->WriteData(1, 20000, buffer1, 10000, NULL, false));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), 20000));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data() + 20000, 10000));
+  entry->Close();
+  EXPECT_EQ("0xc350", GetStatsItem(cache_, "Compressed data size"));
+
+  ASSERT_TRUE(cache_->OpenEntry("the first key", &entry));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), 20000));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data() + 20000, 10000));
+  entry->Doom();
+  entry->Close();
+
+  // Random data is not compressed.
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+  ASSERT_TRUE(cache_->CreateEntry("the second key", &entry));
+  EXPECT_EQ(kSize, entry->WriteData(1, 0, buffer1, kSize, NULL, false));
+  entry->Close();
+  EXPECT_EQ("0xc350", GetStatsItem(cache_, "Compressed data size"));
+
+  ASSERT_TRUE(cache_->OpenEntry("the second key", &entry));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, NULL));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+}
+
 void DiskCacheEntryTest::TruncateData() {
   std::string key1("the first key");
   disk_cache::Entry *entry1;
@@ -1294,6 +1407,140 @@ TEST_F(DiskCacheEntryTest, MemoryPartialSparseEntry) {
   PartialSparseEntry();
 }
 
+// Tests that the parent entry keeps track of the data stored by its children.
+TEST_F(DiskCacheEntryTest, SparseExtents) {
+  InitCache();
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache_->CreateEntry(key, &entry));
+
+  const int kSize = 1024;
+  const int k1Meg = 1024 * 1024;
+  scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  EXPECT_EQ(kSize, entry->WriteSparseData(0, buf, kSize, NULL));
+  EXPECT_EQ(kSize, entry->WriteSparseData(k1Meg + 4096, buf, kSize, NULL));
+  EXPECT_EQ(kSize, entry->WriteSparseData(8 * k1Meg, buf, kSize, NULL));
+  entry->Close();
+  ASSERT_TRUE(cache_->OpenEntry(key, &entry));
+
+  // The header and bitmap of children are followed by three extents.
+  EXPECT_EQ(static_cast<int>(sizeof(disk_cache::SparseData) +
+                             3 * sizeof(disk_cache::SparseExtent)),
+            entry->GetDataSize(2));
+
+  int64 start;
+  EXPECT_EQ(kSize, entry->GetAvailableRange(1024, 10 * k1Meg, &start));
+  EXPECT_EQ(k1Meg + 4096, start);
+  EXPECT_EQ(512, entry->GetAvailableRange(8 * k1Meg + 512, kSize, &start));
+  EXPECT_EQ(8 * k1Meg + 512, start);
+  EXPECT_EQ(0, entry->GetAvailableRange(2 * k1Meg, kSize, &start));
+  EXPECT_EQ(2 * k1Meg, start);
+  EXPECT_EQ(kSize - 10, entry->ReadSparseData(k1Meg + 4106, buf, kSize, NULL));
+  entry->Close();
+
+  // Now store data with a lot of holes, so that there are too many extents to
+  // keep track of.
+  ASSERT_TRUE(cache_->CreateEntry("the second key", &entry));
+  for (int i = 0; i < 1100; i++)
+    EXPECT_EQ(kSize, entry->WriteSparseData(i * 2048, buf, kSize, NULL));
+  entry->Close();
+  ASSERT_TRUE(cache_->OpenEntry("the second key", &entry));
+
+  // We should be back to the bitmap of children.
+  EXPECT_EQ(static_cast<int>(sizeof(disk_cache::SparseData)),
+            entry->GetDataSize(2));
+  EXPECT_EQ(kSize, entry->GetAvailableRange(1024, 4096, &start));
+  EXPECT_EQ(2048, start);
+  EXPECT_EQ(kSize, entry->ReadSparseData(1099 * 2048, buf, kSize, NULL));
+  EXPECT_EQ(0, entry->ReadSparseData(1099 * 2048 + kSize, buf, kSize, NULL));
+  entry->Close();
+}
+
+// Tests that the extents of a child that was evicted are not reported.
+TEST_F(DiskCacheEntryTest, SparseExtentsEvictedChild) {
+  InitCache();
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache_->CreateEntry(key, &entry));
+
+  const int kSize = 1024;
+  const int k1Meg = 1024 * 1024;
+  scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  EXPECT_EQ(kSize, entry->WriteSparseData(0, buf, kSize, NULL));
+  EXPECT_EQ(kSize, entry->WriteSparseData(k1Meg + 4096, buf, kSize, NULL));
+  entry->Close();
+
+  // Evict the second child.
+  void* iter = NULL;
+  std::string child_key;
+  while (cache_->OpenNextEntry(&iter, &entry)) {
+    if (EndsWith(entry->GetKey(), ":1", true))
+      child_key = entry->GetKey();
+    entry->Close();
+  }
+  ASSERT_FALSE(child_key.empty());
+  EXPECT_TRUE(cache_->DoomEntry(child_key));
+
+  ASSERT_TRUE(cache_->OpenEntry(key, &entry));
+  int64 start;
+  EXPECT_EQ(0, entry->GetAvailableRange(kSize, 10 * k1Meg, &start));
+  EXPECT_EQ(kSize, start);
+  EXPECT_EQ(kSize, entry->GetAvailableRange(0, 10 * k1Meg, &start));
+  EXPECT_EQ(0, start);
+
+  // Only the extent of the first child is left.
+  EXPECT_EQ(static_cast<int>(sizeof(disk_cache::SparseData) +
+                             sizeof(disk_cache::SparseExtent)),
+            entry->GetDataSize(2));
+  entry->Close();
+}
+
+// Tests that the parent stops reporting the data of a child as soon as the
+// child is doomed, even if the parent is in use.
+TEST_F(DiskCacheEntryTest, SparseExtentsDoomedChildOfOpenEntry) {
+  InitCache();
+  std::string key("the first key");
+  disk_cache::Entry* entry;
+  ASSERT_TRUE(cache_->CreateEntry(key, &entry));
+
+  const int kSize = 1024;
+  const int k1Meg = 1024 * 1024;
+  scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(kSize);
+  CacheTestFillBuffer(buf->data(), kSize, false);
+
+  EXPECT_EQ(kSize, entry->WriteSparseData(0, buf, kSize, NULL));
+  EXPECT_EQ(kSize, entry->WriteSparseData(k1Meg + 4096, buf, kSize, NULL));
+
+  void* iter = NULL;
+  std::string child_key;
+  disk_cache::Entry* child;
+  while (cache_->OpenNextEntry(&iter, &child)) {
+    if (EndsWith(child->GetKey(), ":1", true))
+      child_key = child->GetKey();
+    child->Close();
+  }
+  ASSERT_FALSE(child_key.empty());
+  EXPECT_TRUE(cache_->DoomEntry(child_key));
+
+  int64 start;
+  EXPECT_EQ(0, entry->GetAvailableRange(kSize, 10 * k1Meg, &start));
+  EXPECT_EQ(kSize, entry->GetAvailableRange(0, 10 * k1Meg, &start));
+  EXPECT_EQ(0, start);
+  entry->Close();
+
+  // The updated list of extents is saved when the entry is closed.
+  ASSERT_TRUE(cache_->OpenEntry(key, &entry));
+  EXPECT_EQ(static_cast<int>(sizeof(disk_cache::SparseData) +
+                             sizeof(disk_cache::SparseExtent)),
+            entry->GetDataSize(2));
+  EXPECT_EQ(0, entry->GetAvailableRange(kSize, 10 * k1Meg, &start));
+  entry->Close();
+}
+
 TEST_F(DiskCacheEntryTest, CleanupSparseEntry) {
   InitCache();
   std::string key("the first key");
@@ -7,6 +7,11 @@
 // only one list in use (Rankings::NO_USE), and elements are sent to the front
 // of the list whenever they are accessed.
 
+// A different replacement policy (see eviction_policy.h) can be used instead of
+// LRU with the original algorithm. The policy keeps its own state in memory, so
+// it is loaded from the NO_USE list when the cache starts, and it decides which
+// entries are evicted; the list is still updated for everything else.
+
 // The new (in-development) eviction policy ads re-use as a factor to evict
 // an entry. The story so far:
 
@@ -28,12 +33,16 @@
 
 #include "net/disk_cache/eviction.h"
 
+#include <utility>
+#include <vector>
+
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/string_util.h"
 #include "base/time.h"
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/entry_impl.h"
+#include "net/disk_cache/hash.h"
 #include "net/disk_cache/histogram_macros.h"
 #include "net/disk_cache/trace.h"
 
@@ -44,6 +53,7 @@ namespace {
 const int kCleanUpMargin = 1024 * 1024;
 const int kHighUse = 10;  // Reuse count to be on the HIGH_USE list.
 const int kTargetTime = 24 * 7;  // Time to be evicted (hours since last use).
+const int kNumStreams = 3;  // Data streams of an entry.
 
 int LowWaterAdjust(int high_water) {
   if (high_water < kCleanUpMargin)
@@ -52,6 +62,14 @@ int LowWaterAdjust(int high_water) {
   return high_water - kCleanUpMargin;
 }
 
+// Returns the amount of data stored by |entry|.
+int64 GetEntrySize(disk_cache::EntryImpl* entry) {
+  int64 size = 0;
+  for (int i = 0; i < kNumStreams; i++)
+    size += entry->GetDataSize(i);
+  return size;
+}
+
 }  // namespace
 
 namespace disk_cache {
@@ -67,6 +85,12 @@ void Eviction::Init(BackendImpl* backend) {
   first_trim_ = true;
   trimming_ = false;
   delay_trim_ = false;
+
+  policy_.reset();
+  if (LRU_POLICY != backend->eviction_policy_ && !new_eviction_) {
+    policy_.reset(EvictionPolicy::Create(backend->eviction_policy_, max_size_));
+    InitPolicy();
+  }
 }
 
 void Eviction::TrimCache(bool empty) {
@@ -79,6 +103,10 @@ void Eviction::TrimCache(bool empty) {
   if (!empty && backend_->IsLoaded())
     return PostDelayedTrim();
 
+  // Emptying the cache doesn't need any policy.
+  if (!empty && policy_.get())
+    return TrimCacheWithPolicy();
+
   Trace("*** Trim Cache ***");
   trimming_ = true;
   Time start = Time::Now();
@@ -122,11 +150,16 @@ void Eviction::UpdateRank(EntryImpl* entry, bool modified) {
     return UpdateRankV2(entry, modified);
 
   rankings_->UpdateRank(entry->rankings(), modified, GetListForEntry(entry));
+  if (policy_.get())
+    policy_->OnResize(entry->GetKey(), GetEntrySize(entry));
 }
 
 void Eviction::OnOpenEntry(EntryImpl* entry) {
   if (new_eviction_)
     return OnOpenEntryV2(entry);
+
+  if (policy_.get())
+    policy_->OnAccess(entry->GetKey());
 }
 
 void Eviction::OnCreateEntry(EntryImpl* entry) {
@@ -134,6 +167,8 @@ void Eviction::OnCreateEntry(EntryImpl* entry) {
     return OnCreateEntryV2(entry);
 
   rankings_->Insert(entry->rankings(), true, GetListForEntry(entry));
+  if (policy_.get())
+    policy_->OnInsert(entry->GetKey(), GetEntrySize(entry));
 }
 
 void Eviction::OnDoomEntry(EntryImpl* entry) {
@@ -141,6 +176,8 @@ void Eviction::OnDoomEntry(EntryImpl* entry) {
     return OnDoomEntryV2(entry);
 
   rankings_->Remove(entry->rankings(), GetListForEntry(entry));
+  if (policy_.get())
+    policy_->OnRemove(entry->GetKey());
 }
 
 void Eviction::OnDestroyEntry(EntryImpl* entry) {
@@ -220,6 +257,84 @@ bool Eviction::EvictEntry(CacheRankingsBlock* node, bool empty) {
   return true;
 }
 
+void Eviction::InitPolicy() {
+  if (backend_->disabled_)
+    return;
+
+  // Start with the oldest entry, so that the policy sees the same order as the
+  // list.
+  Rankings::ScopedRankingsBlock node(rankings_);
+  Rankings::ScopedRankingsBlock next(rankings_,
+      rankings_->GetPrev(node.get(), Rankings::NO_USE));
+  while (next.get()) {
+    if (!next->HasData())
+      break;
+    node.reset(next.release());
+    next.reset(rankings_->GetPrev(node.get(), Rankings::NO_USE));
+
+    // Do NOT use node as an iterator after this point.
+    rankings_->TrackRankingsBlock(node.get(), false);
+    EntryImpl* entry = backend_->GetEnumeratedEntry(node.get(), true);
+    if (!entry)
+      continue;
+
+    policy_->OnInsert(entry->GetKey(), GetEntrySize(entry));
+    entry->Release();
+  }
+}
+
+void Eviction::TrimCacheWithPolicy() {
+  Trace("*** Trim Cache (%s) ***", policy_->GetName());
+  trimming_ = true;
+  Time start = Time::Now();
+
+  // The policy stops tracking the entries that it selects, so the ones that we
+  // cannot evict right now are added back when we are done. Note that an open
+  // entry may be going away right now, so we should not add references to it.
+  std::vector<std::pair<std::string, int64> > in_use;
+  std::string key;
+  while (header_->num_bytes > max_size_ && policy_->Evict(&key)) {
+    uint32 hash = Hash(key);
+    EntryImpl* open_entry = FindOpenEntry(key, hash);
+    if (open_entry) {
+      in_use.push_back(std::make_pair(key, GetEntrySize(open_entry)));
+      continue;
+    }
+
+    EntryImpl* entry = backend_->MatchEntry(key, hash, false);
+    if (!entry)
+      continue;
+
+    ReportTrimTimes(entry);
+    entry->Doom();
+    entry->Release();
+    backend_->OnEvent(Stats::TRIM_ENTRY);
+
+    if ((Time::Now() - start).InMilliseconds() > 20) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          factory_.NewRunnableMethod(&Eviction::TrimCache, false));
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < in_use.size(); i++)
+    policy_->OnInsert(in_use[i].first, in_use[i].second);
+
+  CACHE_UMA(AGE_MS, "TotalTrimTime", backend_->GetSizeGroup(), start);
+  trimming_ = false;
+  Trace("*** Trim Cache end ***");
+}
+
+EntryImpl* Eviction::FindOpenEntry(const std::string& key, uint32 hash) {
+  BackendImpl::EntriesMap::const_iterator it;
+  for (it = backend_->open_entries_.begin();
+       it != backend_->open_entries_.end(); ++it) {
+    if (it->second->GetHash() == hash && it->second->GetKey() == key)
+      return it->second;
+  }
+  return NULL;
+}
+
 // -----------------------------------------------------------------------
 
 void Eviction::TrimCacheV2(bool empty) {
@@ -5,10 +5,14 @@
 #ifndef NET_DISK_CACHE_EVICTION_H_
 #define NET_DISK_CACHE_EVICTION_H_
 
+#include <string>
+
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/scoped_ptr.h"
 #include "base/task.h"
 #include "net/disk_cache/disk_format.h"
+#include "net/disk_cache/eviction_policy.h"
 #include "net/disk_cache/rankings.h"
 
 namespace disk_cache {
@@ -46,6 +50,15 @@ class Eviction {
   Rankings::List GetListForEntry(EntryImpl* entry);
   bool EvictEntry(CacheRankingsBlock* node, bool empty);
 
+  // Replacement policies other than LRU only work with the original eviction
+  // algorithm, and they don't use the rankings lists to select entries.
+  void InitPolicy();
+  void TrimCacheWithPolicy();
+
+  // Returns the entry stored under |key| if it is open, without adding a
+  // reference to it.
+  EntryImpl* FindOpenEntry(const std::string& key, uint32 hash);
+
   // We'll just keep for a while a separate set of methods that implement the
   // new eviction algorithm. This code will replace the original methods when
   // finished.
@@ -71,6 +84,7 @@ class Eviction {
   bool first_trim_;
   bool trimming_;
   bool delay_trim_;
+  scoped_ptr<EvictionPolicy> policy_;  // Selects the entries to evict, if set.
   ScopedRunnableMethodFactory<Eviction> factory_;
 
   DISALLOW_COPY_AND_ASSIGN(Eviction);
@@ -0,0 +1,238 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/eviction_policy.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+// The cost of a miss, on top of the transfer of the data itself, expressed in
+// bytes: roughly what we could transfer during a round trip.
+const int64 kMissCostBytes = 16 * 1024;
+
+// Portion of the cache used by the A1in queue of 2Q.
+const int kA1inPercent = 25;
+
+// Amount of data (as a portion of the cache) remembered by the A1out queue.
+const int kA1outPercent = 50;
+
+}  // namespace
+
+namespace disk_cache {
+
+// Static.
+EvictionPolicy* EvictionPolicy::Create(EvictionPolicyType type,
+                                       int64 max_bytes) {
+  switch (type) {
+    case LRU_POLICY:
+      return new LruPolicy();
+    case GREEDY_DUAL_POLICY:
+      return new GreedyDualPolicy();
+    case TWO_QUEUE_POLICY:
+      return new TwoQueuePolicy(max_bytes);
+    default:
+      NOTREACHED();
+      return NULL;
+  }
+}
+
+// -----------------------------------------------------------------------
+
+void LruPolicy::OnInsert(const std::string& key, int64 size) {
+  DCHECK(keys_.find(key) == keys_.end());
+  list_.push_front(key);
+  keys_[key] = list_.begin();
+}
+
+void LruPolicy::OnAccess(const std::string& key) {
+  KeyMap::iterator it = keys_.find(key);
+  if (it == keys_.end())
+    return;
+
+  list_.splice(list_.begin(), list_, it->second);
+}
+
+void LruPolicy::OnResize(const std::string& key, int64 size) {
+  // We don't care about sizes.
+}
+
+void LruPolicy::OnRemove(const std::string& key) {
+  KeyMap::iterator it = keys_.find(key);
+  if (it == keys_.end())
+    return;
+
+  list_.erase(it->second);
+  keys_.erase(it);
+}
+
+bool LruPolicy::Evict(std::string* key) {
+  if (list_.empty())
+    return false;
+
+  *key = list_.back();
+  keys_.erase(*key);
+  list_.pop_back();
+  return true;
+}
+
+// -----------------------------------------------------------------------
+
+void GreedyDualPolicy::OnInsert(const std::string& key, int64 size) {
+  DCHECK(nodes_.find(key) == nodes_.end());
+  Node& node = nodes_[key];
+  node.size = std::max(size, static_cast<int64>(1));
+  node.frequency = 1;
+  UpdatePriority(key, &node);
+}
+
+void GreedyDualPolicy::OnAccess(const std::string& key) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it == nodes_.end())
+    return;
+
+  queue_.erase(it->second.priority);
+  it->second.frequency++;
+  UpdatePriority(key, &it->second);
+}
+
+void GreedyDualPolicy::OnResize(const std::string& key, int64 size) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it == nodes_.end())
+    return;
+
+  queue_.erase(it->second.priority);
+  it->second.size = std::max(size, static_cast<int64>(1));
+  UpdatePriority(key, &it->second);
+}
+
+void GreedyDualPolicy::OnRemove(const std::string& key) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it == nodes_.end())
+    return;
+
+  queue_.erase(it->second.priority);
+  nodes_.erase(it);
+}
+
+bool GreedyDualPolicy::Evict(std::string* key) {
+  if (queue_.empty())
+    return false;
+
+  Queue::iterator first = queue_.begin();
+  inflation_ = first->first.first;
+  *key = first->second;
+  nodes_.erase(*key);
+  queue_.erase(first);
+  return true;
+}
+
+void GreedyDualPolicy::UpdatePriority(const std::string& key, Node* node) {
+  double value = static_cast<double>(node->frequency) *
+                 (kMissCostBytes + node->size) / node->size;
+  node->priority = Priority(inflation_ + value, sequence_++);
+  queue_[node->priority] = key;
+}
+
+// -----------------------------------------------------------------------
+
+TwoQueuePolicy::TwoQueuePolicy(int64 max_bytes)
+    : max_in_bytes_(max_bytes * kA1inPercent / 100),
+      max_out_bytes_(max_bytes * kA1outPercent / 100) {
+  for (int i = 0; i < 3; i++)
+    bytes_[i] = 0;
+}
+
+void TwoQueuePolicy::OnInsert(const std::string& key, int64 size) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it != nodes_.end()) {
+    // We remember this one, so it goes to the main queue.
+    DCHECK_EQ(A1OUT, it->second.queue);
+    RemoveFromQueue(&it->second);
+    it->second.size = size;
+    return AddToQueue(key, AM, &it->second);
+  }
+
+  Node& node = nodes_[key];
+  node.size = size;
+  AddToQueue(key, A1IN, &node);
+}
+
+void TwoQueuePolicy::OnAccess(const std::string& key) {
+  NodeMap::iterator it = nodes_.find(key);
+
+  // Accesses to an entry on A1in are considered correlated with the first one,
+  // so the entry doesn't move.
+  if (it == nodes_.end() || it->second.queue != AM)
+    return;
+
+  queues_[AM].splice(queues_[AM].begin(), queues_[AM], it->second.position);
+}
+
+void TwoQueuePolicy::OnResize(const std::string& key, int64 size) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it == nodes_.end() || it->second.queue == A1OUT)
+    return;
+
+  bytes_[it->second.queue] += size - it->second.size;
+  it->second.size = size;
+}
+
+void TwoQueuePolicy::OnRemove(const std::string& key) {
+  NodeMap::iterator it = nodes_.find(key);
+  if (it == nodes_.end() || it->second.queue == A1OUT)
+    return;
+
+  RemoveFromQueue(&it->second);
+  nodes_.erase(it);
+}
+
+bool TwoQueuePolicy::Evict(std::string* key) {
+  QueueType queue = AM;
+  if (queues_[AM].empty() || bytes_[A1IN] > max_in_bytes_)
+    queue = A1IN;
+
+  if (queues_[queue].empty())
+    return false;
+
+  *key = queues_[queue].back();
+  Node* node = &nodes_[*key];
+  RemoveFromQueue(node);
+  if (queue == AM) {
+    nodes_.erase(*key);
+    return true;
+  }
+
+  // Remember this entry for a while.
+  AddToQueue(*key, A1OUT, node);
+  TrimGhosts();
+  return true;
+}
+
+void TwoQueuePolicy::AddToQueue(const std::string& key, QueueType queue,
+                                Node* node) {
+  queues_[queue].push_front(key);
+  node->queue = queue;
+  node->position = queues_[queue].begin();
+  bytes_[queue] += node->size;
+}
+
+void TwoQueuePolicy::RemoveFromQueue(Node* node) {
+  bytes_[node->queue] -= node->size;
+  queues_[node->queue].erase(node->position);
+}
+
+void TwoQueuePolicy::TrimGhosts() {
+  while (bytes_[A1OUT] > max_out_bytes_ && !queues_[A1OUT].empty()) {
+    std::string key = queues_[A1OUT].back();
+    NodeMap::iterator it = nodes_.find(key);
+    DCHECK(it != nodes_.end());
+    RemoveFromQueue(&it->second);
+    nodes_.erase(it);
+  }
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,176 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_EVICTION_POLICY_H_
+#define NET_DISK_CACHE_EVICTION_POLICY_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+
+namespace disk_cache {
+
+// The available replacement policies.
+enum EvictionPolicyType {
+  LRU_POLICY,           // Plain least recently used.
+  GREEDY_DUAL_POLICY,   // Size and frequency aware GreedyDual.
+  TWO_QUEUE_POLICY,     // 2Q: scan resistant LRU.
+  NUM_EVICTION_POLICIES
+};
+
+// This is the interface of a cache replacement policy. The policy only keeps
+// track of keys and sizes, and decides which entry should go away next; the
+// caller is responsible for actually storing (and deleting) the data, and for
+// calling Evict() until there is enough free space.
+class EvictionPolicy {
+ public:
+  virtual ~EvictionPolicy() {}
+
+  // Returns a new policy of the given |type|, for a cache that can store up to
+  // |max_bytes|.
+  static EvictionPolicy* Create(EvictionPolicyType type, int64 max_bytes);
+
+  // Returns the name of the policy, for reporting.
+  virtual const char* GetName() const = 0;
+
+  // A new entry, |key|, that stores |size| bytes is added to the cache.
+  virtual void OnInsert(const std::string& key, int64 size) = 0;
+
+  // An existing entry is being used.
+  virtual void OnAccess(const std::string& key) = 0;
+
+  // The amount of data stored by an existing entry changed to |size|.
+  virtual void OnResize(const std::string& key, int64 size) = 0;
+
+  // An entry is removed from the cache for reasons other than eviction (for
+  // instance because it was doomed).
+  virtual void OnRemove(const std::string& key) = 0;
+
+  // Selects the next entry to evict, stops tracking it and returns its key.
+  // Returns false if there is nothing to evict.
+  virtual bool Evict(std::string* key) = 0;
+};
+
+// Least recently used policy.
+class LruPolicy : public EvictionPolicy {
+ public:
+  LruPolicy() {}
+  virtual ~LruPolicy() {}
+
+  // EvictionPolicy interface.
+  virtual const char* GetName() const { return "LRU"; }
+  virtual void OnInsert(const std::string& key, int64 size);
+  virtual void OnAccess(const std::string& key);
+  virtual void OnResize(const std::string& key, int64 size);
+  virtual void OnRemove(const std::string& key);
+  virtual bool Evict(std::string* key);
+
+ private:
+  typedef std::list<std::string> KeyList;
+  typedef base::hash_map<std::string, KeyList::iterator> KeyMap;
+
+  KeyList list_;  // Most recently used first.
+  KeyMap keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(LruPolicy);
+};
+
+// GreedyDual-Size-Frequency policy. Each entry gets a value of
+//   H = L + frequency * cost / size
+// where L is the value of the last evicted entry (so values age as entries are
+// evicted), and the cost of a miss is modeled as a fixed round trip plus the
+// transfer time, in bytes. The entry with the lowest value is evicted first.
+// Large entries that are used often stay around, while entries that are seen
+// only once (as it happens with a scan) go away quickly.
+class GreedyDualPolicy : public EvictionPolicy {
+ public:
+  GreedyDualPolicy() : inflation_(0), sequence_(0) {}
+  virtual ~GreedyDualPolicy() {}
+
+  // EvictionPolicy interface.
+  virtual const char* GetName() const { return "GreedyDual"; }
+  virtual void OnInsert(const std::string& key, int64 size);
+  virtual void OnAccess(const std::string& key);
+  virtual void OnResize(const std::string& key, int64 size);
+  virtual void OnRemove(const std::string& key);
+  virtual bool Evict(std::string* key);
+
+ private:
+  // The priority queue is sorted by value, and by age for the same value.
+  typedef std::pair<double, int64> Priority;
+  typedef std::map<Priority, std::string> Queue;
+
+  struct Node {
+    Priority priority;
+    int64 size;
+    int frequency;
+  };
+  typedef base::hash_map<std::string, Node> NodeMap;
+
+  // Updates the value of |node| and (re)inserts it on the queue.
+  void UpdatePriority(const std::string& key, Node* node);
+
+  Queue queue_;
+  NodeMap nodes_;
+  double inflation_;  // L, the current value of the cache.
+  int64 sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(GreedyDualPolicy);
+};
+
+// Simplified 2Q policy (Johnson and Shasha, VLDB '94), based on bytes. New
+// entries go to a FIFO queue (A1in) and they only move to the main LRU queue
+// (Am) if they are used again after being evicted from A1in, while their key is
+// still remembered (A1out). A single scan of the cache only flushes A1in.
+class TwoQueuePolicy : public EvictionPolicy {
+ public:
+  explicit TwoQueuePolicy(int64 max_bytes);
+  virtual ~TwoQueuePolicy() {}
+
+  // EvictionPolicy interface.
+  virtual const char* GetName() const { return "2Q"; }
+  virtual void OnInsert(const std::string& key, int64 size);
+  virtual void OnAccess(const std::string& key);
+  virtual void OnResize(const std::string& key, int64 size);
+  virtual void OnRemove(const std::string& key);
+  virtual bool Evict(std::string* key);
+
+ private:
+  enum QueueType {
+    A1IN,
+    A1OUT,
+    AM
+  };
+  typedef std::list<std::string> KeyList;
+
+  struct Node {
+    QueueType queue;
+    KeyList::iterator position;
+    int64 size;
+  };
+  typedef base::hash_map<std::string, Node> NodeMap;
+
+  // Moves |key| to the front of |queue|.
+  void AddToQueue(const std::string& key, QueueType queue, Node* node);
+  void RemoveFromQueue(Node* node);
+
+  // Forgets old keys from A1out.
+  void TrimGhosts();
+
+  KeyList queues_[3];  // Indexed by QueueType, most recent first.
+  int64 bytes_[3];
+  NodeMap nodes_;
+  int64 max_in_bytes_;  // Target size for A1in.
+  int64 max_out_bytes_;  // How much data is remembered by A1out.
+
+  DISALLOW_COPY_AND_ASSIGN(TwoQueuePolicy);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_EVICTION_POLICY_H_
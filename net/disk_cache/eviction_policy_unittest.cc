@@ -0,0 +1,109 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "net/disk_cache/eviction_policy.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+TEST(EvictionPolicyTest, Lru) {
+  disk_cache::LruPolicy policy;
+  policy.OnInsert("a", 10);
+  policy.OnInsert("b", 10);
+  policy.OnInsert("c", 10);
+  policy.OnAccess("a");
+  policy.OnRemove("c");
+
+  std::string key;
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("b", key);
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("a", key);
+  EXPECT_FALSE(policy.Evict(&key));
+}
+
+TEST(EvictionPolicyTest, GreedyDual) {
+  disk_cache::GreedyDualPolicy policy;
+
+  // A big entry that is used often should survive small entries that are not.
+  policy.OnInsert("big", 1024 * 1024);
+  for (int i = 0; i < 19; i++)
+    policy.OnAccess("big");
+  policy.OnInsert("small 1", 1000);
+  policy.OnInsert("small 2", 1000);
+
+  std::string key;
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("small 1", key);
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("small 2", key);
+
+  // Without more hits, new entries eventually outrank the big one.
+  policy.OnInsert("new", 1000);
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("big", key);
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("new", key);
+  EXPECT_FALSE(policy.Evict(&key));
+}
+
+TEST(EvictionPolicyTest, GreedyDualResize) {
+  disk_cache::GreedyDualPolicy policy;
+
+  // Entries are created empty, and grow as data is written.
+  policy.OnInsert("a", 0);
+  policy.OnInsert("b", 0);
+  policy.OnResize("a", 1024 * 1024);
+  policy.OnResize("b", 1000);
+
+  std::string key;
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("a", key);
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("b", key);
+  EXPECT_FALSE(policy.Evict(&key));
+}
+
+TEST(EvictionPolicyTest, TwoQueue) {
+  // A1in gets 500 bytes, and A1out remembers 1000 bytes.
+  disk_cache::TwoQueuePolicy policy(2000);
+
+  // "a" is used, evicted from A1in and then used again, so it goes to Am.
+  policy.OnInsert("a", 800);
+  std::string key;
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("a", key);
+  policy.OnInsert("a", 800);
+
+  // A scan only flushes A1in.
+  for (int i = 0; i < 10; i++) {
+    policy.OnInsert(StringPrintf("scan %d", i), 100);
+    if (i < 5)
+      continue;
+    EXPECT_TRUE(policy.Evict(&key));
+    EXPECT_EQ(StringPrintf("scan %d", i - 5), key);
+  }
+
+  policy.OnAccess("a");
+  EXPECT_TRUE(policy.Evict(&key));
+  EXPECT_EQ("a", key);
+
+  int count = 0;
+  while (policy.Evict(&key))
+    count++;
+  EXPECT_EQ(5, count);
+}
+
+TEST(EvictionPolicyTest, Create) {
+  for (int i = 0; i < disk_cache::NUM_EVICTION_POLICIES; i++) {
+    scoped_ptr<disk_cache::EvictionPolicy> policy(
+        disk_cache::EvictionPolicy::Create(
+            static_cast<disk_cache::EvictionPolicyType>(i), 1000));
+    ASSERT_TRUE(policy.get());
+    policy->OnInsert("a", 10);
+    policy->OnRemove("a");
+    std::string key;
+    EXPECT_FALSE(policy->Evict(&key));
+  }
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/extent_map.h"
+
+#include <algorithm>
+
+namespace disk_cache {
+
+void ExtentMap::Add(int64 start, int64 end) {
+  if (start >= end)
+    return;
+
+  Extents::iterator it = extents_.upper_bound(start);
+  if (it != extents_.begin()) {
+    Extents::iterator previous = it;
+    --previous;
+    if (previous->second >= start) {
+      // Extend the previous extent instead of adding a new one.
+      start = previous->first;
+      end = std::max(end, previous->second);
+      it = previous;
+    }
+  }
+
+  // Swallow every extent that overlaps (or touches) the new one.
+  while (it != extents_.end() && it->first <= end) {
+    end = std::max(end, it->second);
+    extents_.erase(it++);
+  }
+
+  extents_[start] = end;
+}
+
+void ExtentMap::Remove(int64 start, int64 end) {
+  if (start >= end)
+    return;
+
+  Extents::iterator it = extents_.upper_bound(start);
+  if (it != extents_.begin()) {
+    Extents::iterator previous = it;
+    --previous;
+    int64 previous_end = previous->second;
+    if (previous_end > start) {
+      // Keep the part of this extent before |start|.
+      if (previous->first < start)
+        previous->second = start;
+      else
+        extents_.erase(previous);
+
+      if (previous_end > end) {
+        // And the part after |end|.
+        extents_[end] = previous_end;
+        return;
+      }
+    }
+  }
+
+  while (it != extents_.end() && it->first < end) {
+    if (it->second > end) {
+      int64 extent_end = it->second;
+      extents_.erase(it);
+      extents_[end] = extent_end;
+      return;
+    }
+    extents_.erase(it++);
+  }
+}
+
+int64 ExtentMap::ContiguousLength(int64 offset) const {
+  const_iterator it = extents_.upper_bound(offset);
+  if (it == extents_.begin())
+    return 0;
+
+  --it;
+  return it->second > offset ? it->second - offset : 0;
+}
+
+int64 ExtentMap::FindFirst(int64 offset, int64 len, int64* start) const {
+  if (len <= 0)
+    return 0;
+
+  int64 end = offset + len;
+  const_iterator it = extents_.upper_bound(offset);
+  if (it != extents_.begin()) {
+    const_iterator previous = it;
+    --previous;
+    if (previous->second > offset) {
+      *start = offset;
+      return std::min(previous->second, end) - offset;
+    }
+  }
+
+  if (it != extents_.end() && it->first < end) {
+    *start = it->first;
+    return std::min(it->second, end) - it->first;
+  }
+  return 0;
+}
+
+}  // namespace disk_cache
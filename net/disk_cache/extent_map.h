@@ -0,0 +1,65 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_EXTENT_MAP_H_
+#define NET_DISK_CACHE_EXTENT_MAP_H_
+
+#include <map>
+
+#include "base/basictypes.h"
+
+namespace disk_cache {
+
+// This class keeps track of a set of disjoint ranges of offsets (extents), for
+// instance the ranges of data stored by a sparse entry. Adjacent or overlapping
+// ranges are merged, and every lookup takes O(log n), where n is the number of
+// extents. All ranges are half-open: [start, end).
+class ExtentMap {
+ public:
+  // Maps the start of each extent to its end.
+  typedef std::map<int64, int64> Extents;
+  typedef Extents::const_iterator const_iterator;
+
+  ExtentMap() {}
+  ~ExtentMap() {}
+
+  // Adds or removes the range [start, end) to the map.
+  void Add(int64 start, int64 end);
+  void Remove(int64 start, int64 end);
+
+  // Returns the number of consecutive bytes stored at |offset|, or 0 if that
+  // offset is not stored.
+  int64 ContiguousLength(int64 offset) const;
+
+  // Looks for the first stored range that intersects [offset, offset + len).
+  // If one is found, sets |start| to the first offset of the intersection and
+  // returns its length. Otherwise returns 0.
+  int64 FindFirst(int64 offset, int64 len, int64* start) const;
+
+  void Clear() {
+    extents_.clear();
+  }
+
+  // Returns the number of extents.
+  int size() const {
+    return static_cast<int>(extents_.size());
+  }
+
+  const_iterator begin() const {
+    return extents_.begin();
+  }
+
+  const_iterator end() const {
+    return extents_.end();
+  }
+
+ private:
+  Extents extents_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExtentMap);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_EXTENT_MAP_H_
@@ -0,0 +1,80 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/extent_map.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+TEST(ExtentMapTest, Add) {
+  disk_cache::ExtentMap map;
+  map.Add(100, 200);
+  map.Add(300, 400);
+  EXPECT_EQ(2, map.size());
+
+  // Overlapping and adjacent ranges are merged.
+  map.Add(150, 250);
+  EXPECT_EQ(2, map.size());
+  map.Add(250, 300);
+  EXPECT_EQ(1, map.size());
+  EXPECT_EQ(100, map.begin()->first);
+  EXPECT_EQ(400, map.begin()->second);
+
+  map.Add(0, 1000);
+  EXPECT_EQ(1, map.size());
+  EXPECT_EQ(0, map.begin()->first);
+  EXPECT_EQ(1000, map.begin()->second);
+
+  // Empty ranges are ignored.
+  map.Add(2000, 2000);
+  EXPECT_EQ(1, map.size());
+}
+
+TEST(ExtentMapTest, Remove) {
+  disk_cache::ExtentMap map;
+  map.Add(100, 200);
+  map.Add(300, 400);
+  map.Add(500, 600);
+
+  // Split an extent.
+  map.Remove(120, 150);
+  EXPECT_EQ(4, map.size());
+  EXPECT_EQ(20, map.ContiguousLength(100));
+  EXPECT_EQ(0, map.ContiguousLength(120));
+  EXPECT_EQ(50, map.ContiguousLength(150));
+
+  // Remove the end of one extent and the start of another one.
+  map.Remove(180, 350);
+  EXPECT_EQ(30, map.ContiguousLength(150));
+  EXPECT_EQ(0, map.ContiguousLength(320));
+  EXPECT_EQ(50, map.ContiguousLength(350));
+
+  // Remove a few complete extents.
+  map.Remove(0, 550);
+  EXPECT_EQ(1, map.size());
+  EXPECT_EQ(550, map.begin()->first);
+
+  map.Remove(550, 600);
+  EXPECT_EQ(0, map.size());
+}
+
+TEST(ExtentMapTest, FindFirst) {
+  disk_cache::ExtentMap map;
+  map.Add(100, 200);
+  map.Add(1000, 5000);
+
+  int64 start = -1;
+  EXPECT_EQ(0, map.FindFirst(0, 100, &start));
+  EXPECT_EQ(0, map.FindFirst(200, 800, &start));
+  EXPECT_EQ(-1, start);
+
+  EXPECT_EQ(100, map.FindFirst(0, 1000, &start));
+  EXPECT_EQ(100, start);
+  EXPECT_EQ(50, map.FindFirst(150, 2000, &start));
+  EXPECT_EQ(150, start);
+  EXPECT_EQ(10, map.FindFirst(120, 10, &start));
+  EXPECT_EQ(120, start);
+  EXPECT_EQ(500, map.FindFirst(200, 1300, &start));
+  EXPECT_EQ(1000, start);
+  EXPECT_EQ(1000, map.FindFirst(4000, 100000, &start));
+  EXPECT_EQ(4000, start);
+}
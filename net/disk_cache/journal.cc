@@ -0,0 +1,266 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/journal.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/platform_file.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/file_block.h"
+#include "net/disk_cache/mapped_file.h"
+#include "net/disk_cache/trace.h"
+
+namespace {
+
+const uint32 kJournalVersion = 0x20000;  // Version 2.0.
+
+// Time to wait before writing the pending records to the block files.
+const int kFlushDelayMs = 250;
+
+const int kJournalSize = sizeof(disk_cache::JournalHeader) +
+    disk_cache::kJournalRecords * sizeof(disk_cache::JournalRecord);
+
+}  // namespace
+
+namespace disk_cache {
+
+Journal::Journal()
+    : backend_(NULL), header_(NULL), records_(NULL), flush_pending_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(factory_(this)) {
+}
+
+Journal::~Journal() {
+  // The backend should have closed the journal while the block files were
+  // still around.
+  DCHECK(!header_);
+}
+
+bool Journal::Init(const FilePath& name, uint64 create_time,
+                   BackendImpl* backend) {
+  DCHECK(!header_);
+  backend_ = backend;
+
+  int64 file_size;
+  if (!file_util::GetFileSize(name, &file_size) || file_size != kJournalSize) {
+    if (!CreateJournal(name, create_time))
+      return false;
+  }
+
+  file_ = new MappedFile();
+  header_ = reinterpret_cast<JournalHeader*>(file_->Init(name, 0));
+  if (!header_) {
+    LOG(ERROR) << "Unable to map the journal";
+    file_ = NULL;
+    return false;
+  }
+  records_ = reinterpret_cast<JournalRecord*>(header_ + 1);
+
+  if (header_->magic != kJournalMagic || header_->version != kJournalVersion ||
+      header_->num_records < 0 || header_->num_records > kJournalRecords) {
+    LOG(WARNING) << "Invalid journal";
+    memset(header_, 0, sizeof(*header_));
+    header_->magic = kJournalMagic;
+    header_->version = kJournalVersion;
+    header_->create_time = create_time;
+  }
+
+  if (header_->create_time != create_time) {
+    // The index was created again after these records were stored, so their
+    // addresses mean nothing for the current block files.
+    LOG(WARNING) << "Discarding the journal of another index";
+    header_->num_records = 0;
+    header_->create_time = create_time;
+  }
+
+  if (header_->num_records) {
+    // The last instance was not properly shut down, so these records may not
+    // be on the block files yet.
+    Trace("Journal recovery: %d records", header_->num_records);
+    for (int i = 0; i < header_->num_records; i++)
+      records_map_[records_[i].address] = i;
+    Flush();
+  }
+  return true;
+}
+
+void Journal::Close() {
+  if (!header_)
+    return;
+
+  Flush();
+  factory_.RevokeAll();
+  flush_pending_ = false;
+  records_map_.clear();
+  header_ = NULL;
+  records_ = NULL;
+  file_ = NULL;
+}
+
+bool Journal::Store(int file_number, const FileBlock* block) {
+  if (!header_ || block->size() != sizeof(RankingsNode))
+    return false;
+
+  Addr address = GetAddress(file_number, block);
+  int index;
+  RecordsMap::iterator it = records_map_.find(address.value());
+  if (it != records_map_.end()) {
+    index = it->second;
+  } else {
+    if (header_->num_records == kJournalRecords)
+      Flush();
+    index = header_->num_records;
+  }
+
+  JournalRecord* record = &records_[index];
+  record->address = address.value();
+  memcpy(&record->node, block->buffer(), sizeof(record->node));
+
+  if (index == header_->num_records) {
+    // The record is complete before it becomes valid.
+    header_->num_records++;
+    records_map_[address.value()] = index;
+  }
+
+  backend_->OnEvent(Stats::JOURNAL_RECORDS);
+  PostFlush();
+  return true;
+}
+
+bool Journal::Load(int file_number, const FileBlock* block) {
+  if (!header_ || block->size() != sizeof(RankingsNode))
+    return false;
+
+  RecordsMap::iterator it =
+      records_map_.find(GetAddress(file_number, block).value());
+  if (it == records_map_.end())
+    return false;
+
+  memcpy(block->buffer(), &records_[it->second].node, sizeof(RankingsNode));
+  return true;
+}
+
+void Journal::Discard(Addr address) {
+  if (!header_)
+    return;
+
+  RecordsMap::iterator it = records_map_.find(address.value());
+  if (it == records_map_.end())
+    return;
+
+  // Move the last record to this slot. If we crash in between, that record
+  // will be present twice, which is harmless.
+  int index = it->second;
+  int last = header_->num_records - 1;
+  records_map_.erase(it);
+  if (index != last) {
+    records_[index] = records_[last];
+    records_map_[records_[index].address] = index;
+  }
+  header_->num_records--;
+}
+
+void Journal::Flush() {
+  if (!header_ || !header_->num_records)
+    return;
+
+  // Sort the records by address, so that each block file is written in order,
+  // and adjacent nodes are written at the same time.
+  std::vector<std::pair<CacheAddr, int> > sorted;
+  sorted.reserve(header_->num_records);
+  for (int i = 0; i < header_->num_records; i++)
+    sorted.push_back(std::make_pair(records_[i].address, i));
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<char> buffer;
+  for (size_t i = 0; i < sorted.size();) {
+    Addr address(sorted[i].first);
+    size_t end = i + 1;
+    while (end < sorted.size() &&
+           sorted[end].first == sorted[end - 1].first + 1 &&
+           Addr(sorted[end].first).FileNumber() == address.FileNumber()) {
+      end++;
+    }
+
+    MappedFile* file = NULL;
+    if (address.is_initialized() && address.file_type() == RANKINGS &&
+        address.num_blocks() == 1) {
+      file = backend_->File(address);
+    }
+
+    BlockFileHeader* header =
+        file ? reinterpret_cast<BlockFileHeader*>(file->buffer()) : NULL;
+    int last_block = address.start_block() + static_cast<int>(end - i);
+    if (!header || last_block > header->max_entries) {
+      LOG(ERROR) << "Invalid journal record";
+      i = end;
+      continue;
+    }
+
+    buffer.resize((end - i) * sizeof(RankingsNode));
+    for (size_t j = i; j < end; j++) {
+      memcpy(&buffer[(j - i) * sizeof(RankingsNode)],
+             &records_[sorted[j].second].node, sizeof(RankingsNode));
+    }
+
+    size_t offset = address.start_block() * sizeof(RankingsNode) +
+                    kBlockHeaderSize;
+    if (!file->Write(&buffer[0], buffer.size(), offset))
+      LOG(ERROR) << "Failed to flush the journal";
+
+    backend_->OnEvent(Stats::JOURNAL_WRITES);
+    i = end;
+  }
+
+  // Everything is on the block files now.
+  header_->num_records = 0;
+  records_map_.clear();
+}
+
+bool Journal::CreateJournal(const FilePath& name, uint64 create_time) {
+  int flags = base::PLATFORM_FILE_CREATE_ALWAYS |
+              base::PLATFORM_FILE_READ |
+              base::PLATFORM_FILE_WRITE;
+  scoped_refptr<disk_cache::File> file(new disk_cache::File(
+      base::CreatePlatformFile(name, flags, NULL)));
+  if (!file->IsValid())
+    return false;
+
+  JournalHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kJournalMagic;
+  header.version = kJournalVersion;
+  header.create_time = create_time;
+  if (!file->Write(&header, sizeof(header), 0))
+    return false;
+
+  return file->SetLength(kJournalSize);
+}
+
+void Journal::PostFlush() {
+  if (flush_pending_)
+    return;
+
+  flush_pending_ = true;
+  MessageLoop::current()->PostDelayedTask(FROM_HERE,
+      factory_.NewRunnableMethod(&Journal::DelayedFlush), kFlushDelayMs);
+}
+
+void Journal::DelayedFlush() {
+  flush_pending_ = false;
+  Flush();
+}
+
+Addr Journal::GetAddress(int file_number, const FileBlock* block) const {
+  return Addr(RANKINGS, 1, file_number,
+              block->offset() / static_cast<int>(sizeof(RankingsNode)));
+}
+
+}  // namespace disk_cache
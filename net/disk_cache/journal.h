@@ -0,0 +1,96 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_JOURNAL_H_
+#define NET_DISK_CACHE_JOURNAL_H_
+
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/ref_counted.h"
+#include "base/task.h"
+#include "net/disk_cache/addr.h"
+#include "net/disk_cache/disk_format.h"
+
+class FilePath;
+
+namespace disk_cache {
+
+class BackendImpl;
+class FileBlock;
+class MappedFile;
+
+// This class implements a write-behind journal for the rankings nodes of the
+// cache. Every update of the LRU lists touches a few rankings nodes, and each
+// one of them used to be written to the rankings block-file right away, which
+// generates a lot of small scattered writes. Instead, the last version of each
+// modified node is kept on a small memory mapped file, and all of them are
+// written to the block files at once, sorted by address (and merging adjacent
+// nodes), after a short delay or when the journal is full.
+//
+// The journal is memory mapped, just like the index (which holds the heads and
+// tails of the lists and the transaction record of Rankings), so if the process
+// dies, both survive, in the same state that we had before when the nodes
+// were written directly to the block file. The records that were not flushed
+// are applied to the block files when the cache is opened again, before the
+// rankings are checked.
+class Journal {
+ public:
+  Journal();
+  ~Journal();
+
+  // Opens (or creates) the journal file |name|, for the index created at
+  // |create_time|. Records left over by a previous instance that was not
+  // properly shut down are written to the block files of |backend|, unless
+  // they belong to another index.
+  bool Init(const FilePath& name, uint64 create_time, BackendImpl* backend);
+
+  // Flushes all pending records and closes the journal.
+  void Close();
+
+  // Stores or loads |block|, located on the rankings block-file |file_number|.
+  // Returns false if the operation should go directly to the block file.
+  bool Store(int file_number, const FileBlock* block);
+  bool Load(int file_number, const FileBlock* block);
+
+  // Forgets any pending version of the rankings node stored at |address|,
+  // because the block is being deleted.
+  void Discard(Addr address);
+
+  // Writes all the pending records to the block files.
+  void Flush();
+
+  // Returns the number of records waiting to be flushed.
+  int num_records() const {
+    return header_ ? header_->num_records : 0;
+  }
+
+ private:
+  typedef base::hash_map<CacheAddr, int> RecordsMap;
+
+  // Creates an empty journal on |name|, for the index created at |create_time|.
+  bool CreateJournal(const FilePath& name, uint64 create_time);
+
+  // Posts a task to flush the journal, if there is not one already.
+  void PostFlush();
+  void DelayedFlush();
+
+  // Returns the address of |block|, stored on |file_number|.
+  Addr GetAddress(int file_number, const FileBlock* block) const;
+
+  BackendImpl* backend_;
+  scoped_refptr<MappedFile> file_;
+  JournalHeader* header_;  // Part of the memory mapped file.
+  JournalRecord* records_;
+  RecordsMap records_map_;  // Maps addresses to indices of records_.
+  bool flush_pending_;
+  ScopedRunnableMethodFactory<Journal> factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(Journal);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_JOURNAL_H_
@@ -17,13 +17,15 @@ class FilePath;
 
 namespace disk_cache {
 
+class Journal;
+
 // This class implements a memory mapped file used to access block-files. The
 // idea is that the header and bitmap will be memory mapped all the time, and
 // the actual data for the blocks will be access asynchronously (most of the
 // time).
 class MappedFile : public File {
  public:
-  MappedFile() : File(true), init_(false) {}
+  MappedFile() : File(true), init_(false), journal_(NULL), file_number_(0) {}
 
   // Performs object initialization. name is the file to use, and size is the
   // ammount of data to memory map from th efile. If size is 0, the whole file
@@ -38,6 +40,12 @@ class MappedFile : public File {
   bool Load(const FileBlock* block);
   bool Store(const FileBlock* block);
 
+  // Sends the blocks of this file (block-file |file_number|) through |journal|.
+  void set_journal(Journal* journal, int file_number) {
+    journal_ = journal;
+    file_number_ = file_number;
+  }
+
  private:
   virtual ~MappedFile();
 
@@ -47,6 +55,8 @@ class MappedFile : public File {
 #endif
   void* buffer_;  // Address of the memory mapped buffer.
   size_t view_size_;  // Size of the memory pointed by buffer_.
+  Journal* journal_;
+  int file_number_;
 
   DISALLOW_COPY_AND_ASSIGN(MappedFile);
 };
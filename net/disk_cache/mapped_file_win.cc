@@ -7,6 +7,7 @@
 #include "base/file_path.h"
 #include "base/logging.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/journal.h"
 
 namespace disk_cache {
 
@@ -43,11 +44,17 @@ MappedFile::~MappedFile() {
 }
 
 bool MappedFile::Load(const FileBlock* block) {
+  if (journal_ && journal_->Load(file_number_, block))
+    return true;
+
   size_t offset = block->offset() + view_size_;
   return Read(block->buffer(), block->size(), offset);
 }
 
 bool MappedFile::Store(const FileBlock* block) {
+  if (journal_ && journal_->Store(file_number_, block))
+    return true;
+
   size_t offset = block->offset() + view_size_;
   return Write(block->buffer(), block->size(), offset);
 }
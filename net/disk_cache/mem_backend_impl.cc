@@ -8,6 +8,7 @@
 #include "base/sys_info.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/hash.h"
 #include "net/disk_cache/mem_entry_impl.h"
 
 using base::Time;
@@ -24,10 +25,40 @@ int LowWaterAdjust(int high_water) {
   return high_water - kCleanUpMargin;
 }
 
+// Returns true if |rank1| was assigned after |rank2|. Ranks wrap around.
+bool IsMoreRecent(int32 rank1, int32 rank2) {
+  return static_cast<int32>(static_cast<uint32>(rank1) -
+                            static_cast<uint32>(rank2)) > 0;
+}
+
 }  // namespace
 
 namespace disk_cache {
 
+// Keeps track of the last entry returned from each shard.
+struct MemBackendImpl::Iterator {
+  Iterator() {
+    for (int i = 0; i < kNumShards; i++) {
+      last[i] = NULL;
+      done[i] = false;
+    }
+  }
+
+  MemEntryImpl* last[kNumShards];
+  bool done[kNumShards];
+};
+
+MemBackendImpl::ScopedLockAllShards::ScopedLockAllShards(
+    MemBackendImpl* backend) : backend_(backend) {
+  for (int i = 0; i < kNumShards; i++)
+    backend_->shards_[i].lock.Acquire();
+}
+
+MemBackendImpl::ScopedLockAllShards::~ScopedLockAllShards() {
+  for (int i = kNumShards - 1; i >= 0; i--)
+    backend_->shards_[i].lock.Release();
+}
+
 Backend* CreateInMemoryCacheBackend(int max_bytes) {
   MemBackendImpl* cache = new MemBackendImpl();
   cache->SetMaxSize(max_bytes);
@@ -41,6 +72,11 @@ Backend* CreateInMemoryCacheBackend(int max_bytes) {
 
 // ------------------------------------------------------------------------
 
+MemBackendImpl::MemBackendImpl()
+    : max_size_(0), current_size_(0), last_rank_(0) {
+  COMPILE_ASSERT(!(kNumShards & (kNumShards - 1)), invalid_number_of_shards);
+}
+
 bool MemBackendImpl::Init() {
   if (max_size_)
     return true;
@@ -64,10 +100,14 @@ bool MemBackendImpl::Init() {
 }
 
 MemBackendImpl::~MemBackendImpl() {
-  EntryMap::iterator it = entries_.begin();
-  while (it != entries_.end()) {
-    it->second->Doom();
-    it = entries_.begin();
+  ScopedLockAllShards lock(this);
+  for (int i = 0; i < kNumShards; i++) {
+    EntryMap& entries = shards_[i].entries;
+    EntryMap::iterator it = entries.begin();
+    while (it != entries.end()) {
+      it->second->DoomLocked();
+      it = entries.begin();
+    }
   }
   DCHECK(!current_size_);
 }
@@ -86,12 +126,19 @@ bool MemBackendImpl::SetMaxSize(int max_bytes) {
 }
 
 int32 MemBackendImpl::GetEntryCount() const {
-  return static_cast<int32>(entries_.size());
+  size_t count = 0;
+  for (int i = 0; i < kNumShards; i++) {
+    AutoLock lock(shards_[i].lock);
+    count += shards_[i].entries.size();
+  }
+  return static_cast<int32>(count);
 }
 
 bool MemBackendImpl::OpenEntry(const std::string& key, Entry** entry) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it == entries_.end())
+  Shard& shard = shards_[ShardForKey(key)];
+  AutoLock lock(shard.lock);
+  EntryMap::iterator it = shard.entries.find(key);
+  if (it == shard.entries.end())
     return false;
 
   it->second->Open();
@@ -109,20 +156,27 @@ int MemBackendImpl::OpenEntry(const std::string& key, Entry** entry,
 }
 
 bool MemBackendImpl::CreateEntry(const std::string& key, Entry** entry) {
-  EntryMap::iterator it = entries_.find(key);
-  if (it != entries_.end())
-    return false;
+  int shard_index = ShardForKey(key);
+  Shard& shard = shards_[shard_index];
+  {
+    AutoLock lock(shard.lock);
+    EntryMap::iterator it = shard.entries.find(key);
+    if (it != shard.entries.end())
+      return false;
+
+    MemEntryImpl* cache_entry = new MemEntryImpl(this, shard_index);
+    if (!cache_entry->CreateEntry(key)) {
+      delete entry;
+      return false;
+    }
 
-  MemEntryImpl* cache_entry = new MemEntryImpl(this);
-  if (!cache_entry->CreateEntry(key)) {
-    delete entry;
-    return false;
-  }
+    InsertIntoRankingList(cache_entry);
+    shard.entries[key] = cache_entry;
 
-  rankings_.Insert(cache_entry);
-  entries_[key] = cache_entry;
+    *entry = cache_entry;
+  }
 
-  *entry = cache_entry;
+  TrimCacheIfNeeded();
   return true;
 }
 
@@ -148,10 +202,12 @@ void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
   // Only parent entries can be passed into this method.
   DCHECK(entry->type() == MemEntryImpl::kParentEntry);
 
-  rankings_.Remove(entry);
-  EntryMap::iterator it = entries_.find(entry->GetKey());
-  if (it != entries_.end())
-    entries_.erase(it);
+  Shard& shard = shards_[entry->shard()];
+  shard.lock.AssertAcquired();
+  shard.rankings.Remove(entry);
+  EntryMap::iterator it = shard.entries.find(entry->GetKey());
+  if (it != shard.entries.end())
+    shard.entries.erase(it);
   else
     NOTREACHED();
 
@@ -159,6 +215,7 @@ void MemBackendImpl::InternalDoomEntry(MemEntryImpl* entry) {
 }
 
 bool MemBackendImpl::DoomAllEntries() {
+  ScopedLockAllShards lock(this);
   TrimCache(true);
   return true;
 }
@@ -177,20 +234,24 @@ bool MemBackendImpl::DoomEntriesBetween(const Time initial_time,
 
   DCHECK(end_time >= initial_time);
 
-  MemEntryImpl* next = rankings_.GetNext(NULL);
+  ScopedLockAllShards lock(this);
+  for (int i = 0; i < kNumShards; i++) {
+    MemRankings& rankings = shards_[i].rankings;
+    MemEntryImpl* next = rankings.GetNext(NULL);
 
-  // rankings_ is ordered by last used, this will descend through the cache
-  // and start dooming items before the end_time, and will stop once it reaches
-  // an item used before the initial time.
-  while (next) {
-    MemEntryImpl* node = next;
-    next = rankings_.GetNext(next);
+    // rankings is ordered by last used, this will descend through the shard
+    // and start dooming items before the end_time, and will stop once it
+    // reaches an item used before the initial time.
+    while (next) {
+      MemEntryImpl* node = next;
+      next = rankings.GetNext(next);
 
-    if (node->GetLastUsed() < initial_time)
-      break;
+      if (node->last_used() < initial_time)
+        break;
 
-    if (node->GetLastUsed() < end_time)
-      node->Doom();
+      if (node->last_used() < end_time)
+        node->DoomLocked();
+    }
   }
 
   return true;
@@ -206,15 +267,19 @@ int MemBackendImpl::DoomEntriesBetween(const base::Time initial_time,
 }
 
 bool MemBackendImpl::DoomEntriesSince(const Time initial_time) {
-  for (;;) {
-    // Get the entry in the front.
-    Entry* entry = rankings_.GetNext(NULL);
-
-    // Break the loop when there are no more entries or the entry is too old.
-    if (!entry || entry->GetLastUsed() < initial_time)
-      return true;
-    entry->Doom();
+  ScopedLockAllShards lock(this);
+  for (int i = 0; i < kNumShards; i++) {
+    for (;;) {
+      // Get the entry in the front.
+      MemEntryImpl* entry = shards_[i].rankings.GetNext(NULL);
+
+      // Break the loop when there are no more entries or the entry is too old.
+      if (!entry || entry->last_used() < initial_time)
+        break;
+      entry->DoomLocked();
+    }
   }
+  return true;
 }
 
 int MemBackendImpl::DoomEntriesSince(const base::Time initial_time,
@@ -225,21 +290,48 @@ int MemBackendImpl::DoomEntriesSince(const base::Time initial_time,
   return net::ERR_FAILED;
 }
 
+// Every shard is ordered by last used, so we just have to pick the most recent
+// of the candidates from each shard.
 bool MemBackendImpl::OpenNextEntry(void** iter, Entry** next_entry) {
-  MemEntryImpl* current = reinterpret_cast<MemEntryImpl*>(*iter);
-  MemEntryImpl* node = rankings_.GetNext(current);
-  // We should never return a child entry so iterate until we hit a parent
-  // entry.
-  while (node && node->type() != MemEntryImpl::kParentEntry) {
-    node = rankings_.GetNext(node);
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  if (!iterator) {
+    iterator = new Iterator();
+    *iter = iterator;
   }
-  *next_entry = node;
-  *iter = node;
 
-  if (node)
-    node->Open();
+  ScopedLockAllShards lock(this);
+  MemEntryImpl* node = NULL;
+  int node_shard = 0;
+  for (int i = 0; i < kNumShards; i++) {
+    if (iterator->done[i])
+      continue;
+
+    MemRankings& rankings = shards_[i].rankings;
+    MemEntryImpl* candidate = rankings.GetNext(iterator->last[i]);
+
+    // We should never return a child entry so iterate until we hit a parent
+    // entry.
+    while (candidate && candidate->type() != MemEntryImpl::kParentEntry)
+      candidate = rankings.GetNext(candidate);
+
+    if (!candidate) {
+      iterator->done[i] = true;
+      continue;
+    }
+
+    if (!node || IsMoreRecent(candidate->rank(), node->rank())) {
+      node = candidate;
+      node_shard = i;
+    }
+  }
+
+  *next_entry = node;
+  if (!node)
+    return false;
 
-  return NULL != node;
+  iterator->last[node_shard] = node;
+  node->Open();
+  return true;
 }
 
 int MemBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
@@ -251,48 +343,59 @@ int MemBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
 }
 
 void MemBackendImpl::EndEnumeration(void** iter) {
+  delete reinterpret_cast<Iterator*>(*iter);
   *iter = NULL;
 }
 
+// We walk all the shards from the oldest entry to the most recent one, at the
+// same time, always dooming the oldest entry.
 void MemBackendImpl::TrimCache(bool empty) {
-  MemEntryImpl* next = rankings_.GetPrev(NULL);
-
-  DCHECK(next);
+  MemEntryImpl* next[kNumShards];
+  for (int i = 0; i < kNumShards; i++) {
+    shards_[i].lock.AssertAcquired();
+    next[i] = shards_[i].rankings.GetPrev(NULL);
+  }
 
   int target_size = empty ? 0 : LowWaterAdjust(max_size_);
-  while (current_size_ > target_size && next) {
-    MemEntryImpl* node = next;
-    next = rankings_.GetPrev(next);
+  while (base::subtle::NoBarrier_Load(&current_size_) > target_size) {
+    int oldest = -1;
+    for (int i = 0; i < kNumShards; i++) {
+      if (next[i] && (oldest < 0 ||
+                      IsMoreRecent(next[oldest]->rank(), next[i]->rank())))
+        oldest = i;
+    }
+    if (oldest < 0)
+      break;
+
+    MemEntryImpl* node = next[oldest];
+    next[oldest] = shards_[oldest].rankings.GetPrev(node);
     if (!node->InUse() || empty) {
-      node->Doom();
+      node->DoomLocked();
     }
   }
 
   return;
 }
 
-void MemBackendImpl::AddStorageSize(int32 bytes) {
-  current_size_ += bytes;
-  DCHECK(current_size_ >= 0);
+void MemBackendImpl::TrimCacheIfNeeded() {
+  if (base::subtle::NoBarrier_Load(&current_size_) <= max_size_)
+    return;
 
-  if (current_size_ > max_size_)
+  ScopedLockAllShards lock(this);
+  if (base::subtle::NoBarrier_Load(&current_size_) > max_size_)
     TrimCache(false);
 }
 
-void MemBackendImpl::SubstractStorageSize(int32 bytes) {
-  current_size_ -= bytes;
-  DCHECK(current_size_ >= 0);
-}
-
 void MemBackendImpl::ModifyStorageSize(int32 old_size, int32 new_size) {
-  if (old_size >= new_size)
-    SubstractStorageSize(old_size - new_size);
-  else
-    AddStorageSize(new_size - old_size);
+  base::subtle::Atomic32 current = base::subtle::NoBarrier_AtomicIncrement(
+      &current_size_, new_size - old_size);
+  DCHECK(current >= 0);
 }
 
 void MemBackendImpl::UpdateRank(MemEntryImpl* node) {
-  rankings_.UpdateRank(node);
+  shards_[node->shard()].lock.AssertAcquired();
+  node->set_rank(base::subtle::NoBarrier_AtomicIncrement(&last_rank_, 1));
+  shards_[node->shard()].rankings.UpdateRank(node);
 }
 
 int MemBackendImpl::MaxFileSize() const {
@@ -300,11 +403,18 @@ int MemBackendImpl::MaxFileSize() const {
 }
 
 void MemBackendImpl::InsertIntoRankingList(MemEntryImpl* entry) {
-  rankings_.Insert(entry);
+  shards_[entry->shard()].lock.AssertAcquired();
+  entry->set_rank(base::subtle::NoBarrier_AtomicIncrement(&last_rank_, 1));
+  shards_[entry->shard()].rankings.Insert(entry);
 }
 
 void MemBackendImpl::RemoveFromRankingList(MemEntryImpl* entry) {
-  rankings_.Remove(entry);
+  shards_[entry->shard()].lock.AssertAcquired();
+  shards_[entry->shard()].rankings.Remove(entry);
+}
+
+int MemBackendImpl::ShardForKey(const std::string& key) const {
+  return static_cast<int>(Hash(key) & (kNumShards - 1));
 }
 
 }  // namespace disk_cache
@@ -7,7 +7,9 @@
 #ifndef NET_DISK_CACHE_MEM_BACKEND_IMPL_H__
 #define NET_DISK_CACHE_MEM_BACKEND_IMPL_H__
 
+#include "base/atomicops.h"
 #include "base/hash_tables.h"
+#include "base/lock.h"
 
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/mem_rankings.h"
@@ -18,9 +20,17 @@ class MemEntryImpl;
 
 // This class implements the Backend interface. An object of this class handles
 // the operations of the cache without writing to disk.
+//
+// The cache can be used from multiple threads. Entries are distributed among a
+// number of shards (based on the hash of the key), and each shard has its own
+// lock that protects the map of entries, the LRU list and the actual entries
+// that belong to that shard, so operations on entries of different shards don't
+// contend with each other. The storage size is tracked globally, and operations
+// that look at the whole cache (eviction, enumeration and the Doom* methods)
+// acquire the lock of every shard, always in the same order.
 class MemBackendImpl : public Backend {
  public:
-  MemBackendImpl() : max_size_(0), current_size_(0) {}
+  MemBackendImpl();
   ~MemBackendImpl();
 
   // Performs general initialization for this current instance of the cache.
@@ -55,18 +65,20 @@ class MemBackendImpl : public Backend {
   // Sets the maximum size for the total amount of data stored by this instance.
   bool SetMaxSize(int max_bytes);
 
+  // Returns the lock that protects the entries of a given |shard|.
+  Lock& ShardLock(int shard) {
+    return shards_[shard].lock;
+  }
+
+  // The following methods must be called with the lock of the shard of |entry|
+  // already acquired.
+
   // Permanently deletes an entry.
   void InternalDoomEntry(MemEntryImpl* entry);
 
   // Updates the ranking information for an entry.
   void UpdateRank(MemEntryImpl* node);
 
-  // A user data block is being created, extended or truncated.
-  void ModifyStorageSize(int32 old_size, int32 new_size);
-
-  // Returns the maximum size for a file to reside on the cache.
-  int MaxFileSize() const;
-
   // Insert an MemEntryImpl into the ranking list. This method is only called
   // from MemEntryImpl to insert child entries. The reference can be removed
   // by calling RemoveFromRankingList(|entry|).
@@ -76,22 +88,58 @@ class MemBackendImpl : public Backend {
   // MemEntryImpl to remove a child entry from the ranking list.
   void RemoveFromRankingList(MemEntryImpl* entry);
 
+  // The following methods can be called without holding any lock.
+
+  // A user data block is being created, extended or truncated.
+  void ModifyStorageSize(int32 old_size, int32 new_size);
+
+  // Evicts entries if the cache is using more storage than allowed. This must
+  // be called after growing an entry, once the lock has been released.
+  void TrimCacheIfNeeded();
+
+  // Returns the maximum size for a file to reside on the cache.
+  int MaxFileSize() const;
+
  private:
+  enum {
+    kNumShards = 16  // Must be a power of two.
+  };
+
+  typedef base::hash_map<std::string, MemEntryImpl*> EntryMap;
+
+  struct Shard {
+    mutable Lock lock;
+    EntryMap entries;
+    MemRankings rankings;  // Rankings to be able to trim the cache.
+  };
+
+  // Holds the lock of every shard while in scope.
+  class ScopedLockAllShards {
+   public:
+    explicit ScopedLockAllShards(MemBackendImpl* backend);
+    ~ScopedLockAllShards();
+
+   private:
+    MemBackendImpl* backend_;
+    DISALLOW_COPY_AND_ASSIGN(ScopedLockAllShards);
+  };
+  friend class ScopedLockAllShards;
+
+  // Enumeration state, as seen by the user of OpenNextEntry().
+  struct Iterator;
+
+  // Returns the shard that stores |key|.
+  int ShardForKey(const std::string& key) const;
+
   // Deletes entries from the cache until the current size is below the limit.
   // If empty is true, the whole cache will be trimmed, regardless of being in
-  // use.
+  // use. All shards must be locked.
   void TrimCache(bool empty);
 
-  // Handles the used storage count.
-  void AddStorageSize(int32 bytes);
-  void SubstractStorageSize(int32 bytes);
-
-  typedef base::hash_map<std::string, MemEntryImpl*> EntryMap;
-
-  EntryMap entries_;
-  MemRankings rankings_;  // Rankings to be able to trim the cache.
-  int32 max_size_;        // Maximum data size for this instance.
-  int32 current_size_;
+  Shard shards_[kNumShards];
+  int32 max_size_;  // Maximum data size for this instance.
+  volatile base::subtle::Atomic32 current_size_;
+  volatile base::subtle::Atomic32 last_rank_;  // Source for MemEntryImpl ranks.
 
   DISALLOW_EVIL_CONSTRUCTORS(MemBackendImpl);
 };
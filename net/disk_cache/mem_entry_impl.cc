@@ -35,9 +35,11 @@ inline int ToChildOffset(int64 offset) {
 
 namespace disk_cache {
 
-MemEntryImpl::MemEntryImpl(MemBackendImpl* backend) {
+MemEntryImpl::MemEntryImpl(MemBackendImpl* backend, int shard) {
   doomed_ = false;
   backend_ = backend;
+  shard_ = shard;
+  rank_ = 0;
   ref_count_ = 0;
   parent_ = NULL;
   child_id_ = 0;
@@ -55,6 +57,11 @@ MemEntryImpl::~MemEntryImpl() {
 }
 
 void MemEntryImpl::Doom() {
+  AutoLock lock(backend_->ShardLock(shard_));
+  DoomLocked();
+}
+
+void MemEntryImpl::DoomLocked() {
   if (doomed_)
     return;
   if (type() == kParentEntry) {
@@ -70,6 +77,7 @@ void MemEntryImpl::Doom() {
 void MemEntryImpl::Close() {
   // Only a parent entry can be closed.
   DCHECK(type() == kParentEntry);
+  AutoLock lock(backend_->ShardLock(shard_));
   ref_count_--;
   DCHECK(ref_count_ >= 0);
   if (!ref_count_ && doomed_)
@@ -83,27 +91,138 @@ std::string MemEntryImpl::GetKey() const {
 }
 
 Time MemEntryImpl::GetLastUsed() const {
+  AutoLock lock(backend_->ShardLock(shard_));
   return last_used_;
 }
 
 Time MemEntryImpl::GetLastModified() const {
+  AutoLock lock(backend_->ShardLock(shard_));
   return last_modified_;
 }
 
 int32 MemEntryImpl::GetDataSize(int index) const {
   if (index < 0 || index >= NUM_STREAMS)
     return 0;
+  AutoLock lock(backend_->ShardLock(shard_));
   return data_size_[index];
 }
 
 int MemEntryImpl::ReadData(int index, int offset, net::IOBuffer* buf,
     int buf_len, net::CompletionCallback* completion_callback) {
+  AutoLock lock(backend_->ShardLock(shard_));
+  return InternalReadData(index, offset, buf, buf_len);
+}
+
+int MemEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback, bool truncate) {
+  int rv;
+  {
+    AutoLock lock(backend_->ShardLock(shard_));
+    rv = InternalWriteData(index, offset, buf, buf_len, truncate);
+  }
+  backend_->TrimCacheIfNeeded();
+  return rv;
+}
+
+int MemEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                                 net::CompletionCallback* completion_callback) {
+  AutoLock lock(backend_->ShardLock(shard_));
+  return InternalReadSparseData(offset, buf, buf_len);
+}
+
+int MemEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+    net::CompletionCallback* completion_callback) {
+  int rv;
+  {
+    AutoLock lock(backend_->ShardLock(shard_));
+    rv = InternalWriteSparseData(offset, buf, buf_len);
+  }
+  backend_->TrimCacheIfNeeded();
+  return rv;
+}
+
+int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
+  AutoLock lock(backend_->ShardLock(shard_));
+  return InternalGetAvailableRange(offset, len, start);
+}
+
+int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
+                                    CompletionCallback* callback) {
+  return GetAvailableRange(offset, len, start);
+}
+
+int MemEntryImpl::ReadyForSparseIO(
+    net::CompletionCallback* completion_callback) {
+  return net::OK;
+}
+
+// ------------------------------------------------------------------------
+
+bool MemEntryImpl::CreateEntry(const std::string& key) {
+  key_ = key;
+  last_modified_ = Time::Now();
+  last_used_ = Time::Now();
+  Open();
+  backend_->ModifyStorageSize(0, static_cast<int32>(key.size()));
+  return true;
+}
+
+void MemEntryImpl::InternalDoom() {
+  doomed_ = true;
+  if (!ref_count_) {
+    if (type() == kParentEntry) {
+      // If this is a parent entry, we need to doom all the child entries.
+      if (children_.get()) {
+        EntryMap children;
+        children.swap(*children_);
+        for (EntryMap::iterator i = children.begin();
+             i != children.end(); ++i) {
+          // Since a pointer to this object is also saved in the map, avoid
+          // dooming it.
+          if (i->second != this)
+            i->second->DoomLocked();
+        }
+        DCHECK(children_->size() == 0);
+      }
+    } else {
+      // If this is a child entry, detach it from the parent.
+      parent_->DetachChild(child_id_);
+    }
+    delete this;
+  }
+}
+
+void MemEntryImpl::Open() {
+  // Only a parent entry can be opened.
+  // TODO(hclam): make sure it's correct to not apply the concept of ref
+  // counting to child entry.
+  DCHECK(type() == kParentEntry);
+  ref_count_++;
+  DCHECK(ref_count_ >= 0);
+  DCHECK(!doomed_);
+}
+
+bool MemEntryImpl::InUse() {
+  if (type() == kParentEntry) {
+    return ref_count_ > 0;
+  } else {
+    // A child entry is always not in use. The consequence is that a child entry
+    // can always be evicted while the associated parent entry is currently in
+    // used (i.e. opened).
+    return false;
+  }
+}
+
+// ------------------------------------------------------------------------
+
+int MemEntryImpl::InternalReadData(int index, int offset, net::IOBuffer* buf,
+                                   int buf_len) {
   DCHECK(type() == kParentEntry || index == kSparseData);
 
   if (index < 0 || index >= NUM_STREAMS)
     return net::ERR_INVALID_ARGUMENT;
 
-  int entry_size = GetDataSize(index);
+  int entry_size = data_size_[index];
   if (offset >= entry_size || offset < 0 || !buf_len)
     return 0;
 
@@ -119,8 +238,8 @@ int MemEntryImpl::ReadData(int index, int offset, net::IOBuffer* buf,
   return buf_len;
 }
 
-int MemEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
-    int buf_len, net::CompletionCallback* completion_callback, bool truncate) {
+int MemEntryImpl::InternalWriteData(int index, int offset, net::IOBuffer* buf,
+                                    int buf_len, bool truncate) {
   DCHECK(type() == kParentEntry || index == kSparseData);
 
   if (index < 0 || index >= NUM_STREAMS)
@@ -138,7 +257,7 @@ int MemEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
   }
 
   // Read the size at this point.
-  int entry_size = GetDataSize(index);
+  int entry_size = data_size_[index];
 
   PrepareTarget(index, offset, buf_len);
 
@@ -161,8 +280,8 @@ int MemEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
   return buf_len;
 }
 
-int MemEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
-                                 net::CompletionCallback* completion_callback) {
+int MemEntryImpl::InternalReadSparseData(int64 offset, net::IOBuffer* buf,
+                                         int buf_len) {
   DCHECK(type() == kParentEntry);
 
   if (!InitSparseInfo())
@@ -190,8 +309,8 @@ int MemEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
     // we should stop.
     if (child_offset < child->child_first_pos_)
       break;
-    int ret = child->ReadData(kSparseData, child_offset, io_buf,
-                              io_buf->BytesRemaining(), NULL);
+    int ret = child->InternalReadData(kSparseData, child_offset, io_buf,
+                                      io_buf->BytesRemaining());
 
     // If we encounter an error in one entry, return immediately.
     if (ret < 0)
@@ -208,8 +327,8 @@ int MemEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
   return io_buf->BytesConsumed();
 }
 
-int MemEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
-    net::CompletionCallback* completion_callback) {
+int MemEntryImpl::InternalWriteSparseData(int64 offset, net::IOBuffer* buf,
+                                          int buf_len) {
   DCHECK(type() == kParentEntry);
 
   if (!InitSparseInfo())
@@ -235,14 +354,14 @@ int MemEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
                              kMaxSparseEntrySize - child_offset);
 
     // Keep a record of the last byte position (exclusive) in the child.
-    int data_size = child->GetDataSize(kSparseData);
+    int data_size = child->data_size_[kSparseData];
 
     // Always writes to the child entry. This operation may overwrite data
     // previously written.
     // TODO(hclam): if there is data in the entry and this write is not
     // continuous we may want to discard this write.
-    int ret = child->WriteData(kSparseData, child_offset, io_buf, write_len,
-                               NULL, true);
+    int ret = child->InternalWriteData(kSparseData, child_offset, io_buf,
+                                       write_len, true);
     if (ret < 0)
       return ret;
     else if (ret == 0)
@@ -263,7 +382,8 @@ int MemEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
   return io_buf->BytesConsumed();
 }
 
-int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
+int MemEntryImpl::InternalGetAvailableRange(int64 offset, int len,
+                                            int64* start) {
   DCHECK(type() == kParentEntry);
   DCHECK(start);
 
@@ -287,7 +407,7 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
     // This loop scan for continuous bytes.
     while (len && current_child) {
       // Number of bytes available in this child.
-      int data_size = current_child->GetDataSize(kSparseData) -
+      int data_size = current_child->data_size_[kSparseData] -
                       ToChildOffset(*start + continuous);
       if (data_size > len)
         data_size = len;
@@ -307,77 +427,10 @@ int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start) {
   return 0;
 }
 
-int MemEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
-                                    CompletionCallback* callback) {
-  return GetAvailableRange(offset, len, start);
-}
-
-int MemEntryImpl::ReadyForSparseIO(
-    net::CompletionCallback* completion_callback) {
-  return net::OK;
-}
-
-// ------------------------------------------------------------------------
-
-bool MemEntryImpl::CreateEntry(const std::string& key) {
-  key_ = key;
-  last_modified_ = Time::Now();
-  last_used_ = Time::Now();
-  Open();
-  backend_->ModifyStorageSize(0, static_cast<int32>(key.size()));
-  return true;
-}
-
-void MemEntryImpl::InternalDoom() {
-  doomed_ = true;
-  if (!ref_count_) {
-    if (type() == kParentEntry) {
-      // If this is a parent entry, we need to doom all the child entries.
-      if (children_.get()) {
-        EntryMap children;
-        children.swap(*children_);
-        for (EntryMap::iterator i = children.begin();
-             i != children.end(); ++i) {
-          // Since a pointer to this object is also saved in the map, avoid
-          // dooming it.
-          if (i->second != this)
-            i->second->Doom();
-        }
-        DCHECK(children_->size() == 0);
-      }
-    } else {
-      // If this is a child entry, detach it from the parent.
-      parent_->DetachChild(child_id_);
-    }
-    delete this;
-  }
-}
-
-void MemEntryImpl::Open() {
-  // Only a parent entry can be opened.
-  // TODO(hclam): make sure it's correct to not apply the concept of ref
-  // counting to child entry.
-  DCHECK(type() == kParentEntry);
-  ref_count_++;
-  DCHECK(ref_count_ >= 0);
-  DCHECK(!doomed_);
-}
-
-bool MemEntryImpl::InUse() {
-  if (type() == kParentEntry) {
-    return ref_count_ > 0;
-  } else {
-    // A child entry is always not in use. The consequence is that a child entry
-    // can always be evicted while the associated parent entry is currently in
-    // used (i.e. opened).
-    return false;
-  }
-}
-
 // ------------------------------------------------------------------------
 
 void MemEntryImpl::PrepareTarget(int index, int offset, int buf_len) {
-  int entry_size = GetDataSize(index);
+  int entry_size = data_size_[index];
 
   if (entry_size >= offset + buf_len)
     return;  // Not growing the stored data.
@@ -410,7 +463,7 @@ bool MemEntryImpl::InitSparseInfo() {
   if (!children_.get()) {
     // If we already have some data in sparse stream but we are being
     // initialized as a sparse entry, we should fail.
-    if (GetDataSize(kSparseData))
+    if (data_size_[kSparseData])
       return false;
     children_.reset(new EntryMap());
 
@@ -440,7 +493,7 @@ MemEntryImpl* MemEntryImpl::OpenChild(int64 offset, bool create) {
   if (i != children_->end()) {
     return i->second;
   } else if (create) {
-    MemEntryImpl* child = new MemEntryImpl(backend_);
+    MemEntryImpl* child = new MemEntryImpl(backend_, shard_);
     child->InitChildEntry(this, index);
     (*children_)[index] = child;
     return child;
@@ -467,7 +520,7 @@ int MemEntryImpl::FindNextChild(int64 offset, int len, MemEntryImpl** child) {
 
       // If the first byte position we should read from doesn't exceed the
       // filled region, we have found the first child.
-      if (first_pos < current_child->GetDataSize(kSparseData)) {
+      if (first_pos < current_child->data_size_[kSparseData]) {
          *child = current_child;
 
          // We need to advance the scanned length.
@@ -41,6 +41,10 @@ class MemBackendImpl;
 // region, and the unfilled region (if there is one) is always before the filled
 // region. The book keeping for filled region in a sparse entry is done by using
 // the variable |child_first_pos_| (inclusive).
+//
+// Every entry belongs to a shard of the backend (child entries are stored on
+// the shard of their parent), and the lock of that shard must be held while
+// accessing the entry. The methods of the Entry interface take care of that.
 
 class MemEntryImpl : public Entry {
  public:
@@ -49,7 +53,7 @@ class MemEntryImpl : public Entry {
     kChildEntry,
   };
 
-  explicit MemEntryImpl(MemBackendImpl* backend);
+  MemEntryImpl(MemBackendImpl* backend, int shard);
 
   // Entry interface.
   virtual void Doom();
@@ -77,12 +81,35 @@ class MemEntryImpl : public Entry {
   // cache.
   bool CreateEntry(const std::string& key);
 
+  // The following methods must be called with the lock of this entry's shard
+  // already acquired.
+
+  // Same as Doom(), without acquiring the lock.
+  void DoomLocked();
+
   // Permanently destroys this entry.
   void InternalDoom();
 
   void Open();
   bool InUse();
 
+  int shard() const {
+    return shard_;
+  }
+
+  // The rank of an entry says when it was used, relative to other entries.
+  int32 rank() const {
+    return rank_;
+  }
+
+  void set_rank(int32 rank) {
+    rank_ = rank;
+  }
+
+  const base::Time& last_used() const {
+    return last_used_;
+  }
+
   MemEntryImpl* next() const {
     return next_;
   }
@@ -112,6 +139,14 @@ class MemEntryImpl : public Entry {
 
   ~MemEntryImpl();
 
+  // Versions of the Entry interface methods that run with the lock held.
+  int InternalReadData(int index, int offset, net::IOBuffer* buf, int buf_len);
+  int InternalWriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        bool truncate);
+  int InternalReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len);
+  int InternalWriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len);
+  int InternalGetAvailableRange(int64 offset, int len, int64* start);
+
   // Grows and cleans up the data buffer.
   void PrepareTarget(int index, int offset, int buf_len);
 
@@ -157,6 +192,8 @@ class MemEntryImpl : public Entry {
   base::Time last_modified_;  // LRU information.
   base::Time last_used_;
   MemBackendImpl* backend_;   // Back pointer to the cache.
+  int shard_;                 // The shard that holds this entry.
+  int32 rank_;                // Position on the global LRU order.
   bool doomed_;               // True if this entry was removed from the cache.
 
   DISALLOW_EVIL_CONSTRUCTORS(MemEntryImpl);
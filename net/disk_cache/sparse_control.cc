@@ -34,6 +34,10 @@ const int kMaxEntrySize = 0x100000;
 // The size of each data block (tracked by the child allocation bitmap).
 const int kBlockSize = 1024;
 
+// The maximum number of extents stored by a parent entry. If the data is more
+// fragmented than this, we just keep the bitmap of children.
+const int kMaxExtents = 1024;
+
 // Returns the name of of a child entry given the base_name and signature of the
 // parent and the child_id.
 // If the entry is called entry_name, child entries will be named something
@@ -91,7 +95,18 @@ void ChildrenDeleter::Start(char* buffer, int len) {
       reinterpret_cast<disk_cache::SparseData*>(buffer);
   signature_ = data->header.signature;
 
-  int num_bits = (len - sizeof(disk_cache::SparseHeader)) * 8;
+  int map_len = len - sizeof(disk_cache::SparseHeader);
+  if (data->header.flags & disk_cache::SPARSE_EXTENTS) {
+    // The bitmap is followed by the list of extents.
+    if (data->header.num_extents < 0 ||
+        data->header.num_extents > kMaxExtents)
+      return Release();
+    map_len -= data->header.num_extents * sizeof(disk_cache::SparseExtent);
+  }
+  if (map_len <= 0 || map_len % 4)
+    return Release();
+
+  int num_bits = map_len * 8;
   children_map_.Resize(num_bits, false);
   children_map_.SetMap(data->bitmap, num_bits / 32);
   buffer_.reset();
@@ -186,6 +201,15 @@ int SparseControl::StartIO(SparseOperation op, int64 offset, net::IOBuffer* buf,
   if (!buf && (op == kReadOperation || op == kWriteOperation))
     return 0;
 
+  if (op == kReadOperation && UsesExtents()) {
+    // Reads stop at the first hole, and we know where that is.
+    int64 available = extents_.ContiguousLength(offset);
+    buf_len = static_cast<int>(std::min(static_cast<int64>(buf_len),
+                                        available));
+    if (!buf_len)
+      return 0;
+  }
+
   // Copy the operation parameters.
   operation_ = op;
   offset_ = offset;
@@ -219,6 +243,18 @@ int SparseControl::GetAvailableRange(int64 offset, int len, int64* start) {
 
   DCHECK(start);
 
+  if (UsesExtents()) {
+    // We know where the data is, so there is no need to look at the children.
+    if (offset < 0 || len < 0)
+      return net::ERR_INVALID_ARGUMENT;
+
+    if (offset + len >= 0x1000000000LL || offset + len < 0)
+      return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+
+    *start = offset;
+    return static_cast<int>(extents_.FindFirst(offset, len, start));
+  }
+
   range_found_ = false;
   int result = StartIO(kGetRangeOperation, offset, NULL, len, NULL);
   if (range_found_) {
@@ -257,8 +293,10 @@ void SparseControl::DeleteChildren(EntryImpl* entry) {
       entry->GetDataSize(kSparseData))
     return;
 
+  // The list of extents (if any) is validated by the deleter.
   int map_len = data_len - sizeof(SparseHeader);
-  if (map_len > kMaxMapSize || map_len % 4)
+  int max_extents_len = kMaxExtents * sizeof(SparseExtent);
+  if (map_len > kMaxMapSize + max_extents_len || map_len % 4)
     return;
 
   char* buffer;
@@ -281,6 +319,45 @@ void SparseControl::DeleteChildren(EntryImpl* entry) {
   }
 }
 
+// Static
+bool SparseControl::ParseChildName(const std::string& name,
+                                   std::string* parent_key, int64* child_id) {
+  // The format is Range_entry_name:XXX:YYY (see GenerateChildName).
+  const char kPrefix[] = "Range_";
+  const size_t kPrefixLen = arraysize(kPrefix) - 1;
+  if (!StartsWithASCII(name, kPrefix, true))
+    return false;
+
+  size_t id_pos = name.rfind(':');
+  if (id_pos == std::string::npos || id_pos <= kPrefixLen)
+    return false;
+  size_t signature_pos = name.rfind(':', id_pos - 1);
+  if (signature_pos == std::string::npos || signature_pos < kPrefixLen)
+    return false;
+
+  int id;
+  if (!HexStringToInt(name.substr(id_pos + 1), &id) || id < 0)
+    return false;
+
+  parent_key->assign(name, kPrefixLen, signature_pos - kPrefixLen);
+  *child_id = id;
+  return true;
+}
+
+void SparseControl::OnChildDoomed(const std::string& child_key,
+                                  int64 child_id) {
+  DCHECK(init_);
+  // The name includes the signature, so this discards children of a previous
+  // entry with the same key.
+  if (child_key != GenerateChildName(entry_->GetKey(), sparse_header_.signature,
+                                     child_id))
+    return;
+
+  if (child_id < children_map_.Size())
+    children_map_.Set(static_cast<int>(child_id), false);
+  extents_.Remove(child_id * kMaxEntrySize, (child_id + 1) * kMaxEntrySize);
+}
+
 // We are going to start using this entry to store sparse data, so we have to
 // initialize our control info.
 int SparseControl::CreateSparseEntry() {
@@ -291,6 +368,7 @@ int SparseControl::CreateSparseEntry() {
   sparse_header_.signature = Time::Now().ToInternalValue();
   sparse_header_.magic = kIndexMagic;
   sparse_header_.parent_key_len = entry_->GetKey().size();
+  sparse_header_.flags = SPARSE_EXTENTS;
   children_map_.Resize(kNumSparseBits, true);
 
   // Save the header. The bitmap is saved in the destructor.
@@ -319,11 +397,6 @@ int SparseControl::OpenSparseEntry(int data_len) {
   if (!(PARENT_ENTRY & entry_->GetEntryFlags()))
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
 
-  // Dont't go over board with the bitmap. 8 KB gives us offsets up to 64 GB.
-  int map_len = data_len - sizeof(sparse_header_);
-  if (map_len > kMaxMapSize || map_len % 4)
-    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
-
   scoped_refptr<net::IOBuffer> buf =
       new net::WrappedIOBuffer(reinterpret_cast<char*>(&sparse_header_));
 
@@ -339,16 +412,39 @@ int SparseControl::OpenSparseEntry(int data_len) {
           static_cast<int>(entry_->GetKey().size()))
     return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
 
-  // Read the actual bitmap.
-  buf = new net::IOBuffer(map_len);
-  rv = entry_->ReadData(kSparseIndex, sizeof(sparse_header_), buf, map_len,
-                        NULL);
-  if (rv != map_len)
+  int num_extents = 0;
+  if (UsesExtents()) {
+    num_extents = sparse_header_.num_extents;
+    if (num_extents < 0 || num_extents > kMaxExtents)
+      return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  }
+  int extents_len = num_extents * sizeof(SparseExtent);
+
+  // Dont't go over board with the bitmap. 8 KB gives us offsets up to 64 GB.
+  int map_len = data_len - sizeof(sparse_header_) - extents_len;
+  if (map_len <= 0 || map_len > kMaxMapSize || map_len % 4)
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+
+  // Read the actual bitmap and the extents.
+  buf = new net::IOBuffer(map_len + extents_len);
+  rv = entry_->ReadData(kSparseIndex, sizeof(sparse_header_), buf,
+                        map_len + extents_len, NULL);
+  if (rv != map_len + extents_len)
     return net::ERR_CACHE_READ_FAILURE;
 
   // Grow the bitmap to the current size and copy the bits.
   children_map_.Resize(map_len * 8, false);
   children_map_.SetMap(reinterpret_cast<uint32*>(buf->data()), map_len);
+
+  extents_.Clear();
+  for (int i = 0; i < num_extents; i++) {
+    SparseExtent extent;
+    memcpy(&extent, buf->data() + map_len + i * sizeof(extent),
+           sizeof(extent));
+    if (extent.start < 0 || extent.start >= extent.end)
+      return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+    extents_.Add(extent.start, extent.end);
+  }
   return net::OK;
 }
 
@@ -417,6 +513,7 @@ std::string SparseControl::GenerateChildKey() {
 // We are deleting the child because something went wrong.
 bool SparseControl::KillChildAndContinue(const std::string& key, bool fatal) {
   SetChildBit(false);
+  RemoveChildExtents();
   child_->Doom();
   child_->Close();
   child_ = NULL;
@@ -429,6 +526,9 @@ bool SparseControl::KillChildAndContinue(const std::string& key, bool fatal) {
 
 // We were not able to open this child; see what we can do.
 bool SparseControl::ContinueWithoutChild(const std::string& key) {
+  // Whatever we thought this child was storing is not there anymore.
+  RemoveChildExtents();
+
   if (kReadOperation == operation_)
     return false;
   if (kGetRangeOperation == operation_)
@@ -463,6 +563,9 @@ void SparseControl::SetChildBit(bool value) {
 }
 
 void SparseControl::WriteSparseData() {
+  if (UsesExtents())
+    return WriteSparseDataWithExtents();
+
   scoped_refptr<net::IOBuffer> buf = new net::WrappedIOBuffer(
       reinterpret_cast<const char*>(children_map_.GetMap()));
 
@@ -474,6 +577,43 @@ void SparseControl::WriteSparseData() {
   }
 }
 
+void SparseControl::WriteSparseDataWithExtents() {
+  sparse_header_.num_extents = extents_.size();
+  if (sparse_header_.num_extents > kMaxExtents) {
+    // This entry is too fragmented. From now on, we'll have to look at the
+    // children to find out what is stored.
+    sparse_header_.flags &= ~SPARSE_EXTENTS;
+    sparse_header_.num_extents = 0;
+  }
+
+  int map_len = children_map_.ArraySize() * 4;
+  int len = sizeof(sparse_header_) + map_len +
+            sparse_header_.num_extents * sizeof(SparseExtent);
+  scoped_refptr<net::IOBuffer> buf = new net::IOBuffer(len);
+  char* data = buf->data();
+  memcpy(data, &sparse_header_, sizeof(sparse_header_));
+  data += sizeof(sparse_header_);
+  memcpy(data, children_map_.GetMap(), map_len);
+  data += map_len;
+
+  if (UsesExtents()) {
+    for (ExtentMap::const_iterator it = extents_.begin(); it != extents_.end();
+         ++it) {
+      SparseExtent extent;
+      extent.start = it->first;
+      extent.end = it->second;
+      memcpy(data, &extent, sizeof(extent));
+      data += sizeof(extent);
+    }
+  }
+
+  // The whole stream is rewritten, so we can get rid of old extents.
+  int rv = entry_->WriteData(kSparseIndex, 0, buf, len, NULL, true);
+  if (rv != len) {
+    DLOG(ERROR) << "Unable to save sparse map";
+  }
+}
+
 bool SparseControl::VerifyRange() {
   DCHECK_GE(result_, 0);
 
@@ -547,6 +687,39 @@ void SparseControl::UpdateRange(int result) {
   child_map_.SetRange(first_bit, last_bit, true);
 }
 
+void SparseControl::UpdateExtents() {
+  RemoveChildExtents();
+  int64 child_start = offset_ - child_offset_;
+
+  // Runs of full blocks, maybe followed by a partial block.
+  int block = 0;
+  while (block < kNumSparseBits) {
+    int num_blocks = child_map_.FindBits(&block, kNumSparseBits, true);
+    if (!num_blocks)
+      break;
+    int64 start = child_start + (block << 10);
+    int64 len = (num_blocks << 10) + PartialBlockLength(block + num_blocks);
+    extents_.Add(start, start + len);
+    block += num_blocks;
+  }
+
+  // A partial block can also be found by itself.
+  int partial_blocks[] = { child_data_.header.last_block,
+                           child_->GetDataSize(kSparseData) >> 10 };
+  for (size_t i = 0; i < arraysize(partial_blocks); i++) {
+    block = partial_blocks[i];
+    if (block < 0 || block >= kNumSparseBits || child_map_.Get(block))
+      continue;
+    int64 start = child_start + (block << 10);
+    extents_.Add(start, start + PartialBlockLength(block));
+  }
+}
+
+void SparseControl::RemoveChildExtents() {
+  int64 child_start = offset_ & ~static_cast<int64>(kMaxEntrySize - 1);
+  extents_.Remove(child_start, child_start + kMaxEntrySize);
+}
+
 int SparseControl::PartialBlockLength(int block_index) const {
   if (block_index == child_data_.header.last_block)
     return child_data_.header.last_block_len;
@@ -690,6 +863,8 @@ void SparseControl::DoChildIOCompleted(int result) {
   }
 
   UpdateRange(result);
+  if (UsesExtents() && result && operation_ == kWriteOperation)
+    UpdateExtents();
 
   result_ += result;
   offset_ += result;
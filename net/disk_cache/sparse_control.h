@@ -13,6 +13,7 @@
 #include "net/base/completion_callback.h"
 #include "net/disk_cache/bitmap.h"
 #include "net/disk_cache/disk_format.h"
+#include "net/disk_cache/extent_map.h"
 
 namespace net {
 class IOBuffer;
@@ -29,6 +30,14 @@ class EntryImpl;
 // the operation into multiple small pieces, sending each one to the
 // appropriate entry. An instance of this class is asociated with each entry
 // used directly for sparse operations (the entry passed in to the constructor).
+//
+// New parent entries also keep track of the actual ranges stored by all the
+// children (see SPARSE_EXTENTS on disk_format.h), so that GetAvailableRange()
+// can be answered without opening any child, and reads can be sized up front
+// instead of looking for holes one child at a time. Children are evicted on
+// their own, so the backend tells the parent when a child is doomed (see
+// OnChildDoomed), and the extents of a child that cannot be opened are dropped
+// as soon as we notice.
 class SparseControl {
  public:
   // The operation to perform.
@@ -75,6 +84,15 @@ class SparseControl {
   // Deletes the children entries of |entry|.
   static void DeleteChildren(EntryImpl* entry);
 
+  // Extracts the key of the parent entry and the child id from the |name| of
+  // a child entry. Returns false if |name| is not the name of a child.
+  static bool ParseChildName(const std::string& name, std::string* parent_key,
+                             int64* child_id);
+
+  // Stops tracking the child |child_id|, named |child_key|, because it was
+  // doomed. The new state is saved to disk when this object goes away.
+  void OnChildDoomed(const std::string& child_key, int64 child_id);
+
  private:
   // Creates a new sparse entry or opens an aready created entry from disk.
   // These methods just read / write the required info from disk for the current
@@ -107,6 +125,24 @@ class SparseControl {
   // Writes to disk the tracking information for this entry.
   void WriteSparseData();
 
+  // Writes to disk the tracking information for this entry, including the list
+  // of extents. Reverts to the plain bitmap of children if there are too many
+  // extents to store.
+  void WriteSparseDataWithExtents();
+
+  // Returns true if this entry keeps track of the extents stored by the
+  // children.
+  bool UsesExtents() const {
+    return (sparse_header_.flags & SPARSE_EXTENTS) != 0;
+  }
+
+  // Updates the list of extents with the data stored by the current child, as
+  // described by the allocation bitmap of the child.
+  void UpdateExtents();
+
+  // Removes the data of the current child from the list of extents.
+  void RemoveChildExtents();
+
   // Verify that the range to be accessed for the current child is appropriate.
   // Returns false if an error is detected or there is no need to perform the
   // current IO operation (for instance if the required range is not stored by
@@ -158,6 +194,7 @@ class SparseControl {
   Bitmap children_map_;  // The actual bitmap of children.
   SparseData child_data_;  // Parent and allocation map of child_.
   Bitmap child_map_;  // The allocation map as a bitmap.
+  ExtentMap extents_;  // The data stored by all the children.
 
   net::CompletionCallbackImpl<SparseControl> child_callback_;
   net::CompletionCallback* user_callback_;
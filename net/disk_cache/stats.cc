@@ -56,7 +56,14 @@ static const char* kCounterNames[] = {
   "Get rankings",
   "Fatal error",
   "Last report",
-  "Last report timer"
+  "Last report timer",
+  "Warm up pages",
+  "Warm up entries",
+  "Warm up time",
+  "Compressed data size",
+  "Compressed stored size",
+  "Journal records",
+  "Journal writes"
 };
 COMPILE_ASSERT(arraysize(kCounterNames) == disk_cache::Stats::MAX_COUNTER,
                update_the_names);
@@ -255,6 +262,11 @@ int64 Stats::GetCounter(Counters counter) const {
   return counters_[counter];
 }
 
+void Stats::OnCompressData(int32 data_size, int32 stored_size) {
+  counters_[COMPRESSED_DATA_SIZE] += data_size;
+  counters_[COMPRESSED_STORED_SIZE] += stored_size;
+}
+
 void Stats::GetItems(StatsItems* items) {
   std::pair<std::string, std::string> item;
   for (int i = 0; i < kDataSizesLength; i++) {
@@ -278,6 +290,15 @@ int Stats::GetResurrectRatio() const {
   return GetRatio(RESURRECT_HIT, CREATE_HIT);
 }
 
+int Stats::GetCompressionRatio() const {
+  int64 data_size = GetCounter(COMPRESSED_DATA_SIZE);
+  if (!data_size)
+    return 0;
+
+  return static_cast<int>(GetCounter(COMPRESSED_STORED_SIZE) * 100 /
+                          data_size);
+}
+
 int Stats::GetRatio(Counters hit, Counters miss) const {
   int64 ratio = GetCounter(hit) * 100;
   if (!ratio)
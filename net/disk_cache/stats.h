@@ -44,6 +44,13 @@ class Stats {
     FATAL_ERROR,
     LAST_REPORT,  // Time of the last time we sent a report.
     LAST_REPORT_TIMER,  // Timer count of the last time we sent a report.
+    WARM_UP_PAGES,  // Pages of the index read by the warm-up stage.
+    WARM_UP_ENTRIES,  // Entries read by the warm-up stage.
+    WARM_UP_TIME,  // Duration of the last warm-up stage, in milliseconds.
+    COMPRESSED_DATA_SIZE,  // User data stored compressed, before compression.
+    COMPRESSED_STORED_SIZE,  // Actual size of the data stored compressed.
+    JOURNAL_RECORDS,  // Rankings nodes stored through the journal.
+    JOURNAL_WRITES,  // Writes performed when flushing the journal.
     MAX_COUNTER
   };
 
@@ -60,9 +67,15 @@ class Stats {
   void SetCounter(Counters counter, int64 value);
   int64 GetCounter(Counters counter) const;
 
+  // Tracks data that is compressed from |data_size| to |stored_size| bytes.
+  void OnCompressData(int32 data_size, int32 stored_size);
+
   void GetItems(StatsItems* items);
   int GetHitRatio() const;
   int GetResurrectRatio() const;
+
+  // Returns the size of the compressed data as a percentage of the original.
+  int GetCompressionRatio() const;
   void ResetRatios();
 
   // Returns the lower bound of the space used by entries bigger than 512 KB.
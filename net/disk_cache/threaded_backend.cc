@@ -0,0 +1,809 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/threaded_backend.h"
+
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/waitable_event.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/entry_impl.h"
+
+namespace disk_cache {
+
+// This class represents a single operation of a ThreadedBackend (or of one of
+// its entries) while it is being bounced between threads. The operation is
+// configured on the original thread by calling one of the public "operation"
+// methods, executed on the cache thread by ExecuteOperation(), and finished
+// back on the original thread.
+//
+// The regular sequence of calls is:
+//                 Thread_1                          Cache_thread
+//    1.   ThreadedBackend::PostOperation()
+//    2.                         -> PostTask ->
+//    3.                                     BackendIO::ExecuteOperation()
+//    4.                         <- PostTask <-
+//    5.     BackendIO::OnIOComplete()
+//    6. ThreadedBackend::OnOperationComplete()
+//    7.       invoke callback
+//
+// Synchronous operations skip steps 4 to 7: the original thread just waits
+// for the operation to be executed and calls Finish() directly.
+class BackendIO : public base::RefCountedThreadSafe<BackendIO> {
+ public:
+  explicit BackendIO(ThreadedBackend* controller)
+      : done_(true, false), controller_(controller), callback_(NULL),
+        operation_(OP_NONE), result_(net::ERR_FAILED), user_entry_(NULL),
+        entry_(NULL), iter_ptr_(NULL), iter_(NULL), stats_(NULL), index_(0),
+        offset_(0), buf_len_(0), truncate_(false), offset64_(0), start_ptr_(0),
+        start_(0) {}
+
+  // These methods set up the operation to perform. Out parameters are only
+  // updated from Finish(), on the original thread.
+  void GetEntryCount();
+  void OpenEntry(const std::string& key, Entry** entry);
+  void CreateEntry(const std::string& key, Entry** entry);
+  void DoomEntry(const std::string& key);
+  void DoomAllEntries();
+  void DoomEntriesBetween(const base::Time initial_time,
+                          const base::Time end_time);
+  void DoomEntriesSince(const base::Time initial_time);
+  void OpenNextEntry(void** iter, Entry** next_entry);
+  void EndEnumeration(void* iter);
+  void GetStats(StatsItems* stats);
+  void DoomEntryImpl(EntryImpl* entry);
+  void CloseEntryImpl(EntryImpl* entry);
+  void GetLastUsed(EntryImpl* entry);
+  void GetLastModified(EntryImpl* entry);
+  void GetDataSize(EntryImpl* entry, int index);
+  void ReadData(EntryImpl* entry, int index, int offset, net::IOBuffer* buf,
+                int buf_len);
+  void WriteData(EntryImpl* entry, int index, int offset, net::IOBuffer* buf,
+                 int buf_len, bool truncate);
+  void ReadSparseData(EntryImpl* entry, int64 offset, net::IOBuffer* buf,
+                      int buf_len);
+  void WriteSparseData(EntryImpl* entry, int64 offset, net::IOBuffer* buf,
+                       int buf_len);
+  void GetAvailableRange(EntryImpl* entry, int64 offset, int len,
+                         int64* start);
+  void CancelSparseIO(EntryImpl* entry);
+  void ReadyForSparseIO(EntryImpl* entry);
+
+  // Runs on the cache thread. Performs the actual work and, for asynchronous
+  // operations, notifies the original thread.
+  void ExecuteOperation();
+
+  // Runs on the original thread when an asynchronous operation completes.
+  void OnIOComplete();
+
+  // Copies the results of the operation to the out parameters provided by the
+  // user. Runs on the original thread.
+  void Finish();
+
+  // Releases any entry opened by this operation that will not be handed out to
+  // the user. Runs on the cache thread.
+  void ReleaseEntry();
+
+  // Blocks the current thread until ExecuteOperation() is done.
+  void WaitForCompletion() {
+    done_.Wait();
+  }
+
+  // Prevents any further notification to the controller.
+  void Cancel() {
+    controller_ = NULL;
+  }
+
+  // Returns true if this operation targets a particular entry (as opposed to
+  // the backend itself).
+  bool IsEntryOperation() const {
+    return operation_ >= OP_ENTRY_DOOM;
+  }
+
+  void set_callback(CompletionCallback* callback) {
+    callback_ = callback;
+  }
+
+  CompletionCallback* callback() const {
+    return callback_;
+  }
+
+  int result() const {
+    return result_;
+  }
+
+  base::Time time_result() const {
+    return time_result_;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<BackendIO>;
+  ~BackendIO() {}
+
+  enum Operation {
+    OP_NONE = 0,
+    OP_GET_COUNT,
+    OP_OPEN,
+    OP_CREATE,
+    OP_DOOM,
+    OP_DOOM_ALL,
+    OP_DOOM_BETWEEN,
+    OP_DOOM_SINCE,
+    OP_OPEN_NEXT,
+    OP_END_ENUMERATION,
+    OP_GET_STATS,
+    OP_ENTRY_DOOM,  // This must be the first entry operation.
+    OP_ENTRY_CLOSE,
+    OP_GET_LAST_USED,
+    OP_GET_LAST_MODIFIED,
+    OP_GET_DATA_SIZE,
+    OP_READ,
+    OP_WRITE,
+    OP_READ_SPARSE,
+    OP_WRITE_SPARSE,
+    OP_GET_RANGE,
+    OP_CANCEL_IO,
+    OP_IS_READY
+  };
+
+  // Stores |entry| as the result of an open or create operation.
+  void SetResultEntry(Entry* entry);
+
+  base::WaitableEvent done_;  // Signaled when ExecuteOperation() completes.
+  ThreadedBackend* controller_;
+  CompletionCallback* callback_;
+  Operation operation_;
+  int result_;
+  std::string key_;
+  Entry** user_entry_;  // Where to store the opened entry.
+  EntryImpl* entry_;  // The target entry, or the entry opened by this object.
+  std::string entry_key_;  // The key of an opened entry.
+  base::Time initial_time_;
+  base::Time end_time_;
+  base::Time time_result_;
+  void** iter_ptr_;
+  void* iter_;
+  StatsItems* stats_;
+  int index_;
+  int offset_;
+  scoped_refptr<net::IOBuffer> buf_;
+  int buf_len_;
+  bool truncate_;
+  int64 offset64_;
+  int64* start_ptr_;
+  int64 start_;
+
+  DISALLOW_COPY_AND_ASSIGN(BackendIO);
+};
+
+void BackendIO::GetEntryCount() {
+  operation_ = OP_GET_COUNT;
+}
+
+void BackendIO::OpenEntry(const std::string& key, Entry** entry) {
+  operation_ = OP_OPEN;
+  key_ = key;
+  user_entry_ = entry;
+}
+
+void BackendIO::CreateEntry(const std::string& key, Entry** entry) {
+  operation_ = OP_CREATE;
+  key_ = key;
+  user_entry_ = entry;
+}
+
+void BackendIO::DoomEntry(const std::string& key) {
+  operation_ = OP_DOOM;
+  key_ = key;
+}
+
+void BackendIO::DoomAllEntries() {
+  operation_ = OP_DOOM_ALL;
+}
+
+void BackendIO::DoomEntriesBetween(const base::Time initial_time,
+                                   const base::Time end_time) {
+  operation_ = OP_DOOM_BETWEEN;
+  initial_time_ = initial_time;
+  end_time_ = end_time;
+}
+
+void BackendIO::DoomEntriesSince(const base::Time initial_time) {
+  operation_ = OP_DOOM_SINCE;
+  initial_time_ = initial_time;
+}
+
+void BackendIO::OpenNextEntry(void** iter, Entry** next_entry) {
+  operation_ = OP_OPEN_NEXT;
+  iter_ptr_ = iter;
+  iter_ = *iter;
+  user_entry_ = next_entry;
+}
+
+void BackendIO::EndEnumeration(void* iter) {
+  operation_ = OP_END_ENUMERATION;
+  iter_ = iter;
+}
+
+void BackendIO::GetStats(StatsItems* stats) {
+  operation_ = OP_GET_STATS;
+  stats_ = stats;
+}
+
+void BackendIO::DoomEntryImpl(EntryImpl* entry) {
+  operation_ = OP_ENTRY_DOOM;
+  entry_ = entry;
+}
+
+void BackendIO::CloseEntryImpl(EntryImpl* entry) {
+  operation_ = OP_ENTRY_CLOSE;
+  entry_ = entry;
+}
+
+void BackendIO::GetLastUsed(EntryImpl* entry) {
+  operation_ = OP_GET_LAST_USED;
+  entry_ = entry;
+}
+
+void BackendIO::GetLastModified(EntryImpl* entry) {
+  operation_ = OP_GET_LAST_MODIFIED;
+  entry_ = entry;
+}
+
+void BackendIO::GetDataSize(EntryImpl* entry, int index) {
+  operation_ = OP_GET_DATA_SIZE;
+  entry_ = entry;
+  index_ = index;
+}
+
+void BackendIO::ReadData(EntryImpl* entry, int index, int offset,
+                         net::IOBuffer* buf, int buf_len) {
+  operation_ = OP_READ;
+  entry_ = entry;
+  index_ = index;
+  offset_ = offset;
+  buf_ = buf;
+  buf_len_ = buf_len;
+}
+
+void BackendIO::WriteData(EntryImpl* entry, int index, int offset,
+                          net::IOBuffer* buf, int buf_len, bool truncate) {
+  operation_ = OP_WRITE;
+  entry_ = entry;
+  index_ = index;
+  offset_ = offset;
+  buf_ = buf;
+  buf_len_ = buf_len;
+  truncate_ = truncate;
+}
+
+void BackendIO::ReadSparseData(EntryImpl* entry, int64 offset,
+                               net::IOBuffer* buf, int buf_len) {
+  operation_ = OP_READ_SPARSE;
+  entry_ = entry;
+  offset64_ = offset;
+  buf_ = buf;
+  buf_len_ = buf_len;
+}
+
+void BackendIO::WriteSparseData(EntryImpl* entry, int64 offset,
+                                net::IOBuffer* buf, int buf_len) {
+  operation_ = OP_WRITE_SPARSE;
+  entry_ = entry;
+  offset64_ = offset;
+  buf_ = buf;
+  buf_len_ = buf_len;
+}
+
+void BackendIO::GetAvailableRange(EntryImpl* entry, int64 offset, int len,
+                                  int64* start) {
+  operation_ = OP_GET_RANGE;
+  entry_ = entry;
+  offset64_ = offset;
+  buf_len_ = len;
+  start_ptr_ = start;
+}
+
+void BackendIO::CancelSparseIO(EntryImpl* entry) {
+  operation_ = OP_CANCEL_IO;
+  entry_ = entry;
+}
+
+void BackendIO::ReadyForSparseIO(EntryImpl* entry) {
+  operation_ = OP_IS_READY;
+  entry_ = entry;
+}
+
+// Runs on the cache thread. Note that every operation is performed
+// synchronously from the point of view of the BackendImpl; the asynchronous
+// behavior is provided by the thread hop.
+void BackendIO::ExecuteOperation() {
+  // The original thread only resets |controller_| after |done_| is signaled,
+  // or after the cache thread is stopped, so it is valid for the duration of
+  // this method. The backend is destroyed on this thread, after every
+  // operation posted before it.
+  DCHECK(controller_);
+  BackendImpl* backend = controller_->backend();
+  Entry* entry = NULL;
+  switch (operation_) {
+    case OP_GET_COUNT:
+      result_ = backend->GetEntryCount();
+      break;
+    case OP_OPEN:
+      result_ = backend->OpenEntry(key_, &entry) ? net::OK : net::ERR_FAILED;
+      SetResultEntry(entry);
+      break;
+    case OP_CREATE:
+      result_ = backend->CreateEntry(key_, &entry) ? net::OK : net::ERR_FAILED;
+      SetResultEntry(entry);
+      break;
+    case OP_DOOM:
+      result_ = backend->DoomEntry(key_) ? net::OK : net::ERR_FAILED;
+      break;
+    case OP_DOOM_ALL:
+      result_ = backend->DoomAllEntries() ? net::OK : net::ERR_FAILED;
+      break;
+    case OP_DOOM_BETWEEN:
+      result_ = backend->DoomEntriesBetween(initial_time_, end_time_) ?
+                net::OK : net::ERR_FAILED;
+      break;
+    case OP_DOOM_SINCE:
+      result_ = backend->DoomEntriesSince(initial_time_) ?
+                net::OK : net::ERR_FAILED;
+      break;
+    case OP_OPEN_NEXT:
+      result_ = backend->OpenNextEntry(&iter_, &entry) ?
+                net::OK : net::ERR_FAILED;
+      SetResultEntry(entry);
+      break;
+    case OP_END_ENUMERATION:
+      backend->EndEnumeration(&iter_);
+      result_ = net::OK;
+      break;
+    case OP_GET_STATS:
+      backend->GetStats(stats_);
+      result_ = net::OK;
+      break;
+    case OP_ENTRY_DOOM:
+      entry_->Doom();
+      result_ = net::OK;
+      break;
+    case OP_ENTRY_CLOSE:
+      entry_->Close();
+      entry_ = NULL;
+      result_ = net::OK;
+      break;
+    case OP_GET_LAST_USED:
+      time_result_ = entry_->GetLastUsed();
+      result_ = net::OK;
+      break;
+    case OP_GET_LAST_MODIFIED:
+      time_result_ = entry_->GetLastModified();
+      result_ = net::OK;
+      break;
+    case OP_GET_DATA_SIZE:
+      result_ = entry_->GetDataSize(index_);
+      break;
+    case OP_READ:
+      result_ = entry_->ReadData(index_, offset_, buf_, buf_len_, NULL);
+      break;
+    case OP_WRITE:
+      result_ = entry_->WriteData(index_, offset_, buf_, buf_len_, NULL,
+                                  truncate_);
+      break;
+    case OP_READ_SPARSE:
+      result_ = entry_->ReadSparseData(offset64_, buf_, buf_len_, NULL);
+      break;
+    case OP_WRITE_SPARSE:
+      result_ = entry_->WriteSparseData(offset64_, buf_, buf_len_, NULL);
+      break;
+    case OP_GET_RANGE:
+      result_ = entry_->GetAvailableRange(offset64_, buf_len_, &start_);
+      break;
+    case OP_CANCEL_IO:
+      entry_->CancelSparseIO();
+      result_ = net::OK;
+      break;
+    case OP_IS_READY:
+      // Every previous operation on this entry has already been executed by
+      // this thread, so there cannot be anything in progress.
+      result_ = entry_->ReadyForSparseIO(NULL);
+      DCHECK_NE(net::ERR_IO_PENDING, result_);
+      break;
+    default:
+      NOTREACHED() << "Invalid Operation";
+      result_ = net::ERR_UNEXPECTED;
+  }
+  DCHECK_NE(net::ERR_IO_PENDING, result_);
+
+  if (callback_) {
+    controller_->callback_loop_->PostTask(FROM_HERE,
+        NewRunnableMethod(this, &BackendIO::OnIOComplete));
+  }
+  done_.Signal();
+}
+
+void BackendIO::SetResultEntry(Entry* entry) {
+  if (net::OK != result_)
+    return;
+
+  entry_ = reinterpret_cast<EntryImpl*>(entry);
+  entry_key_ = entry_->GetKey();
+}
+
+// Runs on the original thread.
+void BackendIO::OnIOComplete() {
+  if (!controller_)
+    return;
+
+  Finish();
+  controller_->OnOperationComplete(this);
+}
+
+// Runs on the original thread.
+void BackendIO::Finish() {
+  buf_ = NULL;
+  switch (operation_) {
+    case OP_OPEN:
+    case OP_CREATE:
+    case OP_OPEN_NEXT:
+      if (net::OK == result_) {
+        *user_entry_ = new ThreadedEntry(controller_, entry_, entry_key_);
+        entry_ = NULL;
+      }
+      if (iter_ptr_)
+        *iter_ptr_ = iter_;
+      break;
+    case OP_GET_RANGE:
+      *start_ptr_ = start_;
+      break;
+    default:
+      break;
+  }
+}
+
+// Runs on the cache thread.
+void BackendIO::ReleaseEntry() {
+  if (operation_ != OP_OPEN && operation_ != OP_CREATE &&
+      operation_ != OP_OPEN_NEXT)
+    return;
+
+  if (entry_) {
+    entry_->Close();
+    entry_ = NULL;
+  }
+  if (iter_) {
+    DCHECK(controller_ && controller_->backend());
+    controller_->backend()->EndEnumeration(&iter_);
+  }
+}
+
+// ------------------------------------------------------------------------
+
+ThreadedBackend::ThreadedBackend()
+    : cache_thread_("cache_thread"), callback_loop_(MessageLoop::current()),
+      backend_(NULL) {
+}
+
+// Pending entry operations will complete from within this method, but the
+// callbacks of backend operations are never invoked (see the description of
+// Backend::~Backend()).
+ThreadedBackend::~ThreadedBackend() {
+  if (!cache_thread_.IsRunning())
+    return;
+
+  OperationsList pending;
+  pending.swap(pending_ops_);
+  for (OperationsList::iterator it = pending.begin(); it != pending.end();
+       ++it) {
+    BackendIO* operation = *it;
+    operation->WaitForCompletion();
+    if (operation->IsEntryOperation()) {
+      operation->Finish();
+      operation->Cancel();
+      operation->callback()->Run(operation->result());
+    } else {
+      // ReleaseEntry() still needs the controller.
+      cache_thread_.message_loop()->PostTask(FROM_HERE,
+          NewRunnableMethod(operation, &BackendIO::ReleaseEntry));
+    }
+  }
+
+  cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &ThreadedBackend::DestroyBackendImpl));
+  cache_thread_.Stop();
+
+  for (OperationsList::iterator it = pending.begin(); it != pending.end();
+       ++it) {
+    (*it)->Cancel();
+  }
+}
+
+bool ThreadedBackend::Init(const FilePath& full_path, bool force,
+                           int max_bytes, net::CacheType type,
+                           BackendFlags flags) {
+  DCHECK(!cache_thread_.IsRunning());
+  if (!callback_loop_)
+    return false;
+
+  base::Thread::Options options;
+  options.message_loop_type = MessageLoop::TYPE_IO;
+  if (!cache_thread_.StartWithOptions(options))
+    return false;
+
+  base::WaitableEvent done(true, false);
+  cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(this, &ThreadedBackend::CreateBackendImpl, full_path,
+                        force, max_bytes, type, flags, &done));
+  done.Wait();
+
+  if (!backend_) {
+    cache_thread_.Stop();
+    return false;
+  }
+  return true;
+}
+
+int32 ThreadedBackend::GetEntryCount() const {
+  scoped_refptr<BackendIO> operation =
+      new BackendIO(const_cast<ThreadedBackend*>(this));
+  operation->GetEntryCount();
+  return const_cast<ThreadedBackend*>(this)->PostOperation(operation, NULL);
+}
+
+bool ThreadedBackend::OpenEntry(const std::string& key, Entry** entry) {
+  return net::OK == OpenEntry(key, entry, NULL);
+}
+
+int ThreadedBackend::OpenEntry(const std::string& key, Entry** entry,
+                               CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->OpenEntry(key, entry);
+  return PostOperation(operation, callback);
+}
+
+bool ThreadedBackend::CreateEntry(const std::string& key, Entry** entry) {
+  return net::OK == CreateEntry(key, entry, NULL);
+}
+
+int ThreadedBackend::CreateEntry(const std::string& key, Entry** entry,
+                                 CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->CreateEntry(key, entry);
+  return PostOperation(operation, callback);
+}
+
+bool ThreadedBackend::DoomEntry(const std::string& key) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->DoomEntry(key);
+  return net::OK == PostOperation(operation, NULL);
+}
+
+bool ThreadedBackend::DoomAllEntries() {
+  return net::OK == DoomAllEntries(NULL);
+}
+
+int ThreadedBackend::DoomAllEntries(CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->DoomAllEntries();
+  return PostOperation(operation, callback);
+}
+
+bool ThreadedBackend::DoomEntriesBetween(const base::Time initial_time,
+                                         const base::Time end_time) {
+  return net::OK == DoomEntriesBetween(initial_time, end_time, NULL);
+}
+
+int ThreadedBackend::DoomEntriesBetween(const base::Time initial_time,
+                                        const base::Time end_time,
+                                        CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->DoomEntriesBetween(initial_time, end_time);
+  return PostOperation(operation, callback);
+}
+
+bool ThreadedBackend::DoomEntriesSince(const base::Time initial_time) {
+  return net::OK == DoomEntriesSince(initial_time, NULL);
+}
+
+int ThreadedBackend::DoomEntriesSince(const base::Time initial_time,
+                                      CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->DoomEntriesSince(initial_time);
+  return PostOperation(operation, callback);
+}
+
+bool ThreadedBackend::OpenNextEntry(void** iter, Entry** next_entry) {
+  return net::OK == OpenNextEntry(iter, next_entry, NULL);
+}
+
+int ThreadedBackend::OpenNextEntry(void** iter, Entry** next_entry,
+                                   CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->OpenNextEntry(iter, next_entry);
+  return PostOperation(operation, callback);
+}
+
+void ThreadedBackend::EndEnumeration(void** iter) {
+  if (!*iter)
+    return;
+
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->EndEnumeration(*iter);
+  *iter = NULL;
+  cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(operation.get(), &BackendIO::ExecuteOperation));
+}
+
+void ThreadedBackend::GetStats(StatsItems* stats) {
+  scoped_refptr<BackendIO> operation = new BackendIO(this);
+  operation->GetStats(stats);
+  PostOperation(operation, NULL);
+}
+
+int ThreadedBackend::PostOperation(BackendIO* operation,
+                                   CompletionCallback* callback) {
+  DCHECK_EQ(callback_loop_, MessageLoop::current());
+  operation->set_callback(callback);
+  if (callback)
+    pending_ops_.insert(operation);
+
+  cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(operation, &BackendIO::ExecuteOperation));
+
+  if (callback)
+    return net::ERR_IO_PENDING;
+
+  operation->WaitForCompletion();
+  operation->Finish();
+  return operation->result();
+}
+
+void ThreadedBackend::OnOperationComplete(BackendIO* operation) {
+  // Keep the operation alive while we invoke the callback.
+  scoped_refptr<BackendIO> op(operation);
+  pending_ops_.erase(op);
+
+  CompletionCallback* callback = op->callback();
+  DCHECK(callback);
+  callback->Run(op->result());
+}
+
+void ThreadedBackend::CreateBackendImpl(const FilePath& full_path, bool force,
+                                        int max_bytes, net::CacheType type,
+                                        BackendFlags flags,
+                                        base::WaitableEvent* done) {
+  backend_ = static_cast<BackendImpl*>(
+      BackendImpl::CreateBackend(full_path, force, max_bytes, type, flags));
+  done->Signal();
+}
+
+void ThreadedBackend::DestroyBackendImpl() {
+  delete backend_;
+  backend_ = NULL;
+}
+
+// ------------------------------------------------------------------------
+
+ThreadedEntry::ThreadedEntry(ThreadedBackend* backend, EntryImpl* entry,
+                             const std::string& key)
+    : backend_(backend), entry_(entry), key_(key) {
+}
+
+void ThreadedEntry::Doom() {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->DoomEntryImpl(entry_);
+  backend_->cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(operation.get(), &BackendIO::ExecuteOperation));
+}
+
+// Pending operations are not affected by closing the entry because they will
+// be executed before the actual EntryImpl is released.
+void ThreadedEntry::Close() {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->CloseEntryImpl(entry_);
+  backend_->cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(operation.get(), &BackendIO::ExecuteOperation));
+  delete this;
+}
+
+std::string ThreadedEntry::GetKey() const {
+  return key_;
+}
+
+base::Time ThreadedEntry::GetLastUsed() const {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->GetLastUsed(entry_);
+  backend_->PostOperation(operation, NULL);
+  return operation->time_result();
+}
+
+base::Time ThreadedEntry::GetLastModified() const {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->GetLastModified(entry_);
+  backend_->PostOperation(operation, NULL);
+  return operation->time_result();
+}
+
+int32 ThreadedEntry::GetDataSize(int index) const {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->GetDataSize(entry_, index);
+  return backend_->PostOperation(operation, NULL);
+}
+
+int ThreadedEntry::ReadData(int index, int offset, net::IOBuffer* buf,
+                            int buf_len,
+                            net::CompletionCallback* completion_callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->ReadData(entry_, index, offset, buf, buf_len);
+  return backend_->PostOperation(operation, completion_callback);
+}
+
+int ThreadedEntry::WriteData(int index, int offset, net::IOBuffer* buf,
+                             int buf_len,
+                             net::CompletionCallback* completion_callback,
+                             bool truncate) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->WriteData(entry_, index, offset, buf, buf_len, truncate);
+  return backend_->PostOperation(operation, completion_callback);
+}
+
+int ThreadedEntry::ReadSparseData(int64 offset, net::IOBuffer* buf,
+                                  int buf_len,
+                                  net::CompletionCallback* completion_callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->ReadSparseData(entry_, offset, buf, buf_len);
+  return backend_->PostOperation(operation, completion_callback);
+}
+
+int ThreadedEntry::WriteSparseData(
+    int64 offset, net::IOBuffer* buf, int buf_len,
+    net::CompletionCallback* completion_callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->WriteSparseData(entry_, offset, buf, buf_len);
+  return backend_->PostOperation(operation, completion_callback);
+}
+
+int ThreadedEntry::GetAvailableRange(int64 offset, int len, int64* start) {
+  return GetAvailableRange(offset, len, start, NULL);
+}
+
+int ThreadedEntry::GetAvailableRange(int64 offset, int len, int64* start,
+                                     CompletionCallback* callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->GetAvailableRange(entry_, offset, len, start);
+  return backend_->PostOperation(operation, callback);
+}
+
+void ThreadedEntry::CancelSparseIO() {
+  // Operations are executed in order by the cache thread so there is nothing
+  // in progress from the point of view of the EntryImpl; the actual effect of
+  // this call is just to let the entry discard any abort state.
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->CancelSparseIO(entry_);
+  backend_->cache_thread_.message_loop()->PostTask(FROM_HERE,
+      NewRunnableMethod(operation.get(), &BackendIO::ExecuteOperation));
+}
+
+int ThreadedEntry::ReadyForSparseIO(
+    net::CompletionCallback* completion_callback) {
+  scoped_refptr<BackendIO> operation = new BackendIO(backend_);
+  operation->ReadyForSparseIO(entry_);
+  return backend_->PostOperation(operation, completion_callback);
+}
+
+// ------------------------------------------------------------------------
+
+Backend* CreateThreadedCacheBackend(const FilePath& full_path, bool force,
+                                    int max_bytes, net::CacheType type) {
+  ThreadedBackend* cache = new ThreadedBackend();
+  if (cache->Init(full_path, force, max_bytes, type, kNone))
+    return cache;
+
+  delete cache;
+  return NULL;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,163 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_THREADED_BACKEND_H_
+#define NET_DISK_CACHE_THREADED_BACKEND_H_
+
+#include <set>
+#include <string>
+
+#include "base/file_path.h"
+#include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/thread.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/disk_cache.h"
+
+class MessageLoop;
+
+namespace base {
+class WaitableEvent;
+}
+
+namespace disk_cache {
+
+class BackendIO;
+class EntryImpl;
+
+// This class implements the Backend interface on top of a BackendImpl that
+// lives on a dedicated cache thread. Every operation that may touch the index,
+// the rankings or the block files is posted to that thread, and its completion
+// callback is invoked back on the thread that issued the request, so that a
+// slow disk never blocks the caller's message loop. The deprecated synchronous
+// methods are still supported, but they block until the cache thread is done.
+//
+// All methods must be called from the thread that created this object, and
+// that thread must have a MessageLoop.
+class ThreadedBackend : public Backend {
+  friend class BackendIO;
+  friend class ThreadedEntry;
+ public:
+  ThreadedBackend();
+  ~ThreadedBackend();
+
+  // Starts the cache thread and creates the actual backend on it. The arguments
+  // have the same meaning as for BackendImpl::CreateBackend(). Returns false if
+  // the backend could not be created.
+  bool Init(const FilePath& full_path, bool force, int max_bytes,
+            net::CacheType type, BackendFlags flags);
+
+  // Backend interface.
+  virtual int32 GetEntryCount() const;
+  virtual bool OpenEntry(const std::string& key, Entry** entry);
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        CompletionCallback* callback);
+  virtual bool CreateEntry(const std::string& key, Entry** entry);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          CompletionCallback* callback);
+  virtual bool DoomEntry(const std::string& key);
+  virtual bool DoomAllEntries();
+  virtual int DoomAllEntries(CompletionCallback* callback);
+  virtual bool DoomEntriesBetween(const base::Time initial_time,
+                                  const base::Time end_time);
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 CompletionCallback* callback);
+  virtual bool DoomEntriesSince(const base::Time initial_time);
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               CompletionCallback* callback);
+  virtual bool OpenNextEntry(void** iter, Entry** next_entry);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            CompletionCallback* callback);
+  virtual void EndEnumeration(void** iter);
+  virtual void GetStats(StatsItems* stats);
+
+  // Returns the number of operations that have been posted to the cache thread
+  // and not completed yet.
+  int num_pending_operations() const {
+    return static_cast<int>(pending_ops_.size());
+  }
+
+ private:
+  typedef std::set<scoped_refptr<BackendIO> > OperationsList;
+
+  // Sends |operation| to the cache thread. If |callback| is NULL, this method
+  // blocks until the operation is done and returns its result; otherwise the
+  // return value is ERR_IO_PENDING, and |callback| will be invoked when the
+  // operation completes.
+  int PostOperation(BackendIO* operation, CompletionCallback* callback);
+
+  // Called on the original thread when an asynchronous |operation| completes.
+  void OnOperationComplete(BackendIO* operation);
+
+  // These methods run on the cache thread.
+  void CreateBackendImpl(const FilePath& full_path, bool force, int max_bytes,
+                         net::CacheType type, BackendFlags flags,
+                         base::WaitableEvent* done);
+  void DestroyBackendImpl();
+
+  BackendImpl* backend() const {
+    return backend_;
+  }
+
+  base::Thread cache_thread_;  // The thread that owns |backend_|.
+  MessageLoop* callback_loop_;  // The loop used to deliver completions.
+  BackendImpl* backend_;  // Only accessed from the cache thread.
+  OperationsList pending_ops_;  // Asynchronous operations in flight.
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadedBackend);
+};
+
+// This class implements the Entry interface for ThreadedBackend. It forwards
+// every operation to the EntryImpl that lives on the cache thread.
+class ThreadedEntry : public Entry {
+ public:
+  ThreadedEntry(ThreadedBackend* backend, EntryImpl* entry,
+                const std::string& key);
+
+  // Entry interface.
+  virtual void Doom();
+  virtual void Close();
+  virtual std::string GetKey() const;
+  virtual base::Time GetLastUsed() const;
+  virtual base::Time GetLastModified() const;
+  virtual int32 GetDataSize(int index) const;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       net::CompletionCallback* completion_callback);
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        net::CompletionCallback* completion_callback,
+                        bool truncate);
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             net::CompletionCallback* completion_callback);
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              net::CompletionCallback* completion_callback);
+  virtual int GetAvailableRange(int64 offset, int len, int64* start);
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                CompletionCallback* callback);
+  virtual void CancelSparseIO();
+  virtual int ReadyForSparseIO(net::CompletionCallback* completion_callback);
+
+ private:
+  ~ThreadedEntry() {}
+
+  ThreadedBackend* backend_;
+  EntryImpl* entry_;  // Owned by the cache thread.
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadedEntry);
+};
+
+}  // namespace disk_cache
+
+// The cache thread is always stopped before a ThreadedBackend goes away, so
+// there is no need to grab references to it when posting tasks.
+template <> struct RunnableMethodTraits<disk_cache::ThreadedBackend> {
+  void RetainCallee(disk_cache::ThreadedBackend* backend) {}
+  void ReleaseCallee(disk_cache::ThreadedBackend* backend) {}
+};
+
+#endif  // NET_DISK_CACHE_THREADED_BACKEND_H_
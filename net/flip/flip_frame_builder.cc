@@ -20,6 +20,14 @@ FlipFrameBuilder::FlipFrameBuilder()
   Resize(kInitialPayload);
 }
 
+FlipFrameBuilder::FlipFrameBuilder(size_t size)
+    : buffer_(NULL),
+      capacity_(0),
+      length_(0),
+      variable_buffer_offset_(0) {
+  Resize(size);
+}
+
 FlipFrameBuilder::FlipFrameBuilder(const char* data, int data_len)
     : buffer_(const_cast<char*>(data)),
       capacity_(kCapacityReadOnly),
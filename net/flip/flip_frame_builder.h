@@ -34,6 +34,11 @@ class FlipFrameBuilder {
   FlipFrameBuilder();
   ~FlipFrameBuilder();
 
+  // Initializes a FlipFrameBuilder with room for |size| bytes, for callers
+  // which know the size of the frame up front.  This avoids growing the
+  // buffer while the frame is written.
+  explicit FlipFrameBuilder(size_t size);
+
   // Initializes a FlipFrameBuilder from a const block of data.  The data is
   // not copied; instead the data is merely referenced by this
   // FlipFrameBuilder.  Only const methods should be used when initialized
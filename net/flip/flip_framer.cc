@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "base/scoped_ptr.h"
+#include "base/singleton.h"
 #include "base/stats_counters.h"
 
 #include "flip_framer.h"  // cross-google3 directory naming.
@@ -434,10 +435,22 @@ bool FlipFramer::ParseHeaderBlock(const FlipFrame* frame,
   return false;
 }
 
+// Returns the number of bytes that |headers| take in a frame.
+static size_t GetSerializedLength(const FlipHeaderBlock* headers) {
+  size_t total_length = sizeof(uint16);  // Number of headers.
+  FlipHeaderBlock::const_iterator it;
+  for (it = headers->begin(); it != headers->end(); ++it) {
+    // Each name and value is a 16 bit length followed by the string.
+    total_length += 2 * sizeof(uint16) + it->first.size() + it->second.size();
+  }
+  return total_length;
+}
+
 FlipSynStreamControlFrame* FlipFramer::CreateSynStream(
     FlipStreamId stream_id, int priority, FlipControlFlags flags,
     bool compressed, FlipHeaderBlock* headers) {
-  FlipFrameBuilder frame;
+  FlipFrameBuilder frame(FlipSynStreamControlFrame::size() +
+                         GetSerializedLength(headers));
 
   frame.WriteUInt16(kControlFlagMask | kFlipProtocolVersion);
   frame.WriteUInt16(SYN_STREAM);
@@ -483,7 +496,8 @@ FlipFinStreamControlFrame* FlipFramer::CreateFinStream(FlipStreamId stream_id,
 FlipSynReplyControlFrame* FlipFramer::CreateSynReply(FlipStreamId stream_id,
     FlipControlFlags flags, bool compressed, FlipHeaderBlock* headers) {
 
-  FlipFrameBuilder frame;
+  FlipFrameBuilder frame(FlipSynReplyControlFrame::size() +
+                         GetSerializedLength(headers));
 
   frame.WriteUInt16(kControlFlagMask | kFlipProtocolVersion);
   frame.WriteUInt16(SYN_REPLY);
@@ -518,21 +532,29 @@ FlipSynReplyControlFrame* FlipFramer::CreateSynReply(FlipStreamId stream_id,
 FlipDataFrame* FlipFramer::CreateDataFrame(FlipStreamId stream_id,
                                            const char* data,
                                            uint32 len, FlipDataFlags flags) {
-  FlipFrameBuilder frame;
+  char* buffer = new char[FlipDataFrame::size() + len];
+  WriteDataFrame(stream_id, data, len, flags, buffer);
+  scoped_ptr<FlipDataFrame> data_frame(new FlipDataFrame(buffer, true));
+  if (flags & DATA_FLAG_COMPRESSED)
+    return reinterpret_cast<FlipDataFrame*>(CompressFrame(data_frame.get()));
+  return data_frame.release();
+}
 
-  frame.WriteUInt32(stream_id);
+/* static */
+void FlipFramer::WriteDataFrame(FlipStreamId stream_id, const char* data,
+                                uint32 len, FlipDataFlags flags,
+                                char* buffer) {
+  uint32 network_stream_id = htonl(stream_id);
+  memcpy(buffer, &network_stream_id, sizeof(network_stream_id));
 
   DCHECK(len < static_cast<size_t>(kLengthMask));
   FlagsAndLength flags_length;
   flags_length.length_ = htonl(len);
   flags_length.flags_[0] = flags;
-  frame.WriteBytes(&flags_length, sizeof(flags_length));
+  memcpy(buffer + sizeof(network_stream_id), &flags_length,
+         sizeof(flags_length));
 
-  frame.WriteBytes(data, len);
-  scoped_ptr<FlipFrame> data_frame(frame.take());
-  if (flags & DATA_FLAG_COMPRESSED)
-    return reinterpret_cast<FlipDataFrame*>(CompressFrame(data_frame.get()));
-  return reinterpret_cast<FlipDataFrame*>(data_frame.release());
+  memcpy(buffer + FlipDataFrame::size(), data, len);
 }
 
 /* static */
@@ -563,6 +585,39 @@ static const char dictionary[] =
   ".1statusversionurl";
 static uLong dictionary_id = 0;
 
+// A compressor which has been primed with the dictionary.  Setting the
+// dictionary makes deflate hash all of it, so this is done only once, and
+// each FlipFramer's compressor starts out as a copy of this one.
+class PrimedCompressor {
+ public:
+  PrimedCompressor() {
+    memset(&compressor_, 0, sizeof(compressor_));
+    int success = deflateInit(&compressor_, kCompressorLevel);
+    if (success == Z_OK)
+      success = deflateSetDictionary(&compressor_,
+                                     reinterpret_cast<const Bytef*>(dictionary),
+                                     sizeof(dictionary));
+    initialized_ = success == Z_OK;
+  }
+
+  ~PrimedCompressor() {
+    deflateEnd(&compressor_);
+  }
+
+  // Initializes |compressor| with a copy of the primed state.
+  int CopyTo(z_stream* compressor) {
+    if (!initialized_)
+      return Z_STREAM_ERROR;
+    return deflateCopy(compressor, &compressor_);
+  }
+
+ private:
+  z_stream compressor_;
+  bool initialized_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrimedCompressor);
+};
+
 bool FlipFramer::InitializeCompressor() {
   if (compressor_.get())
     return true;  // Already initialized.
@@ -570,11 +625,7 @@ bool FlipFramer::InitializeCompressor() {
   compressor_.reset(new z_stream);
   memset(compressor_.get(), 0, sizeof(z_stream));
 
-  int success = deflateInit(compressor_.get(), kCompressorLevel);
-  if (success == Z_OK)
-    success = deflateSetDictionary(compressor_.get(),
-                                   reinterpret_cast<const Bytef*>(dictionary),
-                                   sizeof(dictionary));
+  int success = Singleton<PrimedCompressor>::get()->CopyTo(compressor_.get());
   if (success != Z_OK)
     compressor_.reset(NULL);
   return success == Z_OK;
@@ -165,6 +165,13 @@ class FlipFramer {
   FlipDataFrame* CreateDataFrame(FlipStreamId stream_id, const char* data,
                                  uint32 len, FlipDataFlags flags);
 
+  // Writes an uncompressed data frame into |buffer|, which must have room for
+  // FlipDataFrame::size() + |len| bytes.  Unlike CreateDataFrame(), this
+  // does not allocate, so the caller can build the frame directly in the
+  // buffer it sends.
+  static void WriteDataFrame(FlipStreamId stream_id, const char* data,
+                             uint32 len, FlipDataFlags flags, char* buffer);
+
   static FlipControlFrame* CreateNopFrame();
 
   // NOTES about frame compression.
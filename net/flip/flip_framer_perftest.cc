@@ -0,0 +1,124 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/perftimer.h"
+#include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/scoped_allocation_counter.h"
+#include "net/flip/flip_framer.h"
+#include "net/flip/flip_io_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace flip {
+
+namespace {
+
+const int kNumFrames = 20000;
+const int kDataFrameSize = 2852;
+
+// Returns the headers of a typical request.
+void GetRequestHeaders(FlipHeaderBlock* headers) {
+  (*headers)["method"] = "GET";
+  (*headers)["url"] = "http://www.google.com/images/logo.gif";
+  (*headers)["version"] = "HTTP/1.1";
+  (*headers)["user-agent"] =
+      "Mozilla/5.0 (X11; U; Linux x86_64; en-US) AppleWebKit/532.5 "
+      "(KHTML, like Gecko) Chrome/4.0.249.0 Safari/532.5";
+  (*headers)["referer"] = "http://www.google.com/";
+  (*headers)["accept"] = "image/png,image/*;q=0.8,*/*;q=0.5";
+  (*headers)["accept-language"] = "en-US,en;q=0.8";
+  (*headers)["accept-charset"] = "ISO-8859-1,utf-8;q=0.7,*;q=0.3";
+  (*headers)["cookie"] =
+      "PREF=ID=5c2b6b4ec0b5b86d:TM=1255977723:LM=1255977723:S=xyz";
+}
+
+// Logs the throughput and the allocations of |num_frames| frames, measured
+// over |elapsed| with |counter|.
+void LogFrameResults(const std::string& name, int num_frames,
+                     base::TimeDelta elapsed,
+                     const net::ScopedAllocationCounter& counter) {
+  LogPerfResult((name + "_rate").c_str(),
+                num_frames / elapsed.InSecondsF(), "frames/s");
+  LogPerfResult((name + "_allocated").c_str(),
+                static_cast<double>(counter.bytes()) / num_frames,
+                "bytes/frame");
+}
+
+}  // namespace
+
+// Builds and compresses SYN_STREAM frames on one session.
+TEST(FlipFramerPerfTest, CreateCompressedSynStream) {
+  FlipHeaderBlock headers;
+  GetRequestHeaders(&headers);
+  FlipFramer framer;
+
+  net::ScopedAllocationCounter counter;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumFrames; ++i) {
+    scoped_ptr<FlipSynStreamControlFrame> frame(
+        framer.CreateSynStream(2 * i + 1, 1, CONTROL_FLAG_FIN, true,
+                               &headers));
+    ASSERT_TRUE(frame.get());
+  }
+  LogFrameResults("Flip_framer_compressed_syn_stream", kNumFrames,
+                  base::TimeTicks::Now() - start, counter);
+}
+
+// Compresses the first SYN_STREAM of new sessions, which starts from the
+// preset dictionary.
+TEST(FlipFramerPerfTest, FirstSynStreamOfSession) {
+  FlipHeaderBlock headers;
+  GetRequestHeaders(&headers);
+  const int kNumSessions = kNumFrames / 10;
+
+  net::ScopedAllocationCounter counter;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < kNumSessions; ++i) {
+    FlipFramer framer;
+    scoped_ptr<FlipSynStreamControlFrame> frame(
+        framer.CreateSynStream(1, 1, CONTROL_FLAG_FIN, true, &headers));
+    ASSERT_TRUE(frame.get());
+  }
+  LogFrameResults("Flip_framer_first_syn_stream", kNumSessions,
+                  base::TimeTicks::Now() - start, counter);
+}
+
+// Builds data frames with CreateDataFrame(), and then with WriteDataFrame()
+// into pooled buffers, as FlipSession does.
+TEST(FlipFramerPerfTest, DataFrames) {
+  std::string payload(kDataFrameSize, 'x');
+
+  {
+    FlipFramer framer;
+    net::ScopedAllocationCounter counter;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumFrames; ++i) {
+      scoped_ptr<FlipDataFrame> frame(
+          framer.CreateDataFrame(1, payload.data(), payload.size(),
+                                 DATA_FLAG_NONE));
+    }
+    LogFrameResults("Flip_framer_create_data_frame", kNumFrames,
+                    base::TimeTicks::Now() - start, counter);
+  }
+
+  {
+    scoped_refptr<net::FlipBufferPool> pool = new net::FlipBufferPool(
+        FlipDataFrame::size() + kDataFrameSize, 16);
+    net::ScopedAllocationCounter counter;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumFrames; ++i) {
+      scoped_refptr<net::IOBuffer> buffer = pool->GetBuffer();
+      FlipFramer::WriteDataFrame(1, payload.data(), payload.size(),
+                                 DATA_FLAG_NONE, buffer->data());
+    }
+    LogFrameResults("Flip_framer_write_data_frame_pooled", kNumFrames,
+                    base::TimeTicks::Now() - start, counter);
+  }
+}
+
+}  // namespace flip
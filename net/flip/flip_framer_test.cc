@@ -112,6 +112,8 @@ class TestFlipVisitor : public FlipFramerVisitorInterface  {
 
 }  // namespace flip
 
+using flip::FlipDataFlags;
+using flip::FlipDataFrame;
 using flip::FlipFrame;
 using flip::FlipFrameBuilder;
 using flip::FlipFramer;
@@ -119,6 +121,8 @@ using flip::FlipHeaderBlock;
 using flip::FlipSynStreamControlFrame;
 using flip::kControlFlagMask;
 using flip::CONTROL_FLAG_NONE;
+using flip::DATA_FLAG_FIN;
+using flip::DATA_FLAG_NONE;
 using flip::SYN_STREAM;
 using flip::test::FramerSetEnableCompressionHelper;
 using flip::test::TestFlipVisitor;
@@ -206,6 +210,63 @@ TEST_F(FlipFramerTest, BasicCompression) {
       FlipFrame::size() + frame3->length()));
 }
 
+// Test that new framers start compressing from the same dictionary state.
+TEST_F(FlipFramerTest, CompressionDictionaryIsShared) {
+  FlipHeaderBlock headers;
+  headers["method"] = "GET";
+  headers["url"] = "http://www.google.com/";
+  headers["version"] = "HTTP/1.1";
+  headers["accept-encoding"] = "gzip,deflate";
+
+  FlipFramer framer1;
+  FlipFramer framer2;
+  FramerSetEnableCompressionHelper(&framer1, true);
+  FramerSetEnableCompressionHelper(&framer2, true);
+  scoped_ptr<FlipSynStreamControlFrame>
+      frame1(framer1.CreateSynStream(1, 1, CONTROL_FLAG_NONE, true, &headers));
+  scoped_ptr<FlipSynStreamControlFrame>
+      frame2(framer2.CreateSynStream(1, 1, CONTROL_FLAG_NONE, true, &headers));
+  scoped_ptr<FlipSynStreamControlFrame>
+      uncompressed(framer1.CreateSynStream(1, 1, CONTROL_FLAG_NONE, false,
+                                           &headers));
+
+  // The dictionary makes even the first frame smaller.
+  EXPECT_LT(frame1->length(), uncompressed->length());
+  ASSERT_EQ(frame1->length(), frame2->length());
+  EXPECT_EQ(0, memcmp(frame1->data(), frame2->data(),
+                      FlipFrame::size() + frame1->length()));
+
+  // A new framer can decompress it.
+  FlipFramer framer3;
+  FramerSetEnableCompressionHelper(&framer3, true);
+  scoped_ptr<FlipFrame> decompressed(framer3.DecompressFrame(frame1.get()));
+  ASSERT_TRUE(decompressed.get() != NULL);
+  ASSERT_EQ(uncompressed->length(), decompressed->length());
+  EXPECT_EQ(0, memcmp(uncompressed->data(), decompressed->data(),
+                      FlipFrame::size() + uncompressed->length()));
+}
+
+// Test that WriteDataFrame() writes the same frame as CreateDataFrame().
+TEST_F(FlipFramerTest, WriteDataFrame) {
+  const char kData[] = "hello";
+  const uint32 kLength = sizeof(kData) - 1;
+  const FlipDataFlags kFlags[] = { DATA_FLAG_NONE, DATA_FLAG_FIN };
+
+  FlipFramer framer;
+  for (size_t i = 0; i < arraysize(kFlags); ++i) {
+    scoped_ptr<FlipDataFrame> frame(
+        framer.CreateDataFrame(3, kData, kLength, kFlags[i]));
+    char buffer[8 + kLength];
+    FlipFramer::WriteDataFrame(3, kData, kLength, kFlags[i], buffer);
+
+    FlipDataFrame written_frame(buffer, false);
+    EXPECT_EQ(3u, written_frame.stream_id());
+    EXPECT_EQ(kLength, written_frame.length());
+    EXPECT_EQ(kFlags[i], written_frame.flags());
+    EXPECT_EQ(0, memcmp(frame->data(), buffer, sizeof(buffer)));
+  }
+}
+
 TEST_F(FlipFramerTest, DecompressUncompressedFrame) {
   FlipHeaderBlock headers;
   headers["server"] = "FlipServer 1.0";
@@ -3,6 +3,9 @@
 // found in the LICENSE file.
 
 #include "net/flip/flip_io_buffer.h"
+
+#include "base/logging.h"
+#include "net/flip/flip_protocol.h"
 #include "net/flip/flip_stream.h"
 
 namespace net {
@@ -26,4 +29,59 @@ void FlipIOBuffer::release() {
   stream_ = NULL;
 }
 
+FlipFrameIOBuffer::FlipFrameIOBuffer(flip::FlipFrame* frame)
+    : IOBuffer(frame->data()),
+      frame_(frame) {
+}
+
+FlipFrameIOBuffer::~FlipFrameIOBuffer() {
+  // The frame owns the data, so keep the base class from deleting it.
+  data_ = NULL;
+}
+
+class FlipBufferPool::PooledIOBuffer : public IOBuffer {
+ public:
+  PooledIOBuffer(FlipBufferPool* pool, char* data)
+      : IOBuffer(data),
+        pool_(pool) {
+  }
+
+ private:
+  ~PooledIOBuffer() {
+    pool_->ReleaseBuffer(data_);
+    data_ = NULL;
+  }
+
+  scoped_refptr<FlipBufferPool> pool_;
+};
+
+FlipBufferPool::FlipBufferPool(int buffer_size, size_t max_free_buffers)
+    : buffer_size_(buffer_size),
+      max_free_buffers_(max_free_buffers) {
+  DCHECK_GT(buffer_size, 0);
+}
+
+FlipBufferPool::~FlipBufferPool() {
+  for (size_t i = 0; i < free_buffers_.size(); ++i)
+    delete[] free_buffers_[i];
+}
+
+IOBuffer* FlipBufferPool::GetBuffer() {
+  char* data;
+  if (free_buffers_.empty()) {
+    data = new char[buffer_size_];
+  } else {
+    data = free_buffers_.back();
+    free_buffers_.pop_back();
+  }
+  return new PooledIOBuffer(this, data);
+}
+
+void FlipBufferPool::ReleaseBuffer(char* data) {
+  if (free_buffers_.size() < max_free_buffers_)
+    free_buffers_.push_back(data);
+  else
+    delete[] data;
+}
+
 }  // namespace net
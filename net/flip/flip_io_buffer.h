@@ -5,9 +5,16 @@
 #ifndef NET_FLIP_FLIP_IO_BUFFER_H_
 #define NET_FLIP_FLIP_IO_BUFFER_H_
 
+#include <vector>
+
 #include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
 #include "net/base/io_buffer.h"
 
+namespace flip {
+class FlipFrame;
+}
+
 namespace net {
 
 class FlipStream;
@@ -50,6 +57,51 @@ class FlipIOBuffer {
   static uint64 order_;  // Maintains a FIFO order for equal priorities.
 };
 
+// An IOBuffer which takes ownership of a FlipFrame, so that a frame can be
+// sent without copying it into a new buffer.
+class FlipFrameIOBuffer : public IOBuffer {
+ public:
+  explicit FlipFrameIOBuffer(flip::FlipFrame* frame);
+
+ private:
+  ~FlipFrameIOBuffer();
+
+  scoped_ptr<flip::FlipFrame> frame_;
+};
+
+// A pool of IOBuffers of the same size, so that the buffers of the data
+// frames which the FlipSession sends are reused instead of allocated for each
+// frame.  The buffers hold a reference to the pool, and give their memory
+// back to it when they are destroyed.  At most |max_free_buffers| are kept
+// for reuse.  The pool is not thread safe: the buffers must be released on
+// the thread which uses the pool.
+class FlipBufferPool : public base::RefCounted<FlipBufferPool> {
+ public:
+  FlipBufferPool(int buffer_size, size_t max_free_buffers);
+
+  // Returns a buffer of buffer_size() bytes.
+  IOBuffer* GetBuffer();
+
+  int buffer_size() const { return buffer_size_; }
+  size_t num_free_buffers() const { return free_buffers_.size(); }
+
+ private:
+  class PooledIOBuffer;
+  friend class base::RefCounted<FlipBufferPool>;
+  friend class PooledIOBuffer;
+
+  ~FlipBufferPool();
+
+  // Called by the buffers when they are destroyed.
+  void ReleaseBuffer(char* data);
+
+  const int buffer_size_;
+  const size_t max_free_buffers_;
+  std::vector<char*> free_buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlipBufferPool);
+};
+
 }  // namespace net
 
 #endif  // NET_FLIP_FLIP_IO_BUFFER_H_
@@ -56,6 +56,9 @@ namespace {
 
 const int kReadBufferSize = 32 * 1024;
 
+// The number of unused data frame buffers that a session keeps for reuse.
+const size_t kMaxFreeDataFrameBuffers = 16;
+
 // Convert a FlipHeaderBlock into an HttpResponseInfo.
 // |headers| input parameter with the FlipHeaderBlock.
 // |info| output parameter for the HttpResponseInfo.
@@ -175,6 +178,16 @@ void AdjustSocketBufferSizes(ClientSocket* socket) {
 // static
 bool FlipSession::use_ssl_ = true;
 
+// The MSS is somewhat arbitrary and not really fixed, but it will always work
+// reasonably with ethernet.  Chop the world into 2-packet chunks.  This is
+// also somewhat arbitrary, but is reasonably small and ensures that we elicit
+// ACKs quickly from TCP (because TCP tries to only ACK every other packet).
+// static
+int FlipSession::max_data_frame_size_ = (2 * 1430) - flip::FlipFrame::size();
+
+// static
+int FlipSession::max_bytes_per_write_ = 64 * 1024;
+
 FlipSession::FlipSession(const std::string& host, HttpNetworkSession* session)
     : ALLOW_THIS_IN_INITIALIZER_LIST(
           connect_callback_(this, &FlipSession::OnTCPConnect)),
@@ -190,6 +203,9 @@ FlipSession::FlipSession(const std::string& host, HttpNetworkSession* session)
       read_buffer_(new IOBuffer(kReadBufferSize)),
       read_pending_(false),
       stream_hi_water_mark_(1),  // Always start at 1 for the first stream id.
+      data_frame_buffers_(new FlipBufferPool(
+          flip::FlipDataFrame::size() + max_data_frame_size_,
+          kMaxFreeDataFrameBuffers)),
       write_pending_(false),
       delayed_write_pending_(false),
       is_secure_(false),
@@ -349,9 +365,8 @@ scoped_refptr<FlipStream> FlipSession::GetOrCreateStream(
       flip_framer_.CreateSynStream(stream_id, request.priority, flags, false,
                                    &headers));
   int length = flip::FlipFrame::size() + syn_frame->length();
-  IOBuffer* buffer = new IOBuffer(length);
-  memcpy(buffer->data(), syn_frame->data(), length);
-  queue_.push(FlipIOBuffer(buffer, length, request.priority, stream));
+  IOBuffer* buffer = new FlipFrameIOBuffer(syn_frame.release());
+  queue_.Push(FlipIOBuffer(buffer, length, request.priority, stream));
 
   static StatsCounter flip_requests("flip.requests");
   flip_requests.Increment();
@@ -377,13 +392,6 @@ int FlipSession::WriteStreamData(flip::FlipStreamId stream_id,
                                  net::IOBuffer* data, int len) {
   LOG(INFO) << "Writing Stream Data for stream " << stream_id << " (" << len
             << " bytes)";
-  const int kMss = 1430;  // This is somewhat arbitrary and not really fixed,
-                          // but it will always work reasonably with ethernet.
-  // Chop the world into 2-packet chunks.  This is somewhat arbitrary, but
-  // is reasonably small and ensures that we elicit ACKs quickly from TCP
-  // (because TCP tries to only ACK every other packet).
-  const int kMaxFlipFrameChunkSize = (2 * kMss) - flip::FlipFrame::size();
-
   // Find our stream
   DCHECK(IsStreamActive(stream_id));
   scoped_refptr<FlipStream> stream = active_streams_[stream_id];
@@ -396,18 +404,21 @@ int FlipSession::WriteStreamData(flip::FlipStreamId stream_id,
 
   // Set the flags on the upload.
   flip::FlipDataFlags flags = flip::DATA_FLAG_FIN;
-  if (len > kMaxFlipFrameChunkSize) {
-    len = kMaxFlipFrameChunkSize;
+  if (len > max_data_frame_size_) {
+    len = max_data_frame_size_;
     flags = flip::DATA_FLAG_NONE;
   }
 
-  // TODO(mbelshe): reduce memory copies here.
-  scoped_ptr<flip::FlipDataFrame> frame(
-      flip_framer_.CreateDataFrame(stream_id, data->data(), len, flags));
-  int length = flip::FlipFrame::size() + frame->length();
-  IOBufferWithSize* buffer = new IOBufferWithSize(length);
-  memcpy(buffer->data(), frame->data(), length);
-  queue_.push(FlipIOBuffer(buffer, length, stream->priority(), stream));
+  // Build the frame directly in the buffer that we send.
+  int length = flip::FlipDataFrame::size() + len;
+  scoped_refptr<IOBuffer> buffer;
+  if (length <= data_frame_buffers_->buffer_size())
+    buffer = data_frame_buffers_->GetBuffer();
+  else
+    buffer = new IOBuffer(length);
+  flip::FlipFramer::WriteDataFrame(stream_id, data->data(), len, flags,
+                                   buffer->data());
+  queue_.Push(FlipIOBuffer(buffer, length, stream->priority(), stream));
 
   // Whenever we queue onto the socket we need to ensure that we will write to
   // it later.
@@ -646,13 +657,21 @@ void FlipSession::WriteSocket() {
   if (write_pending_)   // Another write is in progress still.
     return;
 
-  // Loop sending frames until we've sent everything or until the write
-  // returns error (or ERR_IO_PENDING).
-  while (in_flight_write_.buffer() || queue_.size()) {
+  // Loop sending frames until we've sent everything, until the write
+  // returns error (or ERR_IO_PENDING), or until we've written
+  // |max_bytes_per_write_|.  In the last case, the streams which keep
+  // queueing data (e.g. uploads that complete synchronously) would otherwise
+  // keep us from returning to the message loop, where new requests queue
+  // their SYN_STREAMs.
+  // OnWriteComplete() has already scheduled the next WriteSocket() then.
+  int bytes_written = 0;
+  while (in_flight_write_.buffer() || !queue_.empty()) {
+    if (bytes_written >= max_bytes_per_write_)
+      break;
+
     if (!in_flight_write_.buffer()) {
       // Grab the next FlipFrame to send.
-      FlipIOBuffer next_buffer = queue_.top();
-      queue_.pop();
+      FlipIOBuffer next_buffer = queue_.Pop();
 
       // We've deferred compression until just before we write it to the socket,
       // which is now.  At this time, we don't compress our data frames.
@@ -665,11 +684,8 @@ void FlipSession::WriteSocket() {
 
         DCHECK(size > 0);
 
-        // TODO(mbelshe): We have too much copying of data here.
-        IOBufferWithSize* buffer = new IOBufferWithSize(size);
-        memcpy(buffer->data(), compressed_frame->data(), size);
-
         // Attempt to send the frame.
+        IOBuffer* buffer = new FlipFrameIOBuffer(compressed_frame.release());
         in_flight_write_ = FlipIOBuffer(buffer, size, 0, next_buffer.stream());
       } else {
         size = uncompressed_frame.length() + flip::FlipFrame::size();
@@ -686,6 +702,8 @@ void FlipSession::WriteSocket() {
       break;
 
     // We sent the frame successfully.
+    if (rv > 0)
+      bytes_written += rv;
     OnWriteComplete(rv);
 
     // TODO(mbelshe):  Test this error case.  Maybe we should mark the socket
@@ -22,6 +22,7 @@
 #include "net/flip/flip_io_buffer.h"
 #include "net/flip/flip_protocol.h"
 #include "net/flip/flip_session_pool.h"
+#include "net/flip/flip_write_queue.h"
 #include "net/socket/client_socket.h"
 #include "net/socket/client_socket_handle.h"
 #include "testing/platform_test.h"
@@ -78,6 +79,16 @@ class FlipSession : public base::RefCounted<FlipSession>,
   static void SetSSLMode(bool enable) { use_ssl_ = enable; }
   static bool SSLMode() { return use_ssl_; }
 
+  // The largest data frame payload that WriteStreamData() sends at once.
+  // Larger writes are sent in several frames, so that the other streams get
+  // their turn in between.
+  static void SetMaxDataFrameSize(int size) { max_data_frame_size_ = size; }
+  static int MaxDataFrameSize() { return max_data_frame_size_; }
+
+  // The number of bytes WriteSocket() writes before it returns to the message
+  // loop, so that new requests can queue their frames.
+  static void SetMaxBytesPerWrite(int bytes) { max_bytes_per_write_ = bytes; }
+
  protected:
   friend class FlipSessionPool;
 
@@ -104,7 +115,6 @@ class FlipSession : public base::RefCounted<FlipSession>,
   typedef std::map<int, scoped_refptr<FlipStream> > ActiveStreamMap;
   typedef std::list<scoped_refptr<FlipStream> > ActiveStreamList;
   typedef std::map<std::string, scoped_refptr<FlipStream> > PendingStreamMap;
-  typedef std::priority_queue<FlipIOBuffer> OutputQueue;
 
   virtual ~FlipSession();
 
@@ -202,7 +212,10 @@ class FlipSession : public base::RefCounted<FlipSession>,
   PendingStreamMap pending_streams_;
 
   // As we gather data to be sent, we put it into the output queue.
-  OutputQueue queue_;
+  FlipWriteQueue queue_;
+
+  // The buffers for the data frames we send.
+  scoped_refptr<FlipBufferPool> data_frame_buffers_;
 
   // The packet we are currently sending.
   bool write_pending_;            // Will be true when a write is in progress.
@@ -230,6 +243,8 @@ class FlipSession : public base::RefCounted<FlipSession>,
   int streams_abandoned_count_;
 
   static bool use_ssl_;
+  static int max_data_frame_size_;
+  static int max_bytes_per_write_;
 };
 
 }  // namespace net
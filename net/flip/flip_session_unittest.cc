@@ -7,6 +7,7 @@
 #include "net/base/test_completion_callback.h"
 #include "net/flip/flip_session.h"
 #include "net/flip/flip_stream.h"
+#include "net/flip/flip_write_queue.h"
 #include "net/socket/socket_test_util.h"
 #include "testing/platform_test.h"
 
@@ -16,6 +17,27 @@ class FlipSessionTest : public PlatformTest {
  public:
 };
 
+namespace {
+
+// Returns a stream that is not attached to a FlipSession, for use as the
+// owner of queued frames.
+scoped_refptr<FlipStream> CreateDetachedStream() {
+  return new FlipStream(NULL, 0, true, NULL);
+}
+
+// Closes |stream|, so that it can be destroyed without a FlipSession.
+void CloseDetachedStream(FlipStream* stream) {
+  stream->OnClose(OK);
+}
+
+// Queues a frame of |size| bytes for |stream| at |priority|.
+void PushFrame(FlipWriteQueue* queue, int size, int priority,
+               FlipStream* stream) {
+  queue->Push(FlipIOBuffer(new IOBuffer(size), size, priority, stream));
+}
+
+}  // namespace
+
 // Test the FlipIOBuffer class.
 TEST_F(FlipSessionTest, FlipIOBuffer) {
   std::priority_queue<FlipIOBuffer> queue_;
@@ -53,4 +75,115 @@ TEST_F(FlipSessionTest, FlipIOBuffer) {
   }
 }
 
+// Test that the FlipBufferPool reuses the buffers which were released, up to
+// its limit.
+TEST_F(FlipSessionTest, BufferPool) {
+  scoped_refptr<FlipBufferPool> pool = new FlipBufferPool(100, 2);
+  EXPECT_EQ(100, pool->buffer_size());
+
+  scoped_refptr<IOBuffer> buffer1 = pool->GetBuffer();
+  scoped_refptr<IOBuffer> buffer2 = pool->GetBuffer();
+  scoped_refptr<IOBuffer> buffer3 = pool->GetBuffer();
+  EXPECT_EQ(0u, pool->num_free_buffers());
+
+  char* data1 = buffer1->data();
+  buffer1 = NULL;
+  EXPECT_EQ(1u, pool->num_free_buffers());
+  buffer2 = NULL;
+  buffer3 = NULL;
+  EXPECT_EQ(2u, pool->num_free_buffers());
+
+  // The buffers are reused last in, first out.
+  buffer3 = pool->GetBuffer();
+  buffer2 = pool->GetBuffer();
+  EXPECT_EQ(data1, buffer2->data());
+  EXPECT_EQ(0u, pool->num_free_buffers());
+
+  // The buffers keep the pool alive.
+  FlipBufferPool* raw_pool = pool.get();
+  pool = NULL;
+  buffer2 = NULL;
+  EXPECT_EQ(1u, raw_pool->num_free_buffers());
+}
+
+// Test that the FlipWriteQueue writes the higher priority frames first.
+TEST_F(FlipSessionTest, WriteQueuePriorities) {
+  scoped_refptr<FlipStream> stream = CreateDetachedStream();
+  FlipWriteQueue queue;
+
+  PushFrame(&queue, 10, 3, stream);
+  PushFrame(&queue, 11, 1, stream);
+  PushFrame(&queue, 12, 2, stream);
+  PushFrame(&queue, 13, 0, stream);
+  PushFrame(&queue, 14, 1, stream);
+
+  EXPECT_EQ(5u, queue.size());
+  EXPECT_EQ(60u, queue.bytes_queued());
+
+  const int kExpectedPriorities[] = { 0, 1, 1, 2, 3 };
+  const size_t kExpectedSizes[] = { 13, 11, 14, 12, 10 };
+  for (size_t i = 0; i < arraysize(kExpectedPriorities); ++i) {
+    FlipIOBuffer buffer = queue.Pop();
+    EXPECT_EQ(kExpectedPriorities[i], buffer.priority());
+    EXPECT_EQ(kExpectedSizes[i], buffer.size());
+  }
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(0u, queue.bytes_queued());
+
+  CloseDetachedStream(stream);
+}
+
+// Test that the streams of the same priority take turns, and that the frames
+// of each stream keep their order.
+TEST_F(FlipSessionTest, WriteQueueRoundRobin) {
+  scoped_refptr<FlipStream> upload = CreateDetachedStream();
+  scoped_refptr<FlipStream> request1 = CreateDetachedStream();
+  scoped_refptr<FlipStream> request2 = CreateDetachedStream();
+  FlipWriteQueue queue;
+
+  // The upload queues four frames before the other requests queue theirs.
+  for (int i = 1; i <= 4; ++i)
+    PushFrame(&queue, i, 1, upload);
+  PushFrame(&queue, 10, 1, request1);
+  PushFrame(&queue, 20, 1, request2);
+  PushFrame(&queue, 11, 1, request1);
+
+  FlipStream* const kExpectedStreams[] = {
+    upload, request1, request2, upload, request1, upload, upload
+  };
+  const size_t kExpectedSizes[] = { 1, 10, 20, 2, 11, 3, 4 };
+  for (size_t i = 0; i < arraysize(kExpectedStreams); ++i) {
+    FlipIOBuffer buffer = queue.Pop();
+    EXPECT_EQ(kExpectedStreams[i], buffer.stream().get());
+    EXPECT_EQ(kExpectedSizes[i], buffer.size());
+  }
+  EXPECT_TRUE(queue.empty());
+
+  CloseDetachedStream(upload);
+  CloseDetachedStream(request1);
+  CloseDetachedStream(request2);
+}
+
+// Test that a stream which empties its queue goes to the back of the line
+// when it queues again.
+TEST_F(FlipSessionTest, WriteQueueRequeue) {
+  scoped_refptr<FlipStream> stream1 = CreateDetachedStream();
+  scoped_refptr<FlipStream> stream2 = CreateDetachedStream();
+  FlipWriteQueue queue;
+
+  PushFrame(&queue, 1, 2, stream1);
+  PushFrame(&queue, 2, 2, stream2);
+  EXPECT_EQ(stream1.get(), queue.Pop().stream().get());
+
+  PushFrame(&queue, 3, 2, stream1);
+  PushFrame(&queue, 4, 2, stream2);
+  EXPECT_EQ(2u, queue.Pop().size());
+  EXPECT_EQ(3u, queue.Pop().size());
+  EXPECT_EQ(4u, queue.Pop().size());
+  EXPECT_TRUE(queue.empty());
+
+  CloseDetachedStream(stream1);
+  CloseDetachedStream(stream2);
+}
+
 }  // namespace net
@@ -0,0 +1,66 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/flip/flip_write_queue.h"
+
+#include "base/logging.h"
+#include "net/flip/flip_stream.h"
+
+namespace net {
+
+FlipWriteQueue::FlipWriteQueue() : size_(0), bytes_queued_(0) {}
+
+FlipWriteQueue::~FlipWriteQueue() {}
+
+void FlipWriteQueue::Push(const FlipIOBuffer& buffer) {
+  int priority = buffer.priority();
+  DCHECK(priority >= FLIP_PRIORITY_HIGHEST && priority <= FLIP_PRIORITY_LOWEST);
+  if (priority < FLIP_PRIORITY_HIGHEST)
+    priority = FLIP_PRIORITY_HIGHEST;
+  if (priority > FLIP_PRIORITY_LOWEST)
+    priority = FLIP_PRIORITY_LOWEST;
+
+  PriorityLevel& level = levels_[priority];
+  FlipStream* stream = buffer.stream().get();
+  FrameList& frames = level.frames[stream];
+  // A stream with nothing queued joins the back of the line.
+  if (frames.empty())
+    level.turns.push_back(stream);
+  frames.push_back(buffer);
+
+  ++size_;
+  bytes_queued_ += buffer.size();
+}
+
+FlipIOBuffer FlipWriteQueue::Pop() {
+  DCHECK(!empty());
+
+  for (int priority = 0; priority < kNumPriorities; ++priority) {
+    PriorityLevel& level = levels_[priority];
+    if (level.turns.empty())
+      continue;
+
+    FlipStream* stream = level.turns.front();
+    level.turns.pop_front();
+
+    StreamFrameMap::iterator it = level.frames.find(stream);
+    DCHECK(it != level.frames.end());
+    FrameList& frames = it->second;
+    FlipIOBuffer buffer = frames.front();
+    frames.pop_front();
+    if (frames.empty())
+      level.frames.erase(it);
+    else
+      level.turns.push_back(stream);
+
+    --size_;
+    bytes_queued_ -= buffer.size();
+    return buffer;
+  }
+
+  NOTREACHED();
+  return FlipIOBuffer();
+}
+
+}  // namespace net
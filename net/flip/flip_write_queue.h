@@ -0,0 +1,68 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_FLIP_FLIP_WRITE_QUEUE_H_
+#define NET_FLIP_FLIP_WRITE_QUEUE_H_
+
+#include <deque>
+#include <map>
+
+#include "base/basictypes.h"
+#include "net/flip/flip_io_buffer.h"
+#include "net/flip/flip_protocol.h"
+
+namespace net {
+
+class FlipStream;
+
+// The FlipWriteQueue schedules the frames that a FlipSession writes to its
+// socket.  Frames of a higher priority are always written first.  Within a
+// priority, the streams take turns: each stream writes one frame, then goes
+// to the back of the line if it has more frames queued.  This way a stream
+// which queues many frames (e.g. a large upload) does not hold back the
+// other streams of the same priority.  The frames of each stream are written
+// in the order they were queued.
+class FlipWriteQueue {
+ public:
+  FlipWriteQueue();
+  ~FlipWriteQueue();
+
+  // Queues |buffer| at |buffer.priority()|, behind the other frames of
+  // |buffer.stream()|.
+  void Push(const FlipIOBuffer& buffer);
+
+  // Removes and returns the next frame to write.  The queue must not be
+  // empty.
+  FlipIOBuffer Pop();
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // Returns the number of bytes queued.
+  size_t bytes_queued() const { return bytes_queued_; }
+
+ private:
+  typedef std::deque<FlipIOBuffer> FrameList;
+  typedef std::map<FlipStream*, FrameList> StreamFrameMap;
+
+  // The frames of a single priority level.
+  struct PriorityLevel {
+    // The queued frames of each stream.
+    StreamFrameMap frames;
+    // The streams with frames queued, in the order they get their next turn.
+    std::deque<FlipStream*> turns;
+  };
+
+  static const int kNumPriorities = FLIP_PRIORITY_LOWEST + 1;
+
+  PriorityLevel levels_[kNumPriorities];
+  size_t size_;
+  size_t bytes_queued_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlipWriteQueue);
+};
+
+}  // namespace net
+
+#endif  // NET_FLIP_FLIP_WRITE_QUEUE_H_
@@ -0,0 +1,141 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/perftimer.h"
+#include "base/string_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/flip/flip_session.h"
+#include "net/flip/flip_stream.h"
+#include "net/flip/flip_write_queue.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// The simulated page loads.  Each page has two large uploads which run in
+// the background, while the page requests its subresources.
+const int kNumPages = 100;
+const int kNumSubresourcesPerPage = 40;
+const int kUploadSize = 512 * 1024;
+const int kUploadPriority = 2;
+const int kSynStreamSize = 300;
+
+// A new subresource is requested every |kFramesPerRequest| frames written.
+const int kFramesPerRequest = 3;
+
+// A stream of the simulation.  Like a FlipStream, it queues its next data
+// frame only when the previous one was written.
+struct SimulatedStream {
+  scoped_refptr<FlipStream> stream;
+  int priority;
+  int bytes_left;
+  int bytes_written;
+};
+
+// Queues the next data frame of |stream|, if it has more data to send.
+void QueueNextDataFrame(FlipWriteQueue* queue, SimulatedStream* stream) {
+  if (!stream->bytes_left)
+    return;
+  int size = std::min(stream->bytes_left, FlipSession::MaxDataFrameSize());
+  stream->bytes_left -= size;
+  queue->Push(FlipIOBuffer(new IOBuffer(size), size, stream->priority,
+                           stream->stream));
+}
+
+}  // namespace
+
+// Simulates page loads on one FlipSession, and measures how many bytes are
+// written ahead of the SYN_STREAM of each subresource request (i.e. how long
+// the request waits in the write queue), and how evenly the two uploads share
+// the connection.
+TEST(FlipWriteQueuePerfTest, MixedPageLoad) {
+  std::vector<SimulatedStream> uploads(2);
+  for (size_t i = 0; i < uploads.size(); ++i)
+    uploads[i].stream = new FlipStream(NULL, 0, true, NULL);
+  scoped_refptr<FlipStream> requests = new FlipStream(NULL, 0, true, NULL);
+
+  int64 total_delay[FLIP_PRIORITY_LOWEST + 1] = { 0 };
+  int num_requests[FLIP_PRIORITY_LOWEST + 1] = { 0 };
+  int64 max_delay = 0;
+  int64 upload_imbalance = 0;
+
+  PerfTimeLogger timer("Flip_write_queue_mixed_page_load");
+  for (int page = 0; page < kNumPages; ++page) {
+    FlipWriteQueue queue;
+    for (size_t i = 0; i < uploads.size(); ++i) {
+      uploads[i].priority = kUploadPriority;
+      uploads[i].bytes_left = kUploadSize;
+      uploads[i].bytes_written = 0;
+      QueueNextDataFrame(&queue, &uploads[i]);
+    }
+
+    int64 bytes_written = 0;
+    int requests_sent = 0;
+    for (int frame = 0; !queue.empty(); ++frame) {
+      if (frame % kFramesPerRequest == 0 &&
+          requests_sent < kNumSubresourcesPerPage) {
+        int priority = requests_sent % (FLIP_PRIORITY_LOWEST + 1);
+        IOBuffer* buffer = new IOBuffer(kSynStreamSize);
+        // The request time is stored in the buffer, so that it can be read
+        // back when the frame is written.
+        memcpy(buffer->data(), &bytes_written, sizeof(bytes_written));
+        queue.Push(FlipIOBuffer(buffer, kSynStreamSize, priority, requests));
+        ++requests_sent;
+      }
+
+      FlipIOBuffer buffer = queue.Pop();
+      if (buffer.stream() == requests) {
+        int64 requested_at;
+        memcpy(&requested_at, buffer.buffer()->data(), sizeof(requested_at));
+        int64 delay = bytes_written - requested_at;
+        total_delay[buffer.priority()] += delay;
+        ++num_requests[buffer.priority()];
+        max_delay = std::max(max_delay, delay);
+      }
+      bytes_written += buffer.size();
+
+      for (size_t i = 0; i < uploads.size(); ++i) {
+        if (buffer.stream() != uploads[i].stream)
+          continue;
+        uploads[i].bytes_written += buffer.size();
+        QueueNextDataFrame(&queue, &uploads[i]);
+        // When the first upload finishes, see how far behind the other one
+        // is.
+        if (uploads[i].bytes_written == kUploadSize) {
+          int other = uploads[(i + 1) % uploads.size()].bytes_written;
+          if (other < kUploadSize)
+            upload_imbalance += kUploadSize - other;
+        }
+      }
+    }
+    EXPECT_EQ(kNumSubresourcesPerPage, requests_sent);
+  }
+  timer.Done();
+
+  for (int priority = 0; priority <= FLIP_PRIORITY_LOWEST; ++priority) {
+    ASSERT_GT(num_requests[priority], 0);
+    LogPerfResult(StringPrintf("Flip_write_queue_request_delay_p%d",
+                               priority).c_str(),
+                  static_cast<double>(total_delay[priority]) /
+                      num_requests[priority],
+                  "bytes");
+  }
+  LogPerfResult("Flip_write_queue_request_delay_max",
+                static_cast<double>(max_delay), "bytes");
+  LogPerfResult("Flip_write_queue_upload_imbalance",
+                static_cast<double>(upload_imbalance) / kNumPages, "bytes");
+
+  for (size_t i = 0; i < uploads.size(); ++i)
+    uploads[i].stream->OnClose(OK);
+  requests->OnClose(OK);
+}
+
+}  // namespace net
@@ -21,6 +21,7 @@
 #include "net/base/net_errors.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/flip/flip_session_pool.h"
+#include "net/http/http_cache_trace.h"
 #include "net/http/http_cache_transaction.h"
 #include "net/http/http_network_layer.h"
 #include "net/http/http_network_session.h"
@@ -42,7 +43,8 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* e)
     : disk_entry(e),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      streaming(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -147,6 +149,19 @@ int HttpCache::CreateTransaction(scoped_ptr<HttpTransaction>* trans) {
   return OK;
 }
 
+bool HttpCache::StartTrace(const FilePath& path) {
+  trace_.reset(new HttpCacheTrace());
+  if (trace_->Init(path))
+    return true;
+
+  trace_.reset();
+  return false;
+}
+
+void HttpCache::StopTrace() {
+  trace_.reset();
+}
+
 HttpCache* HttpCache::GetCache() {
   return this;
 }
@@ -360,6 +375,18 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
+  //
+  // The exception to the rule is a writer that is streaming the response:
+  // transactions that can use that response become readers right away, and
+  // they follow the writer as it stores the data.
+
+  if (entry->writer && !entry->will_process_pending_queue &&
+      CanFollowWriter(entry, trans)) {
+    entry->readers.push_back(trans);
+    if (!entry->pending_queue.empty())
+      ProcessPendingQueue(entry);
+    return trans->EntryAvailable(entry);
+  }
 
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
@@ -392,11 +419,14 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
                               bool cancel) {
   // If we already posted a task to move on to the next transaction and this was
   // the writer, there is nothing to cancel.
-  if (entry->will_process_pending_queue && entry->readers.empty())
+  if (entry->will_process_pending_queue && entry->readers.empty() &&
+      entry->writer != trans)
     return;
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
+  if (entry->writer == trans) {
+    // Readers following this writer will not get the rest of the response,
+    // even if we keep what we have so far.
+    StopStreaming(entry, false);
 
     // Assume there was a failure.
     bool success = false;
@@ -413,21 +443,25 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 }
 
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
-  DCHECK(entry->readers.empty());
+  // If there are readers following the writer, they are still using the entry
+  // so we cannot destroy it yet, but nobody else should find it.
+  bool in_use = !entry->readers.empty() || entry->will_process_pending_queue;
+  if (!success && in_use && !entry->doomed)
+    DoomEntry(entry->disk_entry->GetKey());
 
   entry->writer = NULL;
+  StopStreaming(entry, success);
 
   if (success) {
     ProcessPendingQueue(entry);
   } else {
-    DCHECK(!entry->will_process_pending_queue);
-
     // We failed to create this entry.
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
     entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (!in_use)
+      DestroyEntry(entry);
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -439,7 +473,7 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  DCHECK(entry->writer != trans);
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
@@ -463,6 +497,41 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::EnableStreaming(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(entry->writer->mode() == Transaction::WRITE);
+
+  entry->streaming = true;
+
+  // Some of the transactions waiting for this entry may be able to follow the
+  // writer now.
+  if (!entry->pending_queue.empty())
+    ProcessPendingQueue(entry);
+}
+
+void HttpCache::DataWrittenToEntry(ActiveEntry* entry) {
+  if (!entry->streaming)
+    return;
+
+  TransactionList::iterator it = entry->readers.begin();
+  for (; it != entry->readers.end(); ++it)
+    (*it)->WriterDataAvailable();
+}
+
+void HttpCache::StopStreaming(ActiveEntry* entry, bool success) {
+  if (!entry->streaming)
+    return;
+  entry->streaming = false;
+
+  TransactionList::iterator it = entry->readers.begin();
+  for (; it != entry->readers.end(); ++it)
+    (*it)->WriterDone(success);
+}
+
+bool HttpCache::CanFollowWriter(ActiveEntry* entry, Transaction* trans) {
+  return entry->streaming && trans->CanFollow(entry->writer);
+}
+
 void HttpCache::RemovePendingTransaction(Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
   bool found = false;
@@ -505,19 +574,22 @@ void HttpCache::ProcessPendingQueue(ActiveEntry* entry) {
 
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
-  DCHECK(!entry->writer);
 
   // If no one is interested in this entry, then we can de-activate it.
   if (entry->pending_queue.empty()) {
-    if (entry->readers.empty())
+    if (entry->readers.empty() && !entry->writer)
       DestroyEntry(entry);
     return;
   }
 
   // Promote next transaction from the pending queue.
   Transaction* next = entry->pending_queue.front();
-  if ((next->mode() & Transaction::WRITE) && !entry->readers.empty())
+  if (entry->writer) {
+    if (!CanFollowWriter(entry, next))
+      return;  // Have to wait for the writer to finish.
+  } else if ((next->mode() & Transaction::WRITE) && !entry->readers.empty()) {
     return;  // Have to wait.
+  }
 
   entry->pending_queue.erase(entry->pending_queue.begin());
 
@@ -34,6 +34,7 @@ class Entry;
 namespace net {
 
 class HostResolver;
+class HttpCacheTrace;
 class HttpNetworkSession;
 class HttpRequestInfo;
 class HttpResponseInfo;
@@ -139,6 +140,11 @@ class HttpCache : public HttpTransactionFactory,
     enable_range_support_ = value;
   }
 
+  // Starts recording every transaction on a trace file (see HttpCacheTrace).
+  // Any previous trace is stopped.
+  bool StartTrace(const FilePath& path);
+  void StopTrace();
+
  private:
 
   // Types --------------------------------------------------------------------
@@ -148,6 +154,10 @@ class HttpCache : public HttpTransactionFactory,
 
   typedef std::list<Transaction*> TransactionList;
 
+  // While the writer is receiving the response from the network, readers may
+  // follow it (|streaming| is true): they get the data as soon as the writer
+  // stores it, instead of waiting in the |pending_queue| for the writer to
+  // finish.
   struct ActiveEntry {
     disk_cache::Entry* disk_entry;
     Transaction*       writer;
@@ -155,6 +165,7 @@ class HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+    bool               streaming;
 
     explicit ActiveEntry(disk_cache::Entry*);
     ~ActiveEntry();
@@ -181,6 +192,10 @@ class HttpCache : public HttpTransactionFactory,
   void DoneWritingToEntry(ActiveEntry* entry, bool success);
   void DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans);
   void ConvertWriterToReader(ActiveEntry* entry);
+  void EnableStreaming(ActiveEntry* entry);
+  void DataWrittenToEntry(ActiveEntry* entry);
+  void StopStreaming(ActiveEntry* entry, bool success);
+  bool CanFollowWriter(ActiveEntry* entry, Transaction* trans);
   void RemovePendingTransaction(Transaction* trans);
   bool RemovePendingTransactionFromEntry(ActiveEntry* entry,
                                          Transaction* trans);
@@ -217,6 +232,8 @@ class HttpCache : public HttpTransactionFactory,
   typedef base::hash_map<std::string, int> PlaybackCacheMap;
   scoped_ptr<PlaybackCacheMap> playback_cache_map_;
 
+  scoped_ptr<HttpCacheTrace> trace_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpCache);
 };
 
@@ -0,0 +1,135 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/http/http_cache_trace.h"
+
+#include <algorithm>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+
+namespace {
+
+const uint32 kTraceMagic = 0x48435452;  // "HCTR".
+const uint32 kTraceVersion = 1;
+
+// Buffered data is written to the file when it reaches this size.
+const size_t kMaxBufferSize = 32 * 1024;
+
+struct FileHeader {
+  uint32 magic;
+  uint32 version;
+};
+
+struct RecordHeader {
+  uint32 time;  // Milliseconds since the start of the trace.
+  int32 size;
+  int32 load_flags;
+  uint8 outcome;
+  uint8 unused;
+  uint16 key_len;
+};
+
+COMPILE_ASSERT(sizeof(RecordHeader) == 16, bad_RecordHeader);
+
+}  // namespace
+
+namespace net {
+
+HttpCacheTrace::HttpCacheTrace() : file_(NULL) {
+}
+
+HttpCacheTrace::~HttpCacheTrace() {
+  if (!file_)
+    return;
+
+  Flush();
+  file_util::CloseFile(file_);
+}
+
+bool HttpCacheTrace::Init(const FilePath& path) {
+  DCHECK(!file_);
+  file_ = file_util::OpenFile(path, "wb");
+  if (!file_)
+    return false;
+
+  FileHeader header;
+  header.magic = kTraceMagic;
+  header.version = kTraceVersion;
+  buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  start_ = base::TimeTicks::Now();
+  return true;
+}
+
+void HttpCacheTrace::AddRecord(const Record& record) {
+  if (!file_)
+    return;
+
+  RecordHeader header;
+  header.time = static_cast<uint32>(
+      (base::TimeTicks::Now() - start_).InMilliseconds());
+  header.size = record.size;
+  header.load_flags = record.load_flags;
+  header.outcome = static_cast<uint8>(record.outcome);
+  header.unused = 0;
+  size_t key_len = std::min(record.key.size(), static_cast<size_t>(kuint16max));
+  header.key_len = static_cast<uint16>(key_len);
+
+  buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer_.append(record.key, 0, key_len);
+  if (buffer_.size() >= kMaxBufferSize)
+    Flush();
+}
+
+void HttpCacheTrace::Flush() {
+  if (!file_ || buffer_.empty())
+    return;
+
+  if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+    LOG(ERROR) << "Unable to write the cache trace";
+  fflush(file_);
+  buffer_.clear();
+}
+
+// static
+bool HttpCacheTrace::ReadTrace(const FilePath& path,
+                               std::vector<Record>* records) {
+  std::string data;
+  if (!file_util::ReadFileToString(path, &data))
+    return false;
+
+  FileHeader file_header;
+  if (data.size() < sizeof(file_header))
+    return false;
+  memcpy(&file_header, data.data(), sizeof(file_header));
+  if (file_header.magic != kTraceMagic || file_header.version != kTraceVersion)
+    return false;
+
+  size_t offset = sizeof(file_header);
+  while (offset < data.size()) {
+    RecordHeader header;
+    if (data.size() - offset < sizeof(header))
+      return false;
+    memcpy(&header, data.data() + offset, sizeof(header));
+    offset += sizeof(header);
+
+    if (data.size() - offset < header.key_len ||
+        header.outcome >= NUM_OUTCOMES) {
+      return false;
+    }
+
+    Record record;
+    record.time = base::TimeDelta::FromMilliseconds(header.time);
+    record.key = data.substr(offset, header.key_len);
+    record.size = header.size;
+    record.load_flags = header.load_flags;
+    record.outcome = static_cast<Outcome>(header.outcome);
+    records->push_back(record);
+    offset += header.key_len;
+  }
+  return true;
+}
+
+}  // namespace net
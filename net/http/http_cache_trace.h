@@ -0,0 +1,74 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// HttpCacheTrace records the activity of an HttpCache on a compact binary
+// file, so that the behavior of the cache under a real workload can be
+// reproduced later (see net/tools/cache_replay).
+//
+// The file starts with a FileHeader, followed by one record per transaction:
+// a RecordHeader followed by the |key_len| bytes of the cache key. All values
+// are stored in the byte order of the machine that created the trace.
+
+#ifndef NET_HTTP_HTTP_CACHE_TRACE_H_
+#define NET_HTTP_HTTP_CACHE_TRACE_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+
+class FilePath;
+
+namespace net {
+
+class HttpCacheTrace {
+ public:
+  // How a transaction used the cache.
+  enum Outcome {
+    MISS,          // The response came from the network.
+    HIT,           // The response came from the cache.
+    VALIDATED,     // The cached response was validated with the server.
+    PASS_THROUGH,  // The cache was not used.
+    NUM_OUTCOMES
+  };
+
+  struct Record {
+    base::TimeDelta time;  // Since the start of the trace.
+    std::string key;
+    int32 size;  // Size of the response body on the cache.
+    int32 load_flags;
+    Outcome outcome;
+  };
+
+  HttpCacheTrace();
+  ~HttpCacheTrace();
+
+  // Starts recording on |path|. Any existing file is overwritten.
+  bool Init(const FilePath& path);
+
+  // Adds a new record to the trace. The time of |record| is ignored: the
+  // current time is used instead.
+  void AddRecord(const Record& record);
+
+  // Writes all buffered records to the file.
+  void Flush();
+
+  // Reads the whole trace stored on |path|. Returns false if the file is not a
+  // valid trace.
+  static bool ReadTrace(const FilePath& path, std::vector<Record>* records);
+
+ private:
+  FILE* file_;
+  base::TimeTicks start_;
+  std::string buffer_;  // Records not yet written to the file.
+
+  DISALLOW_COPY_AND_ASSIGN(HttpCacheTrace);
+};
+
+}  // namespace net
+
+#endif  // NET_HTTP_HTTP_CACHE_TRACE_H_
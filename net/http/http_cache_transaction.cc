@@ -10,6 +10,7 @@
 #include <unistd.h>
 #endif
 
+#include "base/message_loop.h"
 #include "base/ref_counted.h"
 #include "base/string_util.h"
 #include "base/time.h"
@@ -112,8 +113,11 @@ HttpCache::Transaction::Transaction(HttpCache* cache, bool enable_range_support)
       enable_range_support_(enable_range_support),
       truncated_(false),
       server_responded_206_(false),
+      waiting_for_writer_(false),
+      writer_failed_(false),
       read_offset_(0),
       effective_load_flags_(0),
+      cache_outcome_(HttpCacheTrace::PASS_THROUGH),
       final_upload_progress_(0),
       ALLOW_THIS_IN_INITIALIZER_LIST(
           network_callback_(this, &Transaction::OnIOComplete)),
@@ -122,7 +126,8 @@ HttpCache::Transaction::Transaction(HttpCache* cache, bool enable_range_support)
                 this, &Transaction::OnIOComplete))),
       ALLOW_THIS_IN_INITIALIZER_LIST(
           write_headers_callback_(new CancelableCompletionCallback<Transaction>(
-                this, &Transaction::OnIOComplete))) {
+                this, &Transaction::OnIOComplete))),
+      ALLOW_THIS_IN_INITIALIZER_LIST(task_factory_(this)) {
   COMPILE_ASSERT(HttpCache::Transaction::kNumValidationHeaders ==
                      ARRAYSIZE_UNSAFE(kValidationHeaders),
                  Invalid_number_of_validation_headers);
@@ -130,6 +135,9 @@ HttpCache::Transaction::Transaction(HttpCache* cache, bool enable_range_support)
 
 HttpCache::Transaction::~Transaction() {
   if (cache_) {
+    if (cache_->trace_.get() && request_)
+      AddToTrace();
+
     if (entry_) {
       bool cancel_request = reading_ && enable_range_support_;
       if (cancel_request) {
@@ -307,6 +315,12 @@ int HttpCache::Transaction::Read(IOBuffer* buf, int buf_len,
     mode_ = NONE;
   }
 
+  // Once the body starts flowing, other transactions for the same resource
+  // can read it from the cache as we store it. Byte-range requests and
+  // resumed responses are not stored sequentially, so they cannot be followed.
+  if (!reading_ && mode_ == WRITE && entry_ && !partial_.get() && !truncated_)
+    cache_->EnableStreaming(entry_);
+
   reading_ = true;
   int rv;
 
@@ -349,6 +363,8 @@ const HttpResponseInfo* HttpCache::Transaction::GetResponseInfo() const {
 LoadState HttpCache::Transaction::GetLoadState() const {
   if (network_trans_.get())
     return network_trans_->GetLoadState();
+  if (waiting_for_writer_)
+    return LOAD_STATE_WAITING_FOR_CACHE;
   if (entry_ || !request_)
     return LOAD_STATE_IDLE;
   return LOAD_STATE_WAITING_FOR_CACHE;
@@ -484,6 +500,8 @@ int HttpCache::Transaction::EntryAvailable(ActiveEntry* entry) {
 
 int HttpCache::Transaction::DoEntryAvailable() {
   DCHECK(!new_entry_);
+  cache_outcome_ = (mode_ == WRITE) ? HttpCacheTrace::MISS :
+                                      HttpCacheTrace::HIT;
   if (mode_ == WRITE) {
     if (partial_.get())
       partial_->RestoreHeaders(&custom_request_->extra_headers);
@@ -560,6 +578,35 @@ bool HttpCache::Transaction::AddTruncatedFlag() {
   return true;
 }
 
+bool HttpCache::Transaction::CanFollow(Transaction* writer) {
+  // Byte-range requests (and whoever may have to update the entry) have to
+  // wait for the writer to finish.
+  if (partial_.get() || (mode_ != READ && mode_ != READ_WRITE))
+    return false;
+
+  if (mode_ == READ || effective_load_flags_ & LOAD_PREFERRING_CACHE)
+    return true;
+
+  return !RequiresValidation(writer->response_);
+}
+
+void HttpCache::Transaction::WriterDataAvailable() {
+  if (!waiting_for_writer_)
+    return;
+  waiting_for_writer_ = false;
+
+  // We may be called while the writer is in the middle of its own callback, so
+  // we should not call the user back from here.
+  MessageLoop::current()->PostTask(FROM_HERE,
+      task_factory_.NewRunnableMethod(&Transaction::OnWriterProgress));
+}
+
+void HttpCache::Transaction::WriterDone(bool success) {
+  if (!success)
+    writer_failed_ = true;
+  WriterDataAvailable();
+}
+
 void HttpCache::Transaction::DoCallback(int rv) {
   DCHECK(rv != ERR_IO_PENDING);
   DCHECK(callback_);
@@ -875,8 +922,15 @@ int HttpCache::Transaction::BeginCacheRead() {
 int HttpCache::Transaction::BeginCacheValidation() {
   DCHECK(mode_ == READ_WRITE);
 
+  if (entry_->writer != this) {
+    // We are following the writer of this entry, and it is storing a response
+    // that we can use (see CanFollow()).
+    mode_ = READ;
+    return OK;
+  }
+
   if ((effective_load_flags_ & LOAD_PREFERRING_CACHE ||
-       !RequiresValidation()) && !partial_.get()) {
+       !RequiresValidation(response_)) && !partial_.get()) {
     cache_->ConvertWriterToReader(entry_);
     mode_ = READ;
   } else {
@@ -1025,6 +1079,10 @@ int HttpCache::Transaction::DoSendRequest() {
   DCHECK(mode_ & WRITE || mode_ == NONE);
   DCHECK(!network_trans_.get());
 
+  // The cached response (if any) is not good enough as it is.
+  if (cache_outcome_ == HttpCacheTrace::HIT)
+    cache_outcome_ = HttpCacheTrace::MISS;
+
   // Create a network transaction.
   int rv = cache_->network_layer_->CreateTransaction(&network_trans_);
   if (rv != OK)
@@ -1076,7 +1134,8 @@ int HttpCache::Transaction::RestartNetworkRequestWithAuth(
   return rv;
 }
 
-bool HttpCache::Transaction::RequiresValidation() {
+bool HttpCache::Transaction::RequiresValidation(
+    const HttpResponseInfo& response) {
   // TODO(darin): need to do more work here:
   //  - make sure we have a matching request method
   //  - watch out for cached responses that depend on authentication
@@ -1087,16 +1146,16 @@ bool HttpCache::Transaction::RequiresValidation() {
   if (effective_load_flags_ & LOAD_VALIDATE_CACHE)
     return true;
 
-  if (response_.headers->response_code() == 206 && !enable_range_support_)
+  if (response.headers->response_code() == 206 && !enable_range_support_)
     return true;
 
-  if (response_.headers->RequiresValidation(
-          response_.request_time, response_.response_time, Time::Now()))
+  if (response.headers->RequiresValidation(
+          response.request_time, response.response_time, Time::Now()))
     return true;
 
   // Since Vary header computation is fairly expensive, we save it for last.
-  if (response_.vary_data.is_valid() &&
-          !response_.vary_data.MatchesRequest(*request_, *response_.headers))
+  if (response.vary_data.is_valid() &&
+          !response.vary_data.MatchesRequest(*request_, *response.headers))
     return true;
 
   return false;
@@ -1488,8 +1547,20 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
   if (result > 0) {
     read_offset_ += result;
   } else if (result == 0) {  // End of file.
+    if (entry_->writer) {
+      // We are following a writer that has not stored the whole response yet.
+      next_state_ = STATE_CACHE_READ_DATA;
+      if (entry_->disk_entry->GetDataSize(kResponseContentIndex) > read_offset_)
+        return OK;
+      waiting_for_writer_ = true;
+      return ERR_IO_PENDING;
+    }
     cache_->DoneReadingFromEntry(entry_, this);
     entry_ = NULL;
+    if (writer_failed_) {
+      DLOG(WARNING) << "The response was not completely stored";
+      return ERR_CACHE_READ_FAILURE;
+    }
   }
   return result;
 }
@@ -1516,8 +1587,11 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
   if (partial_.get())
     return DoPartialNetworkReadCompleted(result);
 
-  if (result == 0)  // End of file.
+  if (result == 0) {  // End of file.
     DoneWritingToEntry(true);
+  } else if (entry_) {
+    cache_->DataWrittenToEntry(entry_);
+  }
 
   return result;
 }
@@ -1568,6 +1642,8 @@ int HttpCache::Transaction::DoSuccessfulSendRequest() {
 // We received 304 or 206 and we want to update the cached response headers.
 int HttpCache::Transaction::DoUpdateCachedResponse() {
   next_state_ = STATE_UPDATE_CACHED_RESPONSE_COMPLETE;
+  if (!server_responded_206_)
+    cache_outcome_ = HttpCacheTrace::VALIDATED;
   int rv = OK;
   // Update cached response based on headers in new_response.
   // TODO(wtc): should we update cached certificate (response_.ssl_info), too?
@@ -1680,8 +1756,29 @@ int HttpCache::Transaction::DoSendRequestComplete(int result) {
   return result;
 }
 
+void HttpCache::Transaction::AddToTrace() {
+  HttpCacheTrace::Record record;
+  record.key = cache_key_.empty() ? request_->url.spec() : cache_key_;
+  record.size = 0;
+  if (entry_ && entry_->disk_entry)
+    record.size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
+  record.load_flags = effective_load_flags_;
+  record.outcome = cache_outcome_;
+  cache_->trace_->AddRecord(record);
+}
+
 void HttpCache::Transaction::OnIOComplete(int result) {
   DoLoop(result);
 }
 
+void HttpCache::Transaction::OnWriterProgress() {
+  DCHECK_EQ(STATE_CACHE_READ_DATA, next_state_);
+  if (!cache_) {
+    next_state_ = STATE_NONE;
+    HandleResult(ERR_UNEXPECTED);
+    return;
+  }
+  DoLoop(OK);
+}
+
 }  // namespace net
@@ -9,6 +9,7 @@
 #define NET_HTTP_HTTP_CACHE_TRANSACTION_H_
 
 #include "net/http/http_cache.h"
+#include "net/http/http_cache_trace.h"
 #include "net/http/http_response_info.h"
 #include "net/http/http_transaction.h"
 
@@ -83,6 +84,19 @@ class HttpCache::Transaction : public HttpTransaction {
   // success.
   bool AddTruncatedFlag();
 
+  // Returns true if this transaction can use the response that |writer| is
+  // storing in the cache, while it is being received.
+  bool CanFollow(Transaction* writer);
+
+  // Called by the HttpCache when the writer that this transaction is following
+  // has stored more data.
+  void WriterDataAvailable();
+
+  // Called by the HttpCache when the writer that this transaction is following
+  // is done with the entry. |success| is false if the writer didn't store the
+  // whole response.
+  void WriterDone(bool success);
+
  private:
   static const size_t kNumValidationHeaders = 2;
   // Helper struct to pair a header name with its value, for
@@ -219,8 +233,9 @@ class HttpCache::Transaction : public HttpTransaction {
   int RestartNetworkRequestWithAuth(const std::wstring& username,
                                     const std::wstring& password);
 
-  // Called to determine if we need to validate the cache entry before using it.
-  bool RequiresValidation();
+  // Called to determine if we need to validate the cache entry before using it,
+  // given the stored |response|.
+  bool RequiresValidation(const HttpResponseInfo& response);
 
   // Called to make the request conditional (to ask the server if the cached
   // copy is valid).  Returns true if able to make the request conditional.
@@ -274,9 +289,16 @@ class HttpCache::Transaction : public HttpTransaction {
   // Performs the needed work after writing data to the cache.
   int DoCacheWriteCompleted(int result);
 
+  // Adds this transaction to the trace of the cache.
+  void AddToTrace();
+
   // Called to signal completion of asynchronous IO.
   void OnIOComplete(int result);
 
+  // Called to continue reading after the writer that we follow stored more
+  // data (or went away).
+  void OnWriterProgress();
+
   State next_state_;
   const HttpRequestInfo* request_;
   scoped_refptr<LoadLog> load_log_;
@@ -300,16 +322,20 @@ class HttpCache::Transaction : public HttpTransaction {
   bool enable_range_support_;
   bool truncated_;  // We don't have all the response data.
   bool server_responded_206_;
+  bool waiting_for_writer_;  // We need more data from the writer we follow.
+  bool writer_failed_;  // The writer we follow didn't get the whole response.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
   int effective_load_flags_;
+  HttpCacheTrace::Outcome cache_outcome_;  // For the trace.
   scoped_ptr<PartialData> partial_;  // We are dealing with range requests.
   uint64 final_upload_progress_;
   CompletionCallbackImpl<Transaction> network_callback_;
   scoped_refptr<CancelableCompletionCallback<Transaction> > cache_callback_;
   scoped_refptr<CancelableCompletionCallback<Transaction> >
       write_headers_callback_;
+  ScopedRunnableMethodFactory<Transaction> task_factory_;
 };
 
 }  // namespace net
@@ -4,6 +4,8 @@
 
 #include "net/http/http_cache.h"
 
+#include "base/file_path.h"
+#include "base/file_util.h"
 #include "base/hash_tables.h"
 #include "base/message_loop.h"
 #include "base/scoped_vector.h"
@@ -15,6 +17,7 @@
 #include "net/base/ssl_cert_request_info.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/http_byte_range.h"
+#include "net/http/http_cache_trace.h"
 #include "net/http/http_request_info.h"
 #include "net/http/http_response_headers.h"
 #include "net/http/http_response_info.h"
@@ -1452,6 +1455,188 @@ TEST(HttpCache, SimpleGET_ManyWriters_CancelFirst) {
   }
 }
 
+// Tests that a request that arrives while another transaction is receiving the
+// same resource gets the data as it is stored, instead of waiting for the first
+// transaction to finish.
+TEST(HttpCache, SimpleGET_StreamingReader) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+  const std::string expected(kSimpleGET_Transaction.data);
+
+  Context writer;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&writer.trans));
+  int rv = writer.trans->Start(&request, &writer.callback, NULL);
+  EXPECT_EQ(net::OK, writer.callback.GetResult(rv));
+
+  // Receive part of the response.
+  scoped_refptr<net::IOBufferWithSize> buf = new net::IOBufferWithSize(10);
+  rv = writer.trans->Read(buf, buf->size(), &writer.callback);
+  EXPECT_EQ(buf->size(), writer.callback.GetResult(rv));
+
+  // Now a second request should be able to read what we have so far.
+  Context reader;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&reader.trans));
+  rv = reader.trans->Start(&request, &reader.callback, NULL);
+  EXPECT_EQ(net::OK, reader.callback.GetResult(rv));
+
+  scoped_refptr<net::IOBufferWithSize> buf2 = new net::IOBufferWithSize(256);
+  rv = reader.trans->Read(buf2, buf2->size(), &reader.callback);
+  ASSERT_EQ(buf->size(), reader.callback.GetResult(rv));
+  EXPECT_EQ(expected.substr(0, buf->size()),
+            std::string(buf2->data(), buf->size()));
+
+  // And wait for more data.
+  rv = reader.trans->Read(buf2, buf2->size(), &reader.callback);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+  EXPECT_EQ(expected.substr(buf->size()), content);
+
+  rv = reader.callback.WaitForResult();
+  ASSERT_EQ(static_cast<int>(expected.size()) - buf->size(), rv);
+  EXPECT_EQ(expected.substr(buf->size()), std::string(buf2->data(), rv));
+
+  EXPECT_EQ(net::OK, ReadTransaction(reader.trans.get(), &content));
+  EXPECT_TRUE(content.empty());
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that the readers that follow a writer fail if the writer is cancelled
+// before receiving the whole response.
+TEST(HttpCache, SimpleGET_StreamingWriterCancelled) {
+  MockHttpCache cache;
+  cache.http_cache()->set_enable_range_support(true);
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  Context* writer = new Context();
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&writer->trans));
+  int rv = writer->trans->Start(&request, &writer->callback, NULL);
+  EXPECT_EQ(net::OK, writer->callback.GetResult(rv));
+
+  scoped_refptr<net::IOBufferWithSize> buf = new net::IOBufferWithSize(10);
+  rv = writer->trans->Read(buf, buf->size(), &writer->callback);
+  EXPECT_EQ(buf->size(), writer->callback.GetResult(rv));
+
+  Context reader;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&reader.trans));
+  rv = reader.trans->Start(&request, &reader.callback, NULL);
+  EXPECT_EQ(net::OK, reader.callback.GetResult(rv));
+
+  rv = reader.trans->Read(buf, buf->size(), &reader.callback);
+  EXPECT_EQ(buf->size(), reader.callback.GetResult(rv));
+  rv = reader.trans->Read(buf, buf->size(), &reader.callback);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+
+  // The response has no strong validators, so the entry should go away.
+  delete writer;
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, reader.callback.WaitForResult());
+  reader.trans.reset();
+
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
+// Tests that cancelling a reader that follows a writer doesn't affect the
+// writer.
+TEST(HttpCache, SimpleGET_StreamingReaderCancelled) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  Context writer;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&writer.trans));
+  int rv = writer.trans->Start(&request, &writer.callback, NULL);
+  EXPECT_EQ(net::OK, writer.callback.GetResult(rv));
+
+  scoped_refptr<net::IOBufferWithSize> buf = new net::IOBufferWithSize(10);
+  rv = writer.trans->Read(buf, buf->size(), &writer.callback);
+  EXPECT_EQ(buf->size(), writer.callback.GetResult(rv));
+
+  Context* reader = new Context();
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&reader->trans));
+  rv = reader->trans->Start(&request, &reader->callback, NULL);
+  EXPECT_EQ(net::OK, reader->callback.GetResult(rv));
+
+  rv = reader->trans->Read(buf, buf->size(), &reader->callback);
+  EXPECT_EQ(buf->size(), reader->callback.GetResult(rv));
+  rv = reader->trans->Read(buf, buf->size(), &reader->callback);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  delete reader;
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+  writer.trans.reset();
+
+  // The entry should be complete.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that transactions queued behind a writer are served as readers once the
+// writer starts receiving the body.
+TEST(HttpCache, SimpleGET_PendingReadersFollowWriter) {
+  MockHttpCache cache;
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  ScopedVector<Context> context_list;
+  const int kNumTransactions = 3;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.http_cache()->CreateTransaction(&c->trans);
+    EXPECT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(&request, &c->callback, NULL);
+  }
+
+  Context* writer = context_list[0];
+  writer->result = writer->callback.GetResult(writer->result);
+  EXPECT_EQ(net::OK, writer->result);
+
+  // The rest of the transactions are still waiting.
+  MessageLoop::current()->RunAllPending();
+  for (int i = 1; i < kNumTransactions; ++i)
+    EXPECT_FALSE(context_list[i]->callback.have_result());
+
+  // Start reading the body; the others can proceed now.
+  scoped_refptr<net::IOBufferWithSize> buf = new net::IOBufferWithSize(10);
+  int rv = writer->trans->Read(buf, buf->size(), &writer->callback);
+  EXPECT_EQ(buf->size(), writer->callback.GetResult(rv));
+
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    ASSERT_EQ(net::ERR_IO_PENDING, c->result);
+    EXPECT_EQ(net::OK, c->callback.WaitForResult());
+  }
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer->trans.get(), &content));
+  for (int i = 1; i < kNumTransactions; ++i)
+    ReadAndVerifyTransaction(context_list[i]->trans.get(),
+                             kSimpleGET_Transaction);
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
 TEST(HttpCache, SimpleGET_AbandonedCacheRead) {
   MockHttpCache cache;
 
@@ -1536,6 +1721,47 @@ TEST(HttpCache, ETagGET_ConditionalRequest_304) {
   EXPECT_EQ(1, cache.disk_cache()->create_count());
 }
 
+// Tests that every transaction is recorded on the trace, with its outcome.
+TEST(HttpCache, Trace) {
+  MockHttpCache cache;
+
+  FilePath path;
+  ASSERT_TRUE(file_util::CreateTemporaryFile(&path));
+  ASSERT_TRUE(cache.http_cache()->StartTrace(path));
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  RunTransactionTest(cache.http_cache(), transaction);
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  transaction.load_flags = net::LOAD_VALIDATE_CACHE;
+  transaction.handler = ETagGet_ConditionalRequest_Handler;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  transaction.load_flags = net::LOAD_DISABLE_CACHE;
+  transaction.handler = NULL;
+  RunTransactionTest(cache.http_cache(), transaction);
+  cache.http_cache()->StopTrace();
+
+  std::vector<net::HttpCacheTrace::Record> records;
+  ASSERT_TRUE(net::HttpCacheTrace::ReadTrace(path, &records));
+  EXPECT_TRUE(file_util::Delete(path, false));
+  ASSERT_EQ(4U, records.size());
+
+  const net::HttpCacheTrace::Outcome kOutcomes[] = {
+    net::HttpCacheTrace::MISS,
+    net::HttpCacheTrace::HIT,
+    net::HttpCacheTrace::VALIDATED,
+    net::HttpCacheTrace::PASS_THROUGH
+  };
+  int data_size = static_cast<int>(strlen(kETagGET_Transaction.data));
+  for (size_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(kETagGET_Transaction.url, records[i].key);
+    EXPECT_EQ(kOutcomes[i], records[i].outcome);
+    EXPECT_EQ(i < 3 ? data_size : 0, records[i].size);
+  }
+  EXPECT_EQ(net::LOAD_VALIDATE_CACHE, records[2].load_flags);
+}
+
 static void ETagGet_ConditionalRequest_NoStore_Handler(
     const net::HttpRequestInfo* request,
     std::string* response_status,
@@ -2969,6 +3195,46 @@ TEST(HttpCache, RangeGET_Cancel3) {
   RemoveMockTransaction(&kRangeGET_TransactionOK);
 }
 
+// Tests that a byte-range writer doesn't let other transactions follow it.
+TEST(HttpCache, RangeGET_NoStreaming) {
+  MockHttpCache cache;
+  cache.http_cache()->set_enable_range_support(true);
+  AddMockTransaction(&kRangeGET_TransactionOK);
+
+  MockHttpRequest request(kRangeGET_TransactionOK);
+
+  Context writer;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&writer.trans));
+  int rv = writer.trans->Start(&request, &writer.callback, NULL);
+  EXPECT_EQ(net::OK, writer.callback.GetResult(rv));
+
+  scoped_refptr<net::IOBufferWithSize> buf = new net::IOBufferWithSize(5);
+  rv = writer.trans->Read(buf, buf->size(), &writer.callback);
+  EXPECT_EQ(buf->size(), writer.callback.GetResult(rv));
+
+  // The second request has to wait for the first one.
+  Context reader;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&reader.trans));
+  rv = reader.trans->Start(&request, &reader.callback, NULL);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(reader.callback.have_result());
+
+  std::string content;
+  EXPECT_EQ(net::OK, ReadTransaction(writer.trans.get(), &content));
+  EXPECT_EQ("0-49 ", content);
+  writer.trans.reset();
+
+  EXPECT_EQ(net::OK, reader.callback.WaitForResult());
+  ReadAndVerifyTransaction(reader.trans.get(), kRangeGET_TransactionOK);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  RemoveMockTransaction(&kRangeGET_TransactionOK);
+}
+
 // Tests that an invalid range response results in no cached entry.
 TEST(HttpCache, RangeGET_InvalidResponse1) {
   MockHttpCache cache;
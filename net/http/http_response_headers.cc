@@ -75,6 +75,40 @@ const char* const kNonUpdatedHeaders[] = {
   "content-length"
 };
 
+// Returns the bytes between |begin| and |end|, without copying them.
+base::StringPiece MakeStringPiece(std::string::const_iterator begin,
+                                  std::string::const_iterator end) {
+  if (begin == end)
+    return base::StringPiece();
+  return base::StringPiece(&*begin, end - begin);
+}
+
+// Returns the end of the comma separated value that starts at |begin|,
+// skipping over the commas inside quoted strings.  This tokenizes like
+// HttpUtil::ValuesIterator, but without allocating.
+std::string::const_iterator FindValueEnd(std::string::const_iterator begin,
+                                         std::string::const_iterator end) {
+  bool in_quote = false;
+  bool in_escape = false;
+  char quote_char = '\0';
+  for (std::string::const_iterator p = begin; p != end; ++p) {
+    if (in_quote) {
+      if (in_escape)
+        in_escape = false;
+      else if (*p == '\\')
+        in_escape = true;
+      else if (*p == quote_char)
+        in_quote = false;
+    } else if (*p == ',') {
+      return p;
+    } else if (*p == '"' || *p == '\'') {
+      in_quote = true;
+      quote_char = *p;
+    }
+  }
+  return end;
+}
+
 bool ShouldUpdateHeader(const std::string::const_iterator& name_begin,
                         const std::string::const_iterator& name_end) {
   for (size_t i = 0; i < arraysize(kNonUpdatedHeaders); ++i) {
@@ -132,6 +166,9 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
   // so this just copies the first header line.
   blob.assign(raw_headers_.c_str(), strlen(raw_headers_.c_str()) + 1);
 
+  // Reused for every header, to avoid an allocation per header.
+  std::string header_name;
+
   for (size_t i = 0; i < parsed_.size(); ++i) {
     DCHECK(!parsed_[i].is_continuation());
 
@@ -140,7 +177,7 @@ void HttpResponseHeaders::Persist(Pickle* pickle, PersistOptions options) {
     while (++k < parsed_.size() && parsed_[k].is_continuation());
     --k;
 
-    std::string header_name(parsed_[i].name_begin, parsed_[i].name_end);
+    header_name.assign(parsed_[i].name_begin, parsed_[i].name_end);
     StringToLowerASCII(&header_name);
 
     if (filter_headers.find(header_name) == filter_headers.end()) {
@@ -165,6 +202,7 @@ void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
   new_raw_headers.push_back('\0');
 
   HeaderSet updated_headers;
+  std::string name;
 
   // NOTE: we write the new headers then the old headers for convenience.  The
   // order should not matter.
@@ -183,7 +221,7 @@ void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
     const std::string::const_iterator& name_begin = new_parsed[i].name_begin;
     const std::string::const_iterator& name_end = new_parsed[i].name_end;
     if (ShouldUpdateHeader(name_begin, name_end)) {
-      std::string name(name_begin, name_end);
+      name.assign(name_begin, name_end);
       StringToLowerASCII(&name);
       updated_headers.insert(name);
 
@@ -203,6 +241,7 @@ void HttpResponseHeaders::Update(const HttpResponseHeaders& new_headers) {
 void HttpResponseHeaders::MergeWithHeaders(const std::string& raw_headers,
                                            const HeaderSet& headers_to_remove) {
   std::string new_raw_headers(raw_headers);
+  std::string name;
   for (size_t i = 0; i < parsed_.size(); ++i) {
     DCHECK(!parsed_[i].is_continuation());
 
@@ -211,7 +250,7 @@ void HttpResponseHeaders::MergeWithHeaders(const std::string& raw_headers,
     while (++k < parsed_.size() && parsed_[k].is_continuation());
     --k;
 
-    std::string name(parsed_[i].name_begin, parsed_[i].name_end);
+    name.assign(parsed_[i].name_begin, parsed_[i].name_end);
     StringToLowerASCII(&name);
     if (headers_to_remove.find(name) == headers_to_remove.end()) {
       // It's ok to preserve this header in the final result.
@@ -291,15 +330,36 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
   raw_headers_.append(line_end + 1, raw_input.end());
 
   // Adjust to point at the null byte following the status line
+  std::string::const_iterator headers_end = raw_headers_.end();
   line_end = raw_headers_.begin() + status_line_len - 1;
 
-  HttpUtil::HeadersIterator headers(line_end + 1, raw_headers_.end(),
-                                    std::string(1, '\0'));
-  while (headers.GetNext()) {
-    AddHeader(headers.name_begin(),
-              headers.name_end(),
-              headers.values_begin(),
-              headers.values_end());
+  // There is at least one entry per header line.
+  parsed_.reserve(std::count(line_end + 1, headers_end, '\0'));
+
+  // Index the header lines.  This is what HttpUtil::HeadersIterator does, but
+  // without allocating.
+  while (line_end != headers_end) {
+    line_begin = line_end + 1;
+    line_end = std::find(line_begin, headers_end, '\0');
+
+    std::string::const_iterator colon = std::find(line_begin, line_end, ':');
+    if (colon == line_end)
+      continue;  // skip malformed header
+
+    // If the name starts with LWS, it is an invalid line.
+    // Leading LWS implies a line continuation, and these should have
+    // already been joined by AssembleRawHeaders().
+    std::string::const_iterator name_begin = line_begin;
+    std::string::const_iterator name_end = colon;
+    if (name_begin == name_end || HttpUtil::IsLWS(*name_begin))
+      continue;
+    HttpUtil::TrimLWS(&name_begin, &name_end);
+
+    std::string::const_iterator values_begin = colon + 1;
+    std::string::const_iterator values_end = line_end;
+    HttpUtil::TrimLWS(&values_begin, &values_end);
+
+    AddHeader(name_begin, name_end, values_begin, values_end);
   }
 }
 
@@ -357,10 +417,10 @@ void HttpResponseHeaders::GetNormalizedHeaders(std::string* output) const {
   output->push_back('\n');
 }
 
-bool HttpResponseHeaders::GetNormalizedHeader(const std::string& name,
+bool HttpResponseHeaders::GetNormalizedHeader(const base::StringPiece& name,
                                               std::string* value) const {
   // If you hit this assertion, please use EnumerateHeader instead!
-  DCHECK(!HttpUtil::IsNonCoalescingHeader(name));
+  DCHECK(!HttpUtil::IsNonCoalescingHeader(name.as_string()));
 
   value->clear();
 
@@ -405,27 +465,55 @@ std::string HttpResponseHeaders::GetStatusText() const {
 bool HttpResponseHeaders::EnumerateHeaderLines(void** iter,
                                                std::string* name,
                                                std::string* value) const {
+  base::StringPiece name_piece;
+  base::StringPiece value_piece;
+  if (!EnumerateHeaderLines(iter, &name_piece, &value_piece))
+    return false;
+
+  name_piece.CopyToString(name);
+  value_piece.CopyToString(value);
+  return true;
+}
+
+bool HttpResponseHeaders::EnumerateHeaderLines(void** iter,
+                                               base::StringPiece* name,
+                                               base::StringPiece* value) const {
   size_t i = reinterpret_cast<size_t>(*iter);
   if (i == parsed_.size())
     return false;
 
   DCHECK(!parsed_[i].is_continuation());
 
-  name->assign(parsed_[i].name_begin, parsed_[i].name_end);
+  *name = MakeStringPiece(parsed_[i].name_begin, parsed_[i].name_end);
 
+  // The continuations of a header line are contiguous in raw_headers_.
   std::string::const_iterator value_begin = parsed_[i].value_begin;
   std::string::const_iterator value_end = parsed_[i].value_end;
   while (++i < parsed_.size() && parsed_[i].is_continuation())
     value_end = parsed_[i].value_end;
 
-  value->assign(value_begin, value_end);
+  *value = MakeStringPiece(value_begin, value_end);
 
   *iter = reinterpret_cast<void*>(i);
   return true;
 }
 
-bool HttpResponseHeaders::EnumerateHeader(void** iter, const std::string& name,
+bool HttpResponseHeaders::EnumerateHeader(void** iter,
+                                          const base::StringPiece& name,
                                           std::string* value) const {
+  base::StringPiece value_piece;
+  if (!EnumerateHeader(iter, name, &value_piece)) {
+    value->clear();
+    return false;
+  }
+
+  value_piece.CopyToString(value);
+  return true;
+}
+
+bool HttpResponseHeaders::EnumerateHeader(void** iter,
+                                          const base::StringPiece& name,
+                                          base::StringPiece* value) const {
   size_t i;
   if (!iter || !*iter) {
     i = FindHeader(0, name);
@@ -445,16 +533,16 @@ bool HttpResponseHeaders::EnumerateHeader(void** iter, const std::string& name,
 
   if (iter)
     *iter = reinterpret_cast<void*>(i + 1);
-  value->assign(parsed_[i].value_begin, parsed_[i].value_end);
+  *value = MakeStringPiece(parsed_[i].value_begin, parsed_[i].value_end);
   return true;
 }
 
-bool HttpResponseHeaders::HasHeaderValue(const std::string& name,
-                                         const std::string& value) const {
+bool HttpResponseHeaders::HasHeaderValue(const base::StringPiece& name,
+                                         const base::StringPiece& value) const {
   // The value has to be an exact match.  This is important since
   // 'cache-control: no-cache' != 'cache-control: no-cache="foo"'
   void* iter = NULL;
-  std::string temp;
+  base::StringPiece temp;
   while (EnumerateHeader(&iter, name, &temp)) {
     if (value.size() == temp.size() &&
         std::equal(temp.begin(), temp.end(), value.begin(),
@@ -585,7 +673,7 @@ void HttpResponseHeaders::ParseStatusLine(
 }
 
 size_t HttpResponseHeaders::FindHeader(size_t from,
-                                       const std::string& search) const {
+                                       const base::StringPiece& search) const {
   for (size_t i = from; i < parsed_.size(); ++i) {
     if (parsed_[i].is_continuation())
       continue;
@@ -609,9 +697,19 @@ void HttpResponseHeaders::AddHeader(std::string::const_iterator name_begin,
       HttpUtil::IsNonCoalescingHeader(name_begin, name_end)) {
     AddToParsed(name_begin, name_end, values_begin, values_end);
   } else {
-    HttpUtil::ValuesIterator it(values_begin, values_end, ',');
-    while (it.GetNext()) {
-      AddToParsed(name_begin, name_end, it.value_begin(), it.value_end());
+    // Split the values like HttpUtil::ValuesIterator would.
+    while (values_begin != values_end) {
+      std::string::const_iterator value_begin = values_begin;
+      std::string::const_iterator value_end =
+          FindValueEnd(values_begin, values_end);
+      values_begin = value_end == values_end ? values_end : value_end + 1;
+
+      // bypass empty values.
+      HttpUtil::TrimLWS(&value_begin, &value_end);
+      if (value_begin == value_end)
+        continue;
+
+      AddToParsed(name_begin, name_end, value_begin, value_end);
       // clobber these so that subsequent values are treated as continuations
       name_begin = name_end = raw_headers_.end();
     }
@@ -701,13 +799,12 @@ void HttpResponseHeaders::GetMimeTypeAndCharset(std::string* mime_type,
   mime_type->clear();
   charset->clear();
 
-  std::string name = "content-type";
   std::string value;
 
   bool had_charset = false;
 
   void* iter = NULL;
-  while (EnumerateHeader(&iter, name, &value))
+  while (EnumerateHeader(&iter, "content-type", &value))
     HttpUtil::ParseContentType(value, mime_type, charset, &had_charset);
 }
 
@@ -924,14 +1021,13 @@ TimeDelta HttpResponseHeaders::GetCurrentAge(const Time& request_time,
 }
 
 bool HttpResponseHeaders::GetMaxAgeValue(TimeDelta* result) const {
-  std::string name = "cache-control";
   std::string value;
 
   const char kMaxAgePrefix[] = "max-age=";
   const size_t kMaxAgePrefixLen = arraysize(kMaxAgePrefix) - 1;
 
   void* iter = NULL;
-  while (EnumerateHeader(&iter, name, &value)) {
+  while (EnumerateHeader(&iter, "cache-control", &value)) {
     if (value.size() > kMaxAgePrefixLen) {
       if (LowerCaseEqualsASCII(value.begin(),
                                value.begin() + kMaxAgePrefixLen,
@@ -967,9 +1063,9 @@ bool HttpResponseHeaders::GetExpiresValue(Time* result) const {
   return GetTimeValuedHeader("Expires", result);
 }
 
-bool HttpResponseHeaders::GetTimeValuedHeader(const std::string& name,
+bool HttpResponseHeaders::GetTimeValuedHeader(const base::StringPiece& name,
                                               Time* result) const {
-  std::string value;
+  base::StringPiece value;
   if (!EnumerateHeader(NULL, name, &value))
     return false;
 
@@ -984,7 +1080,7 @@ bool HttpResponseHeaders::IsKeepAlive() const {
   // NOTE: It is perhaps risky to assume that a Proxy-Connection header is
   // meaningful when we don't know that this response was from a proxy, but
   // Mozilla also does this, so we'll do the same.
-  std::string connection_val;
+  base::StringPiece connection_val;
   if (!EnumerateHeader(NULL, "connection", &connection_val))
     EnumerateHeader(NULL, "proxy-connection", &connection_val);
 
@@ -992,10 +1088,12 @@ bool HttpResponseHeaders::IsKeepAlive() const {
 
   if (http_version_ == HttpVersion(1, 0)) {
     // HTTP/1.0 responses default to NOT keep-alive
-    keep_alive = LowerCaseEqualsASCII(connection_val, "keep-alive");
+    keep_alive = LowerCaseEqualsASCII(connection_val.begin(),
+                                      connection_val.end(), "keep-alive");
   } else {
     // HTTP/1.1 responses default to keep-alive
-    keep_alive = !LowerCaseEqualsASCII(connection_val, "close");
+    keep_alive = !LowerCaseEqualsASCII(connection_val.begin(),
+                                       connection_val.end(), "close");
   }
 
   return keep_alive;
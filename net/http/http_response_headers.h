@@ -11,6 +11,7 @@
 #include "base/basictypes.h"
 #include "base/hash_tables.h"
 #include "base/ref_counted.h"
+#include "base/string_piece.h"
 #include "net/http/http_version.h"
 
 class Pickle;
@@ -109,7 +110,8 @@ class HttpResponseHeaders
   //
   // TODO(darin): remove this method
   //
-  bool GetNormalizedHeader(const std::string& name, std::string* value) const;
+  bool GetNormalizedHeader(const base::StringPiece& name,
+                           std::string* value) const;
 
   // Returns the normalized status line.  For HTTP/0.9 responses (i.e.,
   // responses that lack a status line), this is the manufactured string
@@ -141,18 +143,31 @@ class HttpResponseHeaders
                             std::string* name,
                             std::string* value) const;
 
+  // Same as above, but the out-params point into raw_headers() instead of
+  // being copied.  They are valid as long as this object is not modified.
+  bool EnumerateHeaderLines(void** iter,
+                            base::StringPiece* name,
+                            base::StringPiece* value) const;
+
   // Enumerate the values of the specified header.   If you are only interested
   // in the first header, then you can pass NULL for the 'iter' parameter.
   // Otherwise, to iterate across all values for the specified header,
   // initialize a 'void*' variable to NULL and pass it by address to
   // EnumerateHeader.  Call EnumerateHeader repeatedly until it returns false.
   bool EnumerateHeader(void** iter,
-                       const std::string& name,
+                       const base::StringPiece& name,
                        std::string* value) const;
 
+  // Same as above, but |value| points into raw_headers() instead of being
+  // copied.  It is valid as long as this object is not modified.
+  bool EnumerateHeader(void** iter,
+                       const base::StringPiece& name,
+                       base::StringPiece* value) const;
+
   // Returns true if the response contains the specified header-value pair.
   // Both name and value are compared case insensitively.
-  bool HasHeaderValue(const std::string& name, const std::string& value) const;
+  bool HasHeaderValue(const base::StringPiece& name,
+                      const base::StringPiece& value) const;
 
   // Get the mime type and charset values in lower case form from the headers.
   // Empty strings are returned if the values are not present.
@@ -206,7 +221,8 @@ class HttpResponseHeaders
 
   // Extracts the time value of a particular header.  This method looks for the
   // first matching header value and parses its value as a HTTP-date.
-  bool GetTimeValuedHeader(const std::string& name, base::Time* result) const;
+  bool GetTimeValuedHeader(const base::StringPiece& name,
+                           base::Time* result) const;
 
   // Determines if this response indicates a keep-alive connection.
   bool IsKeepAlive() const;
@@ -269,7 +285,7 @@ class HttpResponseHeaders
 
   // Find the header in our list (case-insensitive) starting with parsed_ at
   // index |from|.  Returns string::npos if not found.
-  size_t FindHeader(size_t from, const std::string& name) const;
+  size_t FindHeader(size_t from, const base::StringPiece& name) const;
 
   // Add a header->value pair to our list.  If we already have header in our
   // list, append the value to it.
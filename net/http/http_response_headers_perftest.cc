@@ -0,0 +1,147 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "base/perftimer.h"
+#include "base/pickle.h"
+#include "base/ref_counted.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "net/base/scoped_allocation_counter.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Response header blocks, as received from the network.
+const char* const kResponses[] = {
+  // A dynamic page.
+  "HTTP/1.1 200 OK\r\n"
+  "Date: Mon, 19 Oct 2009 18:42:03 GMT\r\n"
+  "Expires: -1\r\n"
+  "Cache-Control: private, max-age=0\r\n"
+  "Content-Type: text/html; charset=UTF-8\r\n"
+  "Set-Cookie: PREF=ID=5c2b6b4ec0b5b86d:TM=1255977723:LM=1255977723:S=x; "
+  "expires=Wed, 19-Oct-2011 18:42:03 GMT; path=/; domain=.example.com\r\n"
+  "Server: gws\r\n"
+  "Transfer-Encoding: chunked\r\n"
+  "\r\n",
+
+  // A static resource.
+  "HTTP/1.1 200 OK\r\n"
+  "Date: Mon, 19 Oct 2009 18:42:03 GMT\r\n"
+  "Server: Apache/2.2.3 (Red Hat)\r\n"
+  "Last-Modified: Tue, 15 Sep 2009 21:12:43 GMT\r\n"
+  "ETag: \"6e0a3-1a2b-473a3f6a2e4c0\"\r\n"
+  "Accept-Ranges: bytes\r\n"
+  "Content-Length: 6699\r\n"
+  "Cache-Control: public, max-age=31536000\r\n"
+  "Expires: Tue, 19 Oct 2010 18:42:03 GMT\r\n"
+  "Vary: Accept-Encoding\r\n"
+  "Keep-Alive: timeout=15, max=100\r\n"
+  "Connection: Keep-Alive\r\n"
+  "Content-Type: image/png\r\n"
+  "\r\n",
+
+  // A revalidation.
+  "HTTP/1.1 304 Not Modified\r\n"
+  "Date: Mon, 19 Oct 2009 18:42:04 GMT\r\n"
+  "Server: Apache\r\n"
+  "Connection: close\r\n"
+  "ETag: \"1a2b3c\"\r\n"
+  "Cache-Control: max-age=3600, must-revalidate\r\n"
+  "\r\n",
+};
+
+// The number of responses parsed by each test.
+const int kNumIterations = 20000;
+
+// Returns a large header block, with many cookies and continuation lines.
+std::string MakeLargeResponse() {
+  std::string response = "HTTP/1.1 200 OK\r\n";
+  for (int i = 0; i < 50; ++i) {
+    response.append(StringPrintf(
+        "Set-Cookie: cookie%d=value%d; path=/; domain=.example.com\r\n", i, i));
+    response.append(StringPrintf(
+        "X-Header-%d: first part,\r\n second part, \"quoted, value\"\r\n", i));
+  }
+  response.append("Content-Type: text/html\r\n\r\n");
+  return response;
+}
+
+// Parses |response| the way HttpStreamParser does, then reads the headers
+// that the network stack and the cache look at.
+void ParseAndInspect(const std::string& response) {
+  scoped_refptr<net::HttpResponseHeaders> headers =
+      new net::HttpResponseHeaders(
+          net::HttpUtil::AssembleRawHeaders(response.data(), response.size()));
+
+  std::string mime_type;
+  std::string charset;
+  headers->GetMimeTypeAndCharset(&mime_type, &charset);
+  headers->GetContentLength();
+  headers->IsKeepAlive();
+  base::Time now = base::Time::Now();
+  headers->RequiresValidation(now, now, now);
+}
+
+// Runs ParseAndInspect() on |responses| round robin, and logs the time and
+// the number of allocations per response as |test_name|.
+void RunParseTest(const char* test_name,
+                  const std::vector<std::string>& responses) {
+  std::string allocations_name = std::string(test_name) + "_allocations";
+
+  net::ScopedAllocationCounter counter;
+  PerfTimeLogger timer(test_name);
+  for (int i = 0; i < kNumIterations; ++i)
+    ParseAndInspect(responses[i % responses.size()]);
+  timer.Done();
+
+  LogPerfResult(allocations_name.c_str(),
+                static_cast<double>(counter.allocations()) / kNumIterations,
+                "allocations/response");
+}
+
+}  // namespace
+
+TEST(HttpResponseHeadersPerfTest, ParseTypicalResponses) {
+  std::vector<std::string> responses(kResponses,
+                                     kResponses + arraysize(kResponses));
+  RunParseTest("HttpResponseHeaders_parse_typical", responses);
+}
+
+TEST(HttpResponseHeadersPerfTest, ParseLargeResponses) {
+  std::vector<std::string> responses(1, MakeLargeResponse());
+  RunParseTest("HttpResponseHeaders_parse_large", responses);
+}
+
+// Measures the round trip through the cache's Pickle format.
+TEST(HttpResponseHeadersPerfTest, PersistAndRestore) {
+  scoped_refptr<net::HttpResponseHeaders> headers =
+      new net::HttpResponseHeaders(net::HttpUtil::AssembleRawHeaders(
+          kResponses[1], strlen(kResponses[1])));
+
+  net::ScopedAllocationCounter counter;
+  PerfTimeLogger timer("HttpResponseHeaders_persist_and_restore");
+  for (int i = 0; i < kNumIterations; ++i) {
+    Pickle pickle;
+    headers->Persist(&pickle,
+                     net::HttpResponseHeaders::PERSIST_SANS_NON_CACHEABLE |
+                     net::HttpResponseHeaders::PERSIST_SANS_COOKIES);
+    void* iter = NULL;
+    scoped_refptr<net::HttpResponseHeaders> restored =
+        new net::HttpResponseHeaders(pickle, &iter);
+    EXPECT_EQ(200, restored->response_code());
+  }
+  timer.Done();
+
+  LogPerfResult("HttpResponseHeaders_persist_and_restore_allocations",
+                static_cast<double>(counter.allocations()) / kNumIterations,
+                "allocations/response");
+}
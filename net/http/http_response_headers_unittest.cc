@@ -485,6 +485,58 @@ TEST(HttpResponseHeadersTest, EnumerateHeader_Coalesced) {
   EXPECT_FALSE(parsed->EnumerateHeader(&iter, "cache-control", &value));
 }
 
+TEST(HttpResponseHeadersTest, EnumerateHeader_QuotedAndEmptyValues) {
+  // Escaped quotes do not end a quoted string, and empty values are skipped.
+  std::string headers =
+    "HTTP/1.1 200 OK\n"
+    "Foo: , 'a,b' ,, \"c\\\",d\", \n"
+    "Bar: ,\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed = new HttpResponseHeaders(headers);
+
+  void* iter = NULL;
+  std::string value;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "foo", &value));
+  EXPECT_EQ("'a,b'", value);
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "foo", &value));
+  EXPECT_EQ("\"c\\\",d\"", value);
+  EXPECT_FALSE(parsed->EnumerateHeader(&iter, "foo", &value));
+  EXPECT_FALSE(parsed->EnumerateHeader(NULL, "bar", &value));
+}
+
+TEST(HttpResponseHeadersTest, EnumerateHeader_StringPiece) {
+  std::string headers =
+    "HTTP/1.1 200 OK\n"
+    "Cache-Control: private, max-age=10\n"
+    "Content-Type: text/html\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<HttpResponseHeaders> parsed = new HttpResponseHeaders(headers);
+
+  // The values point into raw_headers().
+  const std::string& raw = parsed->raw_headers();
+  void* iter = NULL;
+  base::StringPiece value;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "CACHE-CONTROL", &value));
+  EXPECT_EQ("private", value.as_string());
+  EXPECT_TRUE(value.data() >= raw.data() &&
+              value.data() + value.size() <= raw.data() + raw.size());
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "CACHE-CONTROL", &value));
+  EXPECT_EQ("max-age=10", value.as_string());
+  EXPECT_FALSE(parsed->EnumerateHeader(&iter, "CACHE-CONTROL", &value));
+  EXPECT_TRUE(value.empty());
+
+  // The continuations of a header line are returned as a whole.
+  base::StringPiece name;
+  iter = NULL;
+  EXPECT_TRUE(parsed->EnumerateHeaderLines(&iter, &name, &value));
+  EXPECT_EQ("Cache-Control", name.as_string());
+  EXPECT_EQ("private, max-age=10", value.as_string());
+  EXPECT_TRUE(parsed->EnumerateHeaderLines(&iter, &name, &value));
+  EXPECT_EQ("Content-Type", name.as_string());
+  EXPECT_EQ("text/html", value.as_string());
+  EXPECT_FALSE(parsed->EnumerateHeaderLines(&iter, &name, &value));
+}
+
 TEST(HttpResponseHeadersTest, EnumerateHeader_Challenge) {
   // Even though WWW-Authenticate has commas, it should not be treated as
   // coalesced values.
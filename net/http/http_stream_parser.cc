@@ -4,6 +4,8 @@
 
 #include "net/http/http_stream_parser.h"
 
+#include <algorithm>
+
 #include "base/compiler_specific.h"
 #include "base/trace_event.h"
 #include "net/base/io_buffer.h"
@@ -23,6 +25,7 @@ HttpStreamParser::HttpStreamParser(ClientSocketHandle* connection,
       read_buf_(read_buffer),
       read_buf_unused_offset_(0),
       response_header_start_offset_(-1),
+      response_header_scan_offset_(0),
       response_body_length_(-1),
       response_body_read_(0),
       chunked_decoder_(NULL),
@@ -300,6 +303,7 @@ int HttpStreamParser::DoReadHeadersComplete(int result) {
       // tunnel.
       io_state_ = STATE_REQUEST_SENT;
       response_header_start_offset_ = -1;
+      response_header_scan_offset_ = 0;
     } else {
       io_state_ = STATE_BODY_PENDING;
       CalculateResponseBodySize();
@@ -433,10 +437,19 @@ int HttpStreamParser::ParseResponseHeaders() {
   }
 
   if (response_header_start_offset_ >= 0) {
+    // Resume the search where the previous read left it.  The end of the
+    // headers is at most 3 bytes long ("\n\r\n"), so it can start up to 2
+    // bytes before the new data.
+    int scan_offset = std::max(response_header_start_offset_,
+                               response_header_scan_offset_ - 2);
     end_offset = HttpUtil::LocateEndOfHeaders(
         read_buf_->StartOfBuffer() + read_buf_unused_offset_,
         read_buf_->offset() - read_buf_unused_offset_,
-        response_header_start_offset_);
+        scan_offset);
+    if (end_offset == -1) {
+      response_header_scan_offset_ =
+          read_buf_->offset() - read_buf_unused_offset_;
+    }
   } else if (read_buf_->offset() - read_buf_unused_offset_ >= 8) {
     // Enough data to decide that this is an HTTP/0.9 response.
     // 8 bytes = (4 bytes of junk) + "http".length()
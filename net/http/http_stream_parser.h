@@ -131,6 +131,10 @@ class HttpStreamParser {
   // -1 if not found yet.
   int response_header_start_offset_;
 
+  // The amount beyond |read_buf_unused_offset_| that was already searched for
+  // the end of the headers, so that each read only scans the new bytes.
+  int response_header_scan_offset_;
+
   // The parsed response headers.  Owned by the caller.
   HttpResponseInfo* response_;
 
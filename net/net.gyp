@@ -48,6 +48,12 @@
         'base/data_url.h',
         'base/directory_lister.cc',
         'base/directory_lister.h',
+        'base/dns_client.h',
+        'base/dns_client_posix.cc',
+        'base/dns_config.h',
+        'base/dns_config_posix.cc',
+        'base/dns_message.cc',
+        'base/dns_message.h',
         'base/dns_util.cc',
         'base/dns_util.h',
         'base/escape.cc',
@@ -245,6 +251,10 @@
         'disk_cache/errors.h',
         'disk_cache/eviction.cc',
         'disk_cache/eviction.h',
+        'disk_cache/eviction_policy.cc',
+        'disk_cache/eviction_policy.h',
+        'disk_cache/extent_map.cc',
+        'disk_cache/extent_map.h',
         'disk_cache/file.h',
         'disk_cache/file_block.h',
         'disk_cache/file_lock.cc',
@@ -254,6 +264,8 @@
         'disk_cache/hash.cc',
         'disk_cache/hash.h',
         'disk_cache/histogram_macros.h',
+        'disk_cache/journal.cc',
+        'disk_cache/journal.h',
         'disk_cache/mapped_file.h',
         'disk_cache/mapped_file_posix.cc',
         'disk_cache/mapped_file_win.cc',
@@ -273,6 +285,8 @@
         'disk_cache/stats_histogram.h',
         'disk_cache/storage_block-inl.h',
         'disk_cache/storage_block.h',
+        'disk_cache/threaded_backend.cc',
+        'disk_cache/threaded_backend.h',
         'disk_cache/trace.cc',
         'disk_cache/trace.h',
         'flip/flip_bitmasks.h',
@@ -292,6 +306,8 @@
         'flip/flip_stream.cc',
         'flip/flip_stream.h',
         'flip/flip_transaction_factory.h',
+        'flip/flip_write_queue.cc',
+        'flip/flip_write_queue.h',
         'ftp/ftp_auth_cache.cc',
         'ftp/ftp_auth_cache.h',
         'ftp/ftp_ctrl_response_buffer.cc',
@@ -348,6 +364,8 @@
         'http/http_byte_range.h',
         'http/http_cache.cc',
         'http/http_cache.h',
+        'http/http_cache_trace.cc',
+        'http/http_cache_trace.h',
         'http/http_cache_transaction.cc',
         'http/http_cache_transaction.h',
         'http/http_chunked_decoder.cc',
@@ -382,6 +400,8 @@
         'ocsp/nss_ocsp.h',
         'proxy/init_proxy_resolver.cc',
         'proxy/init_proxy_resolver.h',
+        'proxy/multi_threaded_proxy_resolver.cc',
+        'proxy/multi_threaded_proxy_resolver.h',
         'proxy/proxy_config.cc',
         'proxy/proxy_config.h',
         'proxy/proxy_config_service.h',
@@ -585,6 +605,9 @@
         'base/cookie_policy_unittest.cc',
         'base/data_url_unittest.cc',
         'base/directory_lister_unittest.cc',
+        'base/dns_client_posix_unittest.cc',
+        'base/dns_config_posix_unittest.cc',
+        'base/dns_message_unittest.cc',
         'base/dns_util_unittest.cc',
         'base/escape_unittest.cc',
         'base/file_stream_unittest.cc',
@@ -621,6 +644,8 @@
         'disk_cache/disk_cache_test_base.cc',
         'disk_cache/disk_cache_test_base.h',
         'disk_cache/entry_unittest.cc',
+        'disk_cache/eviction_policy_unittest.cc',
+        'disk_cache/extent_map_unittest.cc',
         'disk_cache/mapped_file_unittest.cc',
         'disk_cache/storage_block_unittest.cc',
         'ftp/ftp_auth_cache_unittest.cc',
@@ -656,6 +681,7 @@
         'http/http_vary_data_unittest.cc',
         'proxy/init_proxy_resolver_unittest.cc',
         'proxy/mock_proxy_resolver.h',
+        'proxy/multi_threaded_proxy_resolver_unittest.cc',
         'proxy/proxy_config_service_linux_unittest.cc',
         'proxy/proxy_config_service_win_unittest.cc',
         'proxy/proxy_config_unittest.cc',
@@ -740,7 +766,12 @@
       'msvs_guid': 'AAC78796-B9A2-4CD9-BF89-09B03E92BF73',
       'sources': [
         'base/cookie_monster_perftest.cc',
+        'base/scoped_allocation_counter.cc',
+        'base/scoped_allocation_counter.h',
         'disk_cache/disk_cache_perftest.cc',
+        'flip/flip_framer_perftest.cc',
+        'flip/flip_write_queue_perftest.cc',
+        'http/http_response_headers_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
       ],
       'conditions': [
@@ -792,6 +823,28 @@
         'tools/crash_cache/crash_cache.cc',
       ],
     },
+    {
+      'target_name': 'cache_replay',
+      'type': 'executable',
+      'dependencies': [
+        'net',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/cache_replay/cache_replay.cc',
+      ],
+    },
+    {
+      'target_name': 'eviction_replay',
+      'type': 'executable',
+      'dependencies': [
+        'net',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/eviction_replay/eviction_replay.cc',
+      ],
+    },
     {
       'target_name': 'net_test_support',
       'type': '<(library)',
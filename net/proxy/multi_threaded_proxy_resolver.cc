@@ -0,0 +1,501 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/proxy/multi_threaded_proxy_resolver.h"
+
+#include <algorithm>
+
+#include "base/message_loop.h"
+#include "base/string_util.h"
+#include "base/thread.h"
+#include "net/base/load_log.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+// The results cache is cleared when it grows past this many entries (after
+// dropping the expired ones).
+const size_t kMaxResultCacheEntries = 500;
+
+}  // namespace
+
+// MultiThreadedProxyResolver::Job --------------------------------------------
+
+// A request that runs on the worker thread of an Executor, and then completes
+// on the origin thread.
+class MultiThreadedProxyResolver::Job
+    : public base::RefCountedThreadSafe<MultiThreadedProxyResolver::Job> {
+ public:
+  explicit Job(CompletionCallback* callback)
+      : callback_(callback),
+        origin_loop_(MessageLoop::current()) {
+    DCHECK(callback);
+  }
+
+  // Called by |executor| when it starts running this job.
+  void set_executor(Executor* executor) { executor_ = executor; }
+
+  bool is_started() const { return executor_ != NULL; }
+
+  virtual void Cancel() {
+    // Clear this to inform OnJobCompleted that it should not try to run the
+    // callback.
+    callback_ = NULL;
+  }
+
+  // Returns true if Cancel() has been called.
+  bool was_cancelled() const { return callback_ == NULL; }
+
+  // Runs on the worker thread, with the resolver of the executor.
+  void RunOnWorkerThread(ProxyResolver* resolver) {
+    int rv = Run(resolver);
+    DCHECK_NE(rv, ERR_IO_PENDING);
+    origin_loop_->PostTask(FROM_HERE,
+        NewRunnableMethod(this, &Job::OnJobCompleted, rv));
+  }
+
+ protected:
+  friend class base::RefCountedThreadSafe<MultiThreadedProxyResolver::Job>;
+
+  virtual ~Job() {}
+
+  // Runs the request synchronously on the worker thread.
+  virtual int Run(ProxyResolver* resolver) = 0;
+
+  // Completes the (non-cancelled) request on the origin thread.
+  virtual void Complete(int result_code) = 0;
+
+  CompletionCallback* callback() const { return callback_; }
+
+ private:
+  // Runs on the origin thread. Defined after Executor.
+  void OnJobCompleted(int result_code);
+
+  CompletionCallback* callback_;
+  scoped_refptr<Executor> executor_;
+
+  // Usable from within RunOnWorkerThread on the worker thread.
+  MessageLoop* origin_loop_;
+};
+
+// MultiThreadedProxyResolver::SetPacScriptJob --------------------------------
+
+// Loads the PAC script into the resolver of the first executor, on behalf of
+// MultiThreadedProxyResolver::SetPacScript. It does not occupy the executor:
+// it runs on the worker thread after the job that the executor is running.
+class MultiThreadedProxyResolver::SetPacScriptJob
+    : public MultiThreadedProxyResolver::Job {
+ public:
+  SetPacScriptJob(MultiThreadedProxyResolver* coordinator,
+                  const GURL& pac_url,
+                  const std::string& pac_bytes,
+                  CompletionCallback* callback)
+      : Job(callback),
+        coordinator_(coordinator),
+        pac_url_(pac_url),
+        pac_bytes_(pac_bytes) {
+  }
+
+  virtual void Cancel() {
+    coordinator_ = NULL;
+    Job::Cancel();
+  }
+
+ private:
+  virtual int Run(ProxyResolver* resolver) {
+    return resolver->expects_pac_bytes() ?
+        resolver->SetPacScriptByData(pac_bytes_, NULL) :
+        resolver->SetPacScriptByUrl(pac_url_, NULL);
+  }
+
+  virtual void Complete(int result_code) {
+    CompletionCallback* callback = this->callback();
+    DCHECK_EQ(this, coordinator_->outstanding_set_pac_script_job_.get());
+    coordinator_->outstanding_set_pac_script_job_ = NULL;
+    callback->Run(result_code);
+  }
+
+  // Must only be used on the "origin" thread.
+  MultiThreadedProxyResolver* coordinator_;
+
+  const GURL pac_url_;
+  const std::string pac_bytes_;
+};
+
+// MultiThreadedProxyResolver::GetProxyForURLJob ------------------------------
+
+class MultiThreadedProxyResolver::GetProxyForURLJob
+    : public MultiThreadedProxyResolver::Job {
+ public:
+  // |coordinator| -- the MultiThreadedProxyResolver that owns this job.
+  // |url|         -- the URL of the query.
+  // |results|     -- the structure to fill with proxy resolve results.
+  GetProxyForURLJob(MultiThreadedProxyResolver* coordinator,
+                    const GURL& url,
+                    ProxyInfo* results,
+                    CompletionCallback* callback,
+                    LoadLog* load_log)
+      : Job(callback),
+        coordinator_(coordinator),
+        results_(results),
+        load_log_(load_log),
+        pac_script_id_(coordinator->pac_script_id_),
+        load_log_bound_(load_log ? load_log->max_num_entries() : 0),
+        url_(url) {
+  }
+
+  virtual void Cancel() {
+    // Clear these to inform Complete that it should not try to access them.
+    coordinator_ = NULL;
+    results_ = NULL;
+    Job::Cancel();
+  }
+
+ private:
+  virtual int Run(ProxyResolver* resolver) {
+    if (load_log_bound_ > 0)
+      worker_log_ = new LoadLog(load_log_bound_);
+    return resolver->GetProxyForURL(url_, &results_buf_, NULL, NULL,
+                                    worker_log_);
+  }
+
+  virtual void Complete(int result_code) {
+    // Merge the load log that was generated on the worker thread, into the
+    // main log.
+    if (worker_log_ && load_log_)
+      load_log_->Append(worker_log_);
+
+    // The script may have changed while the job was waiting or running.
+    if (result_code == OK && pac_script_id_ == coordinator_->pac_script_id_)
+      coordinator_->AddToResultCache(url_, results_buf_);
+    if (result_code >= OK)  // Note: unit-tests use values > 0.
+      results_->Use(results_buf_);
+    callback()->Run(result_code);
+  }
+
+  // Must only be used on the "origin" thread.
+  MultiThreadedProxyResolver* coordinator_;
+  ProxyInfo* results_;
+  scoped_refptr<LoadLog> load_log_;
+  const int pac_script_id_;
+
+  // Usable from within Run on the worker thread.
+  const size_t load_log_bound_;
+  const GURL url_;
+  ProxyInfo results_buf_;
+  scoped_refptr<LoadLog> worker_log_;
+};
+
+// MultiThreadedProxyResolver::Executor ---------------------------------------
+
+// A worker thread with its own synchronous ProxyResolver. It runs one job at
+// a time.
+class MultiThreadedProxyResolver::Executor
+    : public base::RefCountedThreadSafe<MultiThreadedProxyResolver::Executor> {
+ public:
+  // |coordinator| -- the MultiThreadedProxyResolver that owns this executor.
+  // |resolver|    -- the synchronous resolver to run (takes ownership).
+  Executor(MultiThreadedProxyResolver* coordinator,
+           ProxyResolver* resolver,
+           int thread_number)
+      : coordinator_(coordinator),
+        resolver_(resolver),
+        thread_(new base::Thread(
+            StringPrintf("pac-thread-%d", thread_number).c_str())) {
+    thread_->Start();
+  }
+
+  // Loads the PAC script on the worker thread, after the outstanding job and
+  // before the next one. There is nobody to tell about failures: the jobs
+  // will fail too.
+  void LoadPacScript(const GURL& pac_url, const std::string& pac_bytes) {
+    thread_->message_loop()->PostTask(FROM_HERE, NewRunnableMethod(
+        this, &Executor::LoadPacScriptOnWorkerThread, pac_url, pac_bytes));
+  }
+
+  // Same as LoadPacScript(), but |job| loads the script and reports the
+  // result. The executor stays available for other jobs.
+  void StartSetPacScriptJob(Job* job) {
+    job->set_executor(this);
+    thread_->message_loop()->PostTask(FROM_HERE, NewRunnableMethod(
+        job, &Job::RunOnWorkerThread, resolver_.get()));
+  }
+
+  void StartJob(Job* job) {
+    DCHECK(!outstanding_job_);
+    outstanding_job_ = job;
+    job->set_executor(this);
+    thread_->message_loop()->PostTask(FROM_HERE, NewRunnableMethod(
+        job, &Job::RunOnWorkerThread, resolver_.get()));
+  }
+
+  // Called on the origin thread when |job| has completed.
+  void OnJobCompleted(Job* job) {
+    if (!coordinator_)
+      return;  // Destroy() was called.
+    if (job != outstanding_job_.get())
+      return;  // |job| was started by StartSetPacScriptJob().
+    outstanding_job_ = NULL;
+    coordinator_->DispatchPendingJobs();
+  }
+
+  void PurgeMemory() {
+    thread_->message_loop()->PostTask(FROM_HERE, NewRunnableMethod(
+        this, &Executor::PurgeMemoryOnWorkerThread));
+  }
+
+  // Cancels the outstanding job, and stops the worker thread. This blocks
+  // until the job returns, so it must only be called on destruction.
+  void Destroy() {
+    if (outstanding_job_) {
+      outstanding_job_->Cancel();
+      outstanding_job_ = NULL;
+    }
+    coordinator_ = NULL;
+
+    // Note that |thread_| is stopped before |resolver_| is destroyed. This is
+    // important since |resolver_| could be running on |thread_|.
+    thread_.reset();
+    resolver_.reset();
+  }
+
+  Job* outstanding_job() const { return outstanding_job_.get(); }
+
+ private:
+  friend class base::RefCountedThreadSafe<
+      MultiThreadedProxyResolver::Executor>;
+
+  ~Executor() {
+    DCHECK(!coordinator_) << "Destroy() was not called";
+  }
+
+  void LoadPacScriptOnWorkerThread(const GURL& pac_url,
+                                   const std::string& pac_bytes) {
+    if (resolver_->expects_pac_bytes())
+      resolver_->SetPacScriptByData(pac_bytes, NULL);
+    else
+      resolver_->SetPacScriptByUrl(pac_url, NULL);
+  }
+
+  void PurgeMemoryOnWorkerThread() {
+    resolver_->PurgeMemory();
+  }
+
+  // Must only be used on the "origin" thread.
+  MultiThreadedProxyResolver* coordinator_;
+  scoped_refptr<Job> outstanding_job_;
+
+  scoped_ptr<ProxyResolver> resolver_;
+  scoped_ptr<base::Thread> thread_;
+};
+
+void MultiThreadedProxyResolver::Job::OnJobCompleted(int result_code) {
+  // Free the executor first, so that it can take the next pending job.
+  executor_->OnJobCompleted(this);
+
+  // The job may have been cancelled after it was started.
+  if (!was_cancelled())
+    Complete(result_code);
+}
+
+// MultiThreadedProxyResolver -------------------------------------------------
+
+MultiThreadedProxyResolver::MultiThreadedProxyResolver(
+    ProxyResolverFactory* resolver_factory,
+    size_t max_num_threads)
+    : ProxyResolver(resolver_factory->expects_pac_bytes()),
+      resolver_factory_(resolver_factory),
+      max_num_threads_(max_num_threads),
+      has_pac_script_(false),
+      pac_script_id_(0) {
+  DCHECK_GE(max_num_threads, 1u);
+}
+
+MultiThreadedProxyResolver::~MultiThreadedProxyResolver() {
+  // Cancel the jobs that did not start yet. The outstanding ones are
+  // cancelled by their executor.
+  for (PendingJobsQueue::iterator it = pending_jobs_.begin();
+       it != pending_jobs_.end();
+       ++it) {
+    (*it)->Cancel();
+  }
+  pending_jobs_.clear();
+
+  if (outstanding_set_pac_script_job_)
+    outstanding_set_pac_script_job_->Cancel();
+
+  ReleaseAllExecutors();
+}
+
+int MultiThreadedProxyResolver::GetProxyForURL(const GURL& url,
+                                               ProxyInfo* results,
+                                               CompletionCallback* callback,
+                                               RequestHandle* request,
+                                               LoadLog* load_log) {
+  DCHECK(callback);
+
+  if (LookupResultCache(url, results))
+    return OK;
+
+  scoped_refptr<Job> job =
+      new GetProxyForURLJob(this, url, results, callback, load_log);
+  pending_jobs_.push_back(job);
+  DispatchPendingJobs();  // Jobs can never finish synchronously.
+
+  // Completion will be notified through |callback|, unless the caller cancels
+  // the request using |request|.
+  if (request)
+    *request = reinterpret_cast<RequestHandle>(job.get());
+
+  return ERR_IO_PENDING;
+}
+
+// There are three states of the request we need to handle:
+// (1) Not started (just sitting in |pending_jobs_|).
+// (2) Running on the worker thread of an executor.
+// (3) Waiting for Job::OnJobCompleted to be run on the origin thread.
+// In the last two cases the executor stays busy until the job completes.
+void MultiThreadedProxyResolver::CancelRequest(RequestHandle req) {
+  DCHECK(req);
+
+  Job* job = reinterpret_cast<Job*>(req);
+  job->Cancel();
+
+  if (!job->is_started()) {
+    PendingJobsQueue::iterator it = std::find(
+        pending_jobs_.begin(), pending_jobs_.end(), job);
+    DCHECK(it != pending_jobs_.end());
+    pending_jobs_.erase(it);
+  }
+}
+
+void MultiThreadedProxyResolver::CancelSetPacScript() {
+  DCHECK(outstanding_set_pac_script_job_);
+  outstanding_set_pac_script_job_->Cancel();
+  outstanding_set_pac_script_job_ = NULL;
+}
+
+void MultiThreadedProxyResolver::PurgeMemory() {
+  result_cache_.clear();
+  for (ExecutorList::iterator it = executors_.begin();
+       it != executors_.end(); ++it) {
+    (*it)->PurgeMemory();
+  }
+}
+
+int MultiThreadedProxyResolver::SetPacScript(
+    const GURL& pac_url,
+    const std::string& pac_bytes,
+    CompletionCallback* callback) {
+  DCHECK(!outstanding_set_pac_script_job_);
+
+  result_cache_.clear();
+  ++pac_script_id_;
+
+  has_pac_script_ = true;
+  pac_url_ = pac_url;
+  pac_bytes_ = pac_bytes;
+
+  // The worker threads are kept: the running jobs may be blocked on this
+  // thread (e.g. resolving a host for the script), so they can't be joined.
+  // Instead every executor loads the new script once its current job is done,
+  // and the first one reports the result. New executors load it on start.
+  if (executors_.empty())
+    AddNewExecutor(false);
+  for (size_t i = 1; i < executors_.size(); ++i)
+    executors_[i]->LoadPacScript(pac_url, pac_bytes);
+
+  outstanding_set_pac_script_job_ =
+      new SetPacScriptJob(this, pac_url, pac_bytes, callback);
+  executors_[0]->StartSetPacScriptJob(outstanding_set_pac_script_job_);
+  return ERR_IO_PENDING;
+}
+
+MultiThreadedProxyResolver::Executor*
+MultiThreadedProxyResolver::AddNewExecutor(bool load_script) {
+  DCHECK_LT(executors_.size(), max_num_threads_);
+  Executor* executor = new Executor(
+      this, resolver_factory_->CreateProxyResolver(), executors_.size());
+  executors_.push_back(executor);
+  if (load_script && has_pac_script_)
+    executor->LoadPacScript(pac_url_, pac_bytes_);
+  return executor;
+}
+
+MultiThreadedProxyResolver::Executor*
+MultiThreadedProxyResolver::FindIdleExecutor() {
+  for (ExecutorList::iterator it = executors_.begin();
+       it != executors_.end(); ++it) {
+    if (!(*it)->outstanding_job())
+      return *it;
+  }
+  return NULL;
+}
+
+void MultiThreadedProxyResolver::ReleaseAllExecutors() {
+  for (ExecutorList::iterator it = executors_.begin();
+       it != executors_.end(); ++it) {
+    (*it)->Destroy();
+  }
+  executors_.clear();
+}
+
+void MultiThreadedProxyResolver::DispatchPendingJobs() {
+  while (!pending_jobs_.empty()) {
+    Executor* executor = FindIdleExecutor();
+    if (!executor) {
+      if (executors_.size() == max_num_threads_)
+        return;  // The jobs wait for the next executor to become idle.
+      executor = AddNewExecutor(true);
+    }
+
+    // Start the next job (FIFO).
+    scoped_refptr<Job> job = pending_jobs_.front();
+    pending_jobs_.pop_front();
+    executor->StartJob(job);
+  }
+}
+
+bool MultiThreadedProxyResolver::LookupResultCache(const GURL& url,
+                                                   ProxyInfo* results) {
+  if (result_cache_ttl_ == base::TimeDelta())
+    return false;
+
+  ResultCache::iterator it = result_cache_.find(url.spec());
+  if (it == result_cache_.end())
+    return false;
+  if (base::TimeTicks::Now() >= it->second.expiration) {
+    result_cache_.erase(it);
+    return false;
+  }
+  results->Use(it->second.info);
+  return true;
+}
+
+void MultiThreadedProxyResolver::AddToResultCache(const GURL& url,
+                                                  const ProxyInfo& results) {
+  if (result_cache_ttl_ == base::TimeDelta())
+    return;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  if (result_cache_.size() >= kMaxResultCacheEntries) {
+    for (ResultCache::iterator it = result_cache_.begin();
+         it != result_cache_.end();) {
+      if (now >= it->second.expiration)
+        result_cache_.erase(it++);
+      else
+        ++it;
+    }
+    if (result_cache_.size() >= kMaxResultCacheEntries)
+      result_cache_.clear();
+  }
+
+  CachedResult& entry = result_cache_[url.spec()];
+  entry.info.Use(results);
+  entry.expiration = now + result_cache_ttl_;
+}
+
+}  // namespace net
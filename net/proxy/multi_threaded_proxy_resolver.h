@@ -0,0 +1,148 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_PROXY_MULTI_THREADED_PROXY_RESOLVER_H_
+#define NET_PROXY_MULTI_THREADED_PROXY_RESOLVER_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/time.h"
+#include "net/proxy/proxy_info.h"
+#include "net/proxy/proxy_resolver.h"
+
+namespace net {
+
+// ProxyResolverFactory creates the synchronous ProxyResolvers that are run by
+// MultiThreadedProxyResolver, one per thread.
+class ProxyResolverFactory {
+ public:
+  explicit ProxyResolverFactory(bool expects_pac_bytes)
+      : expects_pac_bytes_(expects_pac_bytes) {}
+
+  virtual ~ProxyResolverFactory() {}
+
+  // Creates a new synchronous ProxyResolver. The caller takes ownership. It is
+  // called on the origin thread, but the resolver is then only used on its
+  // worker thread.
+  virtual ProxyResolver* CreateProxyResolver() = 0;
+
+  // See ProxyResolver::expects_pac_bytes().
+  bool expects_pac_bytes() const { return expects_pac_bytes_; }
+
+ private:
+  const bool expects_pac_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProxyResolverFactory);
+};
+
+// ProxyResolver implementation that runs up to |max_num_threads| synchronous
+// ProxyResolvers (created by a ProxyResolverFactory), each on its own worker
+// thread, and dispatches the requests to the idle ones. If all of them are
+// busy, the requests are queued and serviced in FIFO order.
+//
+// The threads are created on demand, and are only stopped on destruction.
+// SetPacScript() loads the new script into every resolver once its current
+// request (if any) is done; the requests that are still queued run with the
+// new script.
+//
+// The results can also be cached by URL for a while (see
+// set_result_cache_ttl()), so that the same URL is not evaluated again.
+class MultiThreadedProxyResolver : public ProxyResolver {
+ public:
+  // Takes ownership of |resolver_factory|.
+  MultiThreadedProxyResolver(ProxyResolverFactory* resolver_factory,
+                             size_t max_num_threads);
+
+  virtual ~MultiThreadedProxyResolver();
+
+  // ProxyResolver implementation:
+  virtual int GetProxyForURL(const GURL& url,
+                             ProxyInfo* results,
+                             CompletionCallback* callback,
+                             RequestHandle* request,
+                             LoadLog* load_log);
+  virtual void CancelRequest(RequestHandle request);
+  virtual void CancelSetPacScript();
+  virtual void PurgeMemory();
+
+  // The results of GetProxyForURL() are reused for the same URL during
+  // |ttl|. Zero (the default) disables the result cache.
+  void set_result_cache_ttl(base::TimeDelta ttl) { result_cache_ttl_ = ttl; }
+
+  // The number of worker threads that were started so far.
+  size_t num_threads() const { return executors_.size(); }
+
+ private:
+  class Executor;
+  class Job;
+  class SetPacScriptJob;
+  class GetProxyForURLJob;
+  friend class Executor;
+  friend class SetPacScriptJob;
+  friend class GetProxyForURLJob;
+
+  typedef std::vector<scoped_refptr<Executor> > ExecutorList;
+  typedef std::deque<scoped_refptr<Job> > PendingJobsQueue;
+
+  struct CachedResult {
+    ProxyInfo info;
+    base::TimeTicks expiration;
+  };
+  typedef std::map<std::string, CachedResult> ResultCache;
+
+  // ProxyResolver implementation:
+  virtual int SetPacScript(const GURL& pac_url,
+                           const std::string& pac_bytes,
+                           CompletionCallback* callback);
+
+  // Starts a new worker thread, which first loads the current PAC script (if
+  // there is one, and unless |load_script| is false). The new executor is
+  // idle: the jobs that it is given run after the script is loaded.
+  Executor* AddNewExecutor(bool load_script);
+
+  // Returns an idle executor, or NULL.
+  Executor* FindIdleExecutor();
+
+  // Stops all the worker threads, and cancels their outstanding jobs. Only
+  // called on destruction, since it waits for the running jobs to return.
+  void ReleaseAllExecutors();
+
+  // Starts the pending jobs on the idle executors, adding new executors if
+  // there are none left (up to |max_num_threads_|).
+  void DispatchPendingJobs();
+
+  // Looks up / adds the result for |url| in |result_cache_|.
+  bool LookupResultCache(const GURL& url, ProxyInfo* results);
+  void AddToResultCache(const GURL& url, const ProxyInfo& results);
+
+  scoped_ptr<ProxyResolverFactory> resolver_factory_;
+  const size_t max_num_threads_;
+  ExecutorList executors_;
+  PendingJobsQueue pending_jobs_;
+
+  // The PAC script that the resolvers load.
+  bool has_pac_script_;
+  GURL pac_url_;
+  std::string pac_bytes_;
+  scoped_refptr<Job> outstanding_set_pac_script_job_;
+
+  // Incremented by SetPacScript(), so that the results of the jobs that were
+  // queued for an older script are not cached.
+  int pac_script_id_;
+
+  base::TimeDelta result_cache_ttl_;
+  ResultCache result_cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiThreadedProxyResolver);
+};
+
+}  // namespace net
+
+#endif  // NET_PROXY_MULTI_THREADED_PROXY_RESOLVER_H_
@@ -0,0 +1,574 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/proxy/multi_threaded_proxy_resolver.h"
+
+#include <vector>
+
+#include "base/waitable_event.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/load_log.h"
+#include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/proxy/proxy_info.h"
+#include "net/proxy/proxy_resolver_js_bindings.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+namespace {
+
+// A synchronous mock ProxyResolver implementation, which can be set to block
+// upon reaching GetProxyForURL().
+//       - returns a single-item proxy list with the query's host.
+class BlockableProxyResolver : public ProxyResolver {
+ public:
+  BlockableProxyResolver()
+      : ProxyResolver(true /*expects_pac_bytes*/),
+        wrong_loop_(MessageLoop::current()),
+        request_count_(0),
+        purge_count_(0),
+        should_block_(false),
+        unblocked_(true, true),
+        blocked_(true, false) {
+  }
+
+  void Block() {
+    should_block_ = true;
+    unblocked_.Reset();
+  }
+
+  void Unblock() {
+    should_block_ = false;
+    blocked_.Reset();
+    unblocked_.Signal();
+  }
+
+  void WaitUntilBlocked() {
+    blocked_.Wait();
+  }
+
+  // ProxyResolver implementation:
+  virtual int GetProxyForURL(const GURL& query_url,
+                             ProxyInfo* results,
+                             CompletionCallback* callback,
+                             RequestHandle* request,
+                             LoadLog* load_log) {
+    if (should_block_) {
+      blocked_.Signal();
+      unblocked_.Wait();
+    }
+
+    CheckIsOnWorkerThread();
+
+    EXPECT_TRUE(callback == NULL);
+    EXPECT_TRUE(request == NULL);
+
+    // Write something into |load_log| (doesn't really have any meaning.)
+    LoadLog::BeginEvent(load_log, LoadLog::TYPE_PROXY_RESOLVER_V8_DNS_RESOLVE);
+
+    results->UseNamedProxy(query_url.host());
+
+    // Return a success code which represents the request's order on this
+    // resolver.
+    return request_count_++;
+  }
+
+  virtual void CancelRequest(RequestHandle request) {
+    NOTREACHED();
+  }
+
+  virtual int SetPacScript(const GURL& pac_url,
+                           const std::string& bytes,
+                           CompletionCallback* callback) {
+    CheckIsOnWorkerThread();
+    last_pac_bytes_ = bytes;
+    return OK;
+  }
+
+  virtual void PurgeMemory() {
+    CheckIsOnWorkerThread();
+    ++purge_count_;
+  }
+
+  int purge_count() const { return purge_count_; }
+
+  const std::string& last_pac_bytes() const { return last_pac_bytes_; }
+
+ private:
+  void CheckIsOnWorkerThread() {
+    // The resolver is created on the main loop, and only used on its worker
+    // thread.
+    EXPECT_NE(MessageLoop::current(), wrong_loop_);
+  }
+
+  MessageLoop* wrong_loop_;
+  int request_count_;
+  int purge_count_;
+  std::string last_pac_bytes_;
+  bool should_block_;
+  base::WaitableEvent unblocked_;
+  base::WaitableEvent blocked_;
+};
+
+// Creates BlockableProxyResolvers, and remembers them.
+class MockProxyResolverFactory : public ProxyResolverFactory {
+ public:
+  explicit MockProxyResolverFactory(bool block_new_resolvers)
+      : ProxyResolverFactory(true /*expects_pac_bytes*/),
+        block_new_resolvers_(block_new_resolvers) {
+  }
+
+  virtual ProxyResolver* CreateProxyResolver() {
+    BlockableProxyResolver* resolver = new BlockableProxyResolver;
+    if (block_new_resolvers_)
+      resolver->Block();
+    resolvers_.push_back(resolver);
+    return resolver;
+  }
+
+  // The resolvers that were created so far. They are owned by the
+  // MultiThreadedProxyResolver.
+  BlockableProxyResolver* resolver(size_t i) { return resolvers_[i]; }
+  size_t num_resolvers() const { return resolvers_.size(); }
+
+ private:
+  bool block_new_resolvers_;
+  std::vector<BlockableProxyResolver*> resolvers_;
+};
+
+// A synchronous ProxyResolver which resolves the host of the query through the
+// default javascript bindings, like the dnsResolve() of a PAC script. The
+// bindings run the host resolver on the origin loop, and wait for it.
+//       - returns a single-item proxy list with the query's address.
+class HostResolvingProxyResolver : public ProxyResolver {
+ public:
+  HostResolvingProxyResolver(HostResolver* host_resolver,
+                             MessageLoop* host_resolver_loop,
+                             base::WaitableEvent* resolving)
+      : ProxyResolver(true /*expects_pac_bytes*/),
+        js_bindings_(ProxyResolverJSBindings::CreateDefault(
+            host_resolver, host_resolver_loop)),
+        resolving_(resolving) {
+  }
+
+  // ProxyResolver implementation:
+  virtual int GetProxyForURL(const GURL& query_url,
+                             ProxyInfo* results,
+                             CompletionCallback* callback,
+                             RequestHandle* request,
+                             LoadLog* load_log) {
+    resolving_->Signal();
+    results->UseNamedProxy(js_bindings_->DnsResolve(query_url.host()));
+    return OK;
+  }
+
+  virtual void CancelRequest(RequestHandle request) {
+    NOTREACHED();
+  }
+
+  virtual int SetPacScript(const GURL& pac_url,
+                           const std::string& bytes,
+                           CompletionCallback* callback) {
+    last_pac_bytes_ = bytes;
+    return OK;
+  }
+
+  const std::string& last_pac_bytes() const { return last_pac_bytes_; }
+
+ private:
+  scoped_ptr<ProxyResolverJSBindings> js_bindings_;
+  base::WaitableEvent* resolving_;
+  std::string last_pac_bytes_;
+};
+
+// Creates HostResolvingProxyResolvers which use the current loop, and
+// remembers them.
+class HostResolvingProxyResolverFactory : public ProxyResolverFactory {
+ public:
+  HostResolvingProxyResolverFactory(HostResolver* host_resolver,
+                                    base::WaitableEvent* resolving)
+      : ProxyResolverFactory(true /*expects_pac_bytes*/),
+        host_resolver_(host_resolver),
+        resolving_(resolving) {
+  }
+
+  virtual ProxyResolver* CreateProxyResolver() {
+    HostResolvingProxyResolver* resolver = new HostResolvingProxyResolver(
+        host_resolver_, MessageLoop::current(), resolving_);
+    resolvers_.push_back(resolver);
+    return resolver;
+  }
+
+  // The resolvers that were created so far. They are owned by the
+  // MultiThreadedProxyResolver.
+  HostResolvingProxyResolver* resolver(size_t i) { return resolvers_[i]; }
+
+ private:
+  scoped_refptr<HostResolver> host_resolver_;
+  base::WaitableEvent* resolving_;
+  std::vector<HostResolvingProxyResolver*> resolvers_;
+};
+
+TEST(MultiThreadedProxyResolverTest, Basic) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(false);
+  MultiThreadedProxyResolver resolver(factory, 1);
+
+  int rv;
+
+  EXPECT_TRUE(resolver.expects_pac_bytes());
+
+  // Call SetPacScriptByData() -- verify that it reaches the synchronous
+  // resolver.
+  TestCompletionCallback set_script_callback;
+  rv = resolver.SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, set_script_callback.WaitForResult());
+  ASSERT_EQ(1u, factory->num_resolvers());
+  EXPECT_EQ("pac script bytes", factory->resolver(0)->last_pac_bytes());
+
+  // Start request 0.
+  TestCompletionCallback callback0;
+  scoped_refptr<LoadLog> log0(new LoadLog(LoadLog::kUnbounded));
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, NULL, log0);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  // Wait for request 0 to finish.
+  rv = callback0.WaitForResult();
+  EXPECT_EQ(0, rv);
+  EXPECT_EQ("PROXY request0:80", results0.ToPacString());
+
+  // The mock proxy resolver should have written 1 log entry. And
+  // on completion, this should have been copied into |log0|.
+  EXPECT_EQ(1u, log0->entries().size());
+
+  // Start 2 more requests. With a single thread they run in order.
+  TestCompletionCallback callback1;
+  ProxyInfo results1;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request1"), &results1, &callback1, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  TestCompletionCallback callback2;
+  ProxyInfo results2;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request2"), &results2, &callback2, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  rv = callback1.WaitForResult();
+  EXPECT_EQ(1, rv);
+  EXPECT_EQ("PROXY request1:80", results1.ToPacString());
+
+  rv = callback2.WaitForResult();
+  EXPECT_EQ(2, rv);
+  EXPECT_EQ("PROXY request2:80", results2.ToPacString());
+  EXPECT_EQ(1u, resolver.num_threads());
+
+  // Ensure that PurgeMemory() reaches the resolver and happens on the right
+  // thread. The request that follows it runs on the same thread, after it.
+  EXPECT_EQ(0, factory->resolver(0)->purge_count());
+  resolver.PurgeMemory();
+  TestCompletionCallback callback3;
+  ProxyInfo results3;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request3"), &results3, &callback3, NULL, NULL);
+  EXPECT_EQ(3, callback3.GetResult(rv));
+  EXPECT_EQ(1, factory->resolver(0)->purge_count());
+}
+
+// Requests are dispatched to new threads while the others are busy, and are
+// queued once there are |max_num_threads| of them.
+TEST(MultiThreadedProxyResolverTest, DispatchToIdleThreads) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(true);
+  MultiThreadedProxyResolver resolver(factory, 2);
+
+  int rv;
+
+  TestCompletionCallback set_script_callback;
+  rv = resolver.SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+
+  // Start request 0, and wait until it blocks on the first thread.
+  TestCompletionCallback callback0;
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  factory->resolver(0)->WaitUntilBlocked();
+
+  // Request 1 starts a second thread, which loads the script first.
+  TestCompletionCallback callback1;
+  ProxyInfo results1;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request1"), &results1, &callback1, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(2u, resolver.num_threads());
+  ASSERT_EQ(2u, factory->num_resolvers());
+  factory->resolver(1)->WaitUntilBlocked();
+  EXPECT_EQ("pac script bytes", factory->resolver(1)->last_pac_bytes());
+
+  // Request 2 waits for one of them.
+  TestCompletionCallback callback2;
+  ProxyInfo results2;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request2"), &results2, &callback2, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(2u, resolver.num_threads());
+
+  // Unblock the second thread: it completes request 1, then request 2.
+  factory->resolver(1)->Unblock();
+
+  rv = callback1.WaitForResult();
+  EXPECT_EQ(0, rv);
+  EXPECT_EQ("PROXY request1:80", results1.ToPacString());
+
+  rv = callback2.WaitForResult();
+  EXPECT_EQ(1, rv);
+  EXPECT_EQ("PROXY request2:80", results2.ToPacString());
+
+  EXPECT_FALSE(callback0.have_result());
+  factory->resolver(0)->Unblock();
+  rv = callback0.WaitForResult();
+  EXPECT_EQ(0, rv);
+  EXPECT_EQ("PROXY request0:80", results0.ToPacString());
+}
+
+// Cancel a request which is in progress, and then cancel a request which
+// is pending.
+TEST(MultiThreadedProxyResolverTest, CancelRequest) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(true);
+  MultiThreadedProxyResolver resolver(factory, 1);
+
+  int rv;
+
+  TestCompletionCallback set_script_callback;
+  rv = resolver.SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+
+  // Start request 0.
+  ProxyResolver::RequestHandle request0;
+  TestCompletionCallback callback0;
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, &request0, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  // Wait until requests 0 reaches the worker thread.
+  factory->resolver(0)->WaitUntilBlocked();
+
+  // Start 3 more requests (request1 : request3).
+
+  TestCompletionCallback callback1;
+  ProxyInfo results1;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request1"), &results1, &callback1, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  ProxyResolver::RequestHandle request2;
+  TestCompletionCallback callback2;
+  ProxyInfo results2;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request2"), &results2, &callback2, &request2, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  TestCompletionCallback callback3;
+  ProxyInfo results3;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request3"), &results3, &callback3, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  // Cancel request0 (inprogress) and request2 (pending).
+  resolver.CancelRequest(request0);
+  resolver.CancelRequest(request2);
+
+  // Unblock the worker thread so the requests can continue running.
+  factory->resolver(0)->Unblock();
+
+  // Wait for requests 1 and 3 to finish.
+
+  rv = callback1.WaitForResult();
+  EXPECT_EQ(1, rv);
+  EXPECT_EQ("PROXY request1:80", results1.ToPacString());
+
+  rv = callback3.WaitForResult();
+  // Note that since request2 was cancelled before reaching the resolver,
+  // the request count is 2 and not 3 here.
+  EXPECT_EQ(2, rv);
+  EXPECT_EQ("PROXY request3:80", results3.ToPacString());
+
+  // Requests 0 and 2 which were cancelled, hence their completion callbacks
+  // were never summoned.
+  EXPECT_FALSE(callback0.have_result());
+  EXPECT_FALSE(callback2.have_result());
+}
+
+// Test that deleting MultiThreadedProxyResolver while requests are
+// outstanding cancels them (and doesn't leak anything).
+TEST(MultiThreadedProxyResolverTest, CancelRequestByDeleting) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(true);
+  scoped_ptr<MultiThreadedProxyResolver> resolver(
+      new MultiThreadedProxyResolver(factory, 2));
+
+  int rv;
+
+  TestCompletionCallback set_script_callback;
+  rv = resolver->SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+
+  // Start 3 requests: two of them run, the last one is queued.
+
+  TestCompletionCallback callback0;
+  ProxyInfo results0;
+  rv = resolver->GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  TestCompletionCallback callback1;
+  ProxyInfo results1;
+  rv = resolver->GetProxyForURL(
+      GURL("http://request1"), &results1, &callback1, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  TestCompletionCallback callback2;
+  ProxyInfo results2;
+  rv = resolver->GetProxyForURL(
+      GURL("http://request2"), &results2, &callback2, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  // Wait until requests 0 and 1 reach the worker threads.
+  ASSERT_EQ(2u, factory->num_resolvers());
+  factory->resolver(0)->WaitUntilBlocked();
+  factory->resolver(1)->WaitUntilBlocked();
+
+  // Unblock the worker threads and delete the MultiThreadedProxyResolver
+  // immediately.
+  factory->resolver(0)->Unblock();
+  factory->resolver(1)->Unblock();
+  resolver.reset();
+
+  // Give any posted tasks a chance to run (in case there is badness).
+  MessageLoop::current()->RunAllPending();
+
+  // Check that none of the outstanding requests were completed.
+  EXPECT_FALSE(callback0.have_result());
+  EXPECT_FALSE(callback1.have_result());
+  EXPECT_FALSE(callback2.have_result());
+}
+
+// Cancel an outstanding call to SetPacScriptByData().
+TEST(MultiThreadedProxyResolverTest, CancelSetPacScript) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(false);
+  MultiThreadedProxyResolver resolver(factory, 1);
+
+  int rv;
+
+  TestCompletionCallback set_pac_script_callback;
+  rv = resolver.SetPacScriptByData("data", &set_pac_script_callback);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  // Cancel the SetPacScriptByData request. The script is still loaded.
+  resolver.CancelSetPacScript();
+
+  // Start 1 more request, which runs after the script was loaded.
+  TestCompletionCallback callback0;
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  rv = callback0.WaitForResult();
+  EXPECT_EQ(0, rv);
+  EXPECT_EQ("PROXY request0:80", results0.ToPacString());
+  EXPECT_EQ("data", factory->resolver(0)->last_pac_bytes());
+
+  // The SetPacScript callback should never have been completed.
+  EXPECT_FALSE(set_pac_script_callback.have_result());
+}
+
+// The results are reused for the same URL while the cache entry is fresh,
+// until the script changes.
+TEST(MultiThreadedProxyResolverTest, ResultCache) {
+  MockProxyResolverFactory* factory = new MockProxyResolverFactory(false);
+  MultiThreadedProxyResolver resolver(factory, 1);
+  resolver.set_result_cache_ttl(base::TimeDelta::FromHours(1));
+
+  int rv;
+
+  TestCompletionCallback set_script_callback;
+  rv = resolver.SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+
+  TestCompletionCallback callback;
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0/a"), &results0, &callback, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  // Served from the cache, synchronously.
+  ProxyInfo results1;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0/a"), &results1, &callback, NULL, NULL);
+  EXPECT_EQ(OK, rv);
+  EXPECT_EQ("PROXY request0:80", results1.ToPacString());
+
+  // The cache is keyed by the whole URL.
+  ProxyInfo results2;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0/b"), &results2, &callback, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(1, callback.WaitForResult());
+
+  // A new script empties the cache.
+  rv = resolver.SetPacScriptByData("new script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+  ProxyInfo results3;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0/a"), &results3, &callback, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+}
+
+// Load a new script while a request is waiting for this thread to resolve a
+// host. The worker thread is kept: the request completes, and then the new
+// script is loaded.
+TEST(MultiThreadedProxyResolverTest, SetPacScriptWhileResolvingHost) {
+  scoped_refptr<MockHostResolver> host_resolver(new MockHostResolver);
+  host_resolver->set_synchronous_mode(true);
+  base::WaitableEvent resolving(false, false);
+  HostResolvingProxyResolverFactory* factory =
+      new HostResolvingProxyResolverFactory(host_resolver, &resolving);
+  MultiThreadedProxyResolver resolver(factory, 1);
+
+  int rv;
+
+  TestCompletionCallback set_script_callback;
+  rv = resolver.SetPacScriptByData("pac script bytes", &set_script_callback);
+  EXPECT_EQ(OK, set_script_callback.GetResult(rv));
+
+  // Start request 0, and wait until its worker thread resolves the host.
+  TestCompletionCallback callback0;
+  ProxyInfo results0;
+  rv = resolver.GetProxyForURL(
+      GURL("http://request0"), &results0, &callback0, NULL, NULL);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+  resolving.Wait();
+
+  // The host can only be resolved once this thread runs its loop.
+  rv = resolver.SetPacScriptByData("new script bytes", &set_script_callback);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  rv = callback0.WaitForResult();
+  EXPECT_EQ(OK, rv);
+  EXPECT_EQ("PROXY 127.0.0.1:80", results0.ToPacString());
+
+  EXPECT_EQ(OK, set_script_callback.WaitForResult());
+  EXPECT_EQ("new script bytes", factory->resolver(0)->last_pac_bytes());
+  EXPECT_EQ(1u, resolver.num_threads());
+}
+
+}  // namespace
+}  // namespace net
@@ -2,8 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
 #include "base/perftimer.h"
+#include "base/string_util.h"
 #include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/proxy/multi_threaded_proxy_resolver.h"
 #include "net/proxy/proxy_resolver_js_bindings.h"
 #include "net/proxy/proxy_resolver_v8.h"
 #include "net/url_request/url_request_unittest.h"
@@ -70,6 +76,22 @@ int PacPerfTest::NumQueries() const {
 // The number of URLs to resolve when testing a PAC script.
 const int kNumIterations = 500;
 
+// Reads the PAC script |script_name| of net/data/proxy_resolver_perftest.
+static bool ReadPacScript(const std::string& script_name,
+                          std::string* contents) {
+  FilePath path;
+  PathService::Get(base::DIR_SOURCE_ROOT, &path);
+  path = path.AppendASCII("net");
+  path = path.AppendASCII("data");
+  path = path.AppendASCII("proxy_resolver_perftest");
+  path = path.AppendASCII(script_name);
+
+  // If we can't load the file from disk, something is misconfigured.
+  bool ok = file_util::ReadFileToString(path, contents);
+  LOG_IF(ERROR, !ok) << "Failed to read file: " << path.value();
+  return ok;
+}
+
 // Helper class to run through all the performance tests using the specified
 // proxy resolver implementation.
 class PacPerfSuiteRunner {
@@ -148,20 +170,8 @@ class PacPerfSuiteRunner {
 
   // Read the PAC script from disk and initialize the proxy resolver with it.
   void LoadPacScriptIntoResolver(const std::string& script_name) {
-    FilePath path;
-    PathService::Get(base::DIR_SOURCE_ROOT, &path);
-    path = path.AppendASCII("net");
-    path = path.AppendASCII("data");
-    path = path.AppendASCII("proxy_resolver_perftest");
-    path = path.AppendASCII(script_name);
-
-    // Try to read the file from disk.
     std::string file_contents;
-    bool ok = file_util::ReadFileToString(path, &file_contents);
-
-    // If we can't load the file from disk, something is misconfigured.
-    LOG_IF(ERROR, !ok) << "Failed to read file: " << path.value();
-    ASSERT_TRUE(ok);
+    ASSERT_TRUE(ReadPacScript(script_name, &file_contents));
 
     // Load the PAC script into the ProxyResolver.
     int rv = resolver_->SetPacScriptByData(file_contents, NULL);
@@ -196,3 +206,84 @@ TEST(ProxyResolverPerfTest, ProxyResolverV8) {
   PacPerfSuiteRunner runner(&resolver, "ProxyResolverV8");
   runner.RunAllTests();
 }
+
+// The host resolutions of dns.pac take this long, like a real DNS lookup.
+const int kDnsLatencyMs = 5;
+
+// Creates ProxyResolverV8s whose host resolutions are slow.
+class SlowDnsProxyResolverFactory : public net::ProxyResolverFactory {
+ public:
+  SlowDnsProxyResolverFactory()
+      : net::ProxyResolverFactory(true /*expects_pac_bytes*/) {}
+
+  virtual net::ProxyResolver* CreateProxyResolver() {
+    net::MockHostResolver* host_resolver = new net::MockHostResolver;
+    host_resolver->rules()->AddRuleWithLatency(
+        "*.corp", "10.0.0.1", kDnsLatencyMs);
+    host_resolver->rules()->AddRuleWithLatency(
+        "*", "192.168.1.1", kDnsLatencyMs);
+    return new net::ProxyResolverV8(
+        net::ProxyResolverJSBindings::CreateDefault(host_resolver, NULL));
+  }
+};
+
+// Quits the current message loop once it has run |num_runs| times.
+class QuitAfterCallback : public CallbackRunner<Tuple1<int> > {
+ public:
+  explicit QuitAfterCallback(int num_runs) : num_runs_(num_runs) {}
+
+  virtual void RunWithParams(const Tuple1<int>& params) {
+    EXPECT_EQ(net::OK, params.a);
+    if (--num_runs_ == 0)
+      MessageLoop::current()->Quit();
+  }
+
+ private:
+  int num_runs_;
+};
+
+// Measures the throughput of MultiThreadedProxyResolver on a PAC script that
+// resolves every host, with 1 to 8 threads. The requests are all started at
+// once, as when a page loads its subresources.
+TEST(ProxyResolverPerfTest, MultiThreadedProxyResolverV8) {
+  static const PacQuery kQueries[] = {
+    {"http://intranet.corp/", "DIRECT"},
+    {"http://www.google.com/", "PROXY proxy.corp:8080"},
+    {"http://wiki.corp/index.html", "DIRECT"},
+    {"http://www.example.com/x/y/z", "PROXY proxy.corp:8080"},
+  };
+
+  std::string script;
+  ASSERT_TRUE(ReadPacScript("dns.pac", &script));
+
+  MessageLoop message_loop;
+  for (size_t num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    net::MultiThreadedProxyResolver resolver(
+        new SlowDnsProxyResolverFactory, num_threads);
+    TestCompletionCallback set_script_callback;
+    int rv = resolver.SetPacScriptByData(script, &set_script_callback);
+    ASSERT_EQ(net::OK, set_script_callback.GetResult(rv));
+
+    std::string perf_test_name =
+        StringPrintf("MultiThreadedProxyResolverV8_%d_threads",
+                     static_cast<int>(num_threads));
+    PerfTimeLogger timer(perf_test_name.c_str());
+
+    QuitAfterCallback callback(kNumIterations);
+    std::vector<net::ProxyInfo> results(kNumIterations);
+    for (int i = 0; i < kNumIterations; ++i) {
+      rv = resolver.GetProxyForURL(
+          GURL(kQueries[i % arraysize(kQueries)].query_url), &results[i],
+          &callback, NULL, NULL);
+      ASSERT_EQ(net::ERR_IO_PENDING, rv);
+    }
+    MessageLoop::current()->Run();
+
+    timer.Done();
+
+    for (int i = 0; i < kNumIterations; ++i) {
+      ASSERT_EQ(kQueries[i % arraysize(kQueries)].expected_result,
+                results[i].ToPacString());
+    }
+  }
+}
@@ -298,7 +298,13 @@ class ProxyResolverV8::Context {
 
     // We shouldn't be called with any arguments, but will not complain if
     // we are.
-    std::string result = context->js_bindings_->MyIpAddress();
+    std::string result;
+    {
+      // The bindings may block on the host resolver. Release the V8 lock
+      // meanwhile, so that the other PAC threads can run their scripts.
+      v8::Unlocker unlocked;
+      result = context->js_bindings_->MyIpAddress();
+    }
 
     LoadLog::EndEvent(context->current_request_load_log_,
                       LoadLog::TYPE_PROXY_RESOLVER_V8_MY_IP_ADDRESS);
@@ -319,7 +325,11 @@ class ProxyResolverV8::Context {
 
     // We shouldn't be called with any arguments, but will not complain if
     // we are.
-    std::string result = context->js_bindings_->MyIpAddressEx();
+    std::string result;
+    {
+      v8::Unlocker unlocked;  // See MyIpAddressCallback().
+      result = context->js_bindings_->MyIpAddressEx();
+    }
 
     LoadLog::EndEvent(context->current_request_load_log_,
                       LoadLog::TYPE_PROXY_RESOLVER_V8_MY_IP_ADDRESS_EX);
@@ -344,7 +354,11 @@ class ProxyResolverV8::Context {
     LoadLog::BeginEvent(context->current_request_load_log_,
                         LoadLog::TYPE_PROXY_RESOLVER_V8_DNS_RESOLVE);
 
-    std::string result = context->js_bindings_->DnsResolve(host);
+    std::string result;
+    {
+      v8::Unlocker unlocked;  // See MyIpAddressCallback().
+      result = context->js_bindings_->DnsResolve(host);
+    }
 
     LoadLog::EndEvent(context->current_request_load_log_,
                       LoadLog::TYPE_PROXY_RESOLVER_V8_DNS_RESOLVE);
@@ -370,7 +384,11 @@ class ProxyResolverV8::Context {
     LoadLog::BeginEvent(context->current_request_load_log_,
                         LoadLog::TYPE_PROXY_RESOLVER_V8_DNS_RESOLVE_EX);
 
-    std::string result = context->js_bindings_->DnsResolveEx(host);
+    std::string result;
+    {
+      v8::Unlocker unlocked;  // See MyIpAddressCallback().
+      result = context->js_bindings_->DnsResolveEx(host);
+    }
 
     LoadLog::EndEvent(context->current_request_load_log_,
                       LoadLog::TYPE_PROXY_RESOLVER_V8_DNS_RESOLVE_EX);
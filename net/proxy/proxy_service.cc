@@ -15,6 +15,7 @@
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
 #include "net/proxy/init_proxy_resolver.h"
+#include "net/proxy/multi_threaded_proxy_resolver.h"
 #include "net/proxy/proxy_config_service_fixed.h"
 #include "net/proxy/proxy_script_fetcher.h"
 #if defined(OS_WIN)
@@ -39,6 +40,9 @@ namespace net {
 
 static const size_t kMaxNumLoadLogEntries = 100;
 
+// The maximum number of threads that evaluate the PAC script in parallel.
+static const size_t kMaxNumPacThreads = 4;
+
 // Config getter that fails every time.
 class ProxyConfigServiceNull : public ProxyConfigService {
  public:
@@ -48,6 +52,27 @@ class ProxyConfigServiceNull : public ProxyConfigService {
   }
 };
 
+// Creates the ProxyResolverV8s run by MultiThreadedProxyResolver. Each one
+// gets its own bindings to |host_resolver|.
+class ProxyResolverFactoryForV8 : public ProxyResolverFactory {
+ public:
+  ProxyResolverFactoryForV8(HostResolver* host_resolver, MessageLoop* io_loop)
+      : ProxyResolverFactory(true /*expects_pac_bytes*/),
+        host_resolver_(host_resolver),
+        io_loop_(io_loop) {}
+
+  virtual ProxyResolver* CreateProxyResolver() {
+    // Send javascript errors and alerts to LOG(INFO).
+    ProxyResolverJSBindings* js_bindings =
+        ProxyResolverJSBindings::CreateDefault(host_resolver_, io_loop_);
+    return new ProxyResolverV8(js_bindings);
+  }
+
+ private:
+  scoped_refptr<HostResolver> host_resolver_;
+  MessageLoop* io_loop_;
+};
+
 // Proxy resolver that fails every time.
 class ProxyResolverNull : public ProxyResolver {
  public:
@@ -222,20 +247,20 @@ ProxyService* ProxyService::Create(
   ProxyResolver* proxy_resolver;
 
   if (use_v8_resolver) {
-    // Send javascript errors and alerts to LOG(INFO).
-    HostResolver* host_resolver = url_request_context->host_resolver();
-    ProxyResolverJSBindings* js_bindings =
-        ProxyResolverJSBindings::CreateDefault(host_resolver, io_loop);
-
-    proxy_resolver = new ProxyResolverV8(js_bindings);
+    // Run the PAC script on a pool of threads, each with its own V8 resolver,
+    // so that a script blocked on DNS does not hold up the other requests.
+    proxy_resolver = new MultiThreadedProxyResolver(
+        new ProxyResolverFactoryForV8(url_request_context->host_resolver(),
+                                      io_loop),
+        kMaxNumPacThreads);
   } else {
-    proxy_resolver = CreateNonV8ProxyResolver();
+    // Wrap the (synchronous) ProxyResolver implementation in a
+    // single-threaded runner. This will dispatch requests to a threadpool of
+    // size 1.
+    proxy_resolver = new SingleThreadedProxyResolver(
+        CreateNonV8ProxyResolver());
   }
 
-  // Wrap the (synchronous) ProxyResolver implementation in a single-threaded
-  // runner. This will dispatch requests to a threadpool of size 1.
-  proxy_resolver = new SingleThreadedProxyResolver(proxy_resolver);
-
   ProxyService* proxy_service = new ProxyService(
       proxy_config_service, proxy_resolver, network_change_notifier);
 
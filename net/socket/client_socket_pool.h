@@ -55,6 +55,20 @@ class ClientSocketPool : public base::RefCounted<ClientSocketPool> {
                             CompletionCallback* callback,
                             LoadLog* load_log) = 0;
 
+  // Opens connected sockets for a group_name ahead of time, so that the next
+  // requests for that group don't have to wait for a new connection.  Idle
+  // sockets and the sockets already being connected for the group count
+  // towards |num_sockets|, and the group never gets more than the "max sockets
+  // per group" limit.  The new sockets are added to the set of idle sockets
+  // as unused sockets when they finish connecting.
+  //
+  // Profiling information for the connections is saved to |load_log| if
+  // non-NULL.
+  virtual void RequestSockets(const std::string& group_name,
+                              const void* params,
+                              int num_sockets,
+                              LoadLog* load_log) = 0;
+
   // Called to cancel a RequestSocket call that returned ERR_IO_PENDING.  The
   // same handle parameter must be passed to this method as was passed to the
   // RequestSocket call being cancelled.  The associated CompletionCallback is
@@ -4,6 +4,8 @@
 
 #include "net/socket/client_socket_pool_base.h"
 
+#include <algorithm>
+
 #include "base/compiler_specific.h"
 #include "base/message_loop.h"
 #include "base/stl_util-inl.h"
@@ -42,7 +44,6 @@ ConnectJob::ConnectJob(const std::string& group_name,
       delegate_(delegate),
       load_log_(load_log) {
   DCHECK(!group_name.empty());
-  DCHECK(key_handle);
   DCHECK(delegate);
 }
 
@@ -120,8 +121,9 @@ ClientSocketPoolBaseHelper::ClientSocketPoolBaseHelper(
 }
 
 ClientSocketPoolBaseHelper::~ClientSocketPoolBaseHelper() {
-  if (g_late_binding)
-    CancelAllConnectJobs();
+  // Without late binding, only the jobs started by RequestSockets() may still
+  // be around, since they don't belong to any request.
+  CancelAllConnectJobs();
   // Clean up any idle sockets.  Assert that we have no remaining active
   // sockets or pending requests.  They should have all been cleaned up prior
   // to the manager being destroyed.
@@ -196,13 +198,15 @@ int ClientSocketPoolBaseHelper::RequestSocket(
     DecrementIdleCount();
     if (idle_socket.socket->IsConnectedAndIdle()) {
       // We found one we can reuse!
+      if (idle_socket.preconnected)
+        preconnect_stats_.used_sockets++;
       base::TimeDelta idle_time =
           base::TimeTicks::Now() - idle_socket.start_time;
       HandOutSocket(
           idle_socket.socket, idle_socket.used, handle, idle_time, &group);
       return OK;
     }
-    delete idle_socket.socket;
+    DeleteIdleSocket(idle_socket);
   }
 
   // We couldn't find a socket to reuse, so allocate and connect a new one.
@@ -244,6 +248,45 @@ int ClientSocketPoolBaseHelper::RequestSocket(
   return rv;
 }
 
+void ClientSocketPoolBaseHelper::RequestSockets(
+    const std::string& group_name,
+    const Request& request,
+    int num_sockets) {
+  DCHECK(!request.handle());
+  DCHECK(!request.callback());
+  Group& group = group_map_[group_name];
+
+  // The idle sockets of the group, and the sockets being connected, are
+  // already available for the next requests.
+  int num_missing = std::min(num_sockets, max_sockets_per_group_) -
+      static_cast<int>(group.idle_sockets.size() + group.jobs.size());
+  for (; num_missing > 0; num_missing--) {
+    if (ReachedMaxSocketsLimit() ||
+        !group.HasAvailableSocketSlot(max_sockets_per_group_))
+      break;
+
+    scoped_ptr<ConnectJob> connect_job(
+        connect_job_factory_->NewConnectJob(group_name, request, this,
+                                           request.load_log()));
+    preconnect_stats_.connect_jobs++;
+
+    int rv = connect_job->Connect();
+    if (rv == OK) {
+      AddIdleSocket(connect_job->ReleaseSocket(), false /* unused socket */,
+                    true /* preconnected */, &group);
+    } else if (rv == ERR_IO_PENDING) {
+      connecting_socket_count_++;
+      group.jobs.insert(connect_job.release());
+    } else {
+      // Don't insist on a host that fails.
+      break;
+    }
+  }
+
+  if (group.IsEmpty())
+    group_map_.erase(group_name);
+}
+
 void ClientSocketPoolBaseHelper::CancelRequest(
     const std::string& group_name, const ClientSocketHandle* handle) {
   CHECK(ContainsKey(group_map_, group_name));
@@ -375,7 +418,7 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
       base::TimeDelta timeout =
           j->used ? used_idle_socket_timeout_ : unused_idle_socket_timeout_;
       if (force || j->ShouldCleanup(now, timeout)) {
-        delete j->socket;
+        DeleteIdleSocket(*j);
         j = group.idle_sockets.erase(j);
         DecrementIdleCount();
       } else {
@@ -418,7 +461,8 @@ void ClientSocketPoolBaseHelper::DoReleaseSocket(const std::string& group_name,
 
   const bool can_reuse = socket->IsConnectedAndIdle();
   if (can_reuse) {
-    AddIdleSocket(socket, true /* used socket */, &group);
+    AddIdleSocket(socket, true /* used socket */, false /* not preconnected */,
+                  &group);
   } else {
     delete socket;
   }
@@ -487,12 +531,15 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
     if (result == OK) {
       DCHECK(socket.get());
       if (r.get()) {
+        if (!key_handle)
+          preconnect_stats_.used_sockets++;
         HandOutSocket(
             socket.release(), false /* unused socket */, r->handle(),
             base::TimeDelta(), &group);
         r->callback()->Run(result);
       } else {
-        AddIdleSocket(socket.release(), false /* unused socket */, &group);
+        AddIdleSocket(socket.release(), false /* unused socket */,
+                      !key_handle /* preconnected */, &group);
         OnAvailableSocketSlot(group_name, &group);
       }
     } else {
@@ -505,6 +552,19 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
     return;
   }
 
+  if (!key_handle) {
+    // The job was started by RequestSockets(), so there is no request waiting
+    // for it.
+    RemoveConnectJob(NULL, job, &group);
+    if (result == OK) {
+      DCHECK(socket.get());
+      AddIdleSocket(socket.release(), false /* unused socket */,
+                    true /* preconnected */, &group);
+    }
+    OnAvailableSocketSlot(group_name, &group);
+    return;
+  }
+
   RequestMap* request_map = &group.connecting_requests;
   RequestMap::iterator it = request_map->find(key_handle);
   CHECK(it != request_map->end());
@@ -543,7 +603,7 @@ void ClientSocketPoolBaseHelper::RemoveConnectJob(
   CHECK(connecting_socket_count_ > 0);
   connecting_socket_count_--;
 
-  if (g_late_binding) {
+  if (g_late_binding || !handle) {
     DCHECK(job);
     delete job;
   } else {
@@ -631,17 +691,25 @@ void ClientSocketPoolBaseHelper::HandOutSocket(
 }
 
 void ClientSocketPoolBaseHelper::AddIdleSocket(
-    ClientSocket* socket, bool used, Group* group) {
+    ClientSocket* socket, bool used, bool preconnected, Group* group) {
   DCHECK(socket);
   IdleSocket idle_socket;
   idle_socket.socket = socket;
   idle_socket.start_time = base::TimeTicks::Now();
   idle_socket.used = used;
+  idle_socket.preconnected = preconnected;
 
   group->idle_sockets.push_back(idle_socket);
   IncrementIdleCount();
 }
 
+void ClientSocketPoolBaseHelper::DeleteIdleSocket(
+    const IdleSocket& idle_socket) {
+  if (idle_socket.preconnected)
+    preconnect_stats_.wasted_sockets++;
+  delete idle_socket.socket;
+}
+
 void ClientSocketPoolBaseHelper::CancelAllConnectJobs() {
   for (GroupMap::iterator i = group_map_.begin(); i != group_map_.end();) {
     Group& group = i->second;
@@ -102,7 +102,8 @@ class ConnectJob {
   void OnTimeout();
 
   const std::string group_name_;
-  // Temporarily needed until we switch to late binding.
+  // Temporarily needed until we switch to late binding.  NULL for the jobs
+  // started by ClientSocketPoolBaseHelper::RequestSockets().
   const ClientSocketHandle* const key_handle_;
   const base::TimeDelta timeout_duration_;
   // Timer to abort jobs that take too long.
@@ -166,6 +167,15 @@ class ClientSocketPoolBaseHelper
     DISALLOW_COPY_AND_ASSIGN(ConnectJobFactory);
   };
 
+  // Counters of the sockets opened by RequestSockets().
+  struct PreconnectStats {
+    PreconnectStats() : connect_jobs(0), used_sockets(0), wasted_sockets(0) {}
+
+    int connect_jobs;  // Number of connections started.
+    int used_sockets;  // Sockets later handed out to a request.
+    int wasted_sockets;  // Sockets closed without ever being used.
+  };
+
   ClientSocketPoolBaseHelper(
       int max_sockets,
       int max_sockets_per_group,
@@ -179,6 +189,13 @@ class ClientSocketPoolBaseHelper
   // then ClientSocketPoolBaseHelper takes ownership of |request|.
   int RequestSocket(const std::string& group_name, const Request* request);
 
+  // See ClientSocketPool::RequestSockets for documentation on this function.
+  // |request| has no handle or callback, and it is only used to create the
+  // ConnectJobs.
+  void RequestSockets(const std::string& group_name,
+                      const Request& request,
+                      int num_sockets);
+
   // See ClientSocketPool::CancelRequest for documentation on this function.
   void CancelRequest(const std::string& group_name,
                      const ClientSocketHandle* handle);
@@ -217,6 +234,8 @@ class ClientSocketPoolBaseHelper
   // afterward and receive the socket from the job).
   static void EnableLateBindingOfSockets(bool enabled);
 
+  const PreconnectStats& preconnect_stats() const { return preconnect_stats_; }
+
   // For testing.
   bool may_have_stalled_group() const { return may_have_stalled_group_; }
 
@@ -235,10 +254,11 @@ class ClientSocketPoolBaseHelper
 
   // Entry for a persistent socket which became idle at time |start_time|.
   struct IdleSocket {
-    IdleSocket() : socket(NULL), used(false) {}
+    IdleSocket() : socket(NULL), used(false), preconnected(false) {}
     ClientSocket* socket;
     base::TimeTicks start_time;
     bool used;  // Indicates whether or not the socket has been used yet.
+    bool preconnected;  // The socket was opened by RequestSockets().
 
     // An idle socket should be removed if it can't be reused, or has been idle
     // for too long. |now| is the current time value (TimeTicks::Now()).
@@ -313,7 +333,8 @@ class ClientSocketPoolBaseHelper
   // |connect_job_map_| or |connect_job_set_| depending on whether or not late
   // binding is enabled.  |job| must be non-NULL when late binding is
   // enabled.  Also updates |group| if non-NULL.  When late binding is disabled,
-  // this will also delete the Request from |group->connecting_requests|.
+  // this will also delete the Request from |group->connecting_requests|.  A
+  // NULL |handle| means that |job| was started by RequestSockets().
   void RemoveConnectJob(const ClientSocketHandle* handle,
                         const ConnectJob* job,
                         Group* group);
@@ -336,8 +357,14 @@ class ClientSocketPoolBaseHelper
                      Group* group);
 
   // Adds |socket| to the list of idle sockets for |group|.  |used| indicates
-  // whether or not the socket has previously been used.
-  void AddIdleSocket(ClientSocket* socket, bool used, Group* group);
+  // whether or not the socket has previously been used, and |preconnected|
+  // whether it was opened by RequestSockets().
+  void AddIdleSocket(ClientSocket* socket, bool used, bool preconnected,
+                     Group* group);
+
+  // Deletes |idle_socket|, which is no longer in an idle list, and updates
+  // |preconnect_stats_| if it was never used.
+  void DeleteIdleSocket(const IdleSocket& idle_socket);
 
   // Iterates through |connect_job_map_|, canceling all ConnectJobs.
   // Afterwards, it iterates through all groups and deletes them if they are no
@@ -391,6 +418,8 @@ class ClientSocketPoolBaseHelper
   // in the common case.
   bool may_have_stalled_group_;
 
+  PreconnectStats preconnect_stats_;
+
   const scoped_ptr<ConnectJobFactory> connect_job_factory_;
 
   const scoped_refptr<NetworkChangeNotifier> network_change_notifier_;
@@ -487,6 +516,17 @@ class ClientSocketPoolBase {
     return rv;
   }
 
+  // RequestSockets bundles up the parameters into a Request without a handle
+  // or callback, and then forwards to
+  // ClientSocketPoolBaseHelper::RequestSockets().
+  void RequestSockets(const std::string& group_name,
+                      const SocketParams& params,
+                      int num_sockets,
+                      LoadLog* load_log) {
+    const Request request(NULL, NULL, LOWEST, params, load_log);
+    helper_->RequestSockets(group_name, request, num_sockets);
+  }
+
   void CancelRequest(const std::string& group_name,
                      const ClientSocketHandle* handle) {
     return helper_->CancelRequest(group_name, handle);
@@ -513,6 +553,12 @@ class ClientSocketPoolBase {
     return helper_->OnConnectJobComplete(result, job);
   }
 
+  typedef internal::ClientSocketPoolBaseHelper::PreconnectStats
+      PreconnectStats;
+  const PreconnectStats& preconnect_stats() const {
+    return helper_->preconnect_stats();
+  }
+
   // For testing.
   bool may_have_stalled_group() const {
     return helper_->may_have_stalled_group();
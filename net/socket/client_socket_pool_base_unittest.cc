@@ -292,6 +292,14 @@ class TestClientSocketPool : public ClientSocketPool {
         group_name, params, priority, handle, callback, load_log);
   }
 
+  virtual void RequestSockets(
+      const std::string& group_name,
+      const void* params,
+      int num_sockets,
+      LoadLog* load_log) {
+    base_.RequestSockets(group_name, params, num_sockets, load_log);
+  }
+
   virtual void CancelRequest(
       const std::string& group_name,
       const ClientSocketHandle* handle) {
@@ -1249,6 +1257,78 @@ TEST_F(ClientSocketPoolBaseTest, GroupWithPendingRequestsIsNotEmpty) {
   EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
 }
 
+TEST_F(ClientSocketPoolBaseTest, RequestSockets) {
+  CreatePool(kDefaultMaxSockets, kDefaultMaxSocketsPerGroup);
+
+  pool_->RequestSockets("a", NULL, 1, NULL);
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().connect_jobs);
+
+  // The idle socket counts towards the requested sockets.
+  pool_->RequestSockets("a", NULL, 2, NULL);
+  EXPECT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_EQ(2, pool_->base()->preconnect_stats().connect_jobs);
+
+  // The group limit is respected.
+  pool_->RequestSockets("a", NULL, kDefaultMaxSocketsPerGroup + 1, NULL);
+  EXPECT_EQ(kDefaultMaxSocketsPerGroup, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_EQ(kDefaultMaxSocketsPerGroup,
+            client_socket_factory_.allocation_count());
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  EXPECT_EQ(OK, InitHandle(&handle, "a", kDefaultPriority, &callback,
+                           pool_.get(), NULL));
+  EXPECT_FALSE(handle.is_reused());
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().used_sockets);
+  EXPECT_EQ(kDefaultMaxSocketsPerGroup,
+            client_socket_factory_.allocation_count());
+  handle.Reset();
+  MessageLoop::current()->RunAllPending();
+
+  // The socket that was used is not counted as wasted.
+  pool_->CloseIdleSockets();
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().used_sockets);
+  EXPECT_EQ(kDefaultMaxSocketsPerGroup - 1,
+            pool_->base()->preconnect_stats().wasted_sockets);
+}
+
+TEST_F(ClientSocketPoolBaseTest, RequestSocketsAsynchronous) {
+  CreatePool(kDefaultMaxSockets, kDefaultMaxSocketsPerGroup);
+
+  connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
+  pool_->RequestSockets("a", NULL, 2, NULL);
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+  EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
+
+  // The pending jobs count towards the requested sockets.
+  pool_->RequestSockets("a", NULL, 2, NULL);
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+
+  PlatformThread::Sleep(10);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, pool_->NumConnectJobsInGroup("a"));
+  EXPECT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  EXPECT_EQ(OK, InitHandle(&handle, "a", kDefaultPriority, &callback,
+                           pool_.get(), NULL));
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().used_sockets);
+  handle.Reset();
+}
+
+TEST_F(ClientSocketPoolBaseTest, RequestSocketsFailure) {
+  CreatePool(kDefaultMaxSockets, kDefaultMaxSocketsPerGroup);
+
+  connect_job_factory_->set_job_type(TestConnectJob::kMockFailingJob);
+  pool_->RequestSockets("a", NULL, 2, NULL);
+
+  // Only one connection is attempted, and the group is not kept around.
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().connect_jobs);
+  EXPECT_EQ(0, pool_->IdleSocketCount());
+}
+
 class ClientSocketPoolBaseTest_LateBinding : public ClientSocketPoolBaseTest {
  protected:
   virtual void SetUp() {
@@ -1878,6 +1958,28 @@ TEST_F(ClientSocketPoolBaseTest_LateBinding, CleanupTimedOutIdleSockets) {
   EXPECT_TRUE(req.handle()->is_reused());
 }
 
+TEST_F(ClientSocketPoolBaseTest_LateBinding, RequestSocketsServesRequest) {
+  CreatePool(kDefaultMaxSockets, kDefaultMaxSocketsPerGroup);
+
+  connect_job_factory_->set_job_type(TestConnectJob::kMockWaitingJob);
+  pool_->RequestSockets("a", NULL, 1, NULL);
+  EXPECT_EQ(1, pool_->NumConnectJobsInGroup("a"));
+
+  // The request starts its own job, but it gets the socket of the
+  // preconnect job if that one finishes first.
+  TestSocketRequest req(&request_order_, &completion_count_);
+  EXPECT_EQ(ERR_IO_PENDING,
+            InitHandle(req.handle(), "a", kDefaultPriority, &req,
+                       pool_.get(), NULL));
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+
+  client_socket_factory_.SignalJobs();
+  EXPECT_EQ(OK, req.WaitForResult());
+  EXPECT_EQ(1, pool_->base()->preconnect_stats().used_sockets);
+  EXPECT_EQ(1, pool_->IdleSocketCountInGroup("a"));
+  req.handle()->Reset();
+}
+
 }  // namespace
 
 }  // namespace net
@@ -86,6 +86,8 @@ int MockTCPClientSocket::Connect(net::CompletionCallback* callback,
     return net::OK;
   connected_ = true;
   if (data_->connect_data().async) {
+    if (data_->connect_data().result == net::ERR_IO_PENDING)
+      return net::ERR_IO_PENDING;
     RunCallbackAsync(callback, data_->connect_data().result);
     return net::ERR_IO_PENDING;
   }
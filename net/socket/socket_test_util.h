@@ -40,7 +40,8 @@ class MockClientSocket;
 class SSLClientSocket;
 
 struct MockConnect {
-  // Asynchronous connection success.
+  // Asynchronous connection success.  An asynchronous connection with a
+  // |result| of ERR_IO_PENDING never completes.
   MockConnect() : async(true), result(OK) { }
   MockConnect(bool a, int r) : async(a), result(r) { }
 
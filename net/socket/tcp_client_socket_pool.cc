@@ -4,12 +4,16 @@
 
 #include "net/socket/tcp_client_socket_pool.h"
 
+#include <algorithm>
+
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
+#include "base/string_util.h"
 #include "base/time.h"
 #include "net/base/load_log.h"
 #include "net/base/net_errors.h"
+#include "net/base/sys_addrinfo.h"
 #include "net/socket/client_socket_factory.h"
 #include "net/socket/client_socket_handle.h"
 #include "net/socket/client_socket_pool_base.h"
@@ -30,11 +34,44 @@ namespace net {
 // See comment #12 at http://crbug.com/23364 for specifics.
 static const int kTCPConnectJobTimeoutInSeconds = 240; // 4 minutes.
 
+// When the host has more than one address, the connect to the next address
+// starts if the current one takes longer than this.
+static const int kTCPConnectStaggerDelayInMilliseconds = 300;
+
+// A connect to one of the addresses of the host, racing with the others.
+class TCPConnectJob::ConnectAttempt {
+ public:
+  ConnectAttempt(TCPConnectJob* job, int address_index, ClientSocket* socket)
+      : job_(job),
+        address_index_(address_index),
+        socket_(socket),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            callback_(this, &ConnectAttempt::OnIOComplete)) {}
+
+  int Connect() { return socket_->Connect(&callback_, NULL); }
+
+  int address_index() const { return address_index_; }
+  ClientSocket* ReleaseSocket() { return socket_.release(); }
+
+ private:
+  void OnIOComplete(int result) {
+    job_->OnAttemptComplete(this, result);  // May delete |this|.
+  }
+
+  TCPConnectJob* const job_;
+  const int address_index_;
+  scoped_ptr<ClientSocket> socket_;
+  CompletionCallbackImpl<ConnectAttempt> callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConnectAttempt);
+};
+
 TCPConnectJob::TCPConnectJob(
     const std::string& group_name,
     const HostResolver::RequestInfo& resolve_info,
     const ClientSocketHandle* handle,
     base::TimeDelta timeout_duration,
+    base::TimeDelta stagger_delay,
     ClientSocketFactory* client_socket_factory,
     HostResolver* host_resolver,
     Delegate* delegate,
@@ -45,7 +82,11 @@ TCPConnectJob::TCPConnectJob(
       ALLOW_THIS_IN_INITIALIZER_LIST(
           callback_(this,
                     &TCPConnectJob::OnIOComplete)),
-      resolver_(host_resolver) {}
+      resolver_(host_resolver),
+      stagger_delay_(stagger_delay),
+      next_address_(NULL),
+      next_address_index_(0),
+      last_error_(ERR_FAILED) {}
 
 TCPConnectJob::~TCPConnectJob() {
   // We don't worry about cancelling the host resolution and TCP connect, since
@@ -123,9 +164,19 @@ int TCPConnectJob::DoResolveHostComplete(int result) {
 
 int TCPConnectJob::DoTCPConnect() {
   next_state_ = kStateTCPConnectComplete;
-  set_socket(client_socket_factory_->CreateTCPClientSocket(addresses_));
   connect_start_time_ = base::TimeTicks::Now();
-  return socket()->Connect(&callback_, load_log());
+  if (stagger_delay_ == base::TimeDelta() || !addresses_.head()->ai_next) {
+    set_socket(client_socket_factory_->CreateTCPClientSocket(addresses_));
+    return socket()->Connect(&callback_, load_log());
+  }
+
+  LoadLog::BeginEvent(load_log(), LoadLog::TYPE_TCP_CONNECT_JOB_STAGGERED);
+  next_address_ = addresses_.head();
+  next_address_index_ = 0;
+  int rv = StartAttempts();
+  if (rv != ERR_IO_PENDING)
+    LoadLog::EndEvent(load_log(), LoadLog::TYPE_TCP_CONNECT_JOB_STAGGERED);
+  return rv;
 }
 
 int TCPConnectJob::DoTCPConnectComplete(int result) {
@@ -155,6 +206,86 @@ int TCPConnectJob::DoTCPConnectComplete(int result) {
   return result;
 }
 
+int TCPConnectJob::StartAttempts() {
+  stagger_timer_.Stop();
+  while (next_address_) {
+    // Each attempt gets a list with a single address.
+    struct addrinfo address = *next_address_;
+    address.ai_next = NULL;
+    AddressList single_address;
+    single_address.Copy(&address);
+    next_address_ = next_address_->ai_next;
+
+    int index = next_address_index_++;
+    LoadLog::AddString(load_log(),
+                       StringPrintf("Connecting to address #%d", index));
+    ConnectAttempt* attempt = new ConnectAttempt(
+        this, index,
+        client_socket_factory_->CreateTCPClientSocket(single_address));
+    attempts_.push_back(attempt);
+
+    int rv = attempt->Connect();
+    if (rv == OK) {
+      UseAttempt(attempt);
+      return OK;
+    }
+    if (rv == ERR_IO_PENDING) {
+      if (next_address_) {
+        stagger_timer_.Start(stagger_delay_, this,
+                             &TCPConnectJob::OnStaggerTimer);
+      }
+      return ERR_IO_PENDING;
+    }
+
+    last_error_ = rv;
+    attempts_->pop_back();
+    delete attempt;
+  }
+
+  return attempts_.empty() ? last_error_ : ERR_IO_PENDING;
+}
+
+void TCPConnectJob::UseAttempt(ConnectAttempt* attempt) {
+  stagger_timer_.Stop();
+  LoadLog::AddString(
+      load_log(),
+      StringPrintf("Connected to address #%d", attempt->address_index()));
+  set_socket(attempt->ReleaseSocket());
+
+  // Cancel the other attempts.
+  attempts_.reset();
+  next_address_ = NULL;
+}
+
+void TCPConnectJob::OnAttemptComplete(ConnectAttempt* attempt, int result) {
+  int rv;
+  if (result == OK) {
+    UseAttempt(attempt);
+    rv = OK;
+  } else {
+    last_error_ = result;
+    attempts_->erase(std::find(attempts_.begin(), attempts_.end(), attempt));
+    delete attempt;
+
+    // Don't wait for the timer to try the next address.
+    rv = StartAttempts();
+    if (rv == ERR_IO_PENDING)
+      return;
+  }
+
+  LoadLog::EndEvent(load_log(), LoadLog::TYPE_TCP_CONNECT_JOB_STAGGERED);
+  OnIOComplete(rv);  // Deletes |this|
+}
+
+void TCPConnectJob::OnStaggerTimer() {
+  int rv = StartAttempts();
+  if (rv == ERR_IO_PENDING)
+    return;
+
+  LoadLog::EndEvent(load_log(), LoadLog::TYPE_TCP_CONNECT_JOB_STAGGERED);
+  OnIOComplete(rv);  // Deletes |this|
+}
+
 ConnectJob* TCPClientSocketPool::TCPConnectJobFactory::NewConnectJob(
     const std::string& group_name,
     const PoolBase::Request& request,
@@ -163,7 +294,17 @@ ConnectJob* TCPClientSocketPool::TCPConnectJobFactory::NewConnectJob(
   return new TCPConnectJob(
       group_name, request.params(), request.handle(),
       base::TimeDelta::FromSeconds(kTCPConnectJobTimeoutInSeconds),
-      client_socket_factory_, host_resolver_, delegate, load_log);
+      stagger_delay_, client_socket_factory_, host_resolver_, delegate,
+      load_log);
+}
+
+TCPClientSocketPool::TCPConnectJobFactory::TCPConnectJobFactory(
+    ClientSocketFactory* client_socket_factory,
+    HostResolver* host_resolver)
+    : client_socket_factory_(client_socket_factory),
+      host_resolver_(host_resolver),
+      stagger_delay_(base::TimeDelta::FromMilliseconds(
+          kTCPConnectStaggerDelayInMilliseconds)) {
 }
 
 TCPClientSocketPool::TCPClientSocketPool(
@@ -172,11 +313,12 @@ TCPClientSocketPool::TCPClientSocketPool(
     HostResolver* host_resolver,
     ClientSocketFactory* client_socket_factory,
     const scoped_refptr<NetworkChangeNotifier>& network_change_notifier)
-    : base_(max_sockets, max_sockets_per_group,
+    : connect_job_factory_(
+          new TCPConnectJobFactory(client_socket_factory, host_resolver)),
+      base_(max_sockets, max_sockets_per_group,
             base::TimeDelta::FromSeconds(kUnusedIdleSocketTimeout),
             base::TimeDelta::FromSeconds(kUsedIdleSocketTimeout),
-            new TCPConnectJobFactory(client_socket_factory, host_resolver),
-            network_change_notifier) {}
+            connect_job_factory_, network_change_notifier) {}
 
 TCPClientSocketPool::~TCPClientSocketPool() {}
 
@@ -193,6 +335,16 @@ int TCPClientSocketPool::RequestSocket(
       group_name, *casted_resolve_info, priority, handle, callback, load_log);
 }
 
+void TCPClientSocketPool::RequestSockets(
+    const std::string& group_name,
+    const void* resolve_info,
+    int num_sockets,
+    LoadLog* load_log) {
+  const HostResolver::RequestInfo* casted_resolve_info =
+      static_cast<const HostResolver::RequestInfo*>(resolve_info);
+  base_.RequestSockets(group_name, *casted_resolve_info, num_sockets, load_log);
+}
+
 void TCPClientSocketPool::CancelRequest(
     const std::string& group_name,
     const ClientSocketHandle* handle) {
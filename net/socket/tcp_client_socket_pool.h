@@ -10,6 +10,7 @@
 #include "base/basictypes.h"
 #include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
+#include "base/scoped_vector.h"
 #include "base/time.h"
 #include "base/timer.h"
 #include "net/base/host_resolver.h"
@@ -22,12 +23,20 @@ class ClientSocketFactory;
 
 // TCPConnectJob handles the host resolution necessary for socket creation
 // and the tcp connect.
+//
+// When the host resolves to more than one address and |stagger_delay| is not
+// zero, the addresses are raced: the connect to the first address starts right
+// away, and the connect to each following address starts when the previous
+// one fails, or when |stagger_delay| elapses without a result. The first
+// connection that succeeds is used, and the other attempts are cancelled.
+// Otherwise, a single socket tries the addresses one at a time.
 class TCPConnectJob : public ConnectJob {
  public:
   TCPConnectJob(const std::string& group_name,
                 const HostResolver::RequestInfo& resolve_info,
                 const ClientSocketHandle* handle,
                 base::TimeDelta timeout_duration,
+                base::TimeDelta stagger_delay,
                 ClientSocketFactory* client_socket_factory,
                 HostResolver* host_resolver,
                 Delegate* delegate,
@@ -38,6 +47,8 @@ class TCPConnectJob : public ConnectJob {
   virtual LoadState GetLoadState() const;
 
  private:
+  class ConnectAttempt;
+
   enum State {
     kStateResolveHost,
     kStateResolveHostComplete,
@@ -61,6 +72,20 @@ class TCPConnectJob : public ConnectJob {
   int DoTCPConnect();
   int DoTCPConnectComplete(int result);
 
+  // Starts connecting to the next addresses, until one of the attempts is
+  // pending. Returns OK if one of them connects right away, ERR_IO_PENDING if
+  // there are attempts in progress, or the error of the last attempt.
+  int StartAttempts();
+
+  // Keeps the socket of |attempt| and cancels all the other attempts.
+  void UseAttempt(ConnectAttempt* attempt);
+
+  // Called when |attempt| finishes connecting (asynchronously).
+  void OnAttemptComplete(ConnectAttempt* attempt, int result);
+
+  // Called when the current attempt takes longer than |stagger_delay_|.
+  void OnStaggerTimer();
+
   const HostResolver::RequestInfo resolve_info_;
   ClientSocketFactory* const client_socket_factory_;
   CompletionCallbackImpl<TCPConnectJob> callback_;
@@ -68,6 +93,14 @@ class TCPConnectJob : public ConnectJob {
   AddressList addresses_;
   State next_state_;
 
+  // State of the staggered connect.
+  const base::TimeDelta stagger_delay_;
+  ScopedVector<ConnectAttempt> attempts_;  // Attempts in progress.
+  const struct addrinfo* next_address_;  // The next address to try.
+  int next_address_index_;
+  int last_error_;
+  base::OneShotTimer<TCPConnectJob> stagger_timer_;
+
   // The time Connect() was called.
   base::TimeTicks start_time_;
 
@@ -95,6 +128,11 @@ class TCPClientSocketPool : public ClientSocketPool {
                             CompletionCallback* callback,
                             LoadLog* load_log);
 
+  virtual void RequestSockets(const std::string& group_name,
+                              const void* resolve_info,
+                              int num_sockets,
+                              LoadLog* load_log);
+
   virtual void CancelRequest(const std::string& group_name,
                              const ClientSocketHandle* handle);
 
@@ -112,6 +150,18 @@ class TCPClientSocketPool : public ClientSocketPool {
   virtual LoadState GetLoadState(const std::string& group_name,
                                  const ClientSocketHandle* handle) const;
 
+  // Counters of the sockets opened by RequestSockets().
+  const ClientSocketPoolBase<HostResolver::RequestInfo>::PreconnectStats&
+      preconnect_stats() const {
+    return base_.preconnect_stats();
+  }
+
+  // Sets the delay before a new address is tried, when the host has more than
+  // one address. Zero disables the staggered connect (see TCPConnectJob).
+  void set_stagger_delay(base::TimeDelta delay) {
+    connect_job_factory_->set_stagger_delay(delay);
+  }
+
  protected:
   virtual ~TCPClientSocketPool();
 
@@ -122,12 +172,12 @@ class TCPClientSocketPool : public ClientSocketPool {
       : public PoolBase::ConnectJobFactory {
    public:
     TCPConnectJobFactory(ClientSocketFactory* client_socket_factory,
-                         HostResolver* host_resolver)
-        : client_socket_factory_(client_socket_factory),
-          host_resolver_(host_resolver) {}
+                         HostResolver* host_resolver);
 
     virtual ~TCPConnectJobFactory() {}
 
+    void set_stagger_delay(base::TimeDelta delay) { stagger_delay_ = delay; }
+
     // ClientSocketPoolBase::ConnectJobFactory methods.
 
     virtual ConnectJob* NewConnectJob(
@@ -139,10 +189,12 @@ class TCPClientSocketPool : public ClientSocketPool {
    private:
     ClientSocketFactory* const client_socket_factory_;
     const scoped_refptr<HostResolver> host_resolver_;
+    base::TimeDelta stagger_delay_;
 
     DISALLOW_COPY_AND_ASSIGN(TCPConnectJobFactory);
   };
 
+  TCPConnectJobFactory* const connect_job_factory_;  // Owned by |base_|.
   PoolBase base_;
 
   DISALLOW_COPY_AND_ASSIGN(TCPClientSocketPool);
@@ -6,9 +6,12 @@
 
 #include "base/compiler_specific.h"
 #include "base/message_loop.h"
+#include "net/base/load_log.h"
+#include "net/base/load_log_unittest.h"
 #include "net/base/mock_host_resolver.h"
 #include "net/base/mock_network_change_notifier.h"
 #include "net/base/net_errors.h"
+#include "net/base/sys_addrinfo.h"
 #include "net/base/test_completion_callback.h"
 #include "net/socket/client_socket.h"
 #include "net/socket/client_socket_factory.h"
@@ -193,6 +196,37 @@ class MockClientSocketFactory : public ClientSocketFactory {
   ClientSocketType client_socket_type_;
 };
 
+// Resolves every host to 10.0.0.1, 10.0.0.2 and 10.0.0.3.
+class ThreeAddressesHostResolverProc : public HostResolverProc {
+ public:
+  ThreeAddressesHostResolverProc() : HostResolverProc(NULL) {}
+
+  virtual int Resolve(const std::string& host,
+                      AddressFamily address_family,
+                      AddressList* addrlist) {
+    struct sockaddr_in addrs[kNumAddresses];
+    struct addrinfo infos[kNumAddresses];
+    memset(addrs, 0, sizeof(addrs));
+    memset(infos, 0, sizeof(infos));
+    for (int i = 0; i < kNumAddresses; i++) {
+      addrs[i].sin_family = AF_INET;
+      addrs[i].sin_addr.s_addr = htonl(0x0a000001 + i);
+      infos[i].ai_family = AF_INET;
+      infos[i].ai_socktype = SOCK_STREAM;
+      infos[i].ai_addrlen = sizeof(addrs[i]);
+      infos[i].ai_addr = reinterpret_cast<struct sockaddr*>(&addrs[i]);
+      infos[i].ai_next = i + 1 < kNumAddresses ? &infos[i + 1] : NULL;
+    }
+    addrlist->Copy(infos);
+    return OK;
+  }
+
+ private:
+  static const int kNumAddresses = 3;
+
+  ~ThreeAddressesHostResolverProc() {}
+};
+
 class TCPClientSocketPoolTest : public ClientSocketPoolTest {
  protected:
   TCPClientSocketPoolTest()
@@ -610,6 +644,57 @@ TEST_F(TCPClientSocketPoolTest, ResetIdleSocketsOnIPAddressChange) {
   EXPECT_EQ(0, pool_->IdleSocketCount());
 }
 
+// The connect to the first address hangs and the second one fails, so the
+// third address should be used once the stagger delay elapses.
+TEST_F(TCPClientSocketPoolTest, StaggeredConnect) {
+  host_resolver_->Reset(new ThreeAddressesHostResolverProc);
+
+  StaticSocketDataProvider data[3];
+  data[0].set_connect_data(MockConnect(true, ERR_IO_PENDING));
+  data[1].set_connect_data(MockConnect(true, ERR_CONNECTION_REFUSED));
+  data[2].set_connect_data(MockConnect(true, OK));
+  net::MockClientSocketFactory factory;
+  for (size_t i = 0; i < arraysize(data); i++)
+    factory.AddSocketDataProvider(&data[i]);
+
+  scoped_refptr<TCPClientSocketPool> pool =
+      new TCPClientSocketPool(kMaxSockets, kMaxSocketsPerGroup,
+                              host_resolver_, &factory, notifier_);
+  pool->set_stagger_delay(base::TimeDelta::FromMilliseconds(10));
+
+  TestCompletionCallback callback;
+  ClientSocketHandle handle;
+  HostResolver::RequestInfo info("www.google.com", 80);
+  scoped_refptr<LoadLog> log(new LoadLog(LoadLog::kUnbounded));
+  int rv = handle.Init("a", info, LOW, &callback, pool.get(), log);
+  EXPECT_EQ(ERR_IO_PENDING, rv);
+
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_TRUE(handle.is_initialized());
+  EXPECT_TRUE(handle.socket());
+
+  const struct addrinfo* address =
+      factory.GetMockTCPClientSocket(2)->addresses().head();
+  ASSERT_TRUE(address);
+  EXPECT_EQ(htonl(0x0a000003),
+            reinterpret_cast<const struct sockaddr_in*>(
+                address->ai_addr)->sin_addr.s_addr);
+
+  ExpectLogContainsSomewhere(log, 0,
+                             LoadLog::TYPE_TCP_CONNECT_JOB_STAGGERED,
+                             LoadLog::PHASE_BEGIN);
+  bool found = false;
+  for (size_t i = 0; i < log->entries().size(); i++) {
+    const LoadLog::Entry& entry = log->entries()[i];
+    if (entry.type == LoadLog::Entry::TYPE_STRING &&
+        entry.string == "Connected to address #2")
+      found = true;
+  }
+  EXPECT_TRUE(found);
+
+  handle.Reset();
+}
+
 }  // namespace
 
 }  // namespace net
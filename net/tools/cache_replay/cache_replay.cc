@@ -0,0 +1,279 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// cache_replay is a command line utility that replays a trace captured by the
+// HttpCache (see net/http/http_cache_trace.h) against a disk cache, or an
+// in-memory cache, and reports the hit ratio, the latency of the cache
+// operations and the number of entries evicted.
+//
+// Usage: cache_replay [--cache-dir=<path> | --memory] [--cache-size=<bytes>]
+//                     [--speed=<factor>] <trace file>
+//
+// By default the trace is replayed as fast as possible. --speed=1 replays it
+// at the original speed, --speed=10 ten times faster, etc.
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/message_loop.h"
+#include "base/platform_thread.h"
+#include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "net/base/io_buffer.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/http/http_cache_trace.h"
+
+using base::TimeDelta;
+using base::TimeTicks;
+using net::HttpCacheTrace;
+
+namespace {
+
+const char kCacheDir[] = "cache-dir";
+const char kCacheSize[] = "cache-size";
+const char kMemory[] = "memory";
+const char kSpeed[] = "speed";
+
+// Roughly the size of the response info stored with each entry.
+const int kHeadersSize = 400;
+
+// Log2 histogram of latencies, in microseconds.
+class LatencyHistogram {
+ public:
+  LatencyHistogram() : count_(0) {
+    memset(buckets_, 0, sizeof(buckets_));
+  }
+
+  void Add(TimeDelta latency) {
+    int64 value = latency.InMicroseconds();
+    int bucket = 0;
+    while (value > 1 && bucket < kNumBuckets - 1) {
+      value >>= 1;
+      bucket++;
+    }
+    buckets_[bucket]++;
+    count_++;
+  }
+
+  void Print(const char* name) const {
+    printf("%s: %d operations\n", name, count_);
+    if (!count_)
+      return;
+
+    for (int i = 0; i < kNumBuckets; i++) {
+      if (!buckets_[i])
+        continue;
+      printf("  < %8d us: %7d (%5.1f%%)\n", 2 << i, buckets_[i],
+             buckets_[i] * 100.0 / count_);
+    }
+  }
+
+ private:
+  static const int kNumBuckets = 24;
+  int buckets_[kNumBuckets];
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+struct Results {
+  Results() : requests(0), hits(0), original_hits(0), bytes(0), hit_bytes(0),
+              entries_created(0), write_errors(0) {}
+
+  int requests;
+  int hits;
+  int original_hits;
+  int64 bytes;
+  int64 hit_bytes;
+  int entries_created;
+  int write_errors;
+  LatencyHistogram open_latency;
+  LatencyHistogram create_latency;
+  LatencyHistogram read_latency;
+  LatencyHistogram write_latency;
+};
+
+// Stores a new response for |record| on |entry|.
+void WriteEntry(disk_cache::Entry* entry, const HttpCacheTrace::Record& record,
+                net::IOBuffer* buffer, Results* results) {
+  TimeTicks start = TimeTicks::Now();
+  bool ok = entry->WriteData(0, 0, buffer, kHeadersSize, NULL, true) ==
+                kHeadersSize &&
+            entry->WriteData(1, 0, buffer, record.size, NULL, true) ==
+                record.size;
+  results->write_latency.Add(TimeTicks::Now() - start);
+  if (!ok)
+    results->write_errors++;
+}
+
+void ReplayRecord(disk_cache::Backend* cache,
+                  const HttpCacheTrace::Record& record,
+                  net::IOBuffer* buffer, Results* results) {
+  results->requests++;
+  results->bytes += record.size;
+  if (record.outcome == HttpCacheTrace::HIT ||
+      record.outcome == HttpCacheTrace::VALIDATED) {
+    results->original_hits++;
+  }
+
+  disk_cache::Entry* entry;
+  TimeTicks start = TimeTicks::Now();
+  bool found = cache->OpenEntry(record.key, &entry);
+  results->open_latency.Add(TimeTicks::Now() - start);
+
+  if (found) {
+    if (entry->GetDataSize(1) == record.size) {
+      results->hits++;
+      results->hit_bytes += record.size;
+      start = TimeTicks::Now();
+      int headers_size = std::min(entry->GetDataSize(0), kHeadersSize);
+      entry->ReadData(0, 0, buffer, headers_size, NULL);
+      entry->ReadData(1, 0, buffer, record.size, NULL);
+      results->read_latency.Add(TimeTicks::Now() - start);
+
+      // A validation only updates the stored headers.
+      if (record.outcome == HttpCacheTrace::VALIDATED) {
+        start = TimeTicks::Now();
+        entry->WriteData(0, 0, buffer, kHeadersSize, NULL, true);
+        results->write_latency.Add(TimeTicks::Now() - start);
+      }
+    } else {
+      // The resource changed.
+      WriteEntry(entry, record, buffer, results);
+    }
+    entry->Close();
+    return;
+  }
+
+  start = TimeTicks::Now();
+  bool created = cache->CreateEntry(record.key, &entry);
+  results->create_latency.Add(TimeTicks::Now() - start);
+  if (!created) {
+    results->write_errors++;
+    return;
+  }
+  results->entries_created++;
+  WriteEntry(entry, record, buffer, results);
+  entry->Close();
+}
+
+double Percent(int64 value, int64 total) {
+  return total ? value * 100.0 / total : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  MessageLoop message_loop(MessageLoop::TYPE_IO);
+  CommandLine::Init(argc, argv);
+  CommandLine* command_line = CommandLine::ForCurrentProcess();
+
+  std::vector<std::wstring> values = command_line->GetLooseValues();
+  bool memory = command_line->HasSwitch(kMemory);
+  FilePath cache_dir = command_line->GetSwitchValuePath(kCacheDir);
+  if (values.size() != 1 || memory == !cache_dir.empty()) {
+    printf("Usage: cache_replay [--cache-dir=<path> | --memory] "
+           "[--cache-size=<bytes>] [--speed=<factor>] <trace file>\n");
+    return 1;
+  }
+
+  int64 cache_size = 0;
+  if (command_line->HasSwitch(kCacheSize)) {
+    std::string value = command_line->GetSwitchValueASCII(kCacheSize);
+    if (!StringToInt64(value, &cache_size) || cache_size <= 0 ||
+        cache_size > kint32max) {
+      printf("Invalid --cache-size value: %s\n", value.c_str());
+      return 1;
+    }
+  }
+
+  double speed = 0;
+  if (command_line->HasSwitch(kSpeed)) {
+    std::string value = command_line->GetSwitchValueASCII(kSpeed);
+    if (!StringToDouble(value, &speed) || speed <= 0) {
+      printf("Invalid --speed value: %s\n", value.c_str());
+      return 1;
+    }
+  }
+
+  std::vector<HttpCacheTrace::Record> records;
+  FilePath trace_path = FilePath::FromWStringHack(values[0]);
+  if (!HttpCacheTrace::ReadTrace(trace_path, &records)) {
+    printf("Unable to read the trace %ls\n",
+           trace_path.ToWStringHack().c_str());
+    return 1;
+  }
+
+  scoped_ptr<disk_cache::Backend> cache;
+  if (memory) {
+    cache.reset(disk_cache::CreateInMemoryCacheBackend(
+        static_cast<int>(cache_size)));
+  } else {
+    cache.reset(disk_cache::CreateCacheBackend(
+        cache_dir, true, static_cast<int>(cache_size), net::DISK_CACHE));
+  }
+  if (!cache.get()) {
+    printf("Unable to initialize the cache\n");
+    return 1;
+  }
+  int initial_entries = cache->GetEntryCount();
+
+  int max_size = kHeadersSize;
+  for (size_t i = 0; i < records.size(); i++)
+    max_size = std::max(max_size, static_cast<int>(records[i].size));
+  scoped_refptr<net::IOBuffer> buffer = new net::IOBuffer(max_size);
+  memset(buffer->data(), 0, max_size);
+
+  Results results;
+  TimeTicks start = TimeTicks::Now();
+  for (size_t i = 0; i < records.size(); i++) {
+    const HttpCacheTrace::Record& record = records[i];
+    if (record.outcome == HttpCacheTrace::PASS_THROUGH || record.size < 0)
+      continue;
+
+    if (speed) {
+      TimeDelta target = TimeDelta::FromMicroseconds(
+          static_cast<int64>(record.time.InMicroseconds() / speed));
+      TimeDelta elapsed = TimeTicks::Now() - start;
+      if (target > elapsed)
+        PlatformThread::Sleep(
+            static_cast<int>((target - elapsed).InMilliseconds()));
+    }
+
+    ReplayRecord(cache.get(), record, buffer, &results);
+
+    // Let the cache perform its background work.
+    MessageLoop::current()->RunAllPending();
+  }
+  TimeDelta total_time = TimeTicks::Now() - start;
+
+  int evicted = initial_entries + results.entries_created -
+                cache->GetEntryCount();
+  printf("%d requests replayed in %d ms\n", results.requests,
+         static_cast<int>(total_time.InMilliseconds()));
+  printf("Hit ratio: %.2f%% (original %.2f%%)\n",
+         Percent(results.hits, results.requests),
+         Percent(results.original_hits, results.requests));
+  printf("Byte hit ratio: %.2f%%\n",
+         Percent(results.hit_bytes, results.bytes));
+  printf("Entries created: %d, evicted: %d, write errors: %d\n",
+         results.entries_created, evicted, results.write_errors);
+  results.open_latency.Print("Open");
+  results.create_latency.Print("Create");
+  results.read_latency.Print("Read");
+  results.write_latency.Print("Write");
+
+  cache.reset();
+  CommandLine::Reset();
+  return 0;
+}
@@ -64,6 +64,7 @@ void DumpIndexHeader(const std::wstring& name) {
   printf("table length: %d\n", header.table_len);
   printf("last crash: %d\n", header.crash);
   printf("experiment: %d\n", header.experiment);
+  printf("large blocks: %d\n", header.large_blocks);
   for (int i = 0; i < 5; i++) {
     printf("head %d: 0x%x\n", i, header.lru.heads[i]);
     printf("tail %d: 0x%x\n", i, header.lru.tails[i]);
@@ -95,10 +96,11 @@ void DumpBlockHeader(const std::wstring& name) {
   printf("empty sz 2: %d\n", header.empty[1]);
   printf("empty sz 3: %d\n", header.empty[2]);
   printf("empty sz 4: %d\n", header.empty[3]);
+  printf("16k blocks file: %d\n", header.large_files[0]);
+  printf("64k blocks file: %d\n", header.large_files[1]);
   printf("user 0: 0x%x\n", header.user[0]);
   printf("user 1: 0x%x\n", header.user[1]);
   printf("user 2: 0x%x\n", header.user[2]);
-  printf("user 3: 0x%x\n", header.user[3]);
   printf("-------------------------\n\n");
 }
 
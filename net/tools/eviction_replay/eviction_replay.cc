@@ -0,0 +1,173 @@
+// Copyright (c) 2009 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// eviction_replay is a command line utility that replays a trace of cache
+// accesses through each one of the disk cache eviction policies (see
+// net/disk_cache/eviction_policy.h), and reports the hit ratio and byte hit
+// ratio of each policy for a given cache size.
+//
+// Usage: eviction_replay [--cache-size=<bytes>] <trace file>
+//
+// Each line of the trace describes one access to the cache, with the key of
+// the resource and its size in bytes:
+//   http://www.google.com/ 12345
+// Lines that start with '#' are ignored. When the size of a resource changes,
+// the access is considered a miss (the resource is fetched again).
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/hash_tables.h"
+#include "base/scoped_ptr.h"
+#include "base/string_util.h"
+#include "net/disk_cache/eviction_policy.h"
+
+namespace {
+
+const char kCacheSize[] = "cache-size";
+
+// The default size of the simulated cache.
+const int64 kDefaultCacheSize = 80 * 1024 * 1024;
+
+struct Access {
+  std::string key;
+  int64 size;
+};
+
+struct Results {
+  int64 requests;
+  int64 hits;
+  int64 bytes;
+  int64 hit_bytes;
+};
+
+bool ReadTrace(const FilePath& path, std::vector<Access>* trace) {
+  std::string file_contents;
+  if (!file_util::ReadFileToString(path, &file_contents)) {
+    printf("Unable to read %ls\n", path.ToWStringHack().c_str());
+    return false;
+  }
+
+  std::vector<std::string> lines;
+  SplitString(file_contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::vector<std::string> tokens;
+    SplitStringAlongWhitespace(lines[i], &tokens);
+    if (tokens.empty() || tokens[0][0] == '#')
+      continue;
+
+    Access access;
+    if (tokens.size() != 2 || !StringToInt64(tokens[1], &access.size) ||
+        access.size < 0) {
+      printf("Invalid line %d: %s\n", static_cast<int>(i + 1),
+             lines[i].c_str());
+      continue;
+    }
+    access.key = tokens[0];
+    trace->push_back(access);
+  }
+  return true;
+}
+
+// Replays |trace| on a cache of |max_bytes| managed by |policy|.
+void Replay(const std::vector<Access>& trace, int64 max_bytes,
+            disk_cache::EvictionPolicy* policy, Results* results) {
+  typedef base::hash_map<std::string, int64> EntryMap;
+  EntryMap entries;
+  int64 current_bytes = 0;
+  memset(results, 0, sizeof(*results));
+
+  for (size_t i = 0; i < trace.size(); i++) {
+    const Access& access = trace[i];
+    results->requests++;
+    results->bytes += access.size;
+
+    EntryMap::iterator it = entries.find(access.key);
+    if (it != entries.end() && it->second == access.size) {
+      results->hits++;
+      results->hit_bytes += access.size;
+      policy->OnAccess(access.key);
+      continue;
+    }
+
+    if (it != entries.end()) {
+      // The resource changed.
+      policy->OnRemove(access.key);
+      current_bytes -= it->second;
+      entries.erase(it);
+    }
+
+    // Just like the real cache, don't store resources that are too big.
+    if (access.size > max_bytes / 8)
+      continue;
+
+    entries[access.key] = access.size;
+    current_bytes += access.size;
+    policy->OnInsert(access.key, access.size);
+
+    std::string victim;
+    while (current_bytes > max_bytes && policy->Evict(&victim)) {
+      it = entries.find(victim);
+      if (it == entries.end())
+        continue;
+      current_bytes -= it->second;
+      entries.erase(it);
+    }
+  }
+}
+
+double Percent(int64 value, int64 total) {
+  return total ? value * 100.0 / total : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager at_exit_manager;
+  CommandLine::Init(argc, argv);
+  CommandLine* command_line = CommandLine::ForCurrentProcess();
+
+  int64 cache_size = kDefaultCacheSize;
+  if (command_line->HasSwitch(kCacheSize)) {
+    std::string value = command_line->GetSwitchValueASCII(kCacheSize);
+    if (!StringToInt64(value, &cache_size) || cache_size <= 0) {
+      printf("Invalid --cache-size value: %s\n", value.c_str());
+      return 1;
+    }
+  }
+
+  std::vector<std::wstring> values = command_line->GetLooseValues();
+  if (values.size() != 1) {
+    printf("Usage: eviction_replay [--cache-size=<bytes>] <trace file>\n");
+    return 1;
+  }
+
+  std::vector<Access> trace;
+  if (!ReadTrace(FilePath::FromWStringHack(values[0]), &trace))
+    return 1;
+
+  printf("%d accesses, cache size: %s bytes\n", static_cast<int>(trace.size()),
+         Int64ToString(cache_size).c_str());
+  printf("%-12s %10s %10s\n", "Policy", "Hit ratio", "Byte hits");
+
+  for (int i = 0; i < disk_cache::NUM_EVICTION_POLICIES; i++) {
+    scoped_ptr<disk_cache::EvictionPolicy> policy(
+        disk_cache::EvictionPolicy::Create(
+            static_cast<disk_cache::EvictionPolicyType>(i), cache_size));
+    Results results;
+    Replay(trace, cache_size, policy.get(), &results);
+    printf("%-12s %9.2f%% %9.2f%%\n", policy->GetName(),
+           Percent(results.hits, results.requests),
+           Percent(results.hit_bytes, results.bytes));
+  }
+
+  CommandLine::Reset();
+  return 0;
+}
@@ -14,12 +14,24 @@
 // The user can also control whether the lookups happen asynchronously
 // or synchronously by specifying --async on the command line.
 //
+// With --dns-client, the lookups use the built-in DNS client rather than
+// getaddrinfo(), with the name servers of /etc/resolv.conf, or the one given
+// by --dns-server (on port --dns-port, 53 by default).
+//
+// With --benchmark, the results are not printed; instead the number of
+// lookups per second is reported once all of them are done. For example,
+// against the stand-in server of net/tools/testserver/dns_server.py:
+//   hresolv --async --benchmark --dns-client --dns-server=127.0.0.1
+//       --dns-port=5353 --cache-size=0 --input-path=hosts.txt
+//
 // Future ideas:
 //   Specify whether the lookup is speculative.
 //   Interleave synchronous and asynchronous lookups.
 //   Specify the address family.
 
 #include <stdio.h>
+
+#include <algorithm>
 #include <string>
 
 #include "base/at_exit.h"
@@ -27,12 +39,15 @@
 #include "base/condition_variable.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/format_macros.h"
 #include "base/string_util.h"
 #include "base/thread.h"
 #include "base/time.h"
 #include "base/waitable_event.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
+#include "net/base/dns_client.h"
+#include "net/base/dns_config.h"
 #include "net/base/host_resolver_impl.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
@@ -229,10 +244,13 @@ struct HostAndTime {
 // Invokes a sequence of host resolutions at specified times.
 class ResolverInvoker {
  public:
-  explicit ResolverInvoker(net::HostResolver* resolver)
-      : message_loop_(MessageLoop::TYPE_DEFAULT),
+  // The message loop is a MessageLoopForIO, for the DNS client.
+  ResolverInvoker(net::HostResolver* resolver, bool benchmark)
+      : message_loop_(MessageLoop::TYPE_IO),
         resolver_(resolver),
-        remaining_requests_(0) {
+        benchmark_(benchmark),
+        remaining_requests_(0),
+        failed_requests_(0) {
   }
 
   ~ResolverInvoker() {
@@ -249,9 +267,11 @@ class ResolverInvoker {
   // asynchronously - this can be used to have multiple requests in flight at
   // the same time.
   //
-  // ResolveAll will block until all resolutions are complete.
+  // ResolveAll will block until all resolutions are complete. In benchmark
+  // mode, it then prints the throughput.
   void ResolveAll(const std::vector<HostAndTime>& hosts_and_times,
                   bool async) {
+    base::TimeTicks start_time = base::TimeTicks::Now();
     // Schedule all tasks on our message loop, and then run.
     int num_requests = hosts_and_times.size();
     remaining_requests_ = num_requests;
@@ -267,6 +287,14 @@ class ResolverInvoker {
           host_and_time.delta_in_milliseconds);
     }
     message_loop_.Run();
+
+    if (benchmark_) {
+      base::TimeDelta elapsed = base::TimeTicks::Now() - start_time;
+      double seconds = std::max(elapsed.InSecondsF(), 0.001);
+      printf("%d lookups (%d failed) in %" PRId64 " ms: %.1f lookups/s\n",
+             num_requests, failed_requests_, elapsed.InMilliseconds(),
+             num_requests / seconds);
+    }
   }
 
  private:
@@ -274,7 +302,11 @@ class ResolverInvoker {
 
   void OnResolved(int err, net::AddressList* address_list,
                   const std::string& host) {
-    if (err == net::OK) {
+    if (err != net::OK)
+      ++failed_requests_;
+    if (benchmark_) {
+      // Only the throughput is printed.
+    } else if (err == net::OK) {
       printf("%s", FormatAddressList(*address_list, host).c_str());
     } else {
       printf("Error resolving %s\n", host.c_str());
@@ -288,7 +320,9 @@ class ResolverInvoker {
 
   MessageLoop message_loop_;
   scoped_refptr<net::HostResolver> resolver_;
+  bool benchmark_;
   int remaining_requests_;
+  int failed_requests_;
 };
 
 void DelayedResolve::OnResolveComplete(int result) {
@@ -302,7 +336,10 @@ struct CommandLineOptions {
         async(false),
         cache_size(100),
         cache_ttl(50),
-        input_path() {
+        input_path(),
+        benchmark(false),
+        dns_client(false),
+        dns_port(53) {
   }
 
   bool verbose;
@@ -310,12 +347,20 @@ struct CommandLineOptions {
   int cache_size;
   int cache_ttl;
   FilePath input_path;
+  bool benchmark;
+  bool dns_client;
+  std::string dns_server;
+  int dns_port;
 };
 
 const char* kAsync = "async";
 const char* kCacheSize = "cache-size";
 const char* kCacheTtl = "cache-ttl";
 const char* kInputPath = "input-path";
+const char* kBenchmark = "benchmark";
+const char* kDnsClient = "dns-client";
+const char* kDnsServer = "dns-server";
+const char* kDnsPort = "dns-port";
 
 // Parses the command line values. Returns false if there is a problem,
 // options otherwise.
@@ -349,6 +394,31 @@ bool ParseCommandLine(CommandLine* command_line, CommandLineOptions* options) {
     options->input_path = command_line->GetSwitchValuePath(kInputPath);
   }
 
+  options->benchmark = command_line->HasSwitch(kBenchmark);
+  options->dns_client = command_line->HasSwitch(kDnsClient);
+  if (command_line->HasSwitch(kDnsServer)) {
+    options->dns_server = command_line->GetSwitchValueASCII(kDnsServer);
+  }
+
+  if (command_line->HasSwitch(kDnsPort)) {
+    std::string dns_port = command_line->GetSwitchValueASCII(kDnsPort);
+    bool valid_port = StringToInt(dns_port, &options->dns_port);
+    if (valid_port) {
+      valid_port = options->dns_port > 0 && options->dns_port < 65536;
+    }
+    if (!valid_port) {
+      printf("Invalid --dns-port value: %s\n", dns_port.c_str());
+      return false;
+    }
+  }
+
+#if !defined(OS_POSIX)
+  if (options->dns_client) {
+    printf("--dns-client is only supported on POSIX\n");
+    return false;
+  }
+#endif
+
   return true;
 }
 
@@ -445,9 +515,32 @@ int main(int argc, char** argv) {
       base::TimeDelta::FromMilliseconds(options.cache_ttl),
       base::TimeDelta::FromSeconds(0));
 
-  scoped_refptr<net::HostResolver> host_resolver(
+  scoped_refptr<net::HostResolverImpl> host_resolver(
       new net::HostResolverImpl(NULL, cache));
-  ResolverInvoker invoker(host_resolver.get());
+#if defined(OS_POSIX)
+  if (options.dns_client) {
+    net::DnsConfig config;
+    if (!net::ReadSystemDnsConfig(&config) && options.dns_server.empty()) {
+      printf("No name server in /etc/resolv.conf\n");
+      exit(1);
+    }
+    if (!options.dns_server.empty()) {
+      std::string packed;
+      if (!net::ParseIPLiteral(options.dns_server, &packed)) {
+        printf("Invalid --dns-server value: %s\n",
+               options.dns_server.c_str());
+        exit(1);
+      }
+      config.nameservers.clear();
+      config.nameservers.push_back(net::AddressList::CreateFromIPAddresses(
+          std::vector<std::string>(1, packed), 53));
+    }
+    for (size_t i = 0; i < config.nameservers.size(); ++i)
+      config.nameservers[i].SetPort(options.dns_port);
+    host_resolver->set_dns_client(net::CreateAsyncDnsClient(config));
+  }
+#endif
+  ResolverInvoker invoker(host_resolver.get(), options.benchmark);
   invoker.ResolveAll(hosts_and_times, options.async);
 
   CommandLine::Reset();
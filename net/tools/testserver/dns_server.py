@@ -0,0 +1,209 @@
+#!/usr/bin/python2.4
+# Copyright (c) 2009 The Chromium Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""This is a simple DNS server used for testing the built-in DNS client.
+
+It answers the A and AAAA queries over UDP and TCP, from a file in the hosts
+format (--hosts) and/or with a fixed address for every other name
+(--default-address); the other names get NXDOMAIN. It defaults to living on
+127.0.0.1:5353. With --truncate, the UDP responses are truncated, so that the
+client retries over TCP.
+
+To use it with hresolv, run:
+  hresolv --dns-client --dns-server=127.0.0.1 --dns-port=5353
+"""
+
+import optparse
+import socket
+import SocketServer
+import struct
+import sys
+import threading
+
+TYPE_A = 1
+TYPE_AAAA = 28
+CLASS_IN = 1
+
+RCODE_NOERROR = 0
+RCODE_FORMERR = 1
+RCODE_NXDOMAIN = 3
+
+FLAG_RESPONSE = 0x8000
+FLAG_AUTHORITATIVE = 0x0400
+FLAG_TRUNCATED = 0x0200
+FLAG_RECURSION_DESIRED = 0x0100
+FLAG_RECURSION_AVAILABLE = 0x0080
+
+
+def ParseHosts(path):
+  """Returns a map of the lowercase hostnames of the hosts file |path| to the
+  list of their (family, packed address) pairs."""
+  hosts = {}
+  for line in open(path):
+    line = line.split('#', 1)[0].split()
+    if len(line) < 2:
+      continue
+    address = None
+    for family in (socket.AF_INET, socket.AF_INET6):
+      try:
+        address = (family, socket.inet_pton(family, line[0]))
+        break
+      except socket.error:
+        pass
+    if not address:
+      continue
+    for name in line[1:]:
+      hosts.setdefault(name.lower(), []).append(address)
+  return hosts
+
+
+def ParseQuestion(query):
+  """Returns (id, flags, name, qtype, end of question) for |query|, or None if
+  it is not a valid query."""
+  if len(query) < 12:
+    return None
+  id, flags, qdcount = struct.unpack('!HHH', query[:6])
+  if qdcount != 1 or flags & FLAG_RESPONSE:
+    return None
+  labels = []
+  pos = 12
+  while True:
+    if pos >= len(query):
+      return None
+    length = ord(query[pos])
+    if length == 0:
+      pos += 1
+      break
+    if length & 0xc0:
+      return None  # Queries are not compressed.
+    labels.append(query[pos + 1:pos + 1 + length])
+    pos += 1 + length
+  if pos + 4 > len(query):
+    return None
+  qtype, qclass = struct.unpack('!HH', query[pos:pos + 4])
+  return (id, flags, '.'.join(labels).lower(), qtype, pos + 4)
+
+
+class DnsResolver:
+  """Builds the responses."""
+
+  def __init__(self, hosts, default_address, ttl, truncate):
+    self.hosts = hosts
+    self.default_address = default_address
+    self.ttl = ttl
+    self.truncate = truncate
+    self.lock = threading.Lock()
+    self.queries = 0
+
+  def Respond(self, query, is_udp):
+    self.lock.acquire()
+    self.queries += 1
+    self.lock.release()
+
+    question = ParseQuestion(query)
+    if not question:
+      if len(query) < 2:
+        return None
+      return query[:2] + struct.pack('!HHHHH', FLAG_RESPONSE | RCODE_FORMERR,
+                                     0, 0, 0, 0)
+    id, flags, name, qtype, end = question
+
+    addresses = self.hosts.get(name)
+    if addresses is None and self.default_address:
+      addresses = [self.default_address]
+
+    rcode = RCODE_NOERROR
+    answers = []
+    if addresses is None:
+      rcode = RCODE_NXDOMAIN
+    else:
+      family = {TYPE_A: socket.AF_INET, TYPE_AAAA: socket.AF_INET6}.get(qtype)
+      for address_family, packed in addresses:
+        if address_family == family:
+          # The owner name points to the question.
+          answers.append(struct.pack('!HHHIH', 0xc00c, qtype, CLASS_IN,
+                                     self.ttl, len(packed)) + packed)
+
+    flags = (FLAG_RESPONSE | FLAG_AUTHORITATIVE | FLAG_RECURSION_AVAILABLE |
+             (flags & FLAG_RECURSION_DESIRED) | rcode)
+    if is_udp and self.truncate and answers:
+      flags |= FLAG_TRUNCATED
+      answers = []
+    header = struct.pack('!HHHHHH', id, flags, 1, len(answers), 0, 0)
+    return header + query[12:end] + ''.join(answers)
+
+
+class UDPHandler(SocketServer.BaseRequestHandler):
+  def handle(self):
+    query, sock = self.request
+    response = self.server.resolver.Respond(query, True)
+    if response:
+      sock.sendto(response, self.client_address)
+
+
+class TCPHandler(SocketServer.StreamRequestHandler):
+  def handle(self):
+    while True:
+      length = self.rfile.read(2)
+      if len(length) < 2:
+        return
+      query = self.rfile.read(struct.unpack('!H', length)[0])
+      response = self.server.resolver.Respond(query, False)
+      if not response:
+        return
+      self.wfile.write(struct.pack('!H', len(response)) + response)
+
+
+class ThreadingTCPServer(SocketServer.ThreadingTCPServer):
+  allow_reuse_address = True
+
+
+def main(options, args):
+  hosts = {}
+  if options.hosts:
+    hosts = ParseHosts(options.hosts)
+  default_address = None
+  if options.default_address:
+    default_address = (socket.AF_INET,
+                       socket.inet_aton(options.default_address))
+  resolver = DnsResolver(hosts, default_address, options.ttl,
+                         options.truncate)
+
+  address = ('127.0.0.1', options.port)
+  udp_server = SocketServer.UDPServer(address, UDPHandler)
+  udp_server.resolver = resolver
+  tcp_server = ThreadingTCPServer(address, TCPHandler)
+  tcp_server.resolver = resolver
+
+  tcp_thread = threading.Thread(target=tcp_server.serve_forever)
+  tcp_thread.setDaemon(True)
+  tcp_thread.start()
+
+  print 'DNS server started on port %d...' % options.port
+  try:
+    udp_server.serve_forever()
+  except KeyboardInterrupt:
+    print 'shutting down server, %d queries' % resolver.queries
+  return 0
+
+
+if __name__ == '__main__':
+  option_parser = optparse.OptionParser()
+  option_parser.add_option('', '--port', default='5353', type='int',
+                           help='Port used by the server')
+  option_parser.add_option('', '--hosts', dest='hosts',
+                           help='File in the hosts format with the names to '
+                           'answer')
+  option_parser.add_option('', '--default-address', dest='default_address',
+                           help='IPv4 address of the names that are not in '
+                           'the hosts file')
+  option_parser.add_option('', '--ttl', default='60', type='int',
+                           help='TTL of the records, in seconds')
+  option_parser.add_option('', '--truncate', action='store_true',
+                           default=False,
+                           help='Truncate the UDP responses')
+  options, args = option_parser.parse_args()
+
+  sys.exit(main(options, args))
@@ -235,7 +235,7 @@ class HostResolverCacheSubSection : public SubSection {
          it != host_cache->entries().end();
          ++it) {
       const net::HostCache::Key& key = it->first;
-      const net::HostCache::Entry* entry = it->second.get();
+      const net::HostCache::Entry* entry = &it->second;
 
       std::string address_family_str =
           AddressFamilyToString(key.address_family);